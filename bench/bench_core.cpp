@@ -0,0 +1,403 @@
+#include "bench_harness.hpp"
+#include "capture/capture_reader.hpp"
+#include "market/market_data.hpp"
+#include "order/orderbook.hpp"
+#include "utils/config.hpp"
+#include "utils/logger.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+
+// Baseline timings of the hot paths: order book maintenance, feed parsing,
+// logging under contention, config lookups and order serialization.
+//
+//   bench_core                              table on stdout
+//   bench_core --json results.json          also write machine-readable results
+//   bench_core --filter orderbook --scale 0.1
+//   bench_core --capture captures/          add a case replaying recorded frames
+
+namespace {
+    constexpr const char* kInstrument = "BTC-PERPETUAL";
+    constexpr int kBookLevels = 50;
+    constexpr size_t kFrameCycle = 1024;
+
+    struct Options {
+        std::string jsonPath;
+        std::string filter;
+        std::string capture;
+        double scale = 1.0;
+    };
+
+    void usage() {
+        std::cerr <<
+            "Usage: bench_core [options]\n"
+            "  --json FILE            also write the results as JSON to FILE\n"
+            "  --filter TEXT          only cases whose name contains TEXT\n"
+            "  --scale X              multiply every iteration count by X\n"
+            "  --capture PATH         also time MarketDataManager on a FrameRecorder capture\n";
+    }
+
+    Options parseOptions(int argc, char* argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(0);
+            }
+            if (arg == "--json" && i + 1 < argc) {
+                options.jsonPath = argv[++i];
+            } else if (arg == "--filter" && i + 1 < argc) {
+                options.filter = argv[++i];
+            } else if (arg == "--scale" && i + 1 < argc) {
+                options.scale = std::stod(argv[++i]);
+            } else if (arg == "--capture" && i + 1 < argc) {
+                options.capture = argv[++i];
+            } else {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+        return options;
+    }
+
+    // Frames shaped like the exchange's book, ticker and trades
+    // notifications. Increments continue the snapshot's change_id so
+    // MarketDataManager applies them as a gap-free sequence.
+    std::string levelList(const char* action, double start, double step, int count) {
+        std::string out = "[";
+        char level[96];
+        for (int i = 0; i < count; ++i) {
+            std::snprintf(level, sizeof(level), "%s[\"%s\",%.1f,%.1f]", i ? "," : "",
+                          action, start + step * i, 1000.0 + 10.0 * (i % 17));
+            out += level;
+        }
+        return out + "]";
+    }
+
+    std::string bookSnapshotFrame(int64_t changeId) {
+        return std::string("{\"jsonrpc\":\"2.0\",\"method\":\"subscription\",\"params\":{"
+                           "\"channel\":\"book.BTC-PERPETUAL.100ms\",\"data\":{"
+                           "\"type\":\"snapshot\",\"timestamp\":1700000000000,"
+                           "\"instrument_name\":\"BTC-PERPETUAL\",\"change_id\":") +
+               std::to_string(changeId) +
+               ",\"bids\":" + levelList("new", 42999.5, -0.5, kBookLevels) +
+               ",\"asks\":" + levelList("new", 43000.0, 0.5, kBookLevels) + "}}}";
+    }
+
+    std::string bookChangeFrame(int64_t changeId, std::mt19937& random) {
+        static const char* kActions[] = {"new", "change", "delete"};
+        std::string bids = "[";
+        std::string asks = "[";
+        char level[96];
+        int changes = 1 + static_cast<int>(random() % 4);
+        for (int i = 0; i < changes; ++i) {
+            bool bid = random() & 1;
+            double offset = 0.5 * static_cast<double>(random() % kBookLevels);
+            std::snprintf(level, sizeof(level), "%s[\"%s\",%.1f,%.1f]",
+                          (bid ? bids : asks).size() > 1 ? "," : "", kActions[random() % 3],
+                          bid ? 42999.5 - offset : 43000.0 + offset,
+                          10.0 * static_cast<double>(1 + random() % 500));
+            (bid ? bids : asks) += level;
+        }
+        return std::string("{\"jsonrpc\":\"2.0\",\"method\":\"subscription\",\"params\":{"
+                           "\"channel\":\"book.BTC-PERPETUAL.100ms\",\"data\":{"
+                           "\"type\":\"change\",\"timestamp\":1700000000100,"
+                           "\"instrument_name\":\"BTC-PERPETUAL\",\"prev_change_id\":") +
+               std::to_string(changeId - 1) + ",\"change_id\":" + std::to_string(changeId) +
+               ",\"bids\":" + bids + "],\"asks\":" + asks + "]}}}";
+    }
+
+    const char* kTickerFrame =
+        "{\"jsonrpc\":\"2.0\",\"method\":\"subscription\",\"params\":{"
+        "\"channel\":\"ticker.BTC-PERPETUAL.100ms\",\"data\":{"
+        "\"timestamp\":1700000000123,\"stats\":{\"volume_usd\":412345670.0,\"volume\":9587.3,"
+        "\"price_change\":1.2,\"low\":42100.0,\"high\":43350.5},\"state\":\"open\","
+        "\"settlement_price\":42890.12,\"open_interest\":654321000,\"min_price\":42355.5,"
+        "\"max_price\":43645.0,\"mark_price\":43000.21,\"last_price\":43000.5,"
+        "\"interest_value\":0.0123,\"instrument_name\":\"BTC-PERPETUAL\",\"index_price\":42995.87,"
+        "\"funding_8h\":0.0000312,\"estimated_delivery_price\":42995.87,\"current_funding\":0.0,"
+        "\"best_bid_price\":42999.5,\"best_bid_amount\":12340.0,"
+        "\"best_ask_price\":43000.0,\"best_ask_amount\":5670.0}}}";
+
+    const char* kTradesFrame =
+        "{\"jsonrpc\":\"2.0\",\"method\":\"subscription\",\"params\":{"
+        "\"channel\":\"trades.BTC-PERPETUAL.100ms\",\"data\":["
+        "{\"trade_seq\":123456789,\"trade_id\":\"234567890\",\"timestamp\":1700000000150,"
+        "\"tick_direction\":0,\"price\":43000.0,\"mark_price\":43000.21,\"instrument_name\":\"BTC-PERPETUAL\","
+        "\"index_price\":42995.87,\"direction\":\"buy\",\"amount\":2500.0},"
+        "{\"trade_seq\":123456790,\"trade_id\":\"234567891\",\"timestamp\":1700000000151,"
+        "\"tick_direction\":1,\"price\":43000.0,\"mark_price\":43000.21,\"instrument_name\":\"BTC-PERPETUAL\","
+        "\"index_price\":42995.87,\"direction\":\"buy\",\"amount\":700.0}]}}";
+
+    void benchOrderBook(bench::Suite& suite) {
+        std::map<double, double> bids, asks;
+        for (int i = 0; i < kBookLevels; ++i) {
+            bids[42999.5 - 0.5 * i] = 1000.0 + i;
+            asks[43000.0 + 0.5 * i] = 1000.0 + i;
+        }
+
+        OrderBook book(kInstrument);
+        suite.run("orderbook.snapshot_load_50x50", 20000, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                book.updateFromSnapshot(bids, asks);
+            }
+            return static_cast<uint64_t>(book.getDepth(OrderSide::BUY));
+        });
+
+        // Random touches inside the book: inserts, changes and deletes
+        std::mt19937 random(42);
+        std::vector<std::tuple<OrderSide, double, double>> updates(4096);
+        for (auto& update : updates) {
+            bool bid = random() & 1;
+            double offset = 0.5 * static_cast<double>(random() % (kBookLevels + 10));
+            double volume = (random() % 5 == 0) ? 0.0 : 10.0 * static_cast<double>(1 + random() % 500);
+            update = {bid ? OrderSide::BUY : OrderSide::SELL, bid ? 42999.5 - offset : 43000.0 + offset, volume};
+        }
+        book.updateFromSnapshot(bids, asks);
+        suite.run("orderbook.incremental_update", 2000000, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                const auto& [side, price, volume] = updates[i & (updates.size() - 1)];
+                book.processIncrementalUpdate(side, price, volume);
+            }
+            return static_cast<uint64_t>(book.getDepth(OrderSide::SELL));
+        });
+
+        book.updateFromSnapshot(bids, asks);
+        suite.run("orderbook.best_bid_ask", 5000000, [&](size_t iterations) {
+            double total = 0.0;
+            for (size_t i = 0; i < iterations; ++i) {
+                total += book.getBestBid() + book.getBestAsk();
+            }
+            return static_cast<uint64_t>(total);
+        });
+
+        suite.run("orderbook.top_levels_10", 2000000, [&](size_t iterations) {
+            std::pair<double, double> levels[10];
+            uint64_t total = 0;
+            for (size_t i = 0; i < iterations; ++i) {
+                total += book.getTopLevels((i & 1) ? OrderSide::BUY : OrderSide::SELL, levels, 10);
+            }
+            return total;
+        });
+
+        suite.run("orderbook.depth_copy_50", 100000, [&](size_t iterations) {
+            uint64_t total = 0;
+            for (size_t i = 0; i < iterations; ++i) {
+                total += book.getBidLevels().size() + book.getAskLevels().size();
+            }
+            return total;
+        });
+    }
+
+    void benchFrames(bench::Suite& suite, deribit::MarketDataManager& marketData,
+                     const std::string& name, const std::vector<std::string>& frames, size_t iterations) {
+        suite.run(name, iterations, [&](size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                marketData.processMessage(frames[i % frames.size()]);
+            }
+            return static_cast<uint64_t>(count);
+        });
+    }
+
+    void benchMarketData(bench::Suite& suite, const std::string& capture) {
+        deribit::MarketDataManager marketData("wss://test.deribit.com/ws/api/v2");
+        marketData.addOrderBook(kInstrument);
+        uint64_t callbacks = 0;
+        marketData.setOrderBookCallback([&](const std::string&, const std::string&, const nlohmann::json&) {
+            ++callbacks;
+        });
+        marketData.setMarketDataCallback([&](const std::string&, const std::string&, const nlohmann::json&) {
+            ++callbacks;
+        });
+
+        benchFrames(suite, marketData, "market_data.book_snapshot_50x50", {bookSnapshotFrame(1)}, 5000);
+
+        // One snapshot per cycle restarts the change_id sequence
+        std::mt19937 random(7);
+        std::vector<std::string> stream{bookSnapshotFrame(0)};
+        for (size_t i = 1; i < kFrameCycle; ++i) {
+            stream.push_back(bookChangeFrame(static_cast<int64_t>(i), random));
+        }
+        benchFrames(suite, marketData, "market_data.book_change", stream, 100 * kFrameCycle);
+        benchFrames(suite, marketData, "market_data.ticker", {kTickerFrame}, 100000);
+        benchFrames(suite, marketData, "market_data.trades", {kTradesFrame}, 100000);
+
+        if (!capture.empty()) {
+            std::vector<std::string> frames;
+            CaptureReader reader(CaptureReader::listSegments(capture));
+            CaptureFrame frame;
+            while (reader.next(frame) && frames.size() < 1000000) {
+                frames.emplace_back(frame.data, frame.length);
+            }
+            if (frames.empty()) {
+                throw std::runtime_error("No frames in " + capture);
+            }
+            // Recorded books are not registered, so only parsing and
+            // routing of their updates is timed
+            benchFrames(suite, marketData, "market_data.capture", frames, frames.size());
+        }
+        bench::g_sink = bench::g_sink + callbacks;
+    }
+
+    void benchLogger(bench::Suite& suite) {
+        auto& logger = Logger::getInstance();
+        char path[] = "/tmp/bench_core_log_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot create a temporary log file");
+        }
+        ::close(fd);
+        logger.setLogFile(path);
+        logger.setConsoleOutput(false);
+        logger.setLogLevel(LogLevel::INFO);
+
+        auto contended = [&](int threads) {
+            return [&logger, threads](size_t iterations) {
+                std::vector<std::thread> workers;
+                size_t perThread = iterations / static_cast<size_t>(threads);
+                for (int t = 0; t < threads; ++t) {
+                    workers.emplace_back([&logger, perThread, t] {
+                        for (size_t i = 0; i < perThread; ++i) {
+                            logger.info("Order ", i, " on thread ", t, " price ", 43000.5, " amount ", 10);
+                        }
+                    });
+                }
+                for (auto& worker : workers) {
+                    worker.join();
+                }
+                return static_cast<uint64_t>(perThread);
+            };
+        };
+
+        for (int threads : {1, 4}) {
+            suite.run("logger.sync_info_" + std::to_string(threads) + "t", 100000, threads, contended(threads));
+        }
+
+        AsyncLogConfig config;
+        config.overflow = LogOverflowPolicy::BLOCK;
+        logger.startAsync(config);
+        for (int threads : {1, 4}) {
+            suite.run("logger.async_info_" + std::to_string(threads) + "t", 400000, threads, contended(threads));
+        }
+        suite.run("logger.async_deferred_1t", 400000, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                LOG_DEFERRED(LogLevel::INFO, "Order {} price {} amount {}", i, 43000.5, 10);
+            }
+            return static_cast<uint64_t>(iterations);
+        });
+        suite.run("logger.filtered_debug", 10000000, [&](size_t iterations) {
+            for (size_t i = 0; i < iterations; ++i) {
+                LOG_DEBUG("Filtered ", i);
+            }
+            return static_cast<uint64_t>(iterations);
+        });
+        logger.stopAsync();
+        std::remove(path);
+    }
+
+    void benchConfig(bench::Suite& suite) {
+        auto& config = deribit::Config::getInstance();
+        suite.run("config.get_int", 2000000, [&](size_t iterations) {
+            uint64_t total = 0;
+            for (size_t i = 0; i < iterations; ++i) {
+                total += static_cast<uint64_t>(config.getInt("max_open_orders", 0));
+            }
+            return total;
+        });
+        suite.run("config.get_string", 2000000, [&](size_t iterations) {
+            uint64_t total = 0;
+            for (size_t i = 0; i < iterations; ++i) {
+                total += config.getString("log_level", "").size();
+            }
+            return total;
+        });
+        suite.run("config.get_double", 2000000, [&](size_t iterations) {
+            double total = 0.0;
+            for (size_t i = 0; i < iterations; ++i) {
+                total += config.getMaxNotional();
+            }
+            return static_cast<uint64_t>(total);
+        });
+    }
+
+    void benchSerialization(bench::Suite& suite) {
+        // Same request shape OrderManager and DeribitWebSocket send
+        suite.run("json.order_request_dump", 500000, [&](size_t iterations) {
+            uint64_t total = 0;
+            for (size_t i = 0; i < iterations; ++i) {
+                nlohmann::json params = {
+                    {"instrument_name", kInstrument},
+                    {"amount", 10.0},
+                    {"label", "dt-" + std::to_string(i)},
+                    {"type", "limit"},
+                    {"price", 43000.5},
+                    {"post_only", true}
+                };
+                nlohmann::json request = {
+                    {"jsonrpc", "2.0"},
+                    {"id", static_cast<int64_t>(i)},
+                    {"method", "private/buy"},
+                    {"params", std::move(params)}
+                };
+                total += request.dump().size();
+            }
+            return total;
+        });
+
+        const std::string response =
+            "{\"jsonrpc\":\"2.0\",\"id\":42,\"result\":{\"trades\":[],\"order\":{"
+            "\"web\":false,\"time_in_force\":\"good_til_cancelled\",\"replaced\":false,"
+            "\"reduce_only\":false,\"price\":43000.5,\"post_only\":true,\"order_type\":\"limit\","
+            "\"order_state\":\"open\",\"order_id\":\"USDC-1234567890\",\"max_show\":10.0,"
+            "\"last_update_timestamp\":1700000000200,\"label\":\"dt-42\",\"is_liquidation\":false,"
+            "\"instrument_name\":\"BTC-PERPETUAL\",\"filled_amount\":0.0,\"direction\":\"buy\","
+            "\"creation_timestamp\":1700000000200,\"average_price\":0.0,\"api\":true,\"amount\":10.0}},"
+            "\"usIn\":1700000000200100,\"usOut\":1700000000200350,\"usDiff\":250,\"testnet\":true}";
+        suite.run("json.order_response_parse", 500000, [&](size_t iterations) {
+            uint64_t total = 0;
+            for (size_t i = 0; i < iterations; ++i) {
+                auto parsed = nlohmann::json::parse(response);
+                total += parsed["result"]["order"]["order_id"].get_ref<const std::string&>().size();
+            }
+            return total;
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parseOptions(argc, argv);
+        bench::Suite suite("bench_core");
+        suite.setFilter(options.filter);
+        suite.setScale(options.scale);
+
+        // Keep feed errors and setup chatter out of the table
+        Logger::getInstance().setConsoleOutput(false);
+        suite.printHeader();
+        benchOrderBook(suite);
+        benchMarketData(suite, options.capture);
+        benchConfig(suite);
+        benchSerialization(suite);
+        benchLogger(suite);
+
+        if (!options.jsonPath.empty()) {
+            std::ofstream out(options.jsonPath);
+            if (!out.is_open()) {
+                throw std::runtime_error("Failed to open " + options.jsonPath);
+            }
+            out << suite.toJson().dump(2) << std::endl;
+        }
+        return 0;
+
+    } catch (const std::exception& e) {
+        std::cerr << "bench_core: " << e.what() << std::endl;
+        return 1;
+    }
+}
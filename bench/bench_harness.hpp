@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Minimal benchmark runner shared by the bench_* executables. A case is
+// timed over several runs of a fixed iteration count and reported as the
+// median ns per operation, with the fastest and slowest run alongside.
+// Results print as a table and can be written as JSON for tracking
+// between releases.
+namespace bench {
+
+struct Result {
+    std::string name;
+    size_t iterations = 0;      // Per run
+    int threads = 1;
+    double nsPerOp = 0.0;       // Median run
+    double minNsPerOp = 0.0;
+    double maxNsPerOp = 0.0;
+};
+
+// Keeps results alive so the compiler cannot drop the measured work
+inline volatile uint64_t g_sink = 0;
+
+inline int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Suite {
+public:
+    // Runs iterations operations and returns anything derived from them
+    using Body = std::function<uint64_t(size_t iterations)>;
+
+    Suite(std::string name, int runs = 7) : m_name(std::move(name)), m_runs(runs) {}
+
+    void setFilter(std::string filter) { m_filter = std::move(filter); }
+    // Multiplies every case's iteration count
+    void setScale(double scale) { m_scale = scale; }
+
+    void run(const std::string& name, size_t iterations, Body body) {
+        run(name, iterations, 1, std::move(body));
+    }
+
+    // threads is reported only; a multi-threaded body divides the work
+    // itself and ns per op is wall time over all operations
+    void run(const std::string& name, size_t iterations, int threads, Body body) {
+        if (!m_filter.empty() && name.find(m_filter) == std::string::npos) {
+            return;
+        }
+        iterations = std::max<size_t>(1, static_cast<size_t>(static_cast<double>(iterations) * m_scale));
+
+        g_sink = g_sink + body(std::max<size_t>(1, iterations / 10));  // Warm up
+        std::vector<double> runs;
+        for (int i = 0; i < m_runs; ++i) {
+            int64_t start = steadyNowNs();
+            uint64_t sink = body(iterations);
+            int64_t elapsed = steadyNowNs() - start;
+            g_sink = g_sink + sink;
+            runs.push_back(static_cast<double>(elapsed) / static_cast<double>(iterations));
+        }
+        std::sort(runs.begin(), runs.end());
+
+        Result result;
+        result.name = name;
+        result.iterations = iterations;
+        result.threads = threads;
+        result.nsPerOp = runs[runs.size() / 2];
+        result.minNsPerOp = runs.front();
+        result.maxNsPerOp = runs.back();
+        std::printf("%-40s %8d %12.1f %12.1f %12.1f\n", name.c_str(), threads,
+                    result.nsPerOp, result.minNsPerOp, result.maxNsPerOp);
+        std::fflush(stdout);
+        m_results.push_back(std::move(result));
+    }
+
+    void printHeader() const {
+        std::printf("%-40s %8s %12s %12s %12s\n", "case", "threads", "ns/op", "min", "max");
+    }
+
+    nlohmann::json toJson() const {
+        nlohmann::json results = nlohmann::json::array();
+        for (const auto& result : m_results) {
+            results.push_back({
+                {"name", result.name},
+                {"iterations", result.iterations},
+                {"threads", result.threads},
+                {"ns_per_op", result.nsPerOp},
+                {"min_ns_per_op", result.minNsPerOp},
+                {"max_ns_per_op", result.maxNsPerOp},
+                {"ops_per_second", result.nsPerOp > 0.0 ? 1e9 / result.nsPerOp : 0.0}
+            });
+        }
+        return {
+            {"suite", m_name},
+            {"timestamp", static_cast<int64_t>(std::time(nullptr))},
+            {"runs", m_runs},
+            {"hardware_threads", std::thread::hardware_concurrency()},
+#ifdef __VERSION__
+            {"compiler", __VERSION__},
+#endif
+#ifdef NDEBUG
+            {"assertions", false},
+#else
+            {"assertions", true},
+#endif
+            {"results", results}
+        };
+    }
+
+    const std::vector<Result>& results() const { return m_results; }
+
+private:
+    std::string m_name;
+    int m_runs;
+    std::string m_filter;
+    double m_scale = 1.0;
+    std::vector<Result> m_results;
+};
+
+} // namespace bench
@@ -0,0 +1,94 @@
+#include "risk/pre_trade_risk.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Measures PreTradeRiskGate::check() against the ~100 ns per-order budget.
+// Usage: bench_risk [iterations]
+
+namespace {
+    constexpr double kBudgetNs = 100.0;
+    constexpr int kRuns = 7;
+    constexpr uint32_t kInstruments = 256;
+
+    int64_t steadyNowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    volatile uint64_t g_sink = 0;
+
+    template<typename Fn>
+    double measureNsPerOp(size_t iterations, Fn&& fn) {
+        std::vector<double> runs;
+        for (int run = 0; run < kRuns; ++run) {
+            uint64_t passed = 0;
+            int64_t start = steadyNowNs();
+            for (size_t i = 0; i < iterations; ++i) {
+                passed += fn(i);
+            }
+            int64_t elapsed = steadyNowNs() - start;
+            g_sink = g_sink + passed;
+            runs.push_back(static_cast<double>(elapsed) / static_cast<double>(iterations));
+        }
+        std::sort(runs.begin(), runs.end());
+        return runs[runs.size() / 2];
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = argc > 1 ? std::stoull(argv[1]) : 10000000;
+
+    RiskLimits limits;
+    limits.minOrderSize = 0.0001;
+    limits.maxOrderSize = 10.0;
+    limits.maxNotional = 1e6;
+    limits.priceBand = 0.05;
+    limits.maxPosition = 1e12;
+    limits.maxOpenOrders = 1000;
+    limits.maxMessagesPerSecond = INT64_MAX;
+
+    PreTradeRiskGate gate(limits, kInstruments);
+    for (uint32_t i = 0; i < kInstruments; ++i) {
+        uint32_t id = gate.registerInstrument("INSTRUMENT-" + std::to_string(i));
+        gate.updateReferencePrice(id, 100.0 + i);
+    }
+
+    // Pre-generated orders so the loop measures the gate, not the generator
+    std::vector<RiskOrder> orders(4096);
+    for (size_t i = 0; i < orders.size(); ++i) {
+        uint32_t id = static_cast<uint32_t>(i % kInstruments);
+        orders[i] = {id, (i & 1) ? OrderSide::BUY : OrderSide::SELL,
+                     100.0 + id + ((i % 7) * 0.5 - 1.5), 0.1 + (i % 5) * 0.1};
+    }
+    const size_t mask = orders.size() - 1;
+
+    int64_t baseNs = steadyNowNs();
+    double passNs = measureNsPerOp(iterations, [&](size_t i) {
+        return gate.check(orders[i & mask], baseNs + static_cast<int64_t>(i)) == RiskCheckResult::PASSED;
+    });
+
+    double clockNs = measureNsPerOp(iterations, [&](size_t i) {
+        return gate.check(orders[i & mask]) == RiskCheckResult::PASSED;
+    });
+
+    // Worst-case reject: every check runs to the last limit
+    RiskLimits strict = limits;
+    strict.maxMessagesPerSecond = 0;
+    PreTradeRiskGate strictGate(strict, kInstruments);
+    for (uint32_t i = 0; i < kInstruments; ++i) {
+        uint32_t id = strictGate.registerInstrument("INSTRUMENT-" + std::to_string(i));
+        strictGate.updateReferencePrice(id, 100.0 + i);
+    }
+    double rejectNs = measureNsPerOp(iterations, [&](size_t i) {
+        return strictGate.check(orders[i & mask], baseNs) == RiskCheckResult::MESSAGE_RATE;
+    });
+
+    std::printf("%-28s %10s %10s\n", "case", "ns/check", "budget");
+    std::printf("%-28s %10.2f %10s\n", "all_checks_pass", passNs, passNs <= kBudgetNs ? "ok" : "OVER");
+    std::printf("%-28s %10.2f %10s\n", "all_checks_pass_with_clock", clockNs, clockNs <= kBudgetNs ? "ok" : "OVER");
+    std::printf("%-28s %10.2f %10s\n", "reject_at_last_check", rejectNs, rejectNs <= kBudgetNs ? "ok" : "OVER");
+    return 0;
+}
@@ -0,0 +1,288 @@
+#include "api/auth.hpp"
+#include "utils/logger.hpp"
+#include "utils/utils.hpp"
+#include <stdexcept>
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <openssl/hmac.h>
+#include <openssl/sha.h>
+
+namespace {
+    // Retry delay after a failed refresh attempt
+    constexpr auto kRetryDelay = std::chrono::seconds(5);
+    // Floor between refreshes, whatever lifetime the exchange grants
+    constexpr auto kMinRefreshDelay = std::chrono::seconds(1);
+}
+
+AuthManager::AuthManager(const std::string& clientId, const std::string& clientSecret,
+                         AuthMethod method)
+    : m_clientId(clientId)
+    , m_clientSecret(clientSecret)
+    , m_method(method)
+    , m_refreshMargin(0.8)
+    , m_refreshRunning(false)
+    , m_sessionGeneration(0) {
+}
+
+AuthManager::~AuthManager() {
+    stopAutoRefresh();
+}
+
+void AuthManager::setTransport(AuthTransport transport) {
+    std::lock_guard<std::mutex> lock(m_transportMutex);
+    m_transport = std::move(transport);
+}
+
+void AuthManager::setStreamTransport(AuthTransport transport) {
+    std::lock_guard<std::mutex> lock(m_transportMutex);
+    m_streamTransport = std::move(transport);
+}
+
+void AuthManager::setMethod(AuthMethod method) {
+    m_method = method;
+}
+
+void AuthManager::setRefreshMargin(double fraction) {
+    if (fraction <= 0.0 || fraction >= 1.0) {
+        throw std::invalid_argument("Refresh margin must be between 0 and 1");
+    }
+    m_refreshMargin = fraction;
+}
+
+bool AuthManager::authenticate() {
+    return performAuth(buildAuthParams());
+}
+
+bool AuthManager::refresh() {
+    auto session = getSession();
+    if (!session || session->refreshToken.empty()) {
+        return authenticate();
+    }
+
+    if (performAuth(buildRefreshParams())) {
+        return true;
+    }
+
+    // Refresh token may have been revoked, fall back to full credentials
+    Logger::getInstance().warning("Token refresh failed, re-authenticating");
+    return authenticate();
+}
+
+void AuthManager::startAutoRefresh() {
+    if (m_refreshRunning.exchange(true)) {
+        return;
+    }
+    m_refreshThread = std::thread(&AuthManager::refreshLoop, this);
+}
+
+void AuthManager::stopAutoRefresh() {
+    if (!m_refreshRunning.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_refreshMutex);
+    }
+    m_refreshCv.notify_all();
+    if (m_refreshThread.joinable()) {
+        m_refreshThread.join();
+    }
+}
+
+std::shared_ptr<const AuthSession> AuthManager::getSession() const {
+    return std::atomic_load(&m_session);
+}
+
+std::string AuthManager::getAccessToken() const {
+    auto session = getSession();
+    return session ? session->accessToken : std::string();
+}
+
+bool AuthManager::isAuthenticated() const {
+    auto session = getSession();
+    return session && session->isValid();
+}
+
+nlohmann::json AuthManager::buildAuthParams() const {
+    if (m_method == AuthMethod::CLIENT_SIGNATURE) {
+        auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::string nonce = generateNonce();
+        std::string data;
+
+        std::ostringstream payload;
+        payload << timestamp << "\n" << nonce << "\n" << data;
+
+        return {
+            {"grant_type", "client_signature"},
+            {"client_id", m_clientId},
+            {"timestamp", timestamp},
+            {"nonce", nonce},
+            {"data", data},
+            {"signature", hmacSha256Hex(m_clientSecret, payload.str())}
+        };
+    }
+
+    return {
+        {"grant_type", "client_credentials"},
+        {"client_id", m_clientId},
+        {"client_secret", m_clientSecret}
+    };
+}
+
+nlohmann::json AuthManager::buildRefreshParams() const {
+    auto session = getSession();
+    return {
+        {"grant_type", "refresh_token"},
+        {"refresh_token", session ? session->refreshToken : std::string()}
+    };
+}
+
+bool AuthManager::applyAuthResponse(const nlohmann::json& response) {
+    // Accept both a full JSON-RPC envelope and a bare result object
+    const nlohmann::json& result = response.contains("result") ? response["result"] : response;
+    if (!result.is_object() || !result.contains("access_token")) {
+        return false;
+    }
+    // A grant without a lifetime would be refreshed in a tight loop
+    int expiresIn = result.value("expires_in", 0);
+    if (expiresIn <= 0) {
+        return false;
+    }
+
+    auto session = std::make_shared<AuthSession>();
+    session->accessToken = result["access_token"].get<std::string>();
+    session->refreshToken = result.value("refresh_token", std::string());
+    session->scope = result.value("scope", std::string());
+    session->issuedAt = std::chrono::steady_clock::now();
+    session->expiresAt = session->issuedAt + std::chrono::seconds(expiresIn);
+
+    publishSession(session);
+    return true;
+}
+
+void AuthManager::addSessionListener(SessionListener listener) {
+    std::lock_guard<std::mutex> lock(m_listenerMutex);
+    m_listeners.push_back(std::move(listener));
+}
+
+std::string AuthManager::hmacSha256Hex(const std::string& key, const std::string& data) {
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    unsigned int length = 0;
+
+    HMAC(EVP_sha256(),
+         key.data(), static_cast<int>(key.size()),
+         reinterpret_cast<const unsigned char*>(data.data()), data.size(),
+         digest, &length);
+
+    std::ostringstream oss;
+    for (unsigned int i = 0; i < length; ++i) {
+        oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(digest[i]);
+    }
+    return oss.str();
+}
+
+std::string AuthManager::generateNonce(size_t length) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    thread_local std::mt19937_64 rng(std::random_device{}());
+    std::uniform_int_distribution<size_t> dist(0, sizeof(alphabet) - 2);
+
+    std::string nonce(length, '0');
+    for (auto& c : nonce) {
+        c = alphabet[dist(rng)];
+    }
+    return nonce;
+}
+
+bool AuthManager::performAuth(const nlohmann::json& params) {
+    auto& logger = Logger::getInstance();
+    nlohmann::json response;
+    bool sent = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_transportMutex);
+        if (m_streamTransport) {
+            try {
+                response = m_streamTransport(params);
+                sent = true;
+            } catch (const std::exception& e) {
+                logger.debug("Stream auth unavailable, using REST: ", e.what());
+            }
+        }
+        if (!sent) {
+            if (!m_transport) {
+                logger.error("No auth transport configured");
+                return false;
+            }
+            try {
+                response = m_transport(params);
+            } catch (const std::exception& e) {
+                logger.error("Authentication request failed: ", e.what());
+                return false;
+            }
+        }
+    }
+
+    if (!applyAuthResponse(response)) {
+        logger.error("Authentication rejected: ", response.dump());
+        return false;
+    }
+    return true;
+}
+
+void AuthManager::publishSession(std::shared_ptr<const AuthSession> session) {
+    std::atomic_store(&m_session, session);
+
+    // Wake the refresh thread so it reschedules against the new expiry
+    {
+        std::lock_guard<std::mutex> lock(m_refreshMutex);
+        ++m_sessionGeneration;
+    }
+    m_refreshCv.notify_all();
+
+    std::lock_guard<std::mutex> lock(m_listenerMutex);
+    for (const auto& listener : m_listeners) {
+        listener(session);
+    }
+}
+
+std::chrono::steady_clock::time_point AuthManager::nextRefreshTime() const {
+    auto session = getSession();
+    if (!session) {
+        return std::chrono::steady_clock::now();
+    }
+    auto lifetime = session->expiresAt - session->issuedAt;
+    auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(lifetime * m_refreshMargin.load());
+    return session->issuedAt + std::max<std::chrono::steady_clock::duration>(delay, kMinRefreshDelay);
+}
+
+void AuthManager::refreshLoop() {
+    utils::ThreadUtils::onThreadStart("housekeeping", "auth-refresh");
+    auto& logger = Logger::getInstance();
+    std::chrono::steady_clock::time_point retryAt{};
+
+    while (m_refreshRunning) {
+        auto deadline = std::max(nextRefreshTime(), retryAt);
+        auto generation = m_sessionGeneration.load();
+        {
+            std::unique_lock<std::mutex> lock(m_refreshMutex);
+            m_refreshCv.wait_until(lock, deadline, [this, generation] {
+                return !m_refreshRunning || m_sessionGeneration.load() != generation;
+            });
+        }
+        if (!m_refreshRunning) break;
+
+        // A session published elsewhere moves the deadline, reschedule
+        if (std::chrono::steady_clock::now() < std::max(nextRefreshTime(), retryAt)) {
+            continue;
+        }
+
+        if (refresh()) {
+            logger.info("Access token refreshed");
+            retryAt = {};
+        } else {
+            logger.error("Access token refresh failed, retrying");
+            retryAt = std::chrono::steady_clock::now() + kRetryDelay;
+        }
+    }
+}
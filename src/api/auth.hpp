@@ -0,0 +1,104 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <chrono>
+#include <nlohmann/json.hpp>
+
+enum class AuthMethod {
+    CLIENT_CREDENTIALS,
+    CLIENT_SIGNATURE
+};
+
+// Immutable snapshot of an authenticated session. A refresh publishes a new
+// snapshot instead of mutating this one, so readers never wait on it.
+struct AuthSession {
+    std::string accessToken;
+    std::string refreshToken;
+    std::string scope;
+    std::chrono::steady_clock::time_point issuedAt;
+    std::chrono::steady_clock::time_point expiresAt;
+
+    bool isValid() const {
+        return !accessToken.empty() && std::chrono::steady_clock::now() < expiresAt;
+    }
+};
+
+class AuthManager {
+public:
+    // Performs a blocking public/auth call and returns the raw JSON response
+    using AuthTransport = std::function<nlohmann::json(const nlohmann::json& params)>;
+    using SessionListener = std::function<void(std::shared_ptr<const AuthSession> session)>;
+
+    AuthManager(const std::string& clientId, const std::string& clientSecret,
+                AuthMethod method = AuthMethod::CLIENT_CREDENTIALS);
+    ~AuthManager();
+
+    // Transport configuration
+    void setTransport(AuthTransport transport);          // REST, always available
+    void setStreamTransport(AuthTransport transport);    // websocket, preferred while set
+    void setMethod(AuthMethod method);
+    void setRefreshMargin(double fraction);
+
+    // Blocking authentication, meant for startup and the refresh thread only
+    bool authenticate();
+    bool refresh();
+
+    // Background refresh before expiry
+    void startAutoRefresh();
+    void stopAutoRefresh();
+
+    // Session access, safe to call from the order path
+    std::shared_ptr<const AuthSession> getSession() const;
+    std::string getAccessToken() const;
+    bool isAuthenticated() const;
+
+    // Request parameters for public/auth
+    nlohmann::json buildAuthParams() const;
+    nlohmann::json buildRefreshParams() const;
+
+    // Adopt a public/auth response received outside of the transports
+    bool applyAuthResponse(const nlohmann::json& response);
+
+    void addSessionListener(SessionListener listener);
+
+    // Signature helpers
+    static std::string hmacSha256Hex(const std::string& key, const std::string& data);
+    static std::string generateNonce(size_t length = 16);
+
+private:
+    bool performAuth(const nlohmann::json& params);
+    void publishSession(std::shared_ptr<const AuthSession> session);
+    void refreshLoop();
+    std::chrono::steady_clock::time_point nextRefreshTime() const;
+
+    std::string m_clientId;
+    std::string m_clientSecret;
+    // Read by the refresh thread, the setters may run at any time
+    std::atomic<AuthMethod> m_method;
+    std::atomic<double> m_refreshMargin;
+
+    // Current session, swapped atomically
+    std::shared_ptr<const AuthSession> m_session;
+
+    // Transports
+    AuthTransport m_transport;
+    AuthTransport m_streamTransport;
+    std::mutex m_transportMutex;
+
+    // Listeners
+    std::vector<SessionListener> m_listeners;
+    std::mutex m_listenerMutex;
+
+    // Refresh thread
+    std::thread m_refreshThread;
+    std::atomic<bool> m_refreshRunning;
+    std::atomic<uint64_t> m_sessionGeneration;
+    std::mutex m_refreshMutex;
+    std::condition_variable m_refreshCv;
+};
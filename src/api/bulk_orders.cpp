@@ -0,0 +1,179 @@
+#include "api/bulk_orders.hpp"
+#include "utils/logger.hpp"
+
+BatchResult::BatchResult(size_t expected, CompletionCallback callback)
+    : m_responses(expected)
+    , m_remaining(expected)
+    , m_successCount(0)
+    , m_failureCount(0)
+    , m_startTime(std::chrono::steady_clock::now())
+    , m_elapsedNs(-1)
+    , m_callback(std::move(callback)) {
+}
+
+void BatchResult::complete(size_t index, const nlohmann::json& response) {
+    if (index >= m_responses.size()) {
+        return;
+    }
+
+    m_responses[index] = response;
+    if (response.contains("error")) {
+        m_failureCount.fetch_add(1);
+    } else {
+        m_successCount.fetch_add(1);
+    }
+
+    if (m_remaining.fetch_sub(1) != 1) {
+        return;
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - m_startTime;
+    m_elapsedNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_cv.notify_all();
+
+    if (m_callback) {
+        m_callback(*this);
+    }
+}
+
+bool BatchResult::wait(std::chrono::milliseconds timeout) const {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_cv.wait_for(lock, timeout, [this] { return isComplete(); });
+}
+
+std::chrono::nanoseconds BatchResult::getElapsed() const {
+    int64_t elapsed = m_elapsedNs.load();
+    if (elapsed >= 0) {
+        return std::chrono::nanoseconds(elapsed);
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_startTime);
+}
+
+BulkOrderGateway::BulkOrderGateway(DeribitWebSocket& webSocket)
+    : m_webSocket(webSocket) {
+}
+
+std::shared_ptr<BatchResult> BulkOrderGateway::cancelAll(BatchCallback callback) {
+    return sendBatch({{"private/cancel_all", nlohmann::json::object()}}, std::move(callback));
+}
+
+std::shared_ptr<BatchResult> BulkOrderGateway::cancelAllByInstrument(const std::string& instrument,
+                                                                     BatchCallback callback) {
+    return sendBatch({{"private/cancel_all_by_instrument", {{"instrument_name", instrument}}}},
+                     std::move(callback));
+}
+
+std::shared_ptr<BatchResult> BulkOrderGateway::cancelAllByCurrency(const std::string& currency,
+                                                                   const std::string& kind,
+                                                                   BatchCallback callback) {
+    nlohmann::json params = {{"currency", currency}};
+    if (!kind.empty()) {
+        params["kind"] = kind;
+    }
+    return sendBatch({{"private/cancel_all_by_currency", params}}, std::move(callback));
+}
+
+std::shared_ptr<BatchResult> BulkOrderGateway::cancelByLabel(const std::string& label,
+                                                             const std::string& currency,
+                                                             BatchCallback callback) {
+    nlohmann::json params = {{"label", label}};
+    if (!currency.empty()) {
+        params["currency"] = currency;
+    }
+    return sendBatch({{"private/cancel_by_label", params}}, std::move(callback));
+}
+
+std::shared_ptr<BatchResult> BulkOrderGateway::cancelOrders(const std::vector<std::string>& orderIds,
+                                                            BatchCallback callback) {
+    std::vector<Request> requests;
+    requests.reserve(orderIds.size());
+    for (const auto& orderId : orderIds) {
+        requests.push_back({"private/cancel", {{"order_id", orderId}}});
+    }
+    return sendBatch(std::move(requests), std::move(callback));
+}
+
+std::shared_ptr<BatchResult> BulkOrderGateway::placeBatch(const std::vector<deribit::OrderRequest>& orders,
+                                                          BatchCallback callback) {
+    std::vector<Request> requests;
+    requests.reserve(orders.size());
+    for (const auto& order : orders) {
+        requests.push_back({orderMethod(order), buildOrderParams(order)});
+    }
+    return sendBatch(std::move(requests), std::move(callback));
+}
+
+std::shared_ptr<BatchResult> BulkOrderGateway::replaceBatch(const std::vector<ReplaceRequest>& replaces,
+                                                            BatchCallback callback) {
+    std::vector<Request> requests;
+    requests.reserve(replaces.size());
+    for (const auto& replace : replaces) {
+        requests.push_back({"private/edit", {
+            {"order_id", replace.orderId},
+            {"price", replace.price},
+            {"amount", replace.amount}
+        }});
+    }
+    return sendBatch(std::move(requests), std::move(callback));
+}
+
+std::string BulkOrderGateway::orderMethod(const deribit::OrderRequest& order) {
+    return order.side == deribit::Side::BUY ? "private/buy" : "private/sell";
+}
+
+nlohmann::json BulkOrderGateway::buildOrderParams(const deribit::OrderRequest& order) {
+    nlohmann::json params = {
+        {"instrument_name", order.instrument},
+        {"amount", order.amount},
+        {"type", deribit::utils::orderTypeToString(order.type)}
+    };
+
+    if (order.type == deribit::OrderType::LIMIT || order.type == deribit::OrderType::STOP_LIMIT) {
+        params["price"] = order.price;
+    }
+    if (order.type == deribit::OrderType::STOP_LIMIT || order.type == deribit::OrderType::STOP_MARKET) {
+        params["trigger_price"] = order.stopPrice;
+        params["trigger"] = "last_price";
+    }
+    if (order.postOnly) {
+        params["post_only"] = true;
+    }
+    if (order.reduceOnly) {
+        params["reduce_only"] = true;
+    }
+    if (!order.label.empty()) {
+        params["label"] = order.label;
+    }
+    return params;
+}
+
+std::shared_ptr<BatchResult> BulkOrderGateway::sendBatch(std::vector<Request> requests,
+                                                         BatchCallback callback) {
+    if (requests.empty()) {
+        auto result = std::make_shared<BatchResult>(0);
+        if (callback) {
+            callback(*result);
+        }
+        return result;
+    }
+
+    auto result = std::make_shared<BatchResult>(requests.size(), std::move(callback));
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        try {
+            m_webSocket.sendRequest(requests[i].method, requests[i].params,
+                [result, i](const nlohmann::json& response) {
+                    result->complete(i, response);
+                });
+        } catch (const std::exception& e) {
+            Logger::getInstance().error("Batch request ", requests[i].method, " failed: ", e.what());
+            result->complete(i, {{"error", {{"code", -1}, {"message", e.what()}}}});
+        }
+    }
+
+    return result;
+}
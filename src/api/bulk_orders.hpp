@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "api/websocket.hpp"
+#include "types.hpp"
+
+// Aggregate completion of a group of requests sent concurrently
+class BatchResult {
+public:
+    using CompletionCallback = std::function<void(const BatchResult&)>;
+
+    BatchResult(size_t expected, CompletionCallback callback = nullptr);
+
+    // Records the response for one request, fires the callback on the last
+    void complete(size_t index, const nlohmann::json& response);
+
+    bool isComplete() const { return m_remaining.load() == 0; }
+    bool wait(std::chrono::milliseconds timeout) const;
+
+    size_t size() const { return m_responses.size(); }
+    size_t getSuccessCount() const { return m_successCount.load(); }
+    size_t getFailureCount() const { return m_failureCount.load(); }
+
+    // Only stable once isComplete() returns true
+    const std::vector<nlohmann::json>& getResponses() const { return m_responses; }
+
+    // Submit to last response, the figure that matters for getting flat
+    std::chrono::nanoseconds getElapsed() const;
+
+private:
+    std::vector<nlohmann::json> m_responses;
+    std::atomic<size_t> m_remaining;
+    std::atomic<size_t> m_successCount;
+    std::atomic<size_t> m_failureCount;
+    std::chrono::steady_clock::time_point m_startTime;
+    std::atomic<int64_t> m_elapsedNs;
+    CompletionCallback m_callback;
+
+    mutable std::mutex m_mutex;
+    mutable std::condition_variable m_cv;
+};
+
+struct ReplaceRequest {
+    std::string orderId;
+    double price;
+    double amount;
+};
+
+// Bulk cancel and batched place/replace over an authenticated websocket.
+// Every request of a batch is written before any response is awaited.
+class BulkOrderGateway {
+public:
+    using BatchCallback = BatchResult::CompletionCallback;
+
+    explicit BulkOrderGateway(DeribitWebSocket& webSocket);
+
+    // Mass cancels
+    std::shared_ptr<BatchResult> cancelAll(BatchCallback callback = nullptr);
+    std::shared_ptr<BatchResult> cancelAllByInstrument(const std::string& instrument,
+                                                       BatchCallback callback = nullptr);
+    std::shared_ptr<BatchResult> cancelAllByCurrency(const std::string& currency,
+                                                     const std::string& kind = "",
+                                                     BatchCallback callback = nullptr);
+    std::shared_ptr<BatchResult> cancelByLabel(const std::string& label,
+                                               const std::string& currency = "",
+                                               BatchCallback callback = nullptr);
+    std::shared_ptr<BatchResult> cancelOrders(const std::vector<std::string>& orderIds,
+                                              BatchCallback callback = nullptr);
+
+    // Batched order entry
+    std::shared_ptr<BatchResult> placeBatch(const std::vector<deribit::OrderRequest>& orders,
+                                            BatchCallback callback = nullptr);
+    std::shared_ptr<BatchResult> replaceBatch(const std::vector<ReplaceRequest>& replaces,
+                                              BatchCallback callback = nullptr);
+
+    // Request builders
+    static std::string orderMethod(const deribit::OrderRequest& order);
+    static nlohmann::json buildOrderParams(const deribit::OrderRequest& order);
+
+private:
+    struct Request {
+        std::string method;
+        nlohmann::json params;
+    };
+
+    std::shared_ptr<BatchResult> sendBatch(std::vector<Request> requests, BatchCallback callback);
+
+    DeribitWebSocket& m_webSocket;
+};
@@ -1,46 +1,55 @@
 #include "api/client.hpp"
 #include <stdexcept>
 #include <sstream>
-#include <openssl/hmac.h>
-#include <openssl/sha.h>
 
 DeribitClient::DeribitClient(const std::string& api_key, const std::string& api_secret)
-    : m_apiKey(api_key)
-    , m_apiSecret(api_secret)
-    , m_baseUrl("https://test.deribit.com/api/v2")
-    , m_isAuthenticated(false) {
-    
+    : DeribitClient(std::make_shared<AuthManager>(api_key, api_secret)) {
+}
+
+DeribitClient::DeribitClient(std::shared_ptr<AuthManager> auth, const std::string& baseUrl)
+    : m_auth(std::move(auth))
+    , m_baseUrl(baseUrl)
+    , m_curl(nullptr)
+    , m_authCurl(nullptr) {
+
+    if (!m_auth) {
+        throw std::invalid_argument("AuthManager is required");
+    }
+
     m_curl = curl_easy_init();
-    if (!m_curl) {
+    m_authCurl = curl_easy_init();
+    if (!m_curl || !m_authCurl) {
+        if (m_curl) curl_easy_cleanup(m_curl);
+        if (m_authCurl) curl_easy_cleanup(m_authCurl);
         throw std::runtime_error("Failed to initialize CURL");
     }
+
+    // Auth requests run on the refresh thread, on their own handle
+    m_auth->setTransport([this](const nlohmann::json& params) {
+        std::lock_guard<std::mutex> lock(m_authCurlMutex);
+        return performRequest(m_authCurl, "POST", "/public/auth", params, "");
+    });
 }
 
 DeribitClient::~DeribitClient() {
+    // Blocks until any in-flight refresh using our handle has returned
+    m_auth->setTransport(nullptr);
+
     if (m_curl) {
         curl_easy_cleanup(m_curl);
     }
+    if (m_authCurl) {
+        curl_easy_cleanup(m_authCurl);
+    }
 }
 
 bool DeribitClient::authenticate() {
-    try {
-        nlohmann::json params = {
-            {"grant_type", "client_credentials"},
-            {"client_id", m_apiKey},
-            {"client_secret", m_apiSecret}
-        };
-
-        auto response = sendRequest("POST", "/public/auth", params);
-        m_isAuthenticated = response.contains("access_token");
-        return m_isAuthenticated;
-    } catch (const std::exception& e) {
-        return false;
-    }
+    return m_auth->authenticate();
 }
 
 nlohmann::json DeribitClient::placeOrder(const std::string& instrument, const std::string& side,
                                        double price, double amount, const std::string& orderType) {
-    if (!m_isAuthenticated) throw std::runtime_error("Not authenticated");
+    if (!m_auth->isAuthenticated()) throw std::runtime_error("Not authenticated");
 
     nlohmann::json params = {
         {"instrument_name", instrument},
@@ -54,7 +63,7 @@ nlohmann::json DeribitClient::placeOrder(const std::string& instrument, const st
 }
 
 nlohmann::json DeribitClient::cancelOrder(const std::string& orderId) {
-    if (!m_isAuthenticated) throw std::runtime_error("Not authenticated");
+    if (!m_auth->isAuthenticated()) throw std::runtime_error("Not authenticated");
 
     nlohmann::json params = {
         {"order_id", orderId}
@@ -63,8 +72,50 @@ nlohmann::json DeribitClient::cancelOrder(const std::string& orderId) {
     return sendRequest("POST", "/private/cancel", params);
 }
 
+nlohmann::json DeribitClient::cancelAll() {
+    if (!m_auth->isAuthenticated()) throw std::runtime_error("Not authenticated");
+
+    return sendRequest("POST", "/private/cancel_all", nlohmann::json::object());
+}
+
+nlohmann::json DeribitClient::cancelAllByInstrument(const std::string& instrument) {
+    if (!m_auth->isAuthenticated()) throw std::runtime_error("Not authenticated");
+
+    nlohmann::json params = {
+        {"instrument_name", instrument}
+    };
+
+    return sendRequest("POST", "/private/cancel_all_by_instrument", params);
+}
+
+nlohmann::json DeribitClient::cancelAllByCurrency(const std::string& currency, const std::string& kind) {
+    if (!m_auth->isAuthenticated()) throw std::runtime_error("Not authenticated");
+
+    nlohmann::json params = {
+        {"currency", currency}
+    };
+    if (!kind.empty()) {
+        params["kind"] = kind;
+    }
+
+    return sendRequest("POST", "/private/cancel_all_by_currency", params);
+}
+
+nlohmann::json DeribitClient::cancelByLabel(const std::string& label, const std::string& currency) {
+    if (!m_auth->isAuthenticated()) throw std::runtime_error("Not authenticated");
+
+    nlohmann::json params = {
+        {"label", label}
+    };
+    if (!currency.empty()) {
+        params["currency"] = currency;
+    }
+
+    return sendRequest("POST", "/private/cancel_by_label", params);
+}
+
 nlohmann::json DeribitClient::modifyOrder(const std::string& orderId, double newPrice, double newAmount) {
-    if (!m_isAuthenticated) throw std::runtime_error("Not authenticated");
+    if (!m_auth->isAuthenticated()) throw std::runtime_error("Not authenticated");
 
     nlohmann::json params = {
         {"order_id", orderId},
@@ -83,8 +134,16 @@ nlohmann::json DeribitClient::getOrderbook(const std::string& instrument) {
     return sendRequest("GET", "/public/get_order_book", params);
 }
 
+nlohmann::json DeribitClient::getInstrument(const std::string& instrument) {
+    nlohmann::json params = {
+        {"instrument_name", instrument}
+    };
+
+    return sendRequest("GET", "/public/get_instrument", params);
+}
+
 nlohmann::json DeribitClient::getPositions(const std::string& currency) {
-    if (!m_isAuthenticated) throw std::runtime_error("Not authenticated");
+    if (!m_auth->isAuthenticated()) throw std::runtime_error("Not authenticated");
 
     nlohmann::json params = {
         {"currency", currency}
@@ -100,22 +159,57 @@ size_t DeribitClient::WriteCallback(void* contents, size_t size, size_t nmemb, v
 
 nlohmann::json DeribitClient::sendRequest(const std::string& method, const std::string& endpoint,
                                         const nlohmann::json& params) {
+    // Private endpoints carry the current bearer token; reading it is a
+    // pointer load, the refresh itself happens on the auth thread
+    std::string accessToken;
+    if (endpoint.compare(0, 9, "/private/") == 0) {
+        accessToken = m_auth->getAccessToken();
+        if (m_rateLimiter) {
+            m_rateLimiter->acquire(RateLimiter::laneForMethod(endpoint));
+        }
+    }
+    return performRequest(m_curl, method, endpoint, params, accessToken);
+}
+
+nlohmann::json DeribitClient::performRequest(CURL* curl, const std::string& method,
+                                           const std::string& endpoint,
+                                           const nlohmann::json& params,
+                                           const std::string& accessToken) {
     std::string url = m_baseUrl + endpoint;
     std::string response_string;
+    std::string post_data;
+
+    if (method == "GET" && params.is_object() && !params.empty()) {
+        char separator = '?';
+        for (const auto& [key, value] : params.items()) {
+            std::string raw = value.is_string() ? value.get<std::string>() : value.dump();
+            char* escaped = curl_easy_escape(curl, raw.c_str(), static_cast<int>(raw.size()));
+            url += separator + key + "=" + (escaped ? escaped : "");
+            curl_free(escaped);
+            separator = '&';
+        }
+    }
     
-    curl_easy_setopt(m_curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, &response_string);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
     
     struct curl_slist* headers = nullptr;
     headers = curl_slist_append(headers, "Content-Type: application/json");
+    if (!accessToken.empty()) {
+        std::string authorization = "Authorization: Bearer " + accessToken;
+        headers = curl_slist_append(headers, authorization.c_str());
+    }
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
     
     if (method == "POST") {
-        std::string post_data = params.dump();
-        curl_easy_setopt(m_curl, CURLOPT_POSTFIELDS, post_data.c_str());
+        post_data = params.dump();
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_data.c_str());
+    } else {
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
     }
     
-    CURLcode res = curl_easy_perform(m_curl);
+    CURLcode res = curl_easy_perform(curl);
     curl_slist_free_all(headers);
     
     if (res != CURLE_OK) {
@@ -123,4 +217,4 @@ nlohmann::json DeribitClient::sendRequest(const std::string& method, const std::
     }
     
     return nlohmann::json::parse(response_string);
-}
\ No newline at end of file
+}
@@ -1,34 +1,51 @@
 #pragma once
 #include <string>
 #include <memory>
+#include <mutex>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
+#include "api/auth.hpp"
+#include "api/rate_limiter.hpp"
 
 class DeribitClient {
 public:
     DeribitClient(const std::string& api_key, const std::string& api_secret);
+    DeribitClient(std::shared_ptr<AuthManager> auth,
+                  const std::string& baseUrl = "https://test.deribit.com/api/v2");
     ~DeribitClient();
 
     // Authentication
     bool authenticate();
+    std::shared_ptr<AuthManager> getAuthManager() const { return m_auth; }
+
+    // Outbound pacing
+    void setRateLimiter(std::shared_ptr<RateLimiter> limiter) { m_rateLimiter = std::move(limiter); }
 
     // Order Management
     nlohmann::json placeOrder(const std::string& instrument, const std::string& side, 
                              double price, double amount, const std::string& orderType);
     nlohmann::json cancelOrder(const std::string& orderId);
+    nlohmann::json cancelAll();
+    nlohmann::json cancelAllByInstrument(const std::string& instrument);
+    nlohmann::json cancelAllByCurrency(const std::string& currency, const std::string& kind = "");
+    nlohmann::json cancelByLabel(const std::string& label, const std::string& currency = "");
     nlohmann::json modifyOrder(const std::string& orderId, double newPrice, double newAmount);
     nlohmann::json getOrderbook(const std::string& instrument);
+    nlohmann::json getInstrument(const std::string& instrument);
     nlohmann::json getPositions(const std::string& currency);
 
 private:
     // HTTP request methods
     nlohmann::json sendRequest(const std::string& method, const std::string& endpoint, 
                               const nlohmann::json& params = nlohmann::json());
+    nlohmann::json performRequest(CURL* curl, const std::string& method, const std::string& endpoint,
+                                  const nlohmann::json& params, const std::string& accessToken);
     static size_t WriteCallback(void* contents, size_t size, size_t nmemb, void* userp);
 
-    std::string m_apiKey;
-    std::string m_apiSecret;
+    std::shared_ptr<AuthManager> m_auth;
+    std::shared_ptr<RateLimiter> m_rateLimiter;
     std::string m_baseUrl;
     CURL* m_curl;
-    bool m_isAuthenticated;
-};
\ No newline at end of file
+    CURL* m_authCurl;       // Dedicated handle so refreshes never touch m_curl
+    std::mutex m_authCurlMutex;
+};
@@ -0,0 +1,265 @@
+#include "api/rate_limiter.hpp"
+#include "utils/logger.hpp"
+#include "utils/tsc_clock.hpp"
+#include "utils/utils.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    // Dispatcher sleep bounds while requests are deferred
+    constexpr auto kMinDispatchSleep = std::chrono::microseconds(20);
+    constexpr auto kMaxDispatchSleep = std::chrono::microseconds(1000);
+    constexpr auto kIdleDispatchSleep = std::chrono::microseconds(200);
+}
+
+RateLimiter::RateLimiter(const RateLimiterConfig& config)
+    : m_config(config)
+    , m_nsPerCredit(config.refillPerSecond > 0 ? 1000000000LL / config.refillPerSecond : 0)
+    , m_tat(0)
+    , m_rejectionsAvoided(0)
+    , m_exchangeRejections(0)
+    , m_running(false) {
+
+    if (m_nsPerCredit <= 0 || config.burstCredits <= 0 || config.costPerRequest <= 0) {
+        throw std::invalid_argument("Invalid rate limiter configuration");
+    }
+    if (config.cancelReserve + config.orderReserve + config.costPerRequest > config.burstCredits) {
+        throw std::invalid_argument("Rate limiter reserves exceed burst capacity");
+    }
+
+    m_toleranceNs[static_cast<size_t>(RequestLane::CANCEL)] =
+        config.burstCredits * m_nsPerCredit;
+    m_toleranceNs[static_cast<size_t>(RequestLane::ORDER)] =
+        (config.burstCredits - config.cancelReserve) * m_nsPerCredit;
+    m_toleranceNs[static_cast<size_t>(RequestLane::QUERY)] =
+        (config.burstCredits - config.cancelReserve - config.orderReserve) * m_nsPerCredit;
+
+    for (auto& queue : m_queues) {
+        queue = std::make_unique<utils::MpmcQueue<Deferred>>(config.queueCapacity);
+    }
+
+    // Start with a full bucket
+    m_tat.store(nowNs());
+}
+
+RateLimiter::~RateLimiter() {
+    stop();
+}
+
+bool RateLimiter::tryAcquire(RequestLane lane, int64_t cost) {
+    const int64_t now = nowNs();
+    const int64_t increment = cost * m_nsPerCredit;
+
+    // An idle bucket does not bank credits beyond its size. The new TAT
+    // is only published when it fits, so a refused caller never holds
+    // credits another lane could have used.
+    int64_t tat = m_tat.load(std::memory_order_relaxed);
+    int64_t newTat;
+    do {
+        newTat = std::max(tat, now) + increment;
+        if (newTat - now > toleranceNs(lane)) {
+            return false;
+        }
+    } while (!m_tat.compare_exchange_weak(tat, newTat, std::memory_order_acq_rel, std::memory_order_relaxed));
+    return true;
+}
+
+void RateLimiter::refund(int64_t cost) {
+    // Never back past now, that would bank credit the bucket never had
+    const int64_t now = nowNs();
+    const int64_t decrement = cost * m_nsPerCredit;
+    int64_t tat = m_tat.load(std::memory_order_relaxed);
+    while (tat > now &&
+           !m_tat.compare_exchange_weak(tat, std::max(tat - decrement, now), std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+    }
+}
+
+void RateLimiter::acquire(RequestLane lane) {
+    if (tryAcquire(lane)) {
+        m_counters[static_cast<size_t>(lane)].sent.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    m_rejectionsAvoided.fetch_add(1, std::memory_order_relaxed);
+    const int64_t start = nowNs();
+    do {
+        auto wait = std::max<std::chrono::nanoseconds>(timeUntilAvailable(lane), kMinDispatchSleep);
+        std::this_thread::sleep_for(wait);
+    } while (!tryAcquire(lane));
+
+    auto& counters = m_counters[static_cast<size_t>(lane)];
+    uint64_t waited = static_cast<uint64_t>(std::max<int64_t>(0, nowNs() - start));
+    counters.sent.fetch_add(1, std::memory_order_relaxed);
+    counters.deferred.fetch_add(1, std::memory_order_relaxed);
+    counters.totalQueueTimeNs.fetch_add(waited, std::memory_order_relaxed);
+
+    uint64_t currentMax = counters.maxQueueTimeNs.load(std::memory_order_relaxed);
+    while (waited > currentMax &&
+           !counters.maxQueueTimeNs.compare_exchange_weak(currentMax, waited, std::memory_order_relaxed)) {
+    }
+}
+
+bool RateLimiter::submit(RequestLane lane, SendFunction send) {
+    const size_t index = static_cast<size_t>(lane);
+    auto& counters = m_counters[index];
+
+    // Never overtake requests already waiting in this or a higher lane
+    if (m_queues[index]->empty() && !higherLanesPending(lane)) {
+        if (tryAcquire(lane)) {
+            send();
+            counters.sent.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        m_rejectionsAvoided.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (!m_queues[index]->tryPush(Deferred{std::move(send), nowNs()})) {
+        counters.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    counters.deferred.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+size_t RateLimiter::dispatch() {
+    size_t dispatched = 0;
+
+    for (size_t index = 0; index < kRequestLaneCount; ++index) {
+        auto lane = static_cast<RequestLane>(index);
+        auto& queue = *m_queues[index];
+        auto& counters = m_counters[index];
+
+        while (!queue.empty()) {
+            // Lower lanes have less headroom, so they cannot proceed either
+            if (!tryAcquire(lane)) {
+                return dispatched;
+            }
+
+            Deferred item;
+            if (!queue.tryPop(item)) {
+                refund(m_config.costPerRequest);
+                break;
+            }
+
+            uint64_t waited = static_cast<uint64_t>(std::max<int64_t>(0, nowNs() - item.enqueuedNs));
+            counters.totalQueueTimeNs.fetch_add(waited, std::memory_order_relaxed);
+            uint64_t currentMax = counters.maxQueueTimeNs.load(std::memory_order_relaxed);
+            while (waited > currentMax &&
+                   !counters.maxQueueTimeNs.compare_exchange_weak(currentMax, waited,
+                                                                  std::memory_order_relaxed)) {
+            }
+
+            try {
+                item.send();
+            } catch (const std::exception& e) {
+                Logger::getInstance().error("Deferred request failed: ", e.what());
+            }
+            counters.sent.fetch_add(1, std::memory_order_relaxed);
+            ++dispatched;
+        }
+    }
+
+    return dispatched;
+}
+
+void RateLimiter::start() {
+    if (m_running.exchange(true)) {
+        return;
+    }
+    m_dispatcher = std::thread(&RateLimiter::dispatcherLoop, this);
+}
+
+void RateLimiter::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    if (m_dispatcher.joinable()) {
+        m_dispatcher.join();
+    }
+}
+
+void RateLimiter::onExchangeRejection() {
+    m_exchangeRejections.fetch_add(1, std::memory_order_relaxed);
+
+    const int64_t drained = nowNs() + toleranceNs(RequestLane::CANCEL);
+    int64_t tat = m_tat.load(std::memory_order_relaxed);
+    while (tat < drained &&
+           !m_tat.compare_exchange_weak(tat, drained, std::memory_order_acq_rel)) {
+    }
+}
+
+int64_t RateLimiter::availableCredits() const {
+    int64_t backlog = std::max<int64_t>(0, m_tat.load(std::memory_order_relaxed) - nowNs());
+    return std::max<int64_t>(0, (m_toleranceNs[0] - backlog) / m_nsPerCredit);
+}
+
+std::chrono::nanoseconds RateLimiter::timeUntilAvailable(RequestLane lane) const {
+    int64_t tat = std::max(m_tat.load(std::memory_order_relaxed), nowNs());
+    int64_t wait = tat + m_config.costPerRequest * m_nsPerCredit - toleranceNs(lane) - nowNs();
+    return std::chrono::nanoseconds(std::max<int64_t>(0, wait));
+}
+
+RateLimiterStats RateLimiter::getStats() const {
+    RateLimiterStats stats;
+    for (size_t i = 0; i < kRequestLaneCount; ++i) {
+        const auto& counters = m_counters[i];
+        stats.sent[i] = counters.sent.load(std::memory_order_relaxed);
+        stats.deferred[i] = counters.deferred.load(std::memory_order_relaxed);
+        stats.dropped[i] = counters.dropped.load(std::memory_order_relaxed);
+        stats.totalQueueTimeNs[i] = counters.totalQueueTimeNs.load(std::memory_order_relaxed);
+        stats.maxQueueTimeNs[i] = counters.maxQueueTimeNs.load(std::memory_order_relaxed);
+        stats.queueDepth[i] = m_queues[i]->size();
+    }
+    stats.rejectionsAvoided = m_rejectionsAvoided.load(std::memory_order_relaxed);
+    stats.exchangeRejections = m_exchangeRejections.load(std::memory_order_relaxed);
+    stats.availableCredits = availableCredits();
+    return stats;
+}
+
+RequestLane RateLimiter::laneForMethod(const std::string& method) {
+    if (method.find("cancel") != std::string::npos) {
+        return RequestLane::CANCEL;
+    }
+    if (utils::endsWith(method, "/buy") || utils::endsWith(method, "/sell") ||
+        utils::endsWith(method, "/edit") || utils::endsWith(method, "/edit_by_label") ||
+        utils::endsWith(method, "/close_position")) {
+        return RequestLane::ORDER;
+    }
+    return RequestLane::QUERY;
+}
+
+int64_t RateLimiter::nowNs() {
+    return utils::TscClock::nowNs();
+}
+
+int64_t RateLimiter::toleranceNs(RequestLane lane) const {
+    return m_toleranceNs[static_cast<size_t>(lane)];
+}
+
+bool RateLimiter::higherLanesPending(RequestLane lane) const {
+    for (size_t i = 0; i < static_cast<size_t>(lane); ++i) {
+        if (!m_queues[i]->empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RateLimiter::dispatcherLoop() {
+    utils::ThreadUtils::onThreadStart("order_entry", "rate-limiter");
+    while (m_running) {
+        dispatch();
+
+        auto sleep = kIdleDispatchSleep;
+        for (size_t i = 0; i < kRequestLaneCount; ++i) {
+            if (!m_queues[i]->empty()) {
+                auto wait = std::chrono::duration_cast<std::chrono::microseconds>(
+                    timeUntilAvailable(static_cast<RequestLane>(i)));
+                sleep = std::clamp<std::chrono::microseconds>(wait, kMinDispatchSleep, kMaxDispatchSleep);
+                break;
+            }
+        }
+        std::this_thread::sleep_for(sleep);
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include "utils/lockfree_queue.hpp"
+
+// Outbound priority lanes, lower value goes first
+enum class RequestLane {
+    CANCEL = 0,
+    ORDER = 1,
+    QUERY = 2
+};
+
+constexpr size_t kRequestLaneCount = 3;
+
+// Local model of the exchange matching-engine credit bucket
+struct RateLimiterConfig {
+    int64_t burstCredits = 50000;       // Bucket size
+    int64_t refillPerSecond = 10000;    // Credits restored per second
+    int64_t costPerRequest = 500;       // Default cost of one request
+    int64_t cancelReserve = 5000;       // Credits only cancels may spend
+    int64_t orderReserve = 5000;        // Credits queries may not spend
+    size_t queueCapacity = 1024;        // Per-lane deferred queue size
+};
+
+struct RateLimiterStats {
+    std::array<uint64_t, kRequestLaneCount> sent{};
+    std::array<uint64_t, kRequestLaneCount> deferred{};
+    std::array<uint64_t, kRequestLaneCount> dropped{};
+    std::array<uint64_t, kRequestLaneCount> totalQueueTimeNs{};
+    std::array<uint64_t, kRequestLaneCount> maxQueueTimeNs{};
+    std::array<size_t, kRequestLaneCount> queueDepth{};
+    uint64_t rejectionsAvoided = 0;
+    uint64_t exchangeRejections = 0;
+    int64_t availableCredits = 0;
+};
+
+// Credit-based outbound scheduler. The bucket is tracked as a single
+// theoretical-arrival-time counter (GCRA), so tryAcquire() is a single
+// compare-and-swap loop and never blocks. Each lane may only draw the
+// bucket down to its reserve, which keeps headroom for higher lanes.
+class RateLimiter {
+public:
+    using SendFunction = std::function<void()>;
+
+    explicit RateLimiter(const RateLimiterConfig& config = RateLimiterConfig());
+    ~RateLimiter();
+
+    // Lock-free credit check, spends the credits on success
+    bool tryAcquire(RequestLane lane, int64_t cost);
+    bool tryAcquire(RequestLane lane) { return tryAcquire(lane, m_config.costPerRequest); }
+
+    // Blocks until credits are available, for synchronous callers
+    void acquire(RequestLane lane);
+
+    // Sends immediately when credits allow, otherwise defers to the lane queue
+    bool submit(RequestLane lane, SendFunction send);
+
+    // Sends deferred requests in lane priority order while credits allow
+    size_t dispatch();
+
+    // Background dispatcher for deferred requests
+    void start();
+    void stop();
+
+    // Exchange reported too_many_requests, treat the bucket as drained
+    void onExchangeRejection();
+
+    int64_t availableCredits() const;
+    std::chrono::nanoseconds timeUntilAvailable(RequestLane lane) const;
+    RateLimiterStats getStats() const;
+    const RateLimiterConfig& getConfig() const { return m_config; }
+
+    static RequestLane laneForMethod(const std::string& method);
+
+private:
+    struct Deferred {
+        SendFunction send;
+        int64_t enqueuedNs = 0;
+    };
+
+    struct alignas(utils::kCacheLineSize) LaneCounters {
+        std::atomic<uint64_t> sent{0};
+        std::atomic<uint64_t> deferred{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> totalQueueTimeNs{0};
+        std::atomic<uint64_t> maxQueueTimeNs{0};
+    };
+
+    static int64_t nowNs();
+    int64_t toleranceNs(RequestLane lane) const;
+    // Returns credits taken by a tryAcquire() that sent nothing
+    void refund(int64_t cost);
+    bool higherLanesPending(RequestLane lane) const;
+    void dispatcherLoop();
+
+    const RateLimiterConfig m_config;
+    const int64_t m_nsPerCredit;
+    std::array<int64_t, kRequestLaneCount> m_toleranceNs;
+
+    // Theoretical arrival time of the next request, in steady-clock ns
+    alignas(utils::kCacheLineSize) std::atomic<int64_t> m_tat;
+
+    std::array<std::unique_ptr<utils::MpmcQueue<Deferred>>, kRequestLaneCount> m_queues;
+    std::array<LaneCounters, kRequestLaneCount> m_counters;
+    alignas(utils::kCacheLineSize) std::atomic<uint64_t> m_rejectionsAvoided;
+    std::atomic<uint64_t> m_exchangeRejections;
+
+    std::thread m_dispatcher;
+    std::atomic<bool> m_running;
+};
@@ -1,7 +1,26 @@
 #include "api/websocket.hpp"
+#include "metrics/latency_metrics.hpp"
+#include "utils/logger.hpp"
+#include "utils/tsc_clock.hpp"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <future>
+#include <thread>
+#include <vector>
 
-DeribitWebSocket::DeribitWebSocket() : m_connected(false) {
+namespace {
+    // Upper bound for blocking requests issued from the auth refresh thread
+    constexpr auto kBlockingRequestTimeout = std::chrono::seconds(10);
+}
+
+DeribitWebSocket::DeribitWebSocket()
+    : m_connected(false)
+    , m_externalLoop(false)
+    , m_nextRequestId(1)
+    , m_authenticated(false)
+    , m_carriesRefresh(false)
+    , m_cancelOnDisconnect(false) {
     m_client.clear_access_channels(websocketpp::log::alevel::all);
     m_client.clear_error_channels(websocketpp::log::elevel::all);
 
@@ -26,6 +45,9 @@ DeribitWebSocket::DeribitWebSocket() : m_connected(false) {
 
 DeribitWebSocket::~DeribitWebSocket() {
     close();
+    if (m_auth && m_carriesRefresh) {
+        m_auth->setStreamTransport(nullptr);
+    }
 }
 
 void DeribitWebSocket::connect(const std::string& uri) {
@@ -37,25 +59,89 @@ void DeribitWebSocket::connect(const std::string& uri) {
     }
 
     m_client.connect(con);
+    if (!m_externalLoop) {
+        m_client.run();
+    }
+}
+
+void DeribitWebSocket::setExternalLoop(bool enabled) {
+    m_externalLoop = enabled;
+    if (enabled) {
+        // Keeps run() alive while there is no connection yet
+        m_client.start_perpetual();
+    }
+}
+
+void DeribitWebSocket::run() {
     m_client.run();
 }
 
+size_t DeribitWebSocket::poll() {
+    return m_client.poll();
+}
+
+void DeribitWebSocket::stopLoop() {
+    m_client.stop_perpetual();
+    m_client.stop();
+}
+
+bool DeribitWebSocket::waitForOpen(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!m_connected) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
 void DeribitWebSocket::subscribe(const std::string& channel) {
     if (!m_connected) {
         throw std::runtime_error("WebSocket not connected");
     }
 
-    nlohmann::json msg = {
-        {"jsonrpc", "2.0"},
-        {"method", "public/subscribe"},
-        {"params", {
-            {"channels", {channel}}
-        }},
-        {"id", 42}
-    };
+    // user.* channels need an authenticated connection and private/subscribe
+    bool isPrivate = channel.compare(0, 5, "user.") == 0;
+    {
+        std::lock_guard<std::mutex> lock(m_subscriptionsMutex);
+        m_subscriptions[channel] = true;
+        if (isPrivate && !m_authenticated) {
+            return;  // Sent by subscribePrivateChannels() once authenticated
+        }
+    }
+    sendSubscribe(channel);
+}
 
-    m_client.send(m_hdl, msg.dump(), websocketpp::frame::opcode::text);
-    m_subscriptions[channel] = true;
+void DeribitWebSocket::sendSubscribe(const std::string& channel) {
+    const char* method = channel.compare(0, 5, "user.") == 0 ? "private/subscribe" : "public/subscribe";
+    sendRequest(method, {{"channels", {channel}}}, [channel](const nlohmann::json& response) {
+        // The result lists the channels actually subscribed
+        const auto* result = response.contains("result") ? &response["result"] : nullptr;
+        if (!result || !result->is_array() ||
+            std::find(result->begin(), result->end(), channel) == result->end()) {
+            Logger::getInstance().error("Subscription to ", channel, " failed: ", response.dump());
+        }
+    });
+}
+
+void DeribitWebSocket::subscribePrivateChannels() {
+    std::vector<std::string> channels;
+    {
+        std::lock_guard<std::mutex> lock(m_subscriptionsMutex);
+        for (const auto& [channel, subscribed] : m_subscriptions) {
+            if (subscribed && channel.compare(0, 5, "user.") == 0) {
+                channels.push_back(channel);
+            }
+        }
+    }
+    for (const auto& channel : channels) {
+        try {
+            sendSubscribe(channel);
+        } catch (const std::exception& e) {
+            Logger::getInstance().error("Subscription to ", channel, " not sent: ", e.what());
+        }
+    }
 }
 
 void DeribitWebSocket::unsubscribe(const std::string& channel) {
@@ -63,16 +149,9 @@ void DeribitWebSocket::unsubscribe(const std::string& channel) {
         throw std::runtime_error("WebSocket not connected");
     }
 
-    nlohmann::json msg = {
-        {"jsonrpc", "2.0"},
-        {"method", "public/unsubscribe"},
-        {"params", {
-            {"channels", {channel}}
-        }},
-        {"id", 42}
-    };
-
-    m_client.send(m_hdl, msg.dump(), websocketpp::frame::opcode::text);
+    const char* method = channel.compare(0, 5, "user.") == 0 ? "private/unsubscribe" : "public/unsubscribe";
+    sendRequest(method, {{"channels", {channel}}});
+    std::lock_guard<std::mutex> lock(m_subscriptionsMutex);
     m_subscriptions.erase(channel);
 }
 
@@ -80,6 +159,10 @@ void DeribitWebSocket::setMessageCallback(MessageCallback callback) {
     m_messageCallback = callback;
 }
 
+void DeribitWebSocket::setFrameTap(FrameTap tap) {
+    m_frameTap = std::move(tap);
+}
+
 bool DeribitWebSocket::isConnected() const {
     return m_connected;
 }
@@ -91,21 +174,284 @@ void DeribitWebSocket::close() {
     }
 }
 
+int64_t DeribitWebSocket::sendRequest(const std::string& method, const nlohmann::json& params,
+                                      ResponseCallback callback) {
+    if (!m_connected) {
+        throw std::runtime_error("WebSocket not connected");
+    }
+
+    int64_t id = m_nextRequestId.fetch_add(1);
+    nlohmann::json msg = {
+        {"jsonrpc", "2.0"},
+        {"method", method},
+        {"params", params},
+        {"id", id}
+    };
+
+    if (callback) {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pendingRequests.emplace(id, PendingRequest{std::move(callback), utils::TscClock::nowNs()});
+    }
+
+    std::string payload = msg.dump();
+    if (m_rateLimiter && method.compare(0, 8, "private/") == 0) {
+        auto lane = RateLimiter::laneForMethod(method);
+        bool accepted = m_rateLimiter->submit(lane, [this, id, payload = std::move(payload)] {
+            transmit(id, payload);
+        });
+        if (!accepted) {
+            std::lock_guard<std::mutex> lock(m_pendingMutex);
+            m_pendingRequests.erase(id);
+            throw std::runtime_error("Rate limiter queue full: " + method);
+        }
+        return id;
+    }
+
+    websocketpp::lib::error_code ec;
+    m_client.send(m_hdl, payload, websocketpp::frame::opcode::text, ec);
+    if (ec) {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pendingRequests.erase(id);
+        throw std::runtime_error("WebSocket send failed: " + ec.message());
+    }
+    return id;
+}
+
+void DeribitWebSocket::setRateLimiter(std::shared_ptr<RateLimiter> limiter) {
+    m_rateLimiter = std::move(limiter);
+}
+
+void DeribitWebSocket::setCancelOnDisconnect(bool enabled) {
+    m_cancelOnDisconnect = enabled;
+    if (m_authenticated) {
+        applyCancelOnDisconnect();
+    }
+}
+
+void DeribitWebSocket::sendRaw(int64_t id, const std::string& payload, ResponseCallback callback) {
+    if (!m_connected) {
+        throw std::runtime_error("WebSocket not connected");
+    }
+
+    if (callback) {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pendingRequests[id] = PendingRequest{std::move(callback), utils::TscClock::nowNs()};
+    }
+
+    // Still charged to the credit model, but never queued behind it
+    if (m_rateLimiter) {
+        m_rateLimiter->tryAcquire(RequestLane::CANCEL);
+    }
+
+    websocketpp::lib::error_code ec;
+    m_client.send(m_hdl, payload, websocketpp::frame::opcode::text, ec);
+    if (ec) {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pendingRequests.erase(id);
+        throw std::runtime_error("WebSocket send failed: " + ec.message());
+    }
+}
+
+void DeribitWebSocket::setAuthManager(std::shared_ptr<AuthManager> auth, bool carriesRefresh) {
+    if (m_auth && m_carriesRefresh) {
+        m_auth->setStreamTransport(nullptr);
+    }
+    m_auth = std::move(auth);
+    m_carriesRefresh = carriesRefresh;
+    if (!m_auth || !m_carriesRefresh) {
+        return;
+    }
+
+    // While this connection is authenticated, refreshes go over it so it
+    // stays authorized; otherwise the manager falls back to REST
+    m_auth->setStreamTransport([this](const nlohmann::json& params) {
+        if (!m_authenticated) {
+            throw std::runtime_error("WebSocket session not authenticated");
+        }
+        return requestBlocking("public/auth", params);
+    });
+}
+
+void DeribitWebSocket::authenticate() {
+    if (!m_auth) {
+        throw std::runtime_error("No AuthManager configured");
+    }
+
+    // Continue the shared session when there is one, so REST and websocket
+    // end up on the same token pair
+    auto session = m_auth->getSession();
+    nlohmann::json params = (session && !session->refreshToken.empty())
+        ? m_auth->buildRefreshParams()
+        : m_auth->buildAuthParams();
+
+    sendRequest("public/auth", params, [this](const nlohmann::json& response) {
+        if (!m_auth->applyAuthResponse(response)) {
+            Logger::getInstance().error("WebSocket authentication failed: ", response.dump());
+            return;
+        }
+        m_authenticated = true;
+        if (m_cancelOnDisconnect) {
+            applyCancelOnDisconnect();
+        }
+        subscribePrivateChannels();
+    });
+}
+
+void DeribitWebSocket::applyCancelOnDisconnect() {
+    const char* method = m_cancelOnDisconnect ? "private/enable_cancel_on_disconnect"
+                                              : "private/disable_cancel_on_disconnect";
+    sendRequest(method, {{"scope", "connection"}}, [method](const nlohmann::json& response) {
+        if (response.contains("error")) {
+            Logger::getInstance().error(method, " failed: ", response["error"].dump());
+        } else {
+            Logger::getInstance().info(method, " acknowledged");
+        }
+    });
+}
+
+bool DeribitWebSocket::isAuthenticated() const {
+    return m_authenticated;
+}
+
 void DeribitWebSocket::onMessage(websocketpp::connection_hdl hdl, WebsocketClient::message_ptr msg) {
-    if (m_messageCallback) {
-        m_messageCallback(msg->get_payload());
+    const std::string& payload = msg->get_payload();
+    pipeline::frameReceived();
+    if (m_frameTap) {
+        m_frameTap(payload, utils::TscClock::wallNowNs());
     }
+    if (!dispatchResponse(payload) && m_messageCallback) {
+        m_messageCallback(payload);
+    }
+    pipeline::frameDone();
 }
 
 void DeribitWebSocket::onOpen(websocketpp::connection_hdl hdl) {
     m_hdl = hdl;
     m_connected = true;
+
+    if (m_auth) {
+        try {
+            authenticate();
+        } catch (const std::exception& e) {
+            Logger::getInstance().error("WebSocket authentication request failed: ", e.what());
+        }
+    }
 }
 
 void DeribitWebSocket::onClose(websocketpp::connection_hdl hdl) {
     m_connected = false;
+    m_authenticated = false;
+    failPendingRequests("connection closed");
 }
 
 void DeribitWebSocket::onFail(websocketpp::connection_hdl hdl) {
     m_connected = false;
+    m_authenticated = false;
+    failPendingRequests("connection failed");
+}
+
+bool DeribitWebSocket::dispatchResponse(const std::string& payload) {
+    // Subscription notifications carry no id, skip parsing them here
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        if (m_pendingRequests.empty()) {
+            return false;
+        }
+    }
+    if (payload.find("\"id\"") == std::string::npos) {
+        return false;
+    }
+
+    nlohmann::json response = nlohmann::json::parse(payload, nullptr, false);
+    if (response.is_discarded() || !response.contains("id") || !response["id"].is_number_integer()) {
+        return false;
+    }
+
+    // too_many_requests, resync the local credit model
+    if (m_rateLimiter && response.contains("error") &&
+        response["error"].value("code", 0) == 10028) {
+        m_rateLimiter->onExchangeRejection();
+    }
+
+    ResponseCallback callback;
+    int64_t sentNs;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        auto it = m_pendingRequests.find(response["id"].get<int64_t>());
+        if (it == m_pendingRequests.end()) {
+            return false;
+        }
+        callback = std::move(it->second.callback);
+        sentNs = it->second.sentNs;
+        m_pendingRequests.erase(it);
+    }
+
+    static const uint32_t requestRtt = LatencyMetrics::getInstance().registerMetric("ws.request_rtt");
+    LatencyMetrics::getInstance().record(requestRtt, static_cast<uint64_t>(utils::TscClock::nowNs() - sentNs));
+    callback(response);
+    return true;
+}
+
+void DeribitWebSocket::failPendingRequests(const std::string& reason) {
+    std::unordered_map<int64_t, PendingRequest> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        pending.swap(m_pendingRequests);
+    }
+
+    for (auto& [id, request] : pending) {
+        request.callback({
+            {"jsonrpc", "2.0"},
+            {"id", id},
+            {"error", {{"code", -1}, {"message", reason}}}
+        });
+    }
+}
+
+void DeribitWebSocket::transmit(int64_t id, const std::string& payload) {
+    // Runs later on the limiter's dispatcher, so report failures through
+    // the request callback instead of throwing
+    if (!m_connected) {
+        failRequest(id, "WebSocket not connected");
+        return;
+    }
+
+    websocketpp::lib::error_code ec;
+    m_client.send(m_hdl, payload, websocketpp::frame::opcode::text, ec);
+    if (ec) {
+        failRequest(id, "WebSocket send failed: " + ec.message());
+    }
+}
+
+void DeribitWebSocket::failRequest(int64_t id, const std::string& reason) {
+    ResponseCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        auto it = m_pendingRequests.find(id);
+        if (it == m_pendingRequests.end()) {
+            return;
+        }
+        callback = std::move(it->second.callback);
+        m_pendingRequests.erase(it);
+    }
+
+    callback({
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"error", {{"code", -1}, {"message", reason}}}
+    });
+}
+
+nlohmann::json DeribitWebSocket::requestBlocking(const std::string& method, const nlohmann::json& params) {
+    auto promise = std::make_shared<std::promise<nlohmann::json>>();
+    auto future = promise->get_future();
+
+    sendRequest(method, params, [promise](const nlohmann::json& response) {
+        promise->set_value(response);
+    });
+
+    if (future.wait_for(kBlockingRequestTimeout) != std::future_status::ready) {
+        throw std::runtime_error("WebSocket request timed out: " + method);
+    }
+    return future.get();
 }
\ No newline at end of file
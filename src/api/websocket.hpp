@@ -6,31 +6,108 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include "api/auth.hpp"
+#include "api/rate_limiter.hpp"
 
 using WebsocketClient = websocketpp::client<websocketpp::config::asio_tls_client>;
 using MessageCallback = std::function<void(const std::string&)>;
+using ResponseCallback = std::function<void(const nlohmann::json&)>;
+// Raw inbound frame and its wall-clock receive time in nanoseconds
+using FrameTap = std::function<void(const std::string& payload, int64_t receiveNs)>;
 
 class DeribitWebSocket {
 public:
     DeribitWebSocket();
     ~DeribitWebSocket();
 
+    // Blocks running the event loop unless setExternalLoop() was called,
+    // then it only starts the connection; waitForOpen() waits for it
     void connect(const std::string& uri);
+    // user.* channels are held until the connection is authenticated and
+    // sent again after every authentication
     void subscribe(const std::string& channel);
     void unsubscribe(const std::string& channel);
     void setMessageCallback(MessageCallback callback);
+    // Sees every frame before it is parsed, set before connect()
+    void setFrameTap(FrameTap tap);
     bool isConnected() const;
+    bool waitForOpen(std::chrono::milliseconds timeout);
     void close();
 
+    // Event loop driven by another thread, e.g. a runtime I/O thread.
+    // run() blocks until stopLoop(), poll() runs ready handlers only and
+    // returns how many, for busy-polling.
+    void setExternalLoop(bool enabled);
+    void run();
+    size_t poll();
+    void stopLoop();
+
+    // JSON-RPC requests, the callback receives the matching response
+    int64_t sendRequest(const std::string& method, const nlohmann::json& params,
+                        ResponseCallback callback = nullptr);
+
+    // Authentication, shares the session with the REST client. Only one
+    // connection per AuthManager should carry the token refreshes.
+    void setAuthManager(std::shared_ptr<AuthManager> auth, bool carriesRefresh = true);
+    void authenticate();
+    bool isAuthenticated() const;
+
+    // Private requests are paced through the limiter when one is set
+    void setRateLimiter(std::shared_ptr<RateLimiter> limiter);
+
+    // Ask the exchange to cancel our orders if this connection drops,
+    // (re)enabled after every successful authentication
+    void setCancelOnDisconnect(bool enabled);
+
+    // Preformatted JSON-RPC frame carrying an id from reserveRequestId().
+    // Skips serialization and the limiter queue, for emergency cancels.
+    int64_t reserveRequestId() { return m_nextRequestId.fetch_add(1); }
+    void sendRaw(int64_t id, const std::string& payload, ResponseCallback callback = nullptr);
+
 private:
     void onMessage(websocketpp::connection_hdl hdl, WebsocketClient::message_ptr msg);
     void onOpen(websocketpp::connection_hdl hdl);
     void onClose(websocketpp::connection_hdl hdl);
     void onFail(websocketpp::connection_hdl hdl);
 
+    bool dispatchResponse(const std::string& payload);
+    void failPendingRequests(const std::string& reason);
+    void transmit(int64_t id, const std::string& payload);
+    void failRequest(int64_t id, const std::string& reason);
+    void applyCancelOnDisconnect();
+    void sendSubscribe(const std::string& channel);
+    void subscribePrivateChannels();
+    nlohmann::json requestBlocking(const std::string& method, const nlohmann::json& params);
+
     WebsocketClient m_client;
     websocketpp::connection_hdl m_hdl;
     MessageCallback m_messageCallback;
-    bool m_connected;
+    FrameTap m_frameTap;
+    std::atomic<bool> m_connected;
+    bool m_externalLoop;
+    // Feed shards resubscribe on book gaps while the main thread subscribes
     std::map<std::string, bool> m_subscriptions;
-};
\ No newline at end of file
+    std::mutex m_subscriptionsMutex;
+
+    // In-flight requests keyed by JSON-RPC id
+    std::atomic<int64_t> m_nextRequestId;
+    struct PendingRequest {
+        ResponseCallback callback;
+        int64_t sentNs;             // TscClock, for the round trip
+    };
+    std::unordered_map<int64_t, PendingRequest> m_pendingRequests;
+    std::mutex m_pendingMutex;
+
+    // Authentication
+    std::shared_ptr<AuthManager> m_auth;
+    std::atomic<bool> m_authenticated;
+    bool m_carriesRefresh;
+    std::atomic<bool> m_cancelOnDisconnect;
+
+    // Outbound pacing
+    std::shared_ptr<RateLimiter> m_rateLimiter;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// On-disk layout of a capture segment. A segment is a file header
+// followed by back-to-back records, each padded to 8 bytes. Segments are
+// preallocated, so a record with length 0 (or the end of the file, once a
+// segment is closed and truncated) marks the end of the data.
+//
+// All fields are little-endian, as written by the host.
+
+constexpr char kCaptureMagic[8] = {'D', 'R', 'B', 'T', 'C', 'A', 'P', '1'};
+constexpr uint32_t kCaptureVersion = 1;
+
+struct CaptureFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;        // sizeof(CaptureFileHeader), records start here
+    uint64_t segmentIndex;      // 0-based position in the rotation
+    int64_t createdNs;          // Wall clock, nanoseconds since the epoch
+};
+static_assert(sizeof(CaptureFileHeader) == 32, "capture header layout changed");
+
+struct CaptureRecordHeader {
+    uint32_t length;            // Payload bytes, excluding this header and padding
+    uint32_t connectionId;
+    int64_t receiveNs;          // Wall clock when the frame was handed to us
+};
+static_assert(sizeof(CaptureRecordHeader) == 16, "capture record layout changed");
+
+inline size_t captureRecordSize(size_t payloadLength) {
+    return (sizeof(CaptureRecordHeader) + payloadLength + 7) & ~static_cast<size_t>(7);
+}
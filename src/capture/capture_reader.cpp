@@ -0,0 +1,139 @@
+#include "capture/capture_reader.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CaptureReader::CaptureReader(std::vector<std::string> paths)
+    : m_paths(std::move(paths))
+    , m_pathIndex(0)
+    , m_map(nullptr)
+    , m_size(0)
+    , m_offset(0) {
+    if (m_paths.empty()) {
+        throw std::invalid_argument("No capture segments to read");
+    }
+    openSegment(0);
+}
+
+CaptureReader::~CaptureReader() {
+    closeSegment();
+}
+
+bool CaptureReader::next(CaptureFrame& frame) {
+    for (;;) {
+        if (m_offset + sizeof(CaptureRecordHeader) <= m_size) {
+            CaptureRecordHeader header;
+            std::memcpy(&header, m_map + m_offset, sizeof(header));
+            // A zero length is the unused tail of a segment that was not
+            // closed cleanly
+            if (header.length != 0) {
+                size_t end = m_offset + sizeof(header) + header.length;
+                if (end > m_size) {
+                    throw std::runtime_error("Truncated record in capture segment " + m_paths[m_pathIndex]);
+                }
+                frame.connectionId = header.connectionId;
+                frame.receiveNs = header.receiveNs;
+                frame.data = m_map + m_offset + sizeof(header);
+                frame.length = header.length;
+                m_offset += captureRecordSize(header.length);
+                return true;
+            }
+        }
+
+        if (m_pathIndex + 1 >= m_paths.size()) {
+            return false;
+        }
+        openSegment(m_pathIndex + 1);
+    }
+}
+
+void CaptureReader::rewind() {
+    openSegment(0);
+}
+
+std::vector<std::string> CaptureReader::listSegments(const std::string& path, const std::string& prefix) {
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0) {
+        throw std::runtime_error("Cannot access capture path " + path + ": " + std::strerror(errno));
+    }
+    if (!S_ISDIR(info.st_mode)) {
+        return {path};
+    }
+
+    DIR* dir = ::opendir(path.c_str());
+    if (!dir) {
+        throw std::runtime_error("Cannot open capture directory " + path + ": " + std::strerror(errno));
+    }
+    std::vector<std::string> segments;
+    const std::string head = prefix + "-";
+    while (dirent* entry = ::readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.compare(0, head.size(), head) == 0 && name.size() > 4 &&
+            name.compare(name.size() - 4, 4, ".cap") == 0) {
+            segments.push_back(path + "/" + name);
+        }
+    }
+    ::closedir(dir);
+
+    // Start time and index are fixed width within a run, so name order is
+    // recording order
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void CaptureReader::openSegment(size_t index) {
+    closeSegment();
+    const std::string& path = m_paths[index];
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open capture segment " + path + ": " + std::strerror(errno));
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Failed to stat capture segment " + path + ": " + std::strerror(error));
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    if (size < sizeof(CaptureFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a capture segment: " + path);
+    }
+
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Failed to map capture segment " + path + ": " + std::strerror(errno));
+    }
+    ::madvise(map, size, MADV_SEQUENTIAL);
+
+    m_map = static_cast<const char*>(map);
+    m_size = size;
+    m_pathIndex = index;
+
+    CaptureFileHeader header;
+    std::memcpy(&header, m_map, sizeof(header));
+    if (std::memcmp(header.magic, kCaptureMagic, sizeof(header.magic)) != 0 ||
+        header.version != kCaptureVersion || header.headerSize < sizeof(CaptureFileHeader) ||
+        header.headerSize > size) {
+        closeSegment();
+        throw std::runtime_error("Not a capture segment or unsupported version: " + path);
+    }
+    m_offset = header.headerSize;
+}
+
+void CaptureReader::closeSegment() {
+    if (m_map) {
+        ::munmap(const_cast<char*>(m_map), m_size);
+        m_map = nullptr;
+    }
+    m_size = 0;
+    m_offset = 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "capture/capture_format.hpp"
+
+// One recorded frame. data points into the mapped segment and stays valid
+// until the reader moves to the next segment or is destroyed.
+struct CaptureFrame {
+    uint32_t connectionId;
+    int64_t receiveNs;
+    const char* data;
+    size_t length;
+};
+
+// Sequential reader over a list of capture segments, in the given order.
+// Each segment is mapped read-only in turn; frames are returned in the
+// order they were written.
+class CaptureReader {
+public:
+    explicit CaptureReader(std::vector<std::string> paths);
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    // False at the end of the last segment
+    bool next(CaptureFrame& frame);
+
+    // Back to the first frame of the first segment
+    void rewind();
+
+    // Segment files in a directory, sorted by start time and index.
+    // A path to a single file is returned as is.
+    static std::vector<std::string> listSegments(const std::string& path,
+                                                 const std::string& prefix = "capture");
+
+private:
+    void openSegment(size_t index);
+    void closeSegment();
+
+    std::vector<std::string> m_paths;
+    size_t m_pathIndex;
+    const char* m_map;
+    size_t m_size;
+    size_t m_offset;
+};
@@ -0,0 +1,254 @@
+#include "capture/frame_recorder.hpp"
+#include "utils/logger.hpp"
+#include "utils/tsc_clock.hpp"
+#include "utils/utils.hpp"
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+    // Records taken from one channel before moving on to the next, so a
+    // busy connection cannot starve the others
+    constexpr size_t kDrainBatch = 1024;
+    constexpr auto kIdleSleep = std::chrono::microseconds(50);
+}
+
+CaptureChannel::CaptureChannel(uint32_t connectionId, size_t ringBytes)
+    : m_connectionId(connectionId)
+    , m_ring(ringBytes)
+    , m_dropped(0) {
+}
+
+bool CaptureChannel::record(const char* data, size_t length, int64_t receiveNs) {
+    char* slot = m_ring.beginWrite(sizeof(CaptureRecordHeader) + length);
+    if (!slot) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    CaptureRecordHeader header;
+    header.length = static_cast<uint32_t>(length);
+    header.connectionId = m_connectionId;
+    header.receiveNs = receiveNs;
+    std::memcpy(slot, &header, sizeof(header));
+    std::memcpy(slot + sizeof(header), data, length);
+    m_ring.commitWrite();
+    return true;
+}
+
+FrameRecorder::FrameRecorder(const FrameRecorderConfig& config)
+    : m_config(config)
+    , m_startSeconds(0)
+    , m_channelGeneration(0)
+    , m_fd(-1)
+    , m_map(nullptr)
+    , m_offset(0)
+    , m_segmentIndex(0)
+    , m_running(false)
+    , m_frames(0)
+    , m_bytes(0)
+    , m_segments(0)
+    , m_writeErrors(0) {
+    // Any record a ring accepts must fit in an empty segment
+    if (m_config.segmentBytes < sizeof(CaptureFileHeader) + m_config.channelRingBytes) {
+        throw std::invalid_argument("Capture segment must be larger than the channel ring");
+    }
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize > 0) {
+        size_t page = static_cast<size_t>(pageSize);
+        m_config.segmentBytes = (m_config.segmentBytes + page - 1) / page * page;
+    }
+}
+
+FrameRecorder::~FrameRecorder() {
+    stop();
+}
+
+void FrameRecorder::start() {
+    if (m_running) {
+        return;
+    }
+    m_startSeconds = nowNs() / 1000000000;
+    m_segmentIndex = 0;
+    openSegment();
+
+    m_running = true;
+    m_writer = std::thread([this] { run(); });
+}
+
+void FrameRecorder::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+    closeSegment();
+
+    auto stats = getStats();
+    Logger::getInstance().info("Capture stopped - frames: ", stats.frames, ", bytes: ", stats.bytes,
+                               ", dropped: ", stats.dropped, ", segments: ", stats.segments,
+                               ", write errors: ", stats.writeErrors);
+}
+
+std::shared_ptr<CaptureChannel> FrameRecorder::createChannel(uint32_t connectionId) {
+    auto channel = std::make_shared<CaptureChannel>(connectionId, m_config.channelRingBytes);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_channels.push_back(channel);
+    m_channelGeneration.fetch_add(1, std::memory_order_release);
+    return channel;
+}
+
+FrameRecorderStats FrameRecorder::getStats() const {
+    FrameRecorderStats stats;
+    stats.frames = m_frames.load(std::memory_order_relaxed);
+    stats.bytes = m_bytes.load(std::memory_order_relaxed);
+    stats.segments = m_segments.load(std::memory_order_relaxed);
+    stats.writeErrors = m_writeErrors.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& channel : m_channels) {
+        stats.dropped += channel->getDropped();
+    }
+    return stats;
+}
+
+std::string FrameRecorder::getCurrentSegmentPath() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_segmentPath;
+}
+
+int64_t FrameRecorder::nowNs() {
+    return utils::TscClock::wallNowNs();
+}
+
+void FrameRecorder::run() {
+    utils::ThreadUtils::onThreadStart("logging", "capture-writer");
+    std::vector<std::shared_ptr<CaptureChannel>> channels;
+    uint64_t generation = UINT64_MAX;
+
+    for (;;) {
+        // Read the flag before draining so frames queued before stop() are kept
+        bool stopping = !m_running.load(std::memory_order_acquire);
+
+        uint64_t current = m_channelGeneration.load(std::memory_order_acquire);
+        if (current != generation) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            channels = m_channels;
+            generation = current;
+        }
+
+        // Segment rotation can fail (disk full, mmap); capture is not worth
+        // the process, so the writer gives up and the rings fill and drop
+        size_t written = 0;
+        try {
+            for (const auto& channel : channels) {
+                written += drain(*channel, kDrainBatch);
+            }
+        } catch (const std::exception& e) {
+            m_writeErrors.fetch_add(1, std::memory_order_relaxed);
+            Logger::getInstance().error("Capture stopped, frames are dropped from now on: ", e.what());
+            closeSegment();
+            return;
+        }
+
+        if (written == 0) {
+            if (stopping) {
+                break;
+            }
+            std::this_thread::sleep_for(kIdleSleep);
+        }
+    }
+}
+
+size_t FrameRecorder::drain(CaptureChannel& channel, size_t maxRecords) {
+    size_t count = 0;
+    size_t length = 0;
+    const char* record;
+    while (count < maxRecords && (record = channel.m_ring.beginRead(length)) != nullptr) {
+        append(record, length);
+        channel.m_ring.commitRead();
+        ++count;
+    }
+    return count;
+}
+
+void FrameRecorder::append(const char* record, size_t length) {
+    size_t padded = (length + 7) & ~static_cast<size_t>(7);
+    if (m_offset + padded > m_config.segmentBytes) {
+        closeSegment();
+        ++m_segmentIndex;
+        openSegment();
+    }
+
+    // The file is zero-filled, padding needs no write
+    std::memcpy(m_map + m_offset, record, length);
+    m_offset += padded;
+
+    m_frames.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(length - sizeof(CaptureRecordHeader), std::memory_order_relaxed);
+}
+
+void FrameRecorder::openSegment() {
+    char name[64];
+    std::snprintf(name, sizeof(name), "-%lld-%06llu.cap",
+                  static_cast<long long>(m_startSeconds),
+                  static_cast<unsigned long long>(m_segmentIndex));
+    std::string path = m_config.directory + "/" + m_config.prefix + name;
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open capture segment " + path + ": " + std::strerror(errno));
+    }
+    if (::ftruncate(fd, static_cast<off_t>(m_config.segmentBytes)) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Failed to size capture segment " + path + ": " + std::strerror(error));
+    }
+
+    void* map = ::mmap(nullptr, m_config.segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Failed to map capture segment " + path + ": " + std::strerror(error));
+    }
+    ::madvise(map, m_config.segmentBytes, MADV_SEQUENTIAL);
+
+    CaptureFileHeader header;
+    std::memcpy(header.magic, kCaptureMagic, sizeof(header.magic));
+    header.version = kCaptureVersion;
+    header.headerSize = sizeof(CaptureFileHeader);
+    header.segmentIndex = m_segmentIndex;
+    header.createdNs = nowNs();
+    std::memcpy(map, &header, sizeof(header));
+
+    m_fd = fd;
+    m_map = static_cast<char*>(map);
+    m_offset = sizeof(CaptureFileHeader);
+    m_segments.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_segmentPath = path;
+    }
+    Logger::getInstance().info("Capture segment opened: ", path);
+}
+
+void FrameRecorder::closeSegment() {
+    if (m_fd < 0) {
+        return;
+    }
+
+    // Trim the preallocated tail so the file ends at the last record
+    ::munmap(m_map, m_config.segmentBytes);
+    if (::ftruncate(m_fd, static_cast<off_t>(m_offset)) != 0) {
+        Logger::getInstance().warning("Failed to trim capture segment: ", std::strerror(errno));
+    }
+    ::close(m_fd);
+    m_fd = -1;
+    m_map = nullptr;
+}
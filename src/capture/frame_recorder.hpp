@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "capture/capture_format.hpp"
+#include "utils/lockfree_queue.hpp"
+#include "utils/spsc_ring.hpp"
+
+struct FrameRecorderConfig {
+    std::string directory = ".";
+    std::string prefix = "capture";
+    size_t segmentBytes = 256u << 20;   // Preallocated size of each file
+    size_t channelRingBytes = 16u << 20; // Per-connection staging ring
+};
+
+struct FrameRecorderStats {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;             // Payload bytes written to disk
+    uint64_t dropped = 0;           // Frames lost to a full ring
+    uint64_t segments = 0;
+    uint64_t writeErrors = 0;       // Writer failures; capture stops at the first
+};
+
+class FrameRecorder;
+
+// Producer side for one connection. record() copies the frame into a
+// private SPSC ring and returns; it never blocks or touches the file, so
+// it is safe to call from a websocket I/O thread. Only one thread may
+// record on a channel.
+class CaptureChannel {
+public:
+    CaptureChannel(uint32_t connectionId, size_t ringBytes);
+
+    bool record(const char* data, size_t length, int64_t receiveNs);
+    bool record(const std::string& payload, int64_t receiveNs) {
+        return record(payload.data(), payload.size(), receiveNs);
+    }
+
+    uint32_t getConnectionId() const { return m_connectionId; }
+    uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    friend class FrameRecorder;
+
+    const uint32_t m_connectionId;
+    utils::SpscByteRing m_ring;
+    alignas(utils::kCacheLineSize) std::atomic<uint64_t> m_dropped;
+};
+
+// Lossless capture of raw inbound frames to append-only, memory-mapped
+// segment files (<prefix>-<start>-<index>.cap). A single writer thread
+// drains every channel into the current segment and rotates to a fresh,
+// preallocated file when it fills. Records keep the receive timestamp
+// taken on the I/O thread, so disk stalls never skew them.
+class FrameRecorder {
+public:
+    explicit FrameRecorder(const FrameRecorderConfig& config);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    void start();
+    // Drains what is already queued, then closes the current segment
+    void stop();
+    bool isRunning() const { return m_running; }
+
+    // Connection IDs are written into every record of the channel
+    std::shared_ptr<CaptureChannel> createChannel(uint32_t connectionId);
+
+    FrameRecorderStats getStats() const;
+    std::string getCurrentSegmentPath() const;
+
+    // Wall clock in nanoseconds, the timestamp used for receiveNs
+    static int64_t nowNs();
+
+private:
+    void run();
+    size_t drain(CaptureChannel& channel, size_t maxRecords);
+    void append(const char* record, size_t length);
+    void openSegment();
+    void closeSegment();
+
+    FrameRecorderConfig m_config;
+    int64_t m_startSeconds;
+
+    // Channels are added under the mutex and picked up by the writer
+    // through the generation counter
+    std::vector<std::shared_ptr<CaptureChannel>> m_channels;
+    std::atomic<uint64_t> m_channelGeneration;
+    mutable std::mutex m_mutex;
+
+    // Current segment, writer thread only
+    int m_fd;
+    char* m_map;
+    size_t m_offset;
+    uint64_t m_segmentIndex;
+    std::string m_segmentPath;
+
+    std::thread m_writer;
+    std::atomic<bool> m_running;
+
+    std::atomic<uint64_t> m_frames;
+    std::atomic<uint64_t> m_bytes;
+    std::atomic<uint64_t> m_segments;
+    std::atomic<uint64_t> m_writeErrors;
+};
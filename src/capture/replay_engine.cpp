@@ -0,0 +1,237 @@
+#include "capture/replay_engine.hpp"
+#include "utils/logger.hpp"
+#include "utils/spsc_ring.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr size_t kLoaderRingBytes = 64u << 20;
+    // Closer than this to a frame's release time we spin instead of sleeping
+    constexpr int64_t kSpinThresholdNs = 200000;
+
+    int64_t elapsedSince(Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    // Releases frames at their recorded spacing, scaled. The first frame
+    // anchors the schedule.
+    class Pacer {
+    public:
+        explicit Pacer(double speed) : m_speed(speed), m_started(false), m_firstNs(0), m_maxLagNs(0) {}
+
+        void wait(int64_t receiveNs) {
+            if (!m_started) {
+                m_started = true;
+                m_firstNs = receiveNs;
+                m_start = Clock::now();
+                return;
+            }
+
+            int64_t due = static_cast<int64_t>((receiveNs - m_firstNs) / m_speed);
+            int64_t now = elapsedSince(m_start);
+            if (now > due) {
+                m_maxLagNs = std::max(m_maxLagNs, now - due);
+                return;
+            }
+            if (due - now > kSpinThresholdNs) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now - kSpinThresholdNs / 2));
+            }
+            while (elapsedSince(m_start) < due) {
+            }
+        }
+
+        int64_t getMaxLagNs() const { return m_maxLagNs; }
+
+    private:
+        double m_speed;
+        bool m_started;
+        int64_t m_firstNs;
+        Clock::time_point m_start;
+        int64_t m_maxLagNs;
+    };
+
+    double speedFor(const ReplayConfig& config) {
+        switch (config.pacing) {
+            case ReplayPacing::REAL_TIME: return 1.0;
+            case ReplayPacing::SCALED: return config.speed;
+            default: return 0.0;
+        }
+    }
+
+    uint64_t fnv1a(uint64_t hash, const void* data, size_t length) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < length; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+ReplayEngine::ReplayEngine(deribit::MarketDataManager& marketData, const ReplayConfig& config)
+    : m_marketData(marketData)
+    , m_config(config)
+    , m_stopRequested(false) {
+    if (m_config.pacing == ReplayPacing::SCALED && !(m_config.speed > 0.0)) {
+        throw std::invalid_argument("Replay speed must be positive");
+    }
+    if (m_config.deterministic && m_config.pacing != ReplayPacing::AS_FAST_AS_POSSIBLE) {
+        Logger::getInstance().warning("Deterministic replay ignores pacing");
+        m_config.pacing = ReplayPacing::AS_FAST_AS_POSSIBLE;
+    }
+}
+
+void ReplayEngine::addInstrument(const std::string& instrument) {
+    m_marketData.addOrderBook(instrument);
+    m_instruments.push_back(instrument);
+}
+
+ReplayStats ReplayEngine::run(CaptureReader& reader) {
+    ReplayStats stats;
+    m_stopRequested = false;
+
+    auto start = Clock::now();
+    if (m_config.deterministic) {
+        runDeterministic(reader, stats);
+    } else {
+        runThreaded(reader, stats);
+    }
+    stats.elapsedNs = elapsedSince(start);
+    stats.bookDigest = bookDigest(m_marketData, m_instruments);
+    return stats;
+}
+
+void ReplayEngine::runDeterministic(CaptureReader& reader, ReplayStats& stats) {
+    CaptureFrame frame;
+    while (!m_stopRequested.load(std::memory_order_relaxed) && reader.next(frame)) {
+        if (!accept(frame, stats)) {
+            continue;
+        }
+        process(frame.data, frame.length, stats);
+        if (m_config.maxFrames != 0 && stats.frames >= m_config.maxFrames) {
+            break;
+        }
+    }
+}
+
+void ReplayEngine::runThreaded(CaptureReader& reader, ReplayStats& stats) {
+    utils::SpscByteRing ring(kLoaderRingBytes);
+    std::atomic<bool> loaderDone(false);
+    int64_t maxLagNs = 0;
+    uint64_t skipped = 0;
+
+    // Loader: walks the mapped segments and paces frames into the ring
+    std::thread loader([&] {
+        Pacer pacer(speedFor(m_config));
+        const bool paced = m_config.pacing != ReplayPacing::AS_FAST_AS_POSSIBLE;
+        ReplayStats filterStats;
+        uint64_t queued = 0;
+        CaptureFrame frame;
+
+        while (!m_stopRequested.load(std::memory_order_relaxed) && reader.next(frame)) {
+            if (!accept(frame, filterStats)) {
+                continue;
+            }
+            if (frame.length > ring.maxRecordSize()) {
+                Logger::getInstance().warning("Replay skipped an oversized frame of ", frame.length, " bytes");
+                continue;
+            }
+            if (paced) {
+                pacer.wait(frame.receiveNs);
+            }
+
+            char* slot;
+            while ((slot = ring.beginWrite(frame.length)) == nullptr) {
+                if (m_stopRequested.load(std::memory_order_relaxed)) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+            if (!slot) {
+                break;
+            }
+            std::memcpy(slot, frame.data, frame.length);
+            ring.commitWrite();
+
+            if (m_config.maxFrames != 0 && ++queued >= m_config.maxFrames) {
+                break;
+            }
+        }
+
+        maxLagNs = pacer.getMaxLagNs();
+        skipped = filterStats.skipped;
+        loaderDone.store(true, std::memory_order_release);
+    });
+
+    // Caller thread: parse and apply, as the websocket callback would
+    size_t length = 0;
+    for (;;) {
+        if (const char* data = ring.beginRead(length)) {
+            process(data, length, stats);
+            ring.commitRead();
+            continue;
+        }
+        if (loaderDone.load(std::memory_order_acquire)) {
+            // Anything published before the flag is visible now
+            if (ring.beginRead(length) == nullptr) {
+                break;
+            }
+            continue;
+        }
+    }
+    loader.join();
+
+    stats.maxLagNs = maxLagNs;
+    stats.skipped = skipped;
+}
+
+void ReplayEngine::process(const char* data, size_t length, ReplayStats& stats) {
+    m_message.assign(data, length);
+
+    if (m_config.measureLatency) {
+        auto start = Clock::now();
+        m_marketData.processMessage(m_message);
+        stats.latency.record(static_cast<uint64_t>(elapsedSince(start)));
+    } else {
+        m_marketData.processMessage(m_message);
+    }
+
+    ++stats.frames;
+    stats.bytes += length;
+}
+
+bool ReplayEngine::accept(const CaptureFrame& frame, ReplayStats& stats) const {
+    if (m_config.connectionId != UINT32_MAX && frame.connectionId != m_config.connectionId) {
+        ++stats.skipped;
+        return false;
+    }
+    return true;
+}
+
+uint64_t ReplayEngine::bookDigest(deribit::MarketDataManager& marketData,
+                                  const std::vector<std::string>& instruments) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const auto& instrument : instruments) {
+        hash = fnv1a(hash, instrument.data(), instrument.size());
+        auto book = marketData.getOrderBook(instrument);
+        if (!book) {
+            continue;
+        }
+        for (const auto& level : book->getBidLevels()) {
+            hash = fnv1a(hash, &level.first, sizeof(level.first));
+            hash = fnv1a(hash, &level.second.totalVolume, sizeof(level.second.totalVolume));
+        }
+        // Separates the sides so a level cannot move between them unnoticed
+        hash = fnv1a(hash, "|", 1);
+        for (const auto& level : book->getAskLevels()) {
+            hash = fnv1a(hash, &level.first, sizeof(level.first));
+            hash = fnv1a(hash, &level.second.totalVolume, sizeof(level.second.totalVolume));
+        }
+    }
+    return hash;
+}
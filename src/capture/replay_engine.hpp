@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "capture/capture_reader.hpp"
+#include "market/market_data.hpp"
+#include "utils/histogram.hpp"
+
+enum class ReplayPacing {
+    AS_FAST_AS_POSSIBLE,
+    REAL_TIME,          // Frames released at their recorded spacing
+    SCALED              // Recorded spacing divided by ReplayConfig::speed
+};
+
+struct ReplayConfig {
+    ReplayPacing pacing = ReplayPacing::AS_FAST_AS_POSSIBLE;
+    double speed = 1.0;                 // SCALED only, 2.0 is twice real time
+    uint32_t connectionId = UINT32_MAX; // UINT32_MAX replays every connection
+    uint64_t maxFrames = 0;             // 0 replays the whole capture
+
+    // Everything on the calling thread in file order with no pacing, so
+    // the same capture always produces the same callbacks and books.
+    // Otherwise a loader thread reads and paces frames into a ring, like
+    // the I/O thread does live, and the caller only processes them.
+    bool deterministic = false;
+
+    // Time every processMessage() call; costs two clock reads per frame
+    bool measureLatency = false;
+};
+
+struct ReplayStats {
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t skipped = 0;               // Other connections
+    int64_t elapsedNs = 0;
+    int64_t maxLagNs = 0;               // Worst delivery behind schedule, paced modes
+    uint64_t bookDigest = 0;            // Of every added book after the run
+    utils::LatencyHistogram latency;    // Per frame, with measureLatency
+
+    double messagesPerSecond() const {
+        return elapsedNs > 0 ? frames * 1e9 / elapsedNs : 0.0;
+    }
+    double megabytesPerSecond() const {
+        return elapsedNs > 0 ? bytes * 1e3 / elapsedNs : 0.0;
+    }
+};
+
+// Feeds recorded frames straight into MarketDataManager's message path,
+// for benchmarking parse and book apply on real data and for regression
+// runs. Books are not created by subscription here, so every instrument
+// of interest must be added first.
+class ReplayEngine {
+public:
+    ReplayEngine(deribit::MarketDataManager& marketData, const ReplayConfig& config);
+
+    void addInstrument(const std::string& instrument);
+
+    ReplayStats run(CaptureReader& reader);
+
+    // Ends a run early, safe from any thread
+    void stop() { m_stopRequested = true; }
+
+    // Order-sensitive hash of the given books' levels, for comparing runs
+    static uint64_t bookDigest(deribit::MarketDataManager& marketData,
+                               const std::vector<std::string>& instruments);
+
+private:
+    void runDeterministic(CaptureReader& reader, ReplayStats& stats);
+    void runThreaded(CaptureReader& reader, ReplayStats& stats);
+    void process(const char* data, size_t length, ReplayStats& stats);
+    bool accept(const CaptureFrame& frame, ReplayStats& stats) const;
+
+    deribit::MarketDataManager& m_marketData;
+    ReplayConfig m_config;
+    std::vector<std::string> m_instruments;
+    std::string m_message;              // Reused for every frame
+    std::atomic<bool> m_stopRequested;
+};
@@ -1,13 +1,25 @@
 #include "api/client.hpp"
 #include "api/websocket.hpp"
+#include "capture/frame_recorder.hpp"
+#include "metrics/latency_metrics.hpp"
+#include "metrics/metrics_server.hpp"
+#include "metrics/trace_recorder.hpp"
 #include "order/order.hpp"
 #include "order/orderbook.hpp"
+#include "order/order_manager.hpp"
 #include "market/market_data.hpp"
+#include "risk/kill_switch.hpp"
+#include "risk/position_engine.hpp"
+#include "risk/pre_trade_risk.hpp"
+#include "runtime/runtime.hpp"
+#include "strategy/quote_engine.hpp"
 #include "utils/logger.hpp"
 #include "utils/config.hpp"
+#include "utils/tsc_clock.hpp"
 #include "types.hpp"
 
 #include <iostream>
+#include <set>
 #include <thread>
 #include <atomic>
 #include <csignal>
@@ -16,9 +28,13 @@
 using namespace deribit;
 
 std::atomic<bool> running{true};
+std::atomic<KillSwitch*> killSwitchHandle{nullptr};
 
 void signalHandler(int signal) {
     running = false;
+    if (KillSwitch* killSwitch = killSwitchHandle.load()) {
+        killSwitch->triggerFromSignal();
+    }
     std::cout << "\nShutting down..." << std::endl;
 }
 
@@ -26,30 +42,27 @@ void signalHandler(int signal) {
 void handleOrderBookUpdate(const std::string& instrument, 
                          const std::string& channel,
                          const nlohmann::json& data) {
-    auto& logger = Logger::getInstance();
-    logger.info("OrderBook Update - Instrument: ", instrument, 
-                ", Channel: ", channel);
+    LOG_DEBUG("OrderBook Update - Instrument: ", instrument,
+              ", Channel: ", channel);
 }
 
 // Callback for market data updates
 void handleMarketData(const std::string& instrument, 
                     const std::string& channel,
                     const nlohmann::json& data) {
-    auto& logger = Logger::getInstance();
     if (channel.find("trades") != std::string::npos) {
-        logger.info("Trade Update - Instrument: ", instrument,
-                   ", Data: ", data.dump());
+        LOG_DEBUG("Trade Update - Instrument: ", instrument,
+                  ", Data: ", data.dump());
     } else if (channel.find("ticker") != std::string::npos) {
-        logger.info("Ticker Update - Instrument: ", instrument,
-                   ", Data: ", data.dump());
+        LOG_DEBUG("Ticker Update - Instrument: ", instrument,
+                  ", Data: ", data.dump());
     }
 }
 
 // Callback for order updates
 void handleOrderUpdate(const Order& order) {
-    auto& logger = Logger::getInstance();
-    logger.info("Order Update - ID: ", order.getOrderId(),
-                ", Status: ", static_cast<int>(order.getStatus()));
+    LOG_DEFERRED(LogLevel::INFO, "Order Update - ID: {}, Status: {}",
+                 order.getOrderId(), order.getStatus());
 }
 
 int main(int argc, char* argv[]) {
@@ -69,25 +82,133 @@ int main(int argc, char* argv[]) {
             config.loadFromFile(argv[1]);
         }
 
+        // Thread topology; threads started from here on are named and
+        // placed by role
+        Runtime runtime(RuntimeConfig::fromConfig(config));
+        runtime.installThreadStartHook();
+
+        // Move formatting and file I/O off the hot threads
+        if (config.getBool("log_async", false)) {
+            AsyncLogConfig logConfig;
+            logConfig.ringBytes = static_cast<size_t>(config.getInt("log_ring_kb", 1024)) << 10;
+            logConfig.overflow = Logger::parseOverflowPolicy(config.getString("log_overflow", "count"));
+            logConfig.flushInterval = std::chrono::milliseconds(config.getInt("log_flush_ms", 100));
+            logConfig.binaryFile = config.getString("log_binary_file", "");
+            logger.startAsync(logConfig);
+        }
+
+        // Keep the TSC rate and wall clock anchor fresh
+        int recalibrationMs = config.getInt("clock_recalibration_ms", 60000);
+        if (recalibrationMs > 0) {
+            ::utils::TscClock::startRecalibration(std::chrono::milliseconds(recalibrationMs));
+        }
+
+        // Periodic per-stage latency percentiles, 0 turns them off
+        auto& latencyMetrics = LatencyMetrics::getInstance();
+        int latencyReportMs = config.getInt("latency_report_interval_ms", 10000);
+        if (latencyReportMs > 0) {
+            latencyMetrics.startReporter(std::chrono::milliseconds(latencyReportMs));
+        }
+
+        // Flight recorder, dumped on SIGUSR1 or a slow frame
+        auto& traceRecorder = TraceRecorder::getInstance();
+        if (config.getBool("trace_enabled", false)) {
+            TraceConfig traceConfig;
+            traceConfig.eventsPerThread = static_cast<size_t>(config.getInt("trace_events_per_thread", 65536));
+            traceConfig.directory = config.getString("trace_dir", "traces");
+            traceConfig.thresholdNs = static_cast<int64_t>(config.getInt("trace_threshold_us", 2000)) * 1000;
+            traceRecorder.start(traceConfig);
+            signal(SIGUSR1, TraceRecorder::signalHandler);
+        }
+
+        // Shared auth session for REST and WebSocket
+        auto auth = std::make_shared<AuthManager>(
+            config.getApiKey(), config.getApiSecret(),
+            config.getAuthMethod() == "client_signature" ? AuthMethod::CLIENT_SIGNATURE
+                                                         : AuthMethod::CLIENT_CREDENTIALS);
+        auth->setRefreshMargin(config.getAuthRefreshMargin());
+
+        // Shared outbound pacing, modelled on the exchange credit bucket
+        RateLimiterConfig rateLimits;
+        rateLimits.burstCredits = config.getInt("rate_limit_burst_credits", 50000);
+        rateLimits.refillPerSecond = config.getInt("rate_limit_refill_per_second", 10000);
+        rateLimits.costPerRequest = config.getInt("rate_limit_cost_per_request", 500);
+        auto rateLimiter = std::make_shared<RateLimiter>(rateLimits);
+        rateLimiter->start();
+
+        // Prometheus scrape endpoint, metrics_port 0 turns it off
+        std::unique_ptr<MetricsServer> metricsServer;
+        int metricsPort = config.getInt("metrics_port", 9464);
+        if (metricsPort > 0) {
+            MetricsServerConfig metricsConfig;
+            metricsConfig.bindAddress = config.getString("metrics_bind", "127.0.0.1");
+            metricsConfig.port = static_cast<uint16_t>(metricsPort);
+            metricsServer = std::make_unique<MetricsServer>(metricsConfig);
+            metricsServer->exposeRate("deribit_feed_messages_total", "deribit_feed_messages_per_second",
+                                      "Feed messages per second since the previous scrape");
+            metricsServer->addCollector([rateLimiter](PrometheusWriter& out) {
+                static const char* kLaneNames[kRequestLaneCount] = {"cancel", "order", "query"};
+                auto stats = rateLimiter->getStats();
+                for (size_t lane = 0; lane < kRequestLaneCount; ++lane) {
+                    std::string labels = "lane=\"" + std::string(kLaneNames[lane]) + "\"";
+                    out.counter("deribit_rate_limit_sent_total", "Requests sent",
+                                labels, static_cast<double>(stats.sent[lane]));
+                    out.counter("deribit_rate_limit_deferred_total", "Requests deferred for credits",
+                                labels, static_cast<double>(stats.deferred[lane]));
+                    out.counter("deribit_rate_limit_dropped_total", "Requests dropped on a full lane queue",
+                                labels, static_cast<double>(stats.dropped[lane]));
+                    out.counter("deribit_rate_limit_wait_seconds_total", "Time deferred requests waited",
+                                labels, static_cast<double>(stats.totalQueueTimeNs[lane]) / 1e9);
+                    out.gauge("deribit_rate_limit_max_wait_seconds", "Longest wait of a deferred request",
+                              labels, static_cast<double>(stats.maxQueueTimeNs[lane]) / 1e9);
+                    out.gauge("deribit_rate_limit_queue_depth", "Deferred requests waiting",
+                              labels, static_cast<double>(stats.queueDepth[lane]));
+                }
+                out.counter("deribit_rate_limit_exchange_rejections_total", "too_many_requests replies", "",
+                            static_cast<double>(stats.exchangeRejections));
+                out.gauge("deribit_rate_limit_available_credits", "Credits left in the local bucket", "",
+                          static_cast<double>(stats.availableCredits));
+            });
+            metricsServer->addCollector([&logger](PrometheusWriter& out) {
+                auto stats = logger.getStats();
+                out.counter("deribit_log_records_total", "Log records written", "",
+                            static_cast<double>(stats.written));
+                out.counter("deribit_log_dropped_total", "Log records dropped on a full ring", "",
+                            static_cast<double>(stats.dropped));
+            });
+            metricsServer->start();
+        }
+
         // Initialize API client
-        std::string apiKey = config.getApiKey();
-        std::string apiSecret = config.getApiSecret();
-        DeribitClient client(apiKey, apiSecret);
+        DeribitClient client(auth, config.getRestUrl());
+        client.setRateLimiter(rateLimiter);
+
+        // Optional lossless capture of every inbound frame
+        std::unique_ptr<FrameRecorder> recorder;
+        const std::string captureDir = config.getString("capture_dir", "");
+        if (!captureDir.empty()) {
+            FrameRecorderConfig captureConfig;
+            captureConfig.directory = captureDir;
+            captureConfig.segmentBytes = static_cast<size_t>(config.getInt("capture_segment_mb", 256)) << 20;
+            captureConfig.channelRingBytes = static_cast<size_t>(config.getInt("capture_ring_mb", 16)) << 20;
+            recorder = std::make_unique<FrameRecorder>(captureConfig);
+            recorder->start();
+        }
 
         // Initialize WebSocket connection
         DeribitWebSocket ws;
-        ws.setMessageCallback([&logger](const std::string& msg) {
-            logger.debug("WebSocket message received: ", msg);
+        ws.setAuthManager(auth);
+        ws.setRateLimiter(rateLimiter);
+        ws.setCancelOnDisconnect(config.getBool("cancel_on_disconnect", true));
+        ws.setMessageCallback([](const std::string& msg) {
+            LOG_DEBUG("WebSocket message received: ", msg);
         });
-
-        // Connect to WebSocket
-        logger.info("Connecting to WebSocket...");
-        ws.connect(config.getWsUrl());
-
-        // Initialize Market Data Manager
-        MarketDataManager marketData(config.getWsUrl());
-        marketData.setOrderBookCallback(handleOrderBookUpdate);
-        marketData.setMarketDataCallback(handleMarketData);
+        if (recorder) {
+            auto channel = recorder->createChannel(0);
+            ws.setFrameTap([channel](const std::string& payload, int64_t receiveNs) {
+                channel->record(payload, receiveNs);
+            });
+        }
 
         // Subscribe to instruments
         const std::vector<std::string> instruments = {
@@ -95,40 +216,174 @@ int main(int argc, char* argv[]) {
             "ETH-PERPETUAL"
         };
 
+        // Pre-trade risk limits, compiled once from config
+        auto riskGate = std::make_shared<PreTradeRiskGate>(RiskLimits::fromConfig(config));
+        for (const auto& instrument : instruments) {
+            riskGate->registerInstrument(instrument, PositionEngine::isInverseInstrument(instrument));
+        }
+
+        // Event-driven positions, reconciled against REST periodically
+        PositionEngine positions;
+        std::set<std::string> currencies;
+        for (const auto& instrument : instruments) {
+            positions.registerInstrument(instrument, PositionEngine::isInverseInstrument(instrument));
+            currencies.insert(instrument.substr(0, instrument.find('-')));
+        }
+
+        // Local order state, keyed by client order ID and exchange ID
+        OrderManager orderManager(ws);
+        orderManager.setRiskGate(riskGate);
+
+        // Quote ladders published by the strategy, diffed against live orders
+        QuoteEngine quotes(orderManager);
+        for (const auto& instrument : instruments) {
+            auto spec = client.getInstrument(instrument);
+            const auto& result = spec.contains("result") ? spec["result"] : spec;
+            quotes.registerInstrument(instrument,
+                                      result.value("tick_size", 0.5),
+                                      result.value("min_trade_amount", 0.0));
+        }
+
+        // Halts order entry and pulls everything on signal or on demand
+        KillSwitch killSwitch(ws);
+        killSwitch.addRiskGate(riskGate);
+        killSwitch.addOrderManager(orderManager);
+        killSwitch.arm();
+        killSwitchHandle = &killSwitch;
+
+        orderManager.setOrderUpdateCallback([&quotes](const Order& order) {
+            quotes.onOrderUpdate(order);
+            handleOrderUpdate(order);
+        });
+        orderManager.setFillCallback([&positions](const Order& order, double price, double amount) {
+            positions.onFill(order.getInstrument(), order.getSide(), price, amount);
+        });
+
+        // Initialize Market Data Manager
+        MarketDataManager marketData(config.getWsUrl());
+        marketData.setAuthManager(auth);
+        if (recorder) {
+            auto channel = recorder->createChannel(1);
+            marketData.setFrameTap([channel](const std::string& payload, int64_t receiveNs) {
+                channel->record(payload, receiveNs);
+            });
+        }
+        marketData.setOrderCallback([&orderManager](const OrderResponse& response) {
+            orderManager.onOrderUpdate(response.raw);
+        });
+        marketData.setTradeCallback([&orderManager](const Trade& trade) {
+            orderManager.onTrade(trade.raw);
+        });
+        marketData.setOrderBookCallback([&marketData, &riskGate](const std::string& instrument,
+                                                                 const std::string& channel,
+                                                                 const nlohmann::json& data) {
+            // Keep the risk gate's price band anchored to the current mid
+            if (auto book = marketData.getOrderBook(instrument)) {
+                riskGate->updateReferencePrice(riskGate->getInstrumentId(instrument), book->getMidPrice());
+            }
+            handleOrderBookUpdate(instrument, channel, data);
+        });
+        marketData.setMarketDataCallback([&positions](const std::string& instrument,
+                                                      const std::string& channel,
+                                                      const nlohmann::json& data) {
+            if (channel.find("ticker") != std::string::npos && data.contains("mark_price")) {
+                positions.onMark(instrument, data["mark_price"].get<double>());
+            }
+            handleMarketData(instrument, channel, data);
+        });
+
+        // Event loops on the I/O threads, market data decoded on the feed
+        // shards, every book update wakes the strategy
+        runtime.addConnection(ws);
+        runtime.addConnection(marketData.getWebSocket());
+        marketData.setFrameDispatcher([&runtime](const std::string& payload) {
+            runtime.dispatchFeed(payload);
+        });
+        runtime.setFeedHandler([&marketData, &runtime](const std::string& payload) {
+            marketData.processMessage(payload);
+            runtime.wakeStrategy();
+        });
+        // The I/O threads run the sockets' event loops, so they must stop
+        // before ws and marketData go away on any exit path
+        struct RuntimeStopper {
+            Runtime& runtime;
+            ~RuntimeStopper() { runtime.stop(); }
+        } runtimeStopper{runtime};
+        runtime.start();
+
+        // Connect to WebSocket
+        logger.info("Connecting to WebSocket...");
+        ws.connect(config.getWsUrl());
+        marketData.connect();
+        const auto openTimeout = std::chrono::seconds(10);
+        if (!ws.waitForOpen(openTimeout) || !marketData.getWebSocket().waitForOpen(openTimeout)) {
+            throw std::runtime_error("WebSocket connection timed out");
+        }
+
         for (const auto& instrument : instruments) {
             marketData.subscribeToOrderBook(instrument);
             marketData.subscribe(instrument, true, true, true);  // orderbook, trades, ticker
             logger.info("Subscribed to market data for ", instrument);
         }
 
+        // Push notifications for our own orders, fills and portfolio
+        for (const auto& currency : currencies) {
+            marketData.subscribeUserOrders("any." + currency);
+            marketData.subscribeUserTrades("any." + currency);
+            marketData.subscribeUserPortfolio(currency);
+        }
+
         // Authenticate
         if (!client.authenticate()) {
             logger.error("Authentication failed");
+            killSwitchHandle = nullptr;
             return 1;
         }
         logger.info("Authentication successful");
+        auth->startAutoRefresh();
 
-        // Main loop
+        // Main loop, the main thread becomes the strategy thread
+        runtime.placeCurrentThread(ThreadRole::STRATEGY, "strategy");
+        logger.info(runtime.placementReport());
         logger.info("Starting main loop...");
-        while (running) {
+        const auto reconcileInterval = std::chrono::milliseconds(
+            config.getInt("position_reconcile_interval_ms", 30000));
+        auto nextReconcile = std::chrono::steady_clock::now() + reconcileInterval;
+        auto nextResyncCheck = std::chrono::steady_clock::now();
+        runtime.runStrategy(running, [&]() {
             try {
-                // Process any pending tasks
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                quotes.runCycle();
 
-                // Monitor positions
-                for (const auto& instrument : instruments) {
-                    auto position = client.getPositions(instrument);
-                    logger.debug("Position for ", instrument, ": ", position.dump());
+                // Positions are kept from fills and marks, REST is only a cross-check
+                if (std::chrono::steady_clock::now() >= nextReconcile) {
+                    for (const auto& currency : currencies) {
+                        positions.reconcile(client.getPositions(currency));
+                    }
+                    nextReconcile = std::chrono::steady_clock::now() + reconcileInterval;
+                }
+
+                // Books stuck waiting for a resync snapshot are resubscribed
+                if (std::chrono::steady_clock::now() >= nextResyncCheck) {
+                    marketData.retryStalledResyncs();
+                    nextResyncCheck = std::chrono::steady_clock::now() + std::chrono::seconds(1);
                 }
 
             } catch (const std::exception& e) {
                 logger.error("Error in main loop: ", e.what());
                 std::this_thread::sleep_for(std::chrono::seconds(5));
             }
-        }
+        });
 
         // Clean shutdown
         logger.info("Shutting down...");
+
+        // Give the kill switch's cancel_all a moment to be acknowledged
+        killSwitch.trigger("shutdown");
+        auto flatDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (killSwitch.getTimeToFlatNs() < 0 && std::chrono::steady_clock::now() < flatDeadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        killSwitchHandle = nullptr;
         
         // Unsubscribe from market data
         for (const auto& instrument : instruments) {
@@ -136,13 +391,33 @@ int main(int argc, char* argv[]) {
             logger.info("Unsubscribed from market data for ", instrument);
         }
 
+        auto cycleLatency = quotes.getCycleLatency();
+        logger.info("Quote cycle latency ns - p50: ", cycleLatency.percentile(50),
+                    ", p99: ", cycleLatency.percentile(99), ", max: ", cycleLatency.max());
+
         // Close WebSocket connection
+        auth->stopAutoRefresh();
+        rateLimiter->stop();
         ws.close();
+        marketData.disconnect();
+        runtime.stop();
         logger.info("WebSocket connection closed");
+        if (recorder) {
+            recorder->stop();
+        }
+        if (metricsServer) {
+            metricsServer->stop();
+        }
+        traceRecorder.stop();
+        latencyMetrics.stopReporter();
+        ::utils::TscClock::stopRecalibration();
+        logger.stopAsync();
 
         return 0;
 
     } catch (const std::exception& e) {
+        killSwitchHandle = nullptr;
+        Logger::getInstance().stopAsync();
         std::cerr << "Fatal error: " << e.what() << std::endl;
         return 1;
     }
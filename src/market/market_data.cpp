@@ -1,16 +1,46 @@
 #include "market/market_data.hpp"
+#include "metrics/counters.hpp"
+#include "metrics/latency_metrics.hpp"
+#include "metrics/trace_recorder.hpp"
 #include "utils/logger.hpp"
+#include "utils/tsc_clock.hpp"
 #include <sstream>
 
 namespace deribit {
 
+namespace {
+    // Counter IDs by channel, per thread so feed shards never share a lock.
+    // The registry hands out one ID per series, so the cache is valid for
+    // every manager.
+    thread_local std::unordered_map<std::string, uint32_t> t_channelCounters;
+
+    // A resubscribe with no snapshot after this long is sent again
+    constexpr int64_t kResyncTimeoutNs = 5000000000;
+}
+
 MarketDataManager::MarketDataManager(const std::string& wsUrl)
     : m_wsUrl(wsUrl)
     , m_isConnected(false) {
+    auto& counters = CounterRegistry::getInstance();
+    m_parseErrorCounter = counters.registerCounter(
+        "deribit_feed_parse_errors_total", "Market data frames that failed to parse or apply");
+    m_bookGapCounter = counters.registerCounter(
+        "deribit_book_gaps_total", "Book updates whose prev_change_id did not follow on");
+    m_bookResyncCounter = counters.registerCounter(
+        "deribit_book_resyncs_total", "Books rebuilt from a snapshot after a gap");
+    // Channels beyond the registry's capacity share this series rather
+    // than failing the message
+    m_otherChannelCounter = counters.registerCounter(
+        "deribit_feed_messages_total", "Market data notifications by channel",
+        CounterRegistry::label("channel", "other"));
     
     m_webSocket = std::make_unique<DeribitWebSocket>();
     m_webSocket->setMessageCallback([this](const std::string& msg) {
-        this->handleWebSocketMessage(msg);
+        if (m_frameDispatcher) {
+            m_frameDispatcher(msg);
+        } else {
+            this->handleWebSocketMessage(msg);
+        }
     });
 }
 
@@ -41,11 +71,29 @@ bool MarketDataManager::isConnected() const {
     return m_isConnected;
 }
 
+void MarketDataManager::setFrameTap(FrameTap tap) {
+    m_webSocket->setFrameTap(std::move(tap));
+}
+
+void MarketDataManager::processMessage(const std::string& message) {
+    handleWebSocketMessage(message);
+}
+
+void MarketDataManager::setFrameDispatcher(std::function<void(const std::string&)> dispatcher) {
+    m_frameDispatcher = std::move(dispatcher);
+}
+
+void MarketDataManager::addOrderBook(const std::string& instrument) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    initializeOrderBook(instrument);
+}
+
 void MarketDataManager::subscribe(const std::string& instrument,
                                 bool orderbook,
                                 bool trades,
                                 bool ticker) {
     std::lock_guard<std::mutex> lock(m_mutex);
+    TraceRecorder::getInstance().registerInstrument(instrument);
     
     if (orderbook) {
         std::string channel = createSubscriptionChannel(instrument, "book");
@@ -95,6 +143,29 @@ void MarketDataManager::unsubscribe(const std::string& instrument,
     }
 }
 
+void MarketDataManager::setAuthManager(std::shared_ptr<AuthManager> auth) {
+    // The order session carries token refreshes, this one only authenticates
+    m_webSocket->setAuthManager(std::move(auth), false);
+}
+
+void MarketDataManager::subscribeUserOrders(const std::string& target) {
+    subscribeChannel("user.orders." + target + ".raw");
+}
+
+void MarketDataManager::subscribeUserTrades(const std::string& target) {
+    subscribeChannel("user.trades." + target + ".raw");
+}
+
+void MarketDataManager::subscribeUserPortfolio(const std::string& currency) {
+    subscribeChannel("user.portfolio." + currency);
+}
+
+void MarketDataManager::subscribeChannel(const std::string& channel) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_webSocket->subscribe(channel);
+    m_subscriptions[channel] = true;
+}
+
 void MarketDataManager::subscribeToOrderBook(const std::string& instrument) {
     subscribe(instrument, true, false, false);
 }
@@ -119,62 +190,120 @@ void MarketDataManager::setMarketDataCallback(MarketDataCallback callback) {
     m_marketDataCallback = callback;
 }
 
+void MarketDataManager::setOrderCallback(OrderCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_orderCallback = callback;
+}
+
+void MarketDataManager::setTradeCallback(TradeCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tradeCallback = callback;
+}
+
+void MarketDataManager::setPositionCallback(PositionCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_positionCallback = callback;
+}
+
 void MarketDataManager::handleWebSocketMessage(const std::string& message) {
     try {
         nlohmann::json json = nlohmann::json::parse(message);
+        pipeline::stamp(PipelineStage::PARSED);
         
         if (json.contains("method") && json["method"] == "subscription") {
-            auto params = json["params"];
-            auto channel = params["channel"].get<std::string>();
-            auto data = params["data"];
+            auto& params = json["params"];
+            const auto& channel = params["channel"].get_ref<const std::string&>();
+            auto& data = params["data"];
+            countMessage(channel);
+
+            if (channel.compare(0, 5, "user.") == 0) {
+                processUserMessage(channel, data);
+                return;
+            }
             
-            // Parse channel to get instrument and type
+            // Parse channel to get instrument and type. Both "<instrument>.<type>"
+            // and the exchange's "<type>.<instrument>.<interval>" are accepted.
             std::string instrument, type;
             size_t separator = channel.find('.');
             if (separator != std::string::npos) {
                 instrument = channel.substr(0, separator);
                 type = channel.substr(separator + 1);
+                if (instrument == "book" || instrument == "trades" || instrument == "ticker") {
+                    type = instrument;
+                    size_t end = channel.find('.', separator + 1);
+                    instrument = channel.substr(separator + 1,
+                                                end == std::string::npos ? end : end - separator - 1);
+                }
             }
+            TraceRecorder::setInstrument(instrument);
             
             // Route the update to appropriate handler
             if (type.find("book") != std::string::npos) {
-                processOrderBookUpdate(instrument, data);
+                // Dropped while resyncing, listeners would read a stale book
+                if (!processOrderBookUpdate(instrument, data)) {
+                    return;
+                }
+                pipeline::stamp(PipelineStage::BOOK_APPLIED);
                 if (m_orderBookCallback) {
                     m_orderBookCallback(instrument, "book", data);
                 }
+                pipeline::stamp(PipelineStage::CALLBACK_DONE);
             } else if (type.find("trades") != std::string::npos || 
                        type.find("ticker") != std::string::npos) {
                 if (m_marketDataCallback) {
                     m_marketDataCallback(instrument, type, data);
                 }
+                pipeline::stamp(PipelineStage::CALLBACK_DONE);
             }
         }
     } catch (const std::exception& e) {
+        CounterRegistry::getInstance().add(m_parseErrorCounter);
         auto& logger = Logger::getInstance();
         logger.error("Error processing WebSocket message: ", e.what());
     }
 }
 
-void MarketDataManager::processOrderBookUpdate(const std::string& instrument, 
+bool MarketDataManager::processOrderBookUpdate(const std::string& instrument, 
                                              const nlohmann::json& data) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
-    auto orderbook = getOrderBook(instrument);
-    if (!orderbook) return;
+    std::shared_ptr<OrderBook> orderbook;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_orderBooks.find(instrument);
+        if (it == m_orderBooks.end()) return false;
+        orderbook = it->second;
+    }
+    if (!checkBookSequence(instrument, data)) {
+        return false;
+    }
     
+    // Deribit levels are [action, price, amount] with action new, change or
+    // delete; plain [price, amount] pairs are accepted as well
+    auto parseLevel = [](const nlohmann::json& level, double& price, double& amount) {
+        if (level.size() == 3) {
+            price = level[1].get<double>();
+            amount = level[0] == "delete" ? 0.0 : level[2].get<double>();
+        } else {
+            price = level[0].get<double>();
+            amount = level[1].get<double>();
+        }
+    };
+
     if (data.contains("type") && data["type"] == "snapshot") {
         std::map<double, double> bids, asks;
+        double price, amount;
         
         for (const auto& bid : data["bids"]) {
-            bids[bid[0].get<double>()] = bid[1].get<double>();
+            parseLevel(bid, price, amount);
+            bids[price] = amount;
         }
         
         for (const auto& ask : data["asks"]) {
-            asks[ask[0].get<double>()] = ask[1].get<double>();
+            parseLevel(ask, price, amount);
+            asks[price] = amount;
         }
         
         orderbook->updateFromSnapshot(bids, asks);
-    } else {
+    } else if (data.contains("changes")) {
         for (const auto& change : data["changes"]) {
             std::string side = change[0].get<std::string>();
             double price = change[1].get<double>();
@@ -186,7 +315,18 @@ void MarketDataManager::processOrderBookUpdate(const std::string& instrument,
                 amount
             );
         }
+    } else {
+        double price, amount;
+        for (const auto& bid : data.value("bids", nlohmann::json::array())) {
+            parseLevel(bid, price, amount);
+            orderbook->processIncrementalUpdate(OrderSide::BUY, price, amount);
+        }
+        for (const auto& ask : data.value("asks", nlohmann::json::array())) {
+            parseLevel(ask, price, amount);
+            orderbook->processIncrementalUpdate(OrderSide::SELL, price, amount);
+        }
     }
+    return true;
 }
 
 void MarketDataManager::processTradeUpdate(const std::string& instrument, 
@@ -203,12 +343,171 @@ void MarketDataManager::processTickerUpdate(const std::string& instrument,
     }
 }
 
+void MarketDataManager::processUserMessage(const std::string& channel, nlohmann::json& data) {
+    // user.orders.* carries one order (raw) or an array (aggregated),
+    // user.trades.* always an array
+    if (channel.compare(0, 12, "user.orders.") == 0) {
+        if (data.is_array()) {
+            for (auto& order : data) {
+                processUserOrder(order);
+            }
+        } else {
+            processUserOrder(data);
+        }
+    } else if (channel.compare(0, 12, "user.trades.") == 0) {
+        for (auto& trade : data) {
+            processUserTrade(trade);
+        }
+    } else if (channel.compare(0, 15, "user.portfolio.") == 0) {
+        processUserPortfolio(data);
+    }
+}
+
+void MarketDataManager::processUserOrder(nlohmann::json& order) {
+    if (!m_orderCallback) return;
+
+    OrderResponse response;
+    response.orderId = order.value("order_id", std::string());
+
+    std::string state = order.value("order_state", std::string());
+    if (state == "open") {
+        response.status = order.value("filled_amount", 0.0) > 0.0 ? OrderStatus::PARTIALLY_FILLED
+                                                                   : OrderStatus::OPEN;
+    } else if (state == "untriggered") {
+        response.status = OrderStatus::PENDING;
+    } else {
+        response.status = utils::stringToOrderStatus(state);
+    }
+
+    // The notification is not used after this, hand it over instead of copying
+    response.raw = std::move(order);
+    m_orderCallback(response);
+}
+
+void MarketDataManager::processUserTrade(nlohmann::json& trade) {
+    if (!m_tradeCallback) return;
+
+    Trade update;
+    update.instrument = trade.value("instrument_name", std::string());
+    update.tradeId = trade.value("trade_id", std::string());
+    update.side = utils::stringToSide(trade.value("direction", std::string("buy")));
+    update.price = trade.value("price", 0.0);
+    update.amount = trade.value("amount", 0.0);
+    update.orderId = trade.value("order_id", std::string());
+    update.matchingId = trade.contains("matching_id") && trade["matching_id"].is_string()
+        ? trade["matching_id"].get<std::string>() : std::string();
+    update.timestamp = std::chrono::system_clock::time_point(
+        std::chrono::milliseconds(trade.value("timestamp", int64_t(0))));
+    update.raw = std::move(trade);
+    m_tradeCallback(update);
+}
+
+void MarketDataManager::processUserPortfolio(nlohmann::json& portfolio) {
+    if (!m_positionCallback) return;
+
+    // Portfolio updates are account level: the instrument field carries the
+    // currency and only the PnL figures are meaningful
+    Position update;
+    update.instrument = portfolio.value("currency", std::string());
+    update.size = 0.0;
+    update.entryPrice = 0.0;
+    update.liquidationPrice = 0.0;
+    update.unrealizedPnl = portfolio.value("session_upl", 0.0);
+    update.realizedPnl = portfolio.value("session_rpl", 0.0);
+    update.timestamp = std::chrono::system_clock::now();
+    update.raw = std::move(portfolio);
+    m_positionCallback(update);
+}
+
 void MarketDataManager::initializeOrderBook(const std::string& instrument) {
     if (m_orderBooks.find(instrument) == m_orderBooks.end()) {
         m_orderBooks[instrument] = std::make_shared<OrderBook>(instrument);
     }
 }
 
+void MarketDataManager::countMessage(const std::string& channel) {
+    auto it = t_channelCounters.find(channel);
+    if (it == t_channelCounters.end()) {
+        uint32_t id;
+        try {
+            id = CounterRegistry::getInstance().registerCounter(
+                "deribit_feed_messages_total", "Market data notifications by channel",
+                CounterRegistry::label("channel", channel));
+        } catch (const std::runtime_error&) {
+            id = m_otherChannelCounter;
+        }
+        it = t_channelCounters.emplace(channel, id).first;
+    }
+    CounterRegistry::getInstance().add(it->second);
+}
+
+bool MarketDataManager::checkBookSequence(const std::string& instrument, const nlohmann::json& data) {
+    if (!data.contains("change_id")) {
+        return true;
+    }
+    int64_t changeId = data["change_id"].get<int64_t>();
+    bool snapshot = data.value("type", std::string()) == "snapshot";
+
+    bool resubscribe = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& sequence = m_bookSequences[instrument];
+        if (snapshot) {
+            if (sequence.resyncing) {
+                CounterRegistry::getInstance().add(m_bookResyncCounter);
+                sequence.resyncing = false;
+            }
+        } else if (sequence.resyncing) {
+            return false;  // Stale until the snapshot arrives
+        } else if (sequence.changeId >= 0 && data.contains("prev_change_id") &&
+                   data["prev_change_id"].get<int64_t>() != sequence.changeId) {
+            CounterRegistry::getInstance().add(m_bookGapCounter);
+            Logger::getInstance().warning("Book gap for ", instrument, ": expected prev_change_id ",
+                                          sequence.changeId, ", got ", data["prev_change_id"].get<int64_t>());
+            // Offline input has no subscription to renew, keep applying
+            resubscribe = m_isConnected;
+            sequence.resyncing = resubscribe;
+            sequence.resyncStartNs = ::utils::TscClock::nowNs();
+        }
+        sequence.changeId = changeId;
+    }
+
+    if (resubscribe) {
+        resubscribeBook(instrument);
+        return false;
+    }
+    return true;
+}
+
+void MarketDataManager::retryStalledResyncs() {
+    std::vector<std::string> stalled;
+    int64_t now = ::utils::TscClock::nowNs();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& [instrument, sequence] : m_bookSequences) {
+            if (sequence.resyncing && now - sequence.resyncStartNs >= kResyncTimeoutNs) {
+                sequence.resyncStartNs = now;
+                stalled.push_back(instrument);
+            }
+        }
+    }
+    for (const auto& instrument : stalled) {
+        Logger::getInstance().warning("No snapshot for ", instrument, " after resubscribing, retrying");
+        resubscribeBook(instrument);
+    }
+}
+
+void MarketDataManager::resubscribeBook(const std::string& instrument) {
+    // A failure is retried by retryStalledResyncs()
+    std::string channel = createSubscriptionChannel(instrument, "book");
+    try {
+        m_webSocket->unsubscribe(channel);
+        m_webSocket->subscribe(channel);
+    } catch (const std::exception& e) {
+        Logger::getInstance().error("Resubscribe to ", channel, " failed: ", e.what());
+    }
+}
+
 std::string MarketDataManager::createSubscriptionChannel(const std::string& instrument, 
                                                        const std::string& type) {
     std::ostringstream oss;
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -31,23 +32,62 @@ public:
                      bool trades = true,
                      bool ticker = false);
 
+    // Private user channels, need setAuthManager() before connect(); they
+    // are subscribed once the connection has authenticated.
+    // target is an instrument name or "<kind>.<currency>", e.g. "any.BTC"
+    void setAuthManager(std::shared_ptr<AuthManager> auth);
+    void subscribeUserOrders(const std::string& target);
+    void subscribeUserTrades(const std::string& target);
+    void subscribeUserPortfolio(const std::string& currency);
+
     // Legacy subscription methods (kept for backward compatibility)
     void subscribeToOrderBook(const std::string& instrument);
     void unsubscribeFromOrderBook(const std::string& instrument);
 
+    // Raw frames of the market data connection, e.g. for capture
+    void setFrameTap(FrameTap tap);
+
+    // Offline input such as a replayed capture, no websocket involved.
+    // addOrderBook() creates a book without subscribing.
+    void processMessage(const std::string& message);
+    void addOrderBook(const std::string& instrument);
+
+    // Received frames go to the dispatcher instead of being handled on
+    // the socket's thread, e.g. to feed shards that call processMessage().
+    // Set before connect().
+    void setFrameDispatcher(std::function<void(const std::string&)> dispatcher);
+    // For driving its event loop from a runtime thread
+    DeribitWebSocket& getWebSocket() { return *m_webSocket; }
+
+    // Resubscribes books whose resync got no snapshot in time; call
+    // periodically, e.g. from the strategy loop
+    void retryStalledResyncs();
+
     // Market data access
     std::shared_ptr<OrderBook> getOrderBook(const std::string& instrument);
     
     // Callback registration
     void setOrderBookCallback(OrderBookCallback callback);
     void setMarketDataCallback(MarketDataCallback callback);
+    void setOrderCallback(OrderCallback callback);
+    void setTradeCallback(TradeCallback callback);
+    void setPositionCallback(PositionCallback callback);
 
 private:
     // WebSocket message handler
     void handleWebSocketMessage(const std::string& message);
-    void processOrderBookUpdate(const std::string& instrument, const nlohmann::json& data);
+    // False when the update was not applied, e.g. while resyncing
+    bool processOrderBookUpdate(const std::string& instrument, const nlohmann::json& data);
     void processTradeUpdate(const std::string& instrument, const nlohmann::json& data);
     void processTickerUpdate(const std::string& instrument, const nlohmann::json& data);
+    void processUserMessage(const std::string& channel, nlohmann::json& data);
+    void processUserOrder(nlohmann::json& order);
+    void processUserTrade(nlohmann::json& trade);
+    void processUserPortfolio(nlohmann::json& portfolio);
+    void subscribeChannel(const std::string& channel);
+    void countMessage(const std::string& channel);
+    bool checkBookSequence(const std::string& instrument, const nlohmann::json& data);
+    void resubscribeBook(const std::string& instrument);
 
     // Internal helper methods
     void initializeOrderBook(const std::string& instrument);
@@ -63,15 +103,35 @@ private:
     // Subscription tracking
     std::unordered_map<std::string, bool> m_subscriptions;
 
+    // Book change_id chain per instrument. After a gap the book channel is
+    // resubscribed and the next snapshot completes the resync.
+    struct BookSequence {
+        int64_t changeId = -1;
+        bool resyncing = false;
+        int64_t resyncStartNs = 0;   // TscClock, of the last resubscribe
+    };
+    std::unordered_map<std::string, BookSequence> m_bookSequences;
+
+    // CounterRegistry IDs; per-channel ones are cached per thread
+    uint32_t m_parseErrorCounter;
+    uint32_t m_bookGapCounter;
+    uint32_t m_bookResyncCounter;
+    uint32_t m_otherChannelCounter;
+
+    std::function<void(const std::string&)> m_frameDispatcher;
+
     // Callbacks
     OrderBookCallback m_orderBookCallback;
     MarketDataCallback m_marketDataCallback;
+    OrderCallback m_orderCallback;
+    TradeCallback m_tradeCallback;
+    PositionCallback m_positionCallback;
 
     // Thread safety
     mutable std::mutex m_mutex;
     
     // State tracking
-    bool m_isConnected;
+    std::atomic<bool> m_isConnected;
 };
 
 } // namespace deribit
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "metrics/counters.hpp"
+#include <stdexcept>
+
+namespace {
+    thread_local void* t_block = nullptr;
+}
+
+CounterRegistry& CounterRegistry::getInstance() {
+    static CounterRegistry instance;
+    return instance;
+}
+
+uint32_t CounterRegistry::registerCounter(const std::string& family, const std::string& help,
+                                          const std::string& labels) {
+    std::string key = family + "{" + labels + "}";
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_ids.find(key);
+    if (it != m_ids.end()) {
+        return it->second;
+    }
+    if (m_counters.size() >= kMaxCounters) {
+        throw std::runtime_error("Too many counters, cannot add " + key);
+    }
+
+    m_counters.push_back({family, labels, help});
+    uint32_t id = static_cast<uint32_t>(m_counters.size() - 1);
+    m_ids.emplace(std::move(key), id);
+    return id;
+}
+
+CounterRegistry::ThreadBlock* CounterRegistry::addBlock() {
+    auto block = std::make_unique<ThreadBlock>();
+    ThreadBlock* raw = block.get();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_blocks.push_back(std::move(block));
+    return raw;
+}
+
+void CounterRegistry::add(uint32_t counter, uint64_t count) {
+    if (counter >= kMaxCounters) {
+        return;
+    }
+    auto* block = static_cast<ThreadBlock*>(t_block);
+    if (!block) {
+        block = addBlock();
+        t_block = block;
+    }
+    auto& value = block->values[counter];
+    value.store(value.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+uint64_t CounterRegistry::sumLocked(uint32_t counter) const {
+    uint64_t total = 0;
+    for (const auto& block : m_blocks) {
+        total += block->values[counter].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t CounterRegistry::value(uint32_t counter) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return counter < m_counters.size() ? sumLocked(counter) : 0;
+}
+
+std::vector<CounterValue> CounterRegistry::snapshot() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<CounterValue> values;
+    values.reserve(m_counters.size());
+    for (uint32_t id = 0; id < m_counters.size(); ++id) {
+        const auto& info = m_counters[id];
+        values.push_back({info.family, info.labels, info.help, sumLocked(id)});
+    }
+    return values;
+}
+
+std::string CounterRegistry::label(const std::string& name, const std::string& value) {
+    std::string rendered = name + "=\"";
+    for (char c : value) {
+        switch (c) {
+            case '\\': rendered += "\\\\"; break;
+            case '"':  rendered += "\\\""; break;
+            case '\n': rendered += "\\n"; break;
+            default:   rendered += c; break;
+        }
+    }
+    rendered += '"';
+    return rendered;
+}
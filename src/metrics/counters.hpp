@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "utils/lockfree_queue.hpp"
+
+struct CounterValue {
+    std::string family;     // Prometheus metric name
+    std::string labels;     // Rendered label set, e.g. channel="book", or empty
+    std::string help;
+    uint64_t value = 0;
+};
+
+// Monotonic event counters for the metrics endpoint. Each thread adds into
+// its own cache-line-aligned block with a relaxed single-writer store, so
+// add() never contends; values are summed across threads only when read.
+class CounterRegistry {
+public:
+    static constexpr uint32_t kMaxCounters = 256;
+
+    static CounterRegistry& getInstance();
+
+    // Returns the existing ID for a known family and label set
+    uint32_t registerCounter(const std::string& family, const std::string& help,
+                             const std::string& labels = std::string());
+
+    void add(uint32_t counter, uint64_t count = 1);
+
+    uint64_t value(uint32_t counter) const;
+    std::vector<CounterValue> snapshot() const;
+
+    // Renders name="value" with Prometheus escaping
+    static std::string label(const std::string& name, const std::string& value);
+
+private:
+    CounterRegistry() = default;
+    CounterRegistry(const CounterRegistry&) = delete;
+    CounterRegistry& operator=(const CounterRegistry&) = delete;
+
+    struct alignas(utils::kCacheLineSize) ThreadBlock {
+        std::array<std::atomic<uint64_t>, kMaxCounters> values{};
+    };
+
+    struct Info {
+        std::string family;
+        std::string labels;
+        std::string help;
+    };
+
+    ThreadBlock* addBlock();
+    uint64_t sumLocked(uint32_t counter) const;
+
+    mutable std::mutex m_mutex;
+    std::vector<Info> m_counters;
+    std::unordered_map<std::string, uint32_t> m_ids;
+    // Blocks outlive their thread so its counts stay in the totals
+    std::vector<std::unique_ptr<ThreadBlock>> m_blocks;
+};
@@ -0,0 +1,348 @@
+#include "metrics/latency_metrics.hpp"
+#include "metrics/trace_recorder.hpp"
+#include "utils/logger.hpp"
+#include "utils/tsc_clock.hpp"
+#include "utils/utils.hpp"
+#include <stdexcept>
+
+namespace {
+    // This thread's shard of each metric, created on first record
+    thread_local std::array<void*, LatencyMetrics::kMaxMetrics> t_shards{};
+
+    struct PipelineIds {
+        uint32_t stages[kPipelineStageCount];
+        uint32_t tickToTrade;
+
+        PipelineIds() {
+            auto& metrics = LatencyMetrics::getInstance();
+            for (size_t i = 0; i < kPipelineStageCount; ++i) {
+                stages[i] = metrics.registerMetric(
+                    std::string("pipeline.") + pipeline::stageName(static_cast<PipelineStage>(i)));
+            }
+            tickToTrade = metrics.registerMetric("tick_to_trade");
+        }
+    };
+
+    const PipelineIds& pipelineIds() {
+        static const PipelineIds ids;
+        return ids;
+    }
+
+    // Stamps can come from different threads; never record a negative gap
+    // as a huge unsigned one
+    uint64_t interval(int64_t fromNs, int64_t toNs) {
+        return toNs > fromNs ? static_cast<uint64_t>(toNs - fromNs) : 0;
+    }
+
+    struct TickState {
+        int64_t startNs = 0;
+        int64_t lastNs = 0;
+        bool active = false;
+    };
+    thread_local TickState t_tick;
+}
+
+LatencyMetrics& LatencyMetrics::getInstance() {
+    static LatencyMetrics instance;
+    return instance;
+}
+
+LatencyMetrics::LatencyMetrics()
+    : m_reporterRunning(false)
+    , m_reportInterval(0) {
+}
+
+LatencyMetrics::~LatencyMetrics() {
+    stopReporter();
+}
+
+uint32_t LatencyMetrics::registerMetric(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_names.find(name);
+    if (it != m_names.end()) {
+        return it->second;
+    }
+    if (m_metrics.size() >= kMaxMetrics) {
+        throw std::runtime_error("Too many latency metrics, cannot add " + name);
+    }
+
+    auto metric = std::make_unique<Metric>();
+    metric->name = name;
+    m_metrics.push_back(std::move(metric));
+    uint32_t id = static_cast<uint32_t>(m_metrics.size() - 1);
+    m_names.emplace(name, id);
+    return id;
+}
+
+LatencyMetrics::Shard* LatencyMetrics::addShard(uint32_t metric) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (metric >= m_metrics.size()) {
+        throw std::out_of_range("Unknown latency metric " + std::to_string(metric));
+    }
+    auto shard = std::make_unique<Shard>();
+    Shard* raw = shard.get();
+    // Shards outlive their thread so its samples stay in the totals
+    m_metrics[metric]->shards.push_back(std::move(shard));
+    return raw;
+}
+
+void LatencyMetrics::record(uint32_t metric, uint64_t valueNs) {
+    if (metric >= kMaxMetrics) {
+        return;
+    }
+    Shard* shard = static_cast<Shard*>(t_shards[metric]);
+    if (!shard) {
+        shard = addShard(metric);
+        t_shards[metric] = shard;
+    }
+
+    // Single writer, plain loads and stores suffice
+    auto& bucket = shard->counts[utils::LatencyHistogram::bucketIndex(valueNs)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    shard->sum.store(shard->sum.load(std::memory_order_relaxed) + valueNs, std::memory_order_relaxed);
+    if (valueNs < shard->min.load(std::memory_order_relaxed)) {
+        shard->min.store(valueNs, std::memory_order_relaxed);
+    }
+    if (valueNs > shard->max.load(std::memory_order_relaxed)) {
+        shard->max.store(valueNs, std::memory_order_relaxed);
+    }
+}
+
+void LatencyMetrics::collect(const Metric& metric, std::vector<uint64_t>& counts,
+                             uint64_t& sum, uint64_t& max) const {
+    counts.assign(utils::LatencyHistogram::kBucketCount, 0);
+    sum = 0;
+    max = 0;
+    for (const auto& shard : metric.shards) {
+        for (size_t i = 0; i < counts.size(); ++i) {
+            counts[i] += shard->counts[i].load(std::memory_order_relaxed);
+        }
+        sum += shard->sum.load(std::memory_order_relaxed);
+        max = std::max(max, shard->max.load(std::memory_order_relaxed));
+    }
+}
+
+utils::LatencyHistogram LatencyMetrics::snapshot(uint32_t metric) const {
+    utils::LatencyHistogram histogram;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (metric >= m_metrics.size()) {
+        return histogram;
+    }
+
+    std::vector<uint64_t> counts;
+    uint64_t sum, max;
+    collect(*m_metrics[metric], counts, sum, max);
+    uint64_t min = UINT64_MAX;
+    for (const auto& shard : m_metrics[metric]->shards) {
+        min = std::min(min, shard->min.load(std::memory_order_relaxed));
+    }
+    histogram.mergeBuckets(counts.data(), sum, min, max);
+    return histogram;
+}
+
+std::vector<std::string> LatencyMetrics::getNames() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> names;
+    names.reserve(m_metrics.size());
+    for (const auto& metric : m_metrics) {
+        names.push_back(metric->name);
+    }
+    return names;
+}
+
+std::vector<LatencySummary> LatencyMetrics::summarize() const {
+    auto names = getNames();
+    std::vector<LatencySummary> summaries;
+    summaries.reserve(names.size());
+    for (uint32_t id = 0; id < names.size(); ++id) {
+        summaries.push_back(summarize(names[id], snapshot(id)));
+    }
+    return summaries;
+}
+
+LatencySummary LatencyMetrics::summarize(const std::string& name, const utils::LatencyHistogram& histogram) {
+    LatencySummary summary;
+    summary.name = name;
+    summary.count = histogram.count();
+    summary.p50 = histogram.percentile(50);
+    summary.p99 = histogram.percentile(99);
+    summary.p999 = histogram.percentile(99.9);
+    summary.max = histogram.max();
+    summary.mean = histogram.mean();
+    return summary;
+}
+
+void LatencyMetrics::startReporter(std::chrono::milliseconds interval) {
+    if (interval.count() <= 0) {
+        throw std::invalid_argument("Latency report interval must be positive");
+    }
+    std::lock_guard<std::mutex> lock(m_reporterMutex);
+    if (m_reporterRunning) {
+        return;
+    }
+    m_reportInterval = interval;
+    m_reporterRunning = true;
+    m_reporter = std::thread([this] {
+        utils::ThreadUtils::onThreadStart("housekeeping", "latency-report");
+        std::unique_lock<std::mutex> lock(m_reporterMutex);
+        while (!m_reporterWake.wait_for(lock, m_reportInterval, [this] { return !m_reporterRunning; })) {
+            lock.unlock();
+            report();
+            lock.lock();
+        }
+    });
+}
+
+void LatencyMetrics::stopReporter() {
+    {
+        std::lock_guard<std::mutex> lock(m_reporterMutex);
+        if (!m_reporterRunning) {
+            return;
+        }
+        m_reporterRunning = false;
+    }
+    m_reporterWake.notify_all();
+    if (m_reporter.joinable()) {
+        m_reporter.join();
+    }
+    report();
+}
+
+void LatencyMetrics::report() {
+    std::vector<uint64_t> counts;
+    std::vector<uint64_t> interval(utils::LatencyHistogram::kBucketCount);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_reportedCounts.resize(m_metrics.size());
+    m_reportedSums.resize(m_metrics.size(), 0);
+
+    for (size_t id = 0; id < m_metrics.size(); ++id) {
+        uint64_t sum, max;
+        collect(*m_metrics[id], counts, sum, max);
+
+        // Counts only grow, the difference is this interval's histogram.
+        // Its min and max are known to bucket precision.
+        auto& reported = m_reportedCounts[id];
+        reported.resize(counts.size(), 0);
+        size_t low = SIZE_MAX;
+        size_t high = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            interval[i] = counts[i] - reported[i];
+            if (interval[i] != 0) {
+                low = std::min(low, i);
+                high = i;
+            }
+        }
+        reported = counts;
+        uint64_t intervalSum = sum - m_reportedSums[id];
+        m_reportedSums[id] = sum;
+        if (low == SIZE_MAX) {
+            continue;
+        }
+
+        utils::LatencyHistogram histogram;
+        histogram.mergeBuckets(interval.data(), intervalSum,
+                               utils::LatencyHistogram::bucketUpperBound(low),
+                               std::min(utils::LatencyHistogram::bucketUpperBound(high), max));
+        LatencySummary summary = summarize(m_metrics[id]->name, histogram);
+        LOG_INFO("Latency ", summary.name, " ns - count: ", summary.count, ", p50: ", summary.p50,
+                 ", p99: ", summary.p99, ", p99.9: ", summary.p999, ", max: ", summary.max);
+    }
+}
+
+static_assert(static_cast<int>(PipelineStage::ACK_RECEIVED) == static_cast<int>(TraceStage::ACK_RECEIVED),
+              "Pipeline stages double as trace stages");
+
+namespace pipeline {
+
+int64_t now() {
+    return utils::TscClock::nowNs();
+}
+
+namespace {
+    void beginTick(int64_t startNs, int64_t nowNs) {
+        pipelineIds();
+        t_tick.startNs = startNs;
+        t_tick.lastNs = nowNs;
+        t_tick.active = true;
+        TraceRecorder::beginMessage();
+    }
+}
+
+void frameReceived() {
+    int64_t timeNs = now();
+    beginTick(timeNs, timeNs);
+}
+
+void frameReceived(int64_t receivedNs) {
+    beginTick(receivedNs, now());
+}
+
+int64_t currentFrameNs() {
+    return t_tick.active ? t_tick.startNs : 0;
+}
+
+void stamp(PipelineStage stage) {
+    if (!t_tick.active) {
+        return;
+    }
+    const auto& ids = pipelineIds();
+    auto& metrics = LatencyMetrics::getInstance();
+    int64_t timeNs = now();
+    metrics.record(ids.stages[static_cast<size_t>(stage)], interval(t_tick.lastNs, timeNs));
+    if (stage == PipelineStage::ORDER_SENT) {
+        metrics.record(ids.tickToTrade, interval(t_tick.startNs, timeNs));
+    }
+    t_tick.lastNs = timeNs;
+    TraceRecorder::record(static_cast<TraceStage>(stage));
+}
+
+void frameDone() {
+    if (!t_tick.active) {
+        return;
+    }
+    t_tick.active = false;
+    if (TraceRecorder::isEnabled()) {
+        TraceRecorder::record(TraceStage::FRAME_DONE);
+        TraceRecorder::endMessage();
+        TraceRecorder::checkLatency(now() - t_tick.startNs);
+    }
+}
+
+OrderStamp orderSent(const std::string& instrument) {
+    OrderStamp sent;
+    sent.sentNs = now();
+    stamp(PipelineStage::ORDER_SENT);
+    if (TraceRecorder::isEnabled()) {
+        // Orders sent outside a frame, e.g. from a timer, get their own ID
+        sent.traceMessage = TraceRecorder::currentMessage();
+        sent.traceInstrument = TraceRecorder::instrumentId(instrument);
+        if (!t_tick.active) {
+            TraceRecorder::record(TraceStage::ORDER_SENT, sent.traceMessage, sent.traceInstrument);
+        }
+    }
+    return sent;
+}
+
+void ackReceived(const OrderStamp& sent) {
+    LatencyMetrics::getInstance().record(
+        pipelineIds().stages[static_cast<size_t>(PipelineStage::ACK_RECEIVED)],
+        interval(sent.sentNs, now()));
+    if (sent.traceMessage != 0) {
+        TraceRecorder::record(TraceStage::ACK_RECEIVED, sent.traceMessage, sent.traceInstrument);
+    }
+}
+
+const char* stageName(PipelineStage stage) {
+    switch (stage) {
+        case PipelineStage::FRAME_RECEIVED: return "frame_received";
+        case PipelineStage::PARSED:         return "parsed";
+        case PipelineStage::BOOK_APPLIED:   return "book_applied";
+        case PipelineStage::CALLBACK_DONE:  return "callback_done";
+        case PipelineStage::ORDER_SENT:     return "order_sent";
+        case PipelineStage::ACK_RECEIVED:   return "ack_received";
+    }
+    return "unknown";
+}
+
+} // namespace pipeline
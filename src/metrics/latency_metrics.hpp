@@ -0,0 +1,136 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "utils/histogram.hpp"
+
+struct LatencySummary {
+    std::string name;
+    uint64_t count = 0;
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+    double mean = 0.0;
+};
+
+// Named latency histograms in nanoseconds. Every thread records into its
+// own shard of each metric, a single-writer copy of the LatencyHistogram
+// buckets held in relaxed atomics, so record() takes no lock and shares no
+// cache line with other writers. Snapshots merge the shards and may run
+// concurrently with recording.
+class LatencyMetrics {
+public:
+    static constexpr uint32_t kMaxMetrics = 64;
+
+    static LatencyMetrics& getInstance();
+
+    // Returns the existing ID if the name is already registered
+    uint32_t registerMetric(const std::string& name);
+
+    void record(uint32_t metric, uint64_t valueNs);
+
+    // Registered names, indexed by ID
+    std::vector<std::string> getNames() const;
+
+    // Since start, merged across threads
+    utils::LatencyHistogram snapshot(uint32_t metric) const;
+    std::vector<LatencySummary> summarize() const;
+
+    static LatencySummary summarize(const std::string& name, const utils::LatencyHistogram& histogram);
+
+    // Logs p50/p99/p99.9/max of what each metric recorded in the last
+    // interval
+    void startReporter(std::chrono::milliseconds interval);
+    void stopReporter();
+
+private:
+    LatencyMetrics();
+    ~LatencyMetrics();
+    LatencyMetrics(const LatencyMetrics&) = delete;
+    LatencyMetrics& operator=(const LatencyMetrics&) = delete;
+
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, utils::LatencyHistogram::kBucketCount> counts{};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> min{UINT64_MAX};
+        std::atomic<uint64_t> max{0};
+    };
+
+    struct Metric {
+        std::string name;
+        std::vector<std::unique_ptr<Shard>> shards;
+    };
+
+    Shard* addShard(uint32_t metric);
+    // Bucket counts and sum summed over shards
+    void collect(const Metric& metric, std::vector<uint64_t>& counts, uint64_t& sum, uint64_t& max) const;
+    void report();
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Metric>> m_metrics;
+    std::unordered_map<std::string, uint32_t> m_names;
+
+    std::thread m_reporter;
+    std::mutex m_reporterMutex;
+    std::condition_variable m_reporterWake;
+    bool m_reporterRunning;
+    std::chrono::milliseconds m_reportInterval;
+    // Counts and sum at the last report, per metric
+    std::vector<std::vector<uint64_t>> m_reportedCounts;
+    std::vector<uint64_t> m_reportedSums;
+};
+
+// Stages of one market data frame through to our order and its ack
+enum class PipelineStage : uint8_t {
+    FRAME_RECEIVED,     // Start of a tick, no histogram of its own
+    PARSED,             // JSON parsed
+    BOOK_APPLIED,       // Book update applied
+    CALLBACK_DONE,      // Strategy callbacks returned
+    ORDER_SENT,         // Order handed to the transport
+    ACK_RECEIVED        // Exchange response to the order
+};
+
+constexpr size_t kPipelineStageCount = 6;
+
+// Pipeline stamps of the tick being handled on the calling thread. Each
+// stamp records the time since the previous one under the stage's metric
+// ("pipeline.<stage>"); ORDER_SENT also records "tick_to_trade" from the
+// frame. Stamps outside a tick are ignored, except the order round trip.
+// Every stamp also goes to the TraceRecorder when it is on.
+namespace pipeline {
+
+int64_t now();
+
+void frameReceived();
+// A frame received earlier on another thread and handed over, e.g. to a
+// feed shard: tick_to_trade counts from receivedNs, stage times from now
+void frameReceived(int64_t receivedNs);
+void stamp(PipelineStage stage);
+void frameDone();
+// Receive time of the frame handled on this thread, 0 outside one
+int64_t currentFrameNs();
+
+struct OrderStamp {
+    int64_t sentNs = 0;
+    uint64_t traceMessage = 0;
+    uint32_t traceInstrument = 0;
+};
+
+// ORDER_SENT stamp, keep the result for ackReceived()
+OrderStamp orderSent(const std::string& instrument);
+
+// Order round trip, recorded as "pipeline.ack_received"
+void ackReceived(const OrderStamp& sent);
+
+const char* stageName(PipelineStage stage);
+
+} // namespace pipeline
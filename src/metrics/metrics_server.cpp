@@ -0,0 +1,316 @@
+#include "metrics/metrics_server.hpp"
+#include "metrics/counters.hpp"
+#include "metrics/latency_metrics.hpp"
+#include "utils/logger.hpp"
+#include "utils/utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    constexpr int kAcceptPollMs = 200;
+    constexpr size_t kMaxRequestBytes = 8192;
+
+    std::string formatValue(double value) {
+        if (std::isnan(value)) return "NaN";
+        if (std::isinf(value)) return value > 0 ? "+Inf" : "-Inf";
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.12g", value);
+        return text;
+    }
+
+    bool sendAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // utime and stime of one task from /proc/self/task/<tid>/stat
+    bool readThreadCpu(const std::string& tid, std::string& name, double& seconds) {
+        FILE* fp = std::fopen(("/proc/self/task/" + tid + "/stat").c_str(), "r");
+        if (!fp) return false;
+        char buffer[1024];
+        size_t length = std::fread(buffer, 1, sizeof(buffer) - 1, fp);
+        std::fclose(fp);
+        buffer[length] = '\0';
+
+        // The name is in parentheses and may itself contain spaces
+        char* open = std::strchr(buffer, '(');
+        char* close = std::strrchr(buffer, ')');
+        if (!open || !close || close < open) return false;
+        name.assign(open + 1, close);
+
+        unsigned long utime = 0, stime = 0;
+        // Fields after the name start at 3 (state); utime and stime are 14 and 15
+        if (std::sscanf(close + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                        &utime, &stime) != 2) {
+            return false;
+        }
+        seconds = static_cast<double>(utime + stime) / static_cast<double>(sysconf(_SC_CLK_TCK));
+        return true;
+    }
+}
+
+void PrometheusWriter::header(const std::string& family, const std::string& help, const char* type) {
+    if (!m_families.insert(family).second) {
+        return;
+    }
+    m_out += "# HELP " + family + " " + help + "\n";
+    m_out += "# TYPE " + family + " " + type + "\n";
+}
+
+void PrometheusWriter::sample(const std::string& name, const std::string& labels, double value) {
+    m_out += name;
+    if (!labels.empty()) {
+        m_out += '{';
+        m_out += labels;
+        m_out += '}';
+    }
+    m_out += ' ';
+    m_out += formatValue(value);
+    m_out += '\n';
+}
+
+void PrometheusWriter::counter(const std::string& family, const std::string& help,
+                               const std::string& labels, double value) {
+    header(family, help, "counter");
+    sample(family, labels, value);
+}
+
+void PrometheusWriter::gauge(const std::string& family, const std::string& help,
+                             const std::string& labels, double value) {
+    header(family, help, "gauge");
+    sample(family, labels, value);
+}
+
+void PrometheusWriter::summary(const std::string& family, const std::string& help,
+                               const std::string& labels, const utils::LatencyHistogram& histogram) {
+    header(family, help, "summary");
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    static const std::pair<const char*, double> kQuantiles[] = {
+        {"0.5", 50.0}, {"0.99", 99.0}, {"0.999", 99.9}, {"1", 100.0}
+    };
+    for (const auto& quantile : kQuantiles) {
+        sample(family, prefix + "quantile=\"" + quantile.first + "\"",
+               static_cast<double>(histogram.percentile(quantile.second)) / 1e9);
+    }
+    sample(family + "_sum", labels, histogram.mean() * static_cast<double>(histogram.count()) / 1e9);
+    sample(family + "_count", labels, static_cast<double>(histogram.count()));
+}
+
+MetricsServer::MetricsServer(const MetricsServerConfig& config)
+    : m_config(config)
+    , m_listenFd(-1)
+    , m_port(config.port)
+    , m_running(false)
+    , m_lastScrape(std::chrono::steady_clock::now()) {
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+void MetricsServer::addCollector(Collector collector) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_collectors.push_back(std::move(collector));
+}
+
+void MetricsServer::exposeRate(const std::string& counterFamily, const std::string& gaugeFamily,
+                               const std::string& help) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rates.push_back({counterFamily, gaugeFamily, help});
+}
+
+void MetricsServer::start() {
+    if (m_running) {
+        return;
+    }
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Metrics socket failed: " + std::string(std::strerror(errno)));
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(m_config.port);
+    if (inet_pton(AF_INET, m_config.bindAddress.c_str(), &address.sin_addr) != 1) {
+        ::close(fd);
+        throw std::invalid_argument("Invalid metrics bind address: " + m_config.bindAddress);
+    }
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 8) != 0) {
+        std::string error = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("Metrics listener on " + m_config.bindAddress + ":" +
+                                 std::to_string(m_config.port) + " failed: " + error);
+    }
+
+    socklen_t length = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    m_port = ntohs(address.sin_port);
+    m_listenFd = fd;
+    m_running = true;
+    m_thread = std::thread([this] { run(); });
+    Logger::getInstance().info("Metrics endpoint on http://", m_config.bindAddress, ":", m_port, "/metrics");
+}
+
+void MetricsServer::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    ::close(m_listenFd);
+    m_listenFd = -1;
+}
+
+void MetricsServer::run() {
+    utils::ThreadUtils::onThreadStart("housekeeping", "metrics-http");
+    while (m_running) {
+        pollfd listener{m_listenFd, POLLIN, 0};
+        int ready = ::poll(&listener, 1, kAcceptPollMs);
+        if (ready <= 0) {
+            continue;
+        }
+        int client = ::accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            continue;
+        }
+        // A stalled client must not hold the scraper forever
+        timeval timeout{1, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        try {
+            serve(client);
+        } catch (const std::exception& e) {
+            Logger::getInstance().warning("Metrics scrape failed: ", e.what());
+        }
+        ::close(client);
+    }
+}
+
+void MetricsServer::serve(int client) {
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestBytes) {
+        ssize_t n = ::recv(client, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        request.append(buffer, static_cast<size_t>(n));
+    }
+
+    std::string status = "200 OK";
+    std::string contentType = "text/plain; version=0.0.4; charset=utf-8";
+    std::string body;
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0) {
+        body = render();
+    } else if (request.compare(0, 4, "GET ") == 0) {
+        status = "404 Not Found";
+        body = "Not found, try /metrics\n";
+    } else {
+        status = "405 Method Not Allowed";
+        body = "Only GET is supported\n";
+    }
+
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+                           "Content-Type: " + contentType + "\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+    sendAll(client, response);
+}
+
+std::string MetricsServer::render() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PrometheusWriter out;
+
+    // Counters, grouped by family
+    auto counters = CounterRegistry::getInstance().snapshot();
+    std::stable_sort(counters.begin(), counters.end(), [](const CounterValue& a, const CounterValue& b) {
+        return a.family < b.family;
+    });
+    for (const auto& counter : counters) {
+        out.counter(counter.family, counter.help, counter.labels, static_cast<double>(counter.value));
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - m_lastScrape).count();
+    for (const auto& rate : m_rates) {
+        for (const auto& counter : counters) {
+            if (counter.family != rate.counterFamily) {
+                continue;
+            }
+            std::string key = counter.family + "{" + counter.labels + "}";
+            auto it = m_lastValues.find(key);
+            uint64_t previous = it == m_lastValues.end() ? 0 : it->second;
+            double perSecond = elapsed > 0.0 ? static_cast<double>(counter.value - previous) / elapsed : 0.0;
+            out.gauge(rate.gaugeFamily, rate.help, counter.labels, perSecond);
+        }
+    }
+    for (const auto& counter : counters) {
+        m_lastValues[counter.family + "{" + counter.labels + "}"] = counter.value;
+    }
+    m_lastScrape = now;
+
+    auto& latency = LatencyMetrics::getInstance();
+    auto names = latency.getNames();
+    for (uint32_t id = 0; id < names.size(); ++id) {
+        auto histogram = latency.snapshot(id);
+        if (histogram.count() > 0) {
+            out.summary("deribit_latency_seconds", "Latency by measured stage or operation",
+                        CounterRegistry::label("metric", names[id]), histogram);
+        }
+    }
+
+    writeProcessMetrics(out);
+
+    for (const auto& collector : m_collectors) {
+        collector(out);
+    }
+    return out.str();
+}
+
+void MetricsServer::writeProcessMetrics(PrometheusWriter& out) {
+    out.gauge("deribit_process_resident_memory_bytes", "Resident set size", "",
+              static_cast<double>(utils::MemoryUtils::getProcessMemoryUsage()));
+
+    DIR* tasks = opendir("/proc/self/task");
+    if (!tasks) {
+        return;
+    }
+    std::vector<std::pair<std::string, std::pair<std::string, double>>> threads;
+    while (dirent* entry = readdir(tasks)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::string name;
+        double seconds;
+        if (readThreadCpu(entry->d_name, name, seconds)) {
+            threads.push_back({entry->d_name, {name, seconds}});
+        }
+    }
+    closedir(tasks);
+
+    for (const auto& thread : threads) {
+        out.counter("deribit_thread_cpu_seconds_total", "User and system CPU time per thread",
+                    CounterRegistry::label("tid", thread.first) + "," +
+                    CounterRegistry::label("thread", thread.second.first),
+                    thread.second.second);
+    }
+}
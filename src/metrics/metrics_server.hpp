@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "utils/histogram.hpp"
+
+// Builds a Prometheus text exposition. The HELP and TYPE lines are written
+// the first time a family appears, so keep each family's samples together.
+class PrometheusWriter {
+public:
+    void counter(const std::string& family, const std::string& help, const std::string& labels, double value);
+    void gauge(const std::string& family, const std::string& help, const std::string& labels, double value);
+    // Nanosecond histogram as a summary in seconds
+    void summary(const std::string& family, const std::string& help, const std::string& labels,
+                 const utils::LatencyHistogram& histogram);
+
+    const std::string& str() const { return m_out; }
+
+private:
+    void header(const std::string& family, const std::string& help, const char* type);
+    void sample(const std::string& name, const std::string& labels, double value);
+
+    std::string m_out;
+    std::unordered_set<std::string> m_families;
+};
+
+struct MetricsServerConfig {
+    std::string bindAddress = "127.0.0.1";
+    uint16_t port = 9464;       // 0 picks a free port
+};
+
+// Minimal HTTP listener serving GET /metrics. Each scrape sums the
+// CounterRegistry, summarizes LatencyMetrics, adds process RSS and per
+// thread CPU time, then runs the registered collectors. Requests are
+// served one at a time on the server's own thread.
+class MetricsServer {
+public:
+    using Collector = std::function<void(PrometheusWriter& out)>;
+
+    explicit MetricsServer(const MetricsServerConfig& config = MetricsServerConfig());
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    void addCollector(Collector collector);
+
+    // Per-second rate of each series of a counter family since the
+    // previous scrape, exported as a gauge family
+    void exposeRate(const std::string& counterFamily, const std::string& gaugeFamily, const std::string& help);
+
+    void start();
+    void stop();
+    uint16_t getPort() const { return m_port; }
+
+    // Body of a scrape
+    std::string render();
+
+private:
+    struct RateSpec {
+        std::string counterFamily;
+        std::string gaugeFamily;
+        std::string help;
+    };
+
+    void run();
+    void serve(int client);
+    void writeProcessMetrics(PrometheusWriter& out);
+
+    MetricsServerConfig m_config;
+    int m_listenFd;
+    uint16_t m_port;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::vector<Collector> m_collectors;
+    std::vector<RateSpec> m_rates;
+    // Counter values at the previous scrape, by family{labels}
+    std::unordered_map<std::string, uint64_t> m_lastValues;
+    std::chrono::steady_clock::time_point m_lastScrape;
+};
@@ -0,0 +1,376 @@
+#include "metrics/trace_recorder.hpp"
+#include "utils/logger.hpp"
+#include "utils/utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+    constexpr auto kSignalPoll = std::chrono::milliseconds(100);
+    constexpr size_t kMinEventsPerThread = 1024;
+
+    template<typename T>
+    void writeValue(std::ofstream& out, T value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void writeString(std::ofstream& out, const std::string& value) {
+        writeValue<uint16_t>(out, static_cast<uint16_t>(std::min<size_t>(value.size(), UINT16_MAX)));
+        out.write(value.data(), std::min<size_t>(value.size(), UINT16_MAX));
+    }
+
+    template<typename T>
+    T readValue(const std::string& data, size_t& offset) {
+        if (offset + sizeof(T) > data.size()) {
+            throw std::runtime_error("Truncated trace dump");
+        }
+        T value;
+        std::memcpy(&value, data.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    std::string readString(const std::string& data, size_t& offset) {
+        uint16_t length = readValue<uint16_t>(data, offset);
+        if (offset + length > data.size()) {
+            throw std::runtime_error("Truncated trace dump");
+        }
+        std::string value = data.substr(offset, length);
+        offset += length;
+        return value;
+    }
+
+    // Gives this thread's ring back when the thread exits
+    struct RingRelease {
+        std::function<void()> release;
+        ~RingRelease() {
+            if (release) release();
+        }
+    };
+    thread_local RingRelease t_release;
+
+    // Slot words of one event
+    struct RawEvent {
+        uint64_t ticks;
+        uint64_t messageId;
+        uint64_t instrumentAndStage;
+    };
+}
+
+const char* traceStageName(TraceStage stage) {
+    switch (stage) {
+        case TraceStage::FRAME_RECEIVED: return "frame_received";
+        case TraceStage::PARSED:         return "parsed";
+        case TraceStage::BOOK_APPLIED:   return "book_applied";
+        case TraceStage::CALLBACK_DONE:  return "callback_done";
+        case TraceStage::ORDER_SENT:     return "order_sent";
+        case TraceStage::ACK_RECEIVED:   return "ack_received";
+        case TraceStage::FRAME_DONE:     return "frame_done";
+    }
+    return "unknown";
+}
+
+TraceRecorder& TraceRecorder::getInstance() {
+    static TraceRecorder instance;
+    return instance;
+}
+
+TraceRecorder::TraceRecorder()
+    : m_running(false)
+    , m_dumpPending(false)
+    , m_lastAutoDumpNs(0)
+    , m_minDumpIntervalNs(0) {
+}
+
+TraceRecorder::~TraceRecorder() {
+    stop();
+}
+
+void TraceRecorder::start(const TraceConfig& config) {
+    std::lock_guard<std::mutex> lock(m_dumpMutex);
+    if (m_running) {
+        return;
+    }
+
+    size_t events = kMinEventsPerThread;
+    while (events < config.eventsPerThread) {
+        events <<= 1;
+    }
+    {
+        std::lock_guard<std::mutex> ringsLock(m_mutex);
+        m_config = config;
+        m_config.eventsPerThread = events;
+    }
+    s_generation.fetch_add(1, std::memory_order_relaxed);
+    s_thresholdNs.store(config.thresholdNs, std::memory_order_relaxed);
+    m_minDumpIntervalNs.store(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(config.minDumpInterval).count(),
+        std::memory_order_relaxed);
+    s_enabled.store(true, std::memory_order_relaxed);
+
+    m_running = true;
+    m_dumper = std::thread([this] { dumperLoop(); });
+    Logger::getInstance().info("Trace recorder on, ", events, " events per thread, dumps to ",
+                               config.directory);
+}
+
+void TraceRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_dumpMutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+    }
+    s_enabled.store(false, std::memory_order_relaxed);
+    s_thresholdNs.store(0, std::memory_order_relaxed);
+    m_dumpWake.notify_all();
+    if (m_dumper.joinable()) {
+        m_dumper.join();
+    }
+}
+
+TraceRecorder::Ring* TraceRecorder::addRing() {
+    if (!isEnabled()) {
+        return nullptr;
+    }
+    auto ring = std::make_unique<Ring>();
+    char name[16] = {};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    ring->name = name;
+    ring->tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t generation = s_generation.load(std::memory_order_relaxed);
+    Ring* raw = nullptr;
+    for (auto& existing : m_rings) {
+        if (!existing->owned && existing->generation == generation) {
+            raw = existing.get();
+            raw->head.store(0, std::memory_order_relaxed);
+            raw->tid = ring->tid;
+            raw->name = std::move(ring->name);
+            raw->owned = true;
+            break;
+        }
+    }
+    if (!raw) {
+        ring->slots = std::make_unique<Slot[]>(m_config.eventsPerThread);
+        ring->mask = m_config.eventsPerThread - 1;
+        ring->generation = generation;
+        m_rings.push_back(std::move(ring));
+        raw = m_rings.back().get();
+    }
+
+    t_release.release = [this, raw] {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        raw->owned = false;
+    };
+    return raw;
+}
+
+void TraceRecorder::registerInstrument(const std::string& instrument) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_instruments.emplace(instrumentId(instrument), instrument);
+}
+
+void TraceRecorder::thresholdBreached(int64_t elapsedNs) {
+    // One automatic dump per interval, a slow patch would otherwise
+    // dump on every frame
+    int64_t now = utils::TscClock::nowNs();
+    int64_t last = m_lastAutoDumpNs.load(std::memory_order_relaxed);
+    int64_t intervalNs = m_minDumpIntervalNs.load(std::memory_order_relaxed);
+    if ((last != 0 && now - last < intervalNs) ||
+        !m_lastAutoDumpNs.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        return;
+    }
+    requestDump("frame took " + std::to_string(elapsedNs / 1000) + "us");
+}
+
+void TraceRecorder::requestDump(const std::string& reason) {
+    {
+        std::lock_guard<std::mutex> lock(m_dumpMutex);
+        if (m_dumpPending) {
+            return;
+        }
+        m_pendingReason = reason;
+        m_dumpPending = true;
+    }
+    m_dumpWake.notify_one();
+}
+
+void TraceRecorder::signalHandler(int) {
+    s_signalled = 1;
+}
+
+void TraceRecorder::dumperLoop() {
+    utils::ThreadUtils::onThreadStart("housekeeping", "trace-dumper");
+    std::unique_lock<std::mutex> lock(m_dumpMutex);
+    while (m_running) {
+        m_dumpWake.wait_for(lock, kSignalPoll, [this] { return !m_running || m_dumpPending; });
+        std::string reason;
+        if (m_dumpPending) {
+            reason = m_pendingReason;
+            m_dumpPending = false;
+        } else if (s_signalled) {
+            s_signalled = 0;
+            reason = "signal";
+        } else {
+            continue;
+        }
+
+        lock.unlock();
+        try {
+            std::string path = dump(reason);
+            Logger::getInstance().warning("Trace dump (", reason, ") written to ", path);
+        } catch (const std::exception& e) {
+            Logger::getInstance().error("Trace dump failed: ", e.what());
+        }
+        lock.lock();
+    }
+}
+
+std::string TraceRecorder::dump(const std::string& reason) {
+    std::vector<TraceThread> threads;
+    std::unordered_map<uint32_t, std::string> instruments;
+    std::string directory;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        directory = m_config.directory;
+        instruments = m_instruments;
+        uint64_t generation = s_generation.load(std::memory_order_relaxed);
+        std::vector<RawEvent> raw;
+
+        for (const auto& ring : m_rings) {
+            if (ring->generation != generation) {
+                continue;
+            }
+            // Copy the newest events, then drop any the owner overwrote
+            // while we were copying
+            uint64_t capacity = ring->mask + 1;
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t first = head > capacity ? head - capacity : 0;
+            raw.clear();
+            for (uint64_t i = first; i < head; ++i) {
+                const Slot& slot = ring->slots[i & ring->mask];
+                raw.push_back({slot.ticks.load(std::memory_order_relaxed),
+                               slot.messageId.load(std::memory_order_relaxed),
+                               slot.instrumentAndStage.load(std::memory_order_relaxed)});
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // The owner may be writing slot `after` already
+            uint64_t after = ring->head.load(std::memory_order_relaxed);
+            uint64_t valid = after >= capacity ? std::max(first, after - capacity + 1) : first;
+
+            TraceThread thread;
+            thread.tid = ring->tid;
+            thread.name = ring->name;
+            for (uint64_t i = valid; i < head; ++i) {
+                const RawEvent& event = raw[i - first];
+                TraceEvent converted;
+                converted.timeNs = utils::TscClock::toWallNs(event.ticks);
+                converted.messageId = event.messageId;
+                converted.instrumentId = static_cast<uint32_t>(event.instrumentAndStage >> 8);
+                converted.stage = static_cast<TraceStage>(event.instrumentAndStage & 0xff);
+                thread.events.push_back(converted);
+            }
+            if (!thread.events.empty()) {
+                threads.push_back(std::move(thread));
+            }
+        }
+    }
+
+    if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Failed to create directory " + directory + ": " + std::strerror(errno));
+    }
+    int64_t nowNs = utils::TscClock::wallNowNs();
+    std::time_t seconds = static_cast<std::time_t>(nowNs / 1000000000);
+    std::tm local{};
+    localtime_r(&seconds, &local);
+    char stamp[32];
+    size_t length = std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+    std::snprintf(stamp + length, sizeof(stamp) - length, "-%03d", static_cast<int>((nowNs / 1000000) % 1000));
+    std::string path = directory + "/trace-" + stamp + ".bin";
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    out.write(kTraceDumpMagic, sizeof(kTraceDumpMagic));
+    writeValue<int64_t>(out, nowNs);
+    writeString(out, reason);
+    writeValue<uint32_t>(out, static_cast<uint32_t>(instruments.size()));
+    for (const auto& [id, name] : instruments) {
+        writeValue<uint32_t>(out, id);
+        writeString(out, name);
+    }
+    writeValue<uint32_t>(out, static_cast<uint32_t>(threads.size()));
+    for (const auto& thread : threads) {
+        writeValue<uint32_t>(out, thread.tid);
+        writeString(out, thread.name);
+        writeValue<uint32_t>(out, static_cast<uint32_t>(thread.events.size()));
+        for (const auto& event : thread.events) {
+            writeValue<int64_t>(out, event.timeNs);
+            writeValue<uint64_t>(out, event.messageId);
+            writeValue<uint32_t>(out, event.instrumentId);
+            writeValue<uint8_t>(out, static_cast<uint8_t>(event.stage));
+        }
+    }
+    if (!out.flush()) {
+        throw std::runtime_error("Failed to write " + path);
+    }
+    return path;
+}
+
+TraceDump TraceRecorder::readDump(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(kTraceDumpMagic) ||
+        std::memcmp(data.data(), kTraceDumpMagic, sizeof(kTraceDumpMagic)) != 0) {
+        throw std::runtime_error(path + " is not a trace dump");
+    }
+
+    size_t offset = sizeof(kTraceDumpMagic);
+    TraceDump dump;
+    dump.dumpedAtNs = readValue<int64_t>(data, offset);
+    dump.reason = readString(data, offset);
+    uint32_t instrumentCount = readValue<uint32_t>(data, offset);
+    for (uint32_t i = 0; i < instrumentCount; ++i) {
+        uint32_t id = readValue<uint32_t>(data, offset);
+        dump.instruments[id] = readString(data, offset);
+    }
+    uint32_t threadCount = readValue<uint32_t>(data, offset);
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        TraceThread thread;
+        thread.tid = readValue<uint32_t>(data, offset);
+        thread.name = readString(data, offset);
+        uint32_t eventCount = readValue<uint32_t>(data, offset);
+        thread.events.reserve(eventCount);
+        for (uint32_t j = 0; j < eventCount; ++j) {
+            TraceEvent event;
+            event.timeNs = readValue<int64_t>(data, offset);
+            event.messageId = readValue<uint64_t>(data, offset);
+            event.instrumentId = readValue<uint32_t>(data, offset);
+            uint8_t stage = readValue<uint8_t>(data, offset);
+            if (stage >= kTraceStageCount) {
+                throw std::runtime_error("Bad trace stage in " + path);
+            }
+            event.stage = static_cast<TraceStage>(stage);
+            thread.events.push_back(event);
+        }
+        dump.threads.push_back(std::move(thread));
+    }
+    return dump;
+}
@@ -0,0 +1,209 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "utils/tsc_clock.hpp"
+
+constexpr char kTraceDumpMagic[8] = {'D', 'R', 'B', 'T', 'T', 'R', 'C', '1'};
+
+// Points a message passes on its way through the process
+enum class TraceStage : uint8_t {
+    FRAME_RECEIVED,     // WebSocket frame handed to us
+    PARSED,             // JSON parsed
+    BOOK_APPLIED,       // Book update applied
+    CALLBACK_DONE,      // Strategy callbacks returned
+    ORDER_SENT,         // Order handed to the transport
+    ACK_RECEIVED,       // Exchange response to the order
+    FRAME_DONE          // Frame handler returned
+};
+
+constexpr size_t kTraceStageCount = 7;
+
+const char* traceStageName(TraceStage stage);
+
+struct TraceConfig {
+    size_t eventsPerThread = 65536;                 // Rounded up to a power of two
+    std::string directory = "traces";               // Where dumps are written
+    int64_t thresholdNs = 2000000;                  // Frame time that triggers a dump, 0 never
+    std::chrono::milliseconds minDumpInterval{10000};   // Between threshold dumps
+};
+
+struct TraceEvent {
+    int64_t timeNs = 0;         // CLOCK_REALTIME
+    uint64_t messageId = 0;
+    uint32_t instrumentId = 0;
+    TraceStage stage = TraceStage::FRAME_RECEIVED;
+};
+
+struct TraceThread {
+    uint32_t tid = 0;
+    std::string name;
+    std::vector<TraceEvent> events;     // Oldest first
+};
+
+struct TraceDump {
+    std::string reason;
+    int64_t dumpedAtNs = 0;
+    std::vector<TraceThread> threads;
+    std::unordered_map<uint32_t, std::string> instruments;
+};
+
+// Flight recorder of recent trace events. Each thread writes into its own
+// fixed-size ring, three relaxed stores per event with no lock and no
+// allocation after the first, so recording can stay on in production; the
+// rings are only read when a dump is taken.
+//
+// Dumps are written by a background thread, on request, on SIGUSR1 (with
+// signalHandler installed) or when a frame takes longer than the
+// threshold, and hold the last eventsPerThread events of every thread.
+// tools/trace_to_chrome turns them into Chrome trace / Perfetto JSON.
+class TraceRecorder {
+public:
+    static TraceRecorder& getInstance();
+
+    void start(const TraceConfig& config = TraceConfig());
+    void stop();
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Starts a new message on this thread and records FRAME_RECEIVED
+    static void beginMessage() {
+        if (!isEnabled()) return;
+        t_messageId = s_nextMessageId.fetch_add(1, std::memory_order_relaxed);
+        t_instrumentId = 0;
+        append(TraceStage::FRAME_RECEIVED, t_messageId, 0);
+    }
+
+    // Stage of this thread's current message
+    static void record(TraceStage stage) {
+        if (!isEnabled()) return;
+        append(stage, t_messageId, t_instrumentId);
+    }
+
+    // Stage of a message handled away from its frame, e.g. an order ack
+    static void record(TraceStage stage, uint64_t messageId, uint32_t instrumentId) {
+        if (!isEnabled()) return;
+        append(stage, messageId, instrumentId);
+    }
+
+    // This thread's current message, or a fresh ID when there is none
+    static uint64_t currentMessage() {
+        if (t_messageId == 0) {
+            return s_nextMessageId.fetch_add(1, std::memory_order_relaxed);
+        }
+        return t_messageId;
+    }
+    static void endMessage() { t_messageId = 0; }
+
+    // Tags the rest of this thread's current message with an instrument
+    static void setInstrument(const std::string& instrument) {
+        if (!isEnabled()) return;
+        t_instrumentId = instrumentId(instrument);
+    }
+
+    // FNV-1a of the name; register the name for it to show in dumps
+    static uint32_t instrumentId(const std::string& instrument) {
+        uint32_t hash = 2166136261u;
+        for (char c : instrument) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+        }
+        return hash;
+    }
+    void registerInstrument(const std::string& instrument);
+
+    // Frame time check, asks for a dump past the threshold
+    static void checkLatency(int64_t elapsedNs) {
+        int64_t threshold = s_thresholdNs.load(std::memory_order_relaxed);
+        if (threshold > 0 && elapsedNs > threshold) {
+            getInstance().thresholdBreached(elapsedNs);
+        }
+    }
+
+    // Asks the dump thread for a dump, safe on hot paths
+    void requestDump(const std::string& reason);
+    // Async-signal-safe, for signal(SIGUSR1, TraceRecorder::signalHandler)
+    static void signalHandler(int signal);
+
+    // Writes a dump now and returns its path
+    std::string dump(const std::string& reason);
+
+    // Reads a dump written by dump()
+    static TraceDump readDump(const std::string& path);
+
+private:
+    TraceRecorder();
+    ~TraceRecorder();
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    // One event as three words so a dump can read while the owner writes
+    struct Slot {
+        std::atomic<uint64_t> ticks{0};
+        std::atomic<uint64_t> messageId{0};
+        std::atomic<uint64_t> instrumentAndStage{0};
+    };
+
+    struct Ring {
+        std::unique_ptr<Slot[]> slots;
+        uint64_t mask = 0;
+        std::atomic<uint64_t> head{0};
+        uint32_t tid = 0;
+        std::string name;
+        uint64_t generation = 0;
+        bool owned = true;          // False once the thread exits
+    };
+
+    static void append(TraceStage stage, uint64_t messageId, uint32_t instrumentId) {
+        Ring* ring = t_ring;
+        if (!ring || ring->generation != s_generation.load(std::memory_order_relaxed)) {
+            ring = getInstance().addRing();
+            if (!ring) return;
+            t_ring = ring;
+        }
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        Slot& slot = ring->slots[head & ring->mask];
+        slot.ticks.store(utils::TscClock::ticks(), std::memory_order_relaxed);
+        slot.messageId.store(messageId, std::memory_order_relaxed);
+        slot.instrumentAndStage.store((static_cast<uint64_t>(instrumentId) << 8) | static_cast<uint8_t>(stage),
+                                      std::memory_order_relaxed);
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    Ring* addRing();
+    void thresholdBreached(int64_t elapsedNs);
+    void dumperLoop();
+
+    // Inline so the hot path reads them without a TLS wrapper call
+    static inline std::atomic<bool> s_enabled{false};
+    static inline std::atomic<int64_t> s_thresholdNs{0};
+    static inline std::atomic<uint64_t> s_generation{0};
+    static inline std::atomic<uint64_t> s_nextMessageId{1};
+    static inline volatile std::sig_atomic_t s_signalled = 0;
+    static inline thread_local Ring* t_ring = nullptr;
+    static inline thread_local uint64_t t_messageId = 0;
+    static inline thread_local uint32_t t_instrumentId = 0;
+
+    TraceConfig m_config;
+    std::mutex m_mutex;
+    // Rings are never freed, a thread may still hold a pointer to one of
+    // an earlier start. Rings of exited threads are handed to new ones;
+    // dumps only read the current generation.
+    std::vector<std::unique_ptr<Ring>> m_rings;
+    std::unordered_map<uint32_t, std::string> m_instruments;
+
+    std::thread m_dumper;
+    std::mutex m_dumpMutex;
+    std::condition_variable m_dumpWake;
+    bool m_running;
+    std::string m_pendingReason;
+    std::atomic<bool> m_dumpPending;
+    std::atomic<int64_t> m_lastAutoDumpNs;
+    std::atomic<int64_t> m_minDumpIntervalNs;  // Copy of m_config's, read without m_mutex
+};
@@ -0,0 +1,146 @@
+#include "order/amend_coalescer.hpp"
+#include "utils/logger.hpp"
+#include <stdexcept>
+
+AmendCoalescer::AmendCoalescer(OrderTransport transport)
+    : m_transport(std::move(transport))
+    , m_halted(false)
+    , m_requested(0)
+    , m_sent(0)
+    , m_coalesced(0)
+    , m_failed(0) {
+    if (!m_transport) {
+        throw std::invalid_argument("Order transport is required");
+    }
+}
+
+bool AmendCoalescer::requestAmend(const std::string& orderId, double price, double amount) {
+    m_requested.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_halted) {
+            return false;
+        }
+        Slot& slot = m_slots[orderId];
+        if (slot.inFlight) {
+            if (slot.hasPending) {
+                m_coalesced.fetch_add(1, std::memory_order_relaxed);
+            }
+            slot.hasPending = true;
+            slot.pendingPrice = price;
+            slot.pendingAmount = amount;
+            return true;
+        }
+        slot.inFlight = true;
+    }
+    return send(orderId, price, amount);
+}
+
+void AmendCoalescer::forget(const std::string& orderId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_slots.find(orderId);
+    if (it == m_slots.end()) {
+        return;
+    }
+    if (it->second.hasPending) {
+        m_coalesced.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_slots.erase(it);
+}
+
+void AmendCoalescer::halt() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_halted = true;
+    for (auto& [orderId, slot] : m_slots) {
+        if (slot.hasPending) {
+            m_coalesced.fetch_add(1, std::memory_order_relaxed);
+            slot.hasPending = false;
+        }
+    }
+}
+
+void AmendCoalescer::resume() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_halted = false;
+}
+
+void AmendCoalescer::setAckCallback(AckCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ackCallback = std::move(callback);
+}
+
+bool AmendCoalescer::hasInFlight(const std::string& orderId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_slots.find(orderId);
+    return it != m_slots.end() && it->second.inFlight;
+}
+
+AmendStats AmendCoalescer::getStats() const {
+    AmendStats stats;
+    stats.requested = m_requested.load(std::memory_order_relaxed);
+    stats.sent = m_sent.load(std::memory_order_relaxed);
+    stats.coalesced = m_coalesced.load(std::memory_order_relaxed);
+    stats.failed = m_failed.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool AmendCoalescer::send(const std::string& orderId, double price, double amount) {
+    nlohmann::json params = {
+        {"order_id", orderId},
+        {"price", price},
+        {"amount", amount}
+    };
+
+    // The transport may answer synchronously, so no lock is held here
+    try {
+        m_transport("private/edit", params, [this, orderId](const nlohmann::json& response) {
+            onAck(orderId, response);
+        });
+    } catch (const std::exception& e) {
+        Logger::getInstance().error("Edit failed for ", orderId, ": ", e.what());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_slots.erase(orderId);
+        m_failed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_sent.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void AmendCoalescer::onAck(const std::string& orderId, const nlohmann::json& response) {
+    bool sendNext = false;
+    double price = 0.0;
+    double amount = 0.0;
+    AckCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        callback = m_ackCallback;
+
+        auto it = m_slots.find(orderId);
+        if (it != m_slots.end()) {
+            Slot& slot = it->second;
+            if (response.contains("error")) {
+                // The order is most likely gone, a newer target would fail too
+                m_failed.fetch_add(1, std::memory_order_relaxed);
+                if (slot.hasPending) {
+                    m_coalesced.fetch_add(1, std::memory_order_relaxed);
+                }
+                m_slots.erase(it);
+            } else if (slot.hasPending) {
+                sendNext = true;
+                price = slot.pendingPrice;
+                amount = slot.pendingAmount;
+                slot.hasPending = false;
+            } else {
+                m_slots.erase(it);
+            }
+        }
+    }
+
+    if (sendNext) {
+        send(orderId, price, amount);
+    }
+    if (callback) {
+        callback(orderId, response);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "order/order_transport.hpp"
+
+struct AmendStats {
+    uint64_t requested = 0;     // Targets handed in by the strategy
+    uint64_t sent = 0;          // Edits that went to the exchange
+    uint64_t coalesced = 0;     // Targets overwritten before they were sent
+    uint64_t failed = 0;        // Edits the exchange rejected
+};
+
+// Keeps at most one private/edit in flight per order. A new target while
+// an edit is outstanding replaces any unsent one; the latest target goes
+// out when the outstanding edit is acknowledged.
+class AmendCoalescer {
+public:
+    using AckCallback = std::function<void(const std::string& orderId, const nlohmann::json& response)>;
+
+    explicit AmendCoalescer(OrderTransport transport);
+
+    // Returns false only if the edit could not be handed to the transport
+    bool requestAmend(const std::string& orderId, double price, double amount);
+
+    // Drops any unsent target, for orders that reached a terminal state
+    void forget(const std::string& orderId);
+
+    // Kill switch: drops every unsent target and refuses new ones, so no
+    // edit follows a cancel_all when an outstanding edit is acknowledged
+    void halt();
+    void resume();
+
+    // Fires for every edit response, after the next edit has been sent
+    void setAckCallback(AckCallback callback);
+
+    bool hasInFlight(const std::string& orderId) const;
+    AmendStats getStats() const;
+
+private:
+    struct Slot {
+        bool inFlight = false;
+        bool hasPending = false;
+        double pendingPrice = 0.0;
+        double pendingAmount = 0.0;
+    };
+
+    bool send(const std::string& orderId, double price, double amount);
+    void onAck(const std::string& orderId, const nlohmann::json& response);
+
+    OrderTransport m_transport;
+    std::unordered_map<std::string, Slot> m_slots;
+    bool m_halted;
+    mutable std::mutex m_mutex;
+    AckCallback m_ackCallback;
+
+    std::atomic<uint64_t> m_requested;
+    std::atomic<uint64_t> m_sent;
+    std::atomic<uint64_t> m_coalesced;
+    std::atomic<uint64_t> m_failed;
+};
@@ -10,8 +10,8 @@ Order::Order(const std::string& instrument, OrderSide side, OrderType type,
     , m_amount(amount)
     , m_filledAmount(0.0)
     , m_status(OrderStatus::PENDING)
-    , m_creationTime(std::chrono::system_clock::now())
-    , m_lastUpdateTime(m_creationTime)
+    , m_creationTicks(utils::TscClock::ticks())
+    , m_lastUpdateTicks(m_creationTicks)
 {
     if (price < 0.0 || amount <= 0.0) {
         throw std::invalid_argument("Invalid price or amount");
@@ -24,17 +24,19 @@ void Order::setStatus(OrderStatus status) {
 }
 
 void Order::setFilledAmount(double amount) {
-    if (amount < 0.0 || amount > m_amount) {
-        throw std::invalid_argument("Invalid filled amount");
-    }
-    
-    m_filledAmount = amount;
+    setFilledQuantity(amount);
     if (m_filledAmount == m_amount) {
         setStatus(OrderStatus::FILLED);
     } else if (m_filledAmount > 0) {
         setStatus(OrderStatus::PARTIALLY_FILLED);
     }
-    
+}
+
+void Order::setFilledQuantity(double amount) {
+    if (amount < 0.0 || amount > m_amount) {
+        throw std::invalid_argument("Invalid filled amount");
+    }
+    m_filledAmount = amount;
     updateLastUpdateTime();
 }
 
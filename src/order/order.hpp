@@ -2,6 +2,7 @@
 #include <string>
 #include <chrono>
 #include <memory>
+#include "utils/tsc_clock.hpp"
 
 enum class OrderSide {
     BUY,
@@ -31,6 +32,7 @@ public:
     
     // Getters
     std::string getOrderId() const { return m_orderId; }
+    std::string getClientOrderId() const { return m_clientOrderId; }
     std::string getInstrument() const { return m_instrument; }
     OrderSide getSide() const { return m_side; }
     OrderType getType() const { return m_type; }
@@ -39,23 +41,32 @@ public:
     double getFilledAmount() const { return m_filledAmount; }
     double getRemainingAmount() const { return m_amount - m_filledAmount; }
     OrderStatus getStatus() const { return m_status; }
-    std::chrono::system_clock::time_point getCreationTime() const { return m_creationTime; }
-    std::chrono::system_clock::time_point getLastUpdateTime() const { return m_lastUpdateTime; }
+    std::chrono::system_clock::time_point getCreationTime() const {
+        return utils::TscClock::toSystemTime(m_creationTicks);
+    }
+    std::chrono::system_clock::time_point getLastUpdateTime() const {
+        return utils::TscClock::toSystemTime(m_lastUpdateTicks);
+    }
 
     // Setters
     void setOrderId(const std::string& orderId) { m_orderId = orderId; }
+    void setClientOrderId(const std::string& clientOrderId) { m_clientOrderId = clientOrderId; }
     void setStatus(OrderStatus status);
+    // Moves the status to PARTIALLY_FILLED or FILLED
     void setFilledAmount(double amount);
+    // Keeps the status, for fills reported after the order closed
+    void setFilledQuantity(double amount);
     void setPrice(double price);
     void setAmount(double amount);
     
     // Utility functions
     bool isFilled() const { return m_status == OrderStatus::FILLED; }
     bool isActive() const;
-    void updateLastUpdateTime() { m_lastUpdateTime = std::chrono::system_clock::now(); }
+    void updateLastUpdateTime() { m_lastUpdateTicks = utils::TscClock::ticks(); }
 
 private:
     std::string m_orderId;
+    std::string m_clientOrderId;    // Sent as the Deribit label
     std::string m_instrument;
     OrderSide m_side;
     OrderType m_type;
@@ -63,6 +74,7 @@ private:
     double m_amount;
     double m_filledAmount;
     OrderStatus m_status;
-    std::chrono::system_clock::time_point m_creationTime;
-    std::chrono::system_clock::time_point m_lastUpdateTime;
+    // TscClock ticks, converted to wall time when read
+    uint64_t m_creationTicks;
+    uint64_t m_lastUpdateTicks;
 };
\ No newline at end of file
@@ -0,0 +1,467 @@
+#include "order/order_manager.hpp"
+#include "metrics/latency_metrics.hpp"
+#include "utils/logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+    std::string toBase36(uint64_t value) {
+        static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+        std::string result;
+        do {
+            result.insert(result.begin(), digits[value % 36]);
+            value /= 36;
+        } while (value > 0);
+        return result;
+    }
+
+    // Makes labels unique across restarts without any persisted state
+    std::string sessionTag() {
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        return toBase36(static_cast<uint64_t>(seconds));
+    }
+
+    bool isActiveStatus(OrderStatus status) {
+        return status == OrderStatus::PENDING ||
+               status == OrderStatus::OPEN ||
+               status == OrderStatus::PARTIALLY_FILLED;
+    }
+}
+
+OrderManager::OrderManager(OrderTransport transport, const std::string& labelPrefix)
+    : m_transport(std::move(transport))
+    , m_amends(m_transport)
+    , m_labelPrefix(labelPrefix + "-" + sessionTag() + "-")
+    , m_nextId(1)
+    , m_openOrders(0) {
+    m_amends.setAckCallback([this](const std::string& orderId, const nlohmann::json& response) {
+        std::string clientOrderId;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_byExchangeId.find(orderId);
+            if (it == m_byExchangeId.end()) {
+                return;
+            }
+            clientOrderId = it->second->order->getClientOrderId();
+        }
+        onResponse(clientOrderId, response);
+    });
+}
+
+OrderManager::OrderManager(DeribitWebSocket& webSocket, const std::string& labelPrefix)
+    : OrderManager([&webSocket](const std::string& method, const nlohmann::json& params,
+                                ResponseCallback callback) {
+                       webSocket.sendRequest(method, params, std::move(callback));
+                   },
+                   labelPrefix) {
+}
+
+void OrderManager::setRiskGate(std::shared_ptr<PreTradeRiskGate> riskGate) {
+    m_riskGate = std::move(riskGate);
+}
+
+std::shared_ptr<Order> OrderManager::submitOrder(const std::string& instrument, OrderSide side,
+                                                 OrderType type, double price, double amount,
+                                                 bool postOnly, bool reduceOnly,
+                                                 const std::string& requestedClientOrderId) {
+    auto order = std::make_shared<Order>(instrument, side, type, price, amount);
+    std::string clientOrderId = requestedClientOrderId.empty() ? nextClientOrderId()
+                                                               : requestedClientOrderId;
+    order->setClientOrderId(clientOrderId);
+
+    auto entry = std::make_shared<Entry>();
+    entry->order = order;
+
+    if (m_riskGate) {
+        entry->riskInstrumentId = m_riskGate->getInstrumentId(instrument);
+        auto result = m_riskGate->check({entry->riskInstrumentId, side, price, amount, type});
+        if (result != RiskCheckResult::PASSED) {
+            LOG_DEFERRED(LogLevel::WARNING, "Order {} blocked by risk: {}",
+                         clientOrderId, PreTradeRiskGate::resultToString(result));
+            order->setStatus(OrderStatus::REJECTED);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_byClientId[clientOrderId] = entry;
+            }
+            notify(*order);
+            return order;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_byClientId[clientOrderId] = entry;
+    }
+    m_openOrders.fetch_add(1);
+    if (m_riskGate) {
+        m_riskGate->onOrderOpened();
+    }
+
+    nlohmann::json params = {
+        {"instrument_name", instrument},
+        {"amount", amount},
+        {"label", clientOrderId}
+    };
+    switch (type) {
+        case OrderType::LIMIT:       params["type"] = "limit"; break;
+        case OrderType::MARKET:      params["type"] = "market"; break;
+        case OrderType::STOP_LIMIT:  params["type"] = "stop_limit"; break;
+        case OrderType::STOP_MARKET: params["type"] = "stop_market"; break;
+    }
+    if (type != OrderType::MARKET && type != OrderType::STOP_MARKET) {
+        params["price"] = price;
+    }
+    if (postOnly) params["post_only"] = true;
+    if (reduceOnly) params["reduce_only"] = true;
+
+    const char* method = side == OrderSide::BUY ? "private/buy" : "private/sell";
+    try {
+        auto sent = pipeline::orderSent(instrument);
+        m_transport(method, params, [this, clientOrderId, sent](const nlohmann::json& response) {
+            pipeline::ackReceived(sent);
+            onResponse(clientOrderId, response);
+        });
+    } catch (const std::exception& e) {
+        Logger::getInstance().error("Order submission failed: ", e.what());
+        onResponse(clientOrderId, {{"error", {{"code", -1}, {"message", e.what()}}}});
+    }
+
+    return order;
+}
+
+bool OrderManager::cancelOrder(const std::string& clientOrderId) {
+    std::string orderId;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_byClientId.find(clientOrderId);
+        if (it == m_byClientId.end() || !it->second->order->isActive()) {
+            return false;
+        }
+        it->second->cancelInFlight = true;
+        orderId = it->second->order->getOrderId();
+    }
+
+    // Before the ack only the label is known to both sides
+    std::string method = orderId.empty() ? "private/cancel_by_label" : "private/cancel";
+    nlohmann::json params = orderId.empty()
+        ? nlohmann::json{{"label", clientOrderId}}
+        : nlohmann::json{{"order_id", orderId}};
+
+    try {
+        m_transport(method, params, [this, clientOrderId](const nlohmann::json& response) {
+            clearCancelInFlight(clientOrderId);
+            onResponse(clientOrderId, response);
+        });
+    } catch (const std::exception& e) {
+        Logger::getInstance().error("Cancel failed for ", clientOrderId, ": ", e.what());
+        clearCancelInFlight(clientOrderId);
+        return false;
+    }
+    return true;
+}
+
+bool OrderManager::hasCancelInFlight(const std::string& clientOrderId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_byClientId.find(clientOrderId);
+    return it != m_byClientId.end() && it->second->cancelInFlight;
+}
+
+void OrderManager::clearCancelInFlight(const std::string& clientOrderId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_byClientId.find(clientOrderId);
+    if (it != m_byClientId.end()) {
+        it->second->cancelInFlight = false;
+    }
+}
+
+bool OrderManager::modifyOrder(const std::string& clientOrderId, double newPrice, double newAmount) {
+    std::string orderId;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_byClientId.find(clientOrderId);
+        if (it == m_byClientId.end() || !it->second->order->isActive()) {
+            return false;
+        }
+        orderId = it->second->order->getOrderId();
+    }
+
+    // A halted gate blocks edits as well, they can add risk too
+    if (m_riskGate && m_riskGate->isHalted()) {
+        return false;
+    }
+
+    // Edits need the exchange order ID
+    if (orderId.empty()) {
+        return false;
+    }
+
+    return m_amends.requestAmend(orderId, newPrice, newAmount);
+}
+
+void OrderManager::onOrderUpdate(const nlohmann::json& order) {
+    std::shared_ptr<Order> updated;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = findEntry(order);
+        if (!entry) {
+            return;  // Not one of ours, or placed by another session
+        }
+        applyOrderState(*entry, order);
+        updated = entry->order;
+    }
+    notify(*updated);
+}
+
+void OrderManager::onTrade(const nlohmann::json& trade) {
+    std::shared_ptr<Order> updated;
+    FillCallback fillCallback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = findEntry(trade);
+        if (!entry || !recordTrade(*entry, trade)) {
+            return;
+        }
+        applyFilled(*entry);
+        updated = entry->order;
+        fillCallback = m_fillCallback;
+    }
+    if (fillCallback) {
+        fillCallback(*updated, trade.value("price", 0.0), trade.value("amount", 0.0));
+    }
+    notify(*updated);
+}
+
+std::shared_ptr<Order> OrderManager::getByClientId(const std::string& clientOrderId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_byClientId.find(clientOrderId);
+    return (it != m_byClientId.end()) ? it->second->order : nullptr;
+}
+
+std::shared_ptr<Order> OrderManager::getByExchangeId(const std::string& orderId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_byExchangeId.find(orderId);
+    return (it != m_byExchangeId.end()) ? it->second->order : nullptr;
+}
+
+std::vector<std::shared_ptr<Order>> OrderManager::getActiveOrders() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::shared_ptr<Order>> active;
+    active.reserve(m_openOrders.load());
+    for (const auto& [clientOrderId, entry] : m_byClientId) {
+        if (entry->order->isActive()) {
+            active.push_back(entry->order);
+        }
+    }
+    return active;
+}
+
+size_t OrderManager::purgeInactive() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t removed = 0;
+    for (auto it = m_byClientId.begin(); it != m_byClientId.end();) {
+        if (!it->second->order->isActive()) {
+            m_byExchangeId.erase(it->second->order->getOrderId());
+            it = m_byClientId.erase(it);
+            ++removed;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+void OrderManager::setOrderUpdateCallback(OrderUpdateCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_updateCallback = std::move(callback);
+}
+
+void OrderManager::setFillCallback(FillCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fillCallback = std::move(callback);
+}
+
+std::string OrderManager::nextClientOrderId() {
+    return m_labelPrefix + toBase36(m_nextId.fetch_add(1));
+}
+
+OrderStatus OrderManager::parseOrderState(const std::string& state) {
+    if (state == "open" || state == "untriggered") return OrderStatus::OPEN;
+    if (state == "filled") return OrderStatus::FILLED;
+    if (state == "cancelled") return OrderStatus::CANCELLED;
+    if (state == "rejected") return OrderStatus::REJECTED;
+    throw std::invalid_argument("Invalid order state: " + state);
+}
+
+void OrderManager::onResponse(const std::string& clientOrderId, const nlohmann::json& response) {
+    std::shared_ptr<Order> updated;
+    std::vector<std::pair<double, double>> fills;
+    FillCallback fillCallback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_byClientId.find(clientOrderId);
+        if (it == m_byClientId.end()) {
+            return;
+        }
+        auto& entry = *it->second;
+
+        if (response.contains("error")) {
+            Logger::getInstance().warning("Order request rejected for ", clientOrderId, ": ",
+                                          response["error"].dump());
+            // Only a failed placement is terminal, a failed cancel or edit
+            // leaves the order as it was. Listeners still hear about it so
+            // they can drop what they assumed the request would change.
+            if (entry.order->getStatus() == OrderStatus::PENDING && entry.order->getOrderId().empty()) {
+                setStatus(entry, OrderStatus::REJECTED);
+            }
+            updated = entry.order;
+        } else {
+            const auto& result = response.contains("result") ? response["result"] : response;
+            if (result.contains("order")) {
+                applyOrderState(entry, result["order"]);
+                updated = entry.order;
+            } else if (result.contains("order_id")) {
+                applyOrderState(entry, result);
+                updated = entry.order;
+            }
+            if (result.contains("trades")) {
+                for (const auto& trade : result["trades"]) {
+                    if (recordTrade(entry, trade)) {
+                        fills.emplace_back(trade.value("price", 0.0), trade.value("amount", 0.0));
+                    }
+                }
+                applyFilled(entry);
+                updated = entry.order;
+            }
+        }
+        fillCallback = m_fillCallback;
+    }
+    if (fillCallback) {
+        for (const auto& [price, amount] : fills) {
+            fillCallback(*updated, price, amount);
+        }
+    }
+    if (updated) {
+        notify(*updated);
+    }
+}
+
+bool OrderManager::recordTrade(Entry& entry, const nlohmann::json& trade) {
+    // The same trade arrives in the order response and on user.trades
+    if (trade.contains("trade_id")) {
+        const auto& tradeId = trade["trade_id"];
+        if (!entry.tradeIds.insert(tradeId.is_string() ? tradeId.get<std::string>() : tradeId.dump()).second) {
+            return false;
+        }
+    }
+    entry.tradeFilled += trade.value("amount", 0.0);
+    return true;
+}
+
+std::shared_ptr<OrderManager::Entry> OrderManager::findEntry(const nlohmann::json& data) const {
+    if (data.contains("order_id")) {
+        auto it = m_byExchangeId.find(data["order_id"].get<std::string>());
+        if (it != m_byExchangeId.end()) {
+            return it->second;
+        }
+    }
+    if (data.contains("label") && data["label"].is_string()) {
+        auto it = m_byClientId.find(data["label"].get<std::string>());
+        if (it != m_byClientId.end()) {
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+void OrderManager::applyOrderState(Entry& entry, const nlohmann::json& order) {
+    auto& local = *entry.order;
+
+    if (local.getOrderId().empty() && order.contains("order_id")) {
+        std::string orderId = order["order_id"].get<std::string>();
+        local.setOrderId(orderId);
+        m_byExchangeId[orderId] = m_byClientId[local.getClientOrderId()];
+    }
+
+    if (order.contains("amount")) {
+        double amount = order["amount"].get<double>();
+        if (amount > 0.0 && amount >= local.getFilledAmount()) {
+            local.setAmount(amount);
+        }
+    }
+    if (order.contains("price") && order["price"].is_number()) {
+        local.setPrice(order["price"].get<double>());
+    }
+    if (order.contains("filled_amount")) {
+        entry.reportedFilled = std::max(entry.reportedFilled, order["filled_amount"].get<double>());
+    }
+    applyFilled(entry);
+
+    if (order.contains("order_state")) {
+        OrderStatus status = parseOrderState(order["order_state"].get<std::string>());
+        if (status == OrderStatus::OPEN && local.getFilledAmount() > 0.0) {
+            status = OrderStatus::PARTIALLY_FILLED;
+        }
+        setStatus(entry, status);
+    }
+}
+
+void OrderManager::applyFilled(Entry& entry) {
+    auto& local = *entry.order;
+
+    // Both sources are cumulative, so the larger one is never double counted
+    double filled = std::min(std::max(entry.reportedFilled, entry.tradeFilled), local.getAmount());
+    if (filled <= local.getFilledAmount()) {
+        return;
+    }
+
+    bool wasActive = local.isActive();
+    double delta = filled - local.getFilledAmount();
+    // A trade can arrive after the cancel notification, on another
+    // channel; it counts but does not reopen the order
+    if (wasActive) {
+        local.setFilledAmount(filled);
+    } else {
+        local.setFilledQuantity(filled);
+    }
+    if (m_riskGate) {
+        m_riskGate->onFill(entry.riskInstrumentId, local.getSide(), delta);
+    }
+    if (wasActive && !local.isActive()) {
+        onOrderClosed(entry);
+    }
+}
+
+void OrderManager::setStatus(Entry& entry, OrderStatus status) {
+    auto& local = *entry.order;
+    if (!local.isActive()) {
+        return;  // Terminal states are final
+    }
+
+    local.setStatus(status);
+    if (!isActiveStatus(status)) {
+        onOrderClosed(entry);
+    }
+}
+
+void OrderManager::onOrderClosed(Entry& entry) {
+    m_openOrders.fetch_sub(1);
+    if (!entry.order->getOrderId().empty()) {
+        m_amends.forget(entry.order->getOrderId());
+    }
+    if (m_riskGate) {
+        m_riskGate->onOrderClosed();
+    }
+}
+
+void OrderManager::notify(const Order& order) {
+    OrderUpdateCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        callback = m_updateCallback;
+    }
+    if (callback) {
+        callback(order);
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "order/order.hpp"
+#include "order/amend_coalescer.hpp"
+#include "order/order_transport.hpp"
+#include "risk/pre_trade_risk.hpp"
+
+// Tracks our orders from submission to a terminal state. Orders are
+// created locally with a client order ID (the Deribit label) and are usable
+// immediately; exchange acks and private notifications fill in the rest.
+//
+//   PENDING           sent, not yet acknowledged
+//   OPEN              acknowledged by the exchange
+//   PARTIALLY_FILLED  acknowledged with some fills
+//   FILLED / CANCELLED / REJECTED  terminal
+class OrderManager {
+public:
+    using OrderUpdateCallback = std::function<void(const Order& order)>;
+    using FillCallback = std::function<void(const Order& order, double price, double amount)>;
+
+    OrderManager(OrderTransport transport, const std::string& labelPrefix = "dt");
+    OrderManager(DeribitWebSocket& webSocket, const std::string& labelPrefix = "dt");
+
+    // Orders failing a pre-trade check come back REJECTED and are not sent
+    void setRiskGate(std::shared_ptr<PreTradeRiskGate> riskGate);
+
+    // Order entry, returns the local order without waiting for the ack. A
+    // caller-supplied client order ID (from nextClientOrderId) lets callers
+    // index the order before any update for it can arrive.
+    std::shared_ptr<Order> submitOrder(const std::string& instrument, OrderSide side, OrderType type,
+                                       double price, double amount,
+                                       bool postOnly = false, bool reduceOnly = false,
+                                       const std::string& clientOrderId = std::string());
+    // False when the cancel was not sent; the order is left as it was
+    bool cancelOrder(const std::string& clientOrderId);
+    bool hasCancelInFlight(const std::string& clientOrderId) const;
+    // Edits are coalesced, at most one is in flight per order
+    bool modifyOrder(const std::string& clientOrderId, double newPrice, double newAmount);
+    AmendStats getAmendStats() const { return m_amends.getStats(); }
+    bool hasAmendInFlight(const std::string& orderId) const { return m_amends.hasInFlight(orderId); }
+    // Called by the kill switch, drops queued edits and refuses new ones
+    void haltAmends() { m_amends.halt(); }
+    void resumeAmends() { m_amends.resume(); }
+
+    // Reconciliation from user.orders.* and user.trades.* notifications
+    void onOrderUpdate(const nlohmann::json& order);
+    void onTrade(const nlohmann::json& trade);
+
+    // Lookups
+    std::shared_ptr<Order> getByClientId(const std::string& clientOrderId) const;
+    std::shared_ptr<Order> getByExchangeId(const std::string& orderId) const;
+    std::vector<std::shared_ptr<Order>> getActiveOrders() const;
+    size_t getOpenOrderCount() const { return m_openOrders.load(); }
+
+    // Drops terminal orders from the indexes
+    size_t purgeInactive();
+
+    void setOrderUpdateCallback(OrderUpdateCallback callback);
+
+    // Fires once per trade, for position keeping
+    void setFillCallback(FillCallback callback);
+
+    std::string nextClientOrderId();
+    static OrderStatus parseOrderState(const std::string& state);
+
+private:
+    struct Entry {
+        std::shared_ptr<Order> order;
+        double reportedFilled = 0.0;   // Cumulative, from order notifications
+        double tradeFilled = 0.0;      // Sum of our trade notifications
+        std::unordered_set<std::string> tradeIds;
+        bool cancelInFlight = false;   // Until its response, or the send fails
+        uint32_t riskInstrumentId = PreTradeRiskGate::kUnknownInstrument;
+    };
+
+    void onResponse(const std::string& clientOrderId, const nlohmann::json& response);
+    void clearCancelInFlight(const std::string& clientOrderId);
+    std::shared_ptr<Entry> findEntry(const nlohmann::json& data) const;
+    void applyOrderState(Entry& entry, const nlohmann::json& order);
+    void applyFilled(Entry& entry);
+    bool recordTrade(Entry& entry, const nlohmann::json& trade);
+    void setStatus(Entry& entry, OrderStatus status);
+    void onOrderClosed(Entry& entry);
+    void notify(const Order& order);
+
+    OrderTransport m_transport;
+    AmendCoalescer m_amends;
+    std::shared_ptr<PreTradeRiskGate> m_riskGate;
+    std::string m_labelPrefix;
+    std::atomic<uint64_t> m_nextId;
+    std::atomic<size_t> m_openOrders;
+
+    // Both indexes share entries, the exchange one fills in on ack
+    std::unordered_map<std::string, std::shared_ptr<Entry>> m_byClientId;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> m_byExchangeId;
+    mutable std::mutex m_mutex;
+
+    OrderUpdateCallback m_updateCallback;
+    FillCallback m_fillCallback;
+};
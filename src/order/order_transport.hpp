@@ -0,0 +1,10 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "api/websocket.hpp"
+
+// Sends one JSON-RPC request, the callback receives the response
+using OrderTransport = std::function<void(const std::string& method,
+                                          const nlohmann::json& params,
+                                          ResponseCallback callback)>;
@@ -116,6 +116,32 @@ size_t OrderBook::getDepth(OrderSide side) const {
     return (side == OrderSide::BUY) ? m_bids.size() : m_asks.size();
 }
 
+double OrderBook::getVolumeAt(OrderSide side, double price) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (side == OrderSide::BUY) {
+        auto it = m_bids.find(price);
+        return it != m_bids.end() ? it->second.totalVolume : 0.0;
+    }
+    auto it = m_asks.find(price);
+    return it != m_asks.end() ? it->second.totalVolume : 0.0;
+}
+
+size_t OrderBook::getTopLevels(OrderSide side, std::pair<double, double>* out, size_t maxLevels) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    auto copy = [&](const auto& levels) {
+        for (auto it = levels.begin(); it != levels.end() && count < maxLevels; ++it) {
+            out[count++] = {it->first, it->second.totalVolume};
+        }
+    };
+    if (side == OrderSide::BUY) {
+        copy(m_bids);
+    } else {
+        copy(m_asks);
+    }
+    return count;
+}
+
 void OrderBook::clear() {
     std::lock_guard<std::mutex> lock(m_mutex);
     m_bids.clear();
@@ -37,6 +37,10 @@ public:
     BidMap getBidLevels() const;
     AskMap getAskLevels() const;
     size_t getDepth(OrderSide side) const;
+    // Volume resting at one price, 0 if there is no level
+    double getVolumeAt(OrderSide side, double price) const;
+    // Best levels of one side as (price, volume), without copying orders
+    size_t getTopLevels(OrderSide side, std::pair<double, double>* out, size_t maxLevels) const;
 
     // Instrument info
     std::string getInstrument() const { return m_instrument; }
@@ -0,0 +1,139 @@
+#include "risk/kill_switch.hpp"
+#include "utils/logger.hpp"
+#include "utils/tsc_clock.hpp"
+#include "utils/utils.hpp"
+#include <cerrno>
+#include <stdexcept>
+
+namespace {
+    int64_t steadyNowNs() {
+        return utils::TscClock::nowNs();
+    }
+}
+
+KillSwitch::KillSwitch(DeribitWebSocket& webSocket)
+    : m_webSocket(webSocket)
+    , m_cancelId(0)
+    , m_triggered(false)
+    , m_triggeredAtNs(0)
+    , m_timeToFlatNs(-1)
+    , m_watching(true) {
+    if (sem_init(&m_signalSem, 0, 0) != 0) {
+        throw std::runtime_error("Failed to create kill switch semaphore");
+    }
+    m_watcher = std::thread(&KillSwitch::watchSignals, this);
+}
+
+KillSwitch::~KillSwitch() {
+    m_watching = false;
+    sem_post(&m_signalSem);
+    if (m_watcher.joinable()) {
+        m_watcher.join();
+    }
+    sem_destroy(&m_signalSem);
+}
+
+void KillSwitch::addRiskGate(std::shared_ptr<PreTradeRiskGate> gate) {
+    m_gates.push_back(std::move(gate));
+}
+
+void KillSwitch::addOrderManager(OrderManager& orders) {
+    m_orderManagers.push_back(&orders);
+}
+
+void KillSwitch::arm() {
+    m_cancelId = m_webSocket.reserveRequestId();
+    m_cancelPayload = "{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(m_cancelId) +
+                      ",\"method\":\"private/cancel_all\",\"params\":{}}";
+}
+
+bool KillSwitch::trigger(const char* reason) {
+    if (m_triggered.exchange(true)) {
+        return false;
+    }
+    m_triggeredAtNs = steadyNowNs();
+
+    // Stop anything new first, then pull what is resting
+    for (const auto& gate : m_gates) {
+        gate->halt();
+    }
+    for (auto* orders : m_orderManagers) {
+        orders->haltAmends();
+    }
+
+    if (m_cancelPayload.empty()) {
+        arm();
+    }
+    try {
+        m_webSocket.sendRaw(m_cancelId, m_cancelPayload, [this](const nlohmann::json& response) {
+            onCancelResponse(response);
+        });
+    } catch (const std::exception& e) {
+        // Cancel-on-disconnect is the backstop when the connection is gone
+        Logger::getInstance().error("Kill switch cancel_all not sent: ", e.what());
+    }
+
+    Logger::getInstance().warning("Kill switch triggered: ", reason);
+    return true;
+}
+
+void KillSwitch::triggerFromSignal() {
+    sem_post(&m_signalSem);
+}
+
+void KillSwitch::reset() {
+    for (const auto& gate : m_gates) {
+        gate->resume();
+    }
+    for (auto* orders : m_orderManagers) {
+        orders->resumeAmends();
+    }
+    m_timeToFlatNs = -1;
+    arm();
+    m_triggered = false;
+}
+
+void KillSwitch::setFlatCallback(FlatCallback callback) {
+    std::lock_guard<std::mutex> lock(m_callbackMutex);
+    m_flatCallback = std::move(callback);
+}
+
+void KillSwitch::watchSignals() {
+    utils::ThreadUtils::onThreadStart("order_entry", "kill-switch");
+    while (m_watching) {
+        if (sem_wait(&m_signalSem) != 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (!m_watching) {
+            break;
+        }
+        trigger("signal");
+    }
+}
+
+void KillSwitch::onCancelResponse(const nlohmann::json& response) {
+    auto elapsed = std::chrono::nanoseconds(steadyNowNs() - m_triggeredAtNs.load());
+    bool success = !response.contains("error");
+    m_timeToFlatNs = elapsed.count();
+
+    auto& logger = Logger::getInstance();
+    if (success) {
+        logger.warning("Kill switch flat after ", elapsed.count() / 1000, " us, cancelled ",
+                       response.value("result", nlohmann::json()).dump(), " orders");
+    } else {
+        logger.error("Kill switch cancel_all failed after ", elapsed.count() / 1000, " us: ",
+                     response["error"].dump());
+    }
+
+    FlatCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_callbackMutex);
+        callback = m_flatCallback;
+    }
+    if (callback) {
+        callback(success, elapsed);
+    }
+}
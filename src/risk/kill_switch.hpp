@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <semaphore.h>
+#include "api/websocket.hpp"
+#include "order/order_manager.hpp"
+#include "risk/pre_trade_risk.hpp"
+
+// Local kill switch. Triggering halts every registered risk gate, which
+// blocks new orders and edits, drops the edits queued behind in-flight
+// ones in every registered order manager, and sends a private/cancel_all frame that
+// was serialized in advance over the already open connection. It latches
+// until reset().
+class KillSwitch {
+public:
+    using FlatCallback = std::function<void(bool success, std::chrono::nanoseconds elapsed)>;
+
+    explicit KillSwitch(DeribitWebSocket& webSocket);
+    ~KillSwitch();
+
+    KillSwitch(const KillSwitch&) = delete;
+    KillSwitch& operator=(const KillSwitch&) = delete;
+
+    void addRiskGate(std::shared_ptr<PreTradeRiskGate> gate);
+    void addOrderManager(OrderManager& orders);
+
+    // Preformats the cancel request, call once at startup
+    void arm();
+
+    // Returns false if the switch had already been triggered
+    bool trigger(const char* reason);
+
+    // Async-signal-safe, only posts a semaphore; a watcher thread triggers
+    void triggerFromSignal();
+
+    bool isTriggered() const { return m_triggered.load(std::memory_order_relaxed); }
+
+    // Resumes the gates and re-arms
+    void reset();
+
+    // Trigger to cancel_all acknowledgement, -1 until it arrives
+    int64_t getTimeToFlatNs() const { return m_timeToFlatNs.load(); }
+    void setFlatCallback(FlatCallback callback);
+
+private:
+    void watchSignals();
+    void onCancelResponse(const nlohmann::json& response);
+
+    DeribitWebSocket& m_webSocket;
+    std::vector<std::shared_ptr<PreTradeRiskGate>> m_gates;
+    std::vector<OrderManager*> m_orderManagers;
+
+    // Prepared by arm()
+    int64_t m_cancelId;
+    std::string m_cancelPayload;
+
+    std::atomic<bool> m_triggered;
+    std::atomic<int64_t> m_triggeredAtNs;
+    std::atomic<int64_t> m_timeToFlatNs;
+    FlatCallback m_flatCallback;
+    std::mutex m_callbackMutex;
+
+    // Signal watcher
+    sem_t m_signalSem;
+    std::atomic<bool> m_watching;
+    std::thread m_watcher;
+};
@@ -0,0 +1,210 @@
+#include "risk/position_engine.hpp"
+#include "utils/logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+PositionEngine::PositionEngine(double sizeTolerance)
+    : m_sizeTolerance(sizeTolerance)
+    , m_adoptExchangeState(true) {
+}
+
+void PositionEngine::registerInstrument(const std::string& instrument, bool inverse) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_states[instrument].inverse = inverse;
+}
+
+void PositionEngine::onFill(const std::string& instrument, OrderSide side, double price, double amount) {
+    if (amount <= 0.0 || price <= 0.0) {
+        return;
+    }
+
+    deribit::Position snapshot;
+    deribit::PositionCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        State& state = stateFor(instrument);
+        applyFill(state, side == OrderSide::BUY ? amount : -amount, price);
+        updateUnrealized(state);
+        state.timestamp = std::chrono::system_clock::now();
+
+        callback = m_positionCallback;
+        if (callback) {
+            snapshot = toPosition(instrument, state);
+        }
+    }
+    if (callback) {
+        callback(snapshot);
+    }
+}
+
+void PositionEngine::onMark(const std::string& instrument, double markPrice) {
+    if (markPrice <= 0.0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_states.find(instrument);
+    if (it == m_states.end()) {
+        return;
+    }
+    it->second.markPrice = markPrice;
+    updateUnrealized(it->second);
+}
+
+size_t PositionEngine::reconcile(const nlohmann::json& response) {
+    const nlohmann::json& positions = response.contains("result") ? response["result"] : response;
+    if (!positions.is_array()) {
+        return 0;
+    }
+
+    auto& logger = Logger::getInstance();
+    std::vector<std::tuple<std::string, double, double>> divergences;
+    DivergenceCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        callback = m_divergenceCallback;
+        for (const auto& position : positions) {
+            std::string instrument = position.value("instrument_name", std::string());
+            if (instrument.empty()) {
+                continue;
+            }
+
+            double exchangeSize = position.value("size", 0.0);
+            State& state = stateFor(instrument);
+            if (std::fabs(state.size - exchangeSize) <= m_sizeTolerance) {
+                continue;
+            }
+
+            divergences.emplace_back(instrument, state.size, exchangeSize);
+            if (m_adoptExchangeState) {
+                state.size = exchangeSize;
+                state.entryPrice = position.value("average_price", state.entryPrice);
+                state.markPrice = position.value("mark_price", state.markPrice);
+                updateUnrealized(state);
+            }
+        }
+    }
+
+    for (const auto& [instrument, localSize, exchangeSize] : divergences) {
+        logger.warning("Position divergence for ", instrument, ": local ", localSize,
+                       ", exchange ", exchangeSize);
+        if (callback) {
+            callback(instrument, localSize, exchangeSize);
+        }
+    }
+    return divergences.size();
+}
+
+deribit::Position PositionEngine::getPosition(const std::string& instrument) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_states.find(instrument);
+    if (it == m_states.end()) {
+        return toPosition(instrument, State());
+    }
+    return toPosition(instrument, it->second);
+}
+
+std::vector<deribit::Position> PositionEngine::getPositions() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<deribit::Position> positions;
+    positions.reserve(m_states.size());
+    for (const auto& [instrument, state] : m_states) {
+        positions.push_back(toPosition(instrument, state));
+    }
+    return positions;
+}
+
+void PositionEngine::setPositionCallback(deribit::PositionCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_positionCallback = std::move(callback);
+}
+
+void PositionEngine::setDivergenceCallback(DivergenceCallback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_divergenceCallback = std::move(callback);
+}
+
+bool PositionEngine::isInverseInstrument(const std::string& instrument) {
+    // USDC-margined instruments carry the settlement currency in the name
+    if (instrument.find("_USDC") != std::string::npos || instrument.find("_USDT") != std::string::npos ||
+        (instrument.compare(0, 4, "BTC-") != 0 && instrument.compare(0, 4, "ETH-") != 0)) {
+        return false;
+    }
+    // Options (BTC-27DEC24-60000-C) are quoted in the coin and their PnL
+    // is linear in the premium; only perpetuals and futures are inverse
+    size_t last = instrument.rfind('-');
+    bool option = std::count(instrument.begin(), instrument.end(), '-') >= 3 &&
+                  (instrument.compare(last, std::string::npos, "-C") == 0 ||
+                   instrument.compare(last, std::string::npos, "-P") == 0);
+    return !option;
+}
+
+PositionEngine::State& PositionEngine::stateFor(const std::string& instrument) {
+    auto it = m_states.find(instrument);
+    if (it != m_states.end()) {
+        return it->second;
+    }
+    State& state = m_states[instrument];
+    state.inverse = isInverseInstrument(instrument);
+    return state;
+}
+
+void PositionEngine::applyFill(State& state, double signedAmount, double price) {
+    const double size = state.size;
+
+    // Opening or adding: blend the entry price
+    if (size == 0.0 || (size > 0.0) == (signedAmount > 0.0)) {
+        double total = std::fabs(size) + std::fabs(signedAmount);
+        if (state.inverse) {
+            // Inverse contracts average in 1/price
+            double weighted = (size == 0.0 ? 0.0 : std::fabs(size) / state.entryPrice) +
+                              std::fabs(signedAmount) / price;
+            state.entryPrice = total / weighted;
+        } else {
+            state.entryPrice = (std::fabs(size) * state.entryPrice + std::fabs(signedAmount) * price) / total;
+        }
+        state.size = size + signedAmount;
+        return;
+    }
+
+    // Reducing, closing or flipping: realize PnL on the closed part
+    double closed = std::min(std::fabs(signedAmount), std::fabs(size));
+    double closedSigned = size > 0.0 ? closed : -closed;
+    state.realizedPnl += pnl(state, closedSigned, state.entryPrice, price);
+
+    state.size = size + signedAmount;
+    if (std::fabs(state.size) <= m_sizeTolerance) {
+        state.size = 0.0;
+        state.entryPrice = 0.0;
+    } else if ((state.size > 0.0) != (size > 0.0)) {
+        state.entryPrice = price;   // Flipped, the remainder opened at this fill
+    }
+}
+
+void PositionEngine::updateUnrealized(State& state) {
+    if (state.size == 0.0 || state.markPrice <= 0.0) {
+        state.unrealizedPnl = 0.0;
+        return;
+    }
+    state.unrealizedPnl = pnl(state, state.size, state.entryPrice, state.markPrice);
+}
+
+double PositionEngine::pnl(const State& state, double size, double fromPrice, double toPrice) const {
+    if (state.inverse) {
+        return size * (1.0 / fromPrice - 1.0 / toPrice);
+    }
+    return size * (toPrice - fromPrice);
+}
+
+deribit::Position PositionEngine::toPosition(const std::string& instrument, const State& state) {
+    deribit::Position position;
+    position.instrument = instrument;
+    position.size = state.size;
+    position.entryPrice = state.entryPrice;
+    position.liquidationPrice = 0.0;
+    position.unrealizedPnl = state.unrealizedPnl;
+    position.realizedPnl = state.realizedPnl;
+    position.timestamp = state.timestamp;
+    return position;
+}
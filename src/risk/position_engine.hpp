@@ -0,0 +1,69 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "order/order.hpp"
+#include "types.hpp"
+
+// Event-driven positions. Fills move size, average entry and realized PnL;
+// marks move unrealized PnL. Each update is O(1) for one instrument.
+// Inverse instruments (BTC/ETH futures and perpetuals) are sized in USD and
+// settle PnL in the coin; linear instruments use size * price difference.
+class PositionEngine {
+public:
+    using DivergenceCallback = std::function<void(const std::string& instrument,
+                                                  double localSize,
+                                                  double exchangeSize)>;
+
+    explicit PositionEngine(double sizeTolerance = 1e-8);
+
+    void registerInstrument(const std::string& instrument, bool inverse);
+
+    // Event inputs
+    void onFill(const std::string& instrument, OrderSide side, double price, double amount);
+    void onMark(const std::string& instrument, double markPrice);
+
+    // Compares against a private/get_positions response, returns the number
+    // of instruments whose size diverged
+    size_t reconcile(const nlohmann::json& response);
+
+    // When set, a divergent instrument takes the exchange's size and entry
+    void setAdoptExchangeState(bool adopt) { m_adoptExchangeState = adopt; }
+
+    deribit::Position getPosition(const std::string& instrument) const;
+    std::vector<deribit::Position> getPositions() const;
+
+    void setPositionCallback(deribit::PositionCallback callback);
+    void setDivergenceCallback(DivergenceCallback callback);
+
+    static bool isInverseInstrument(const std::string& instrument);
+
+private:
+    struct State {
+        bool inverse = false;
+        double size = 0.0;          // Signed
+        double entryPrice = 0.0;
+        double markPrice = 0.0;
+        double realizedPnl = 0.0;
+        double unrealizedPnl = 0.0;
+        std::chrono::system_clock::time_point timestamp;
+    };
+
+    State& stateFor(const std::string& instrument);
+    void applyFill(State& state, double signedAmount, double price);
+    void updateUnrealized(State& state);
+    double pnl(const State& state, double size, double fromPrice, double toPrice) const;
+    static deribit::Position toPosition(const std::string& instrument, const State& state);
+
+    std::unordered_map<std::string, State> m_states;
+    mutable std::mutex m_mutex;
+    double m_sizeTolerance;
+    bool m_adoptExchangeState;
+
+    deribit::PositionCallback m_positionCallback;
+    DivergenceCallback m_divergenceCallback;
+};
@@ -0,0 +1,96 @@
+#include "risk/pre_trade_risk.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    // Non-positive config values disable a limit
+    double limitOrInfinity(double value) {
+        return value > 0.0 ? value : INFINITY;
+    }
+}
+
+RiskLimits RiskLimits::fromConfig(const deribit::Config& config) {
+    RiskLimits limits;
+    limits.minOrderSize = std::max(0.0, config.getMinOrderSize());
+    limits.maxOrderSize = limitOrInfinity(config.getMaxOrderSize());
+    limits.maxNotional = limitOrInfinity(config.getMaxNotional());
+    limits.priceBand = limitOrInfinity(config.getPriceBand());
+    limits.maxPosition = limitOrInfinity(config.getMaxPosition());
+    limits.maxOpenOrders = config.getMaxOpenOrders() > 0 ? config.getMaxOpenOrders() : INT64_MAX;
+    limits.maxMessagesPerSecond =
+        config.getMaxMessagesPerSecond() > 0 ? config.getMaxMessagesPerSecond() : INT64_MAX;
+    return limits;
+}
+
+PreTradeRiskGate::PreTradeRiskGate(const RiskLimits& limits, size_t maxInstruments)
+    : m_limits(limits)
+    , m_instruments(new InstrumentState[maxInstruments])
+    , m_maxInstruments(maxInstruments)
+    , m_instrumentCount(0)
+    , m_windowStartNs(0)
+    , m_windowMessages(0)
+    , m_openOrders(0)
+    , m_halted(false) {
+    for (auto& counter : m_counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint32_t PreTradeRiskGate::registerInstrument(const std::string& instrument, bool inverse) {
+    auto it = m_instrumentIds.find(instrument);
+    if (it != m_instrumentIds.end()) {
+        return it->second;
+    }
+    if (m_instrumentCount >= m_maxInstruments) {
+        throw std::runtime_error("Too many instruments registered with risk gate");
+    }
+    uint32_t id = m_instrumentCount++;
+    m_instruments[id].inverse = inverse;
+    m_instrumentIds.emplace(instrument, id);
+    return id;
+}
+
+uint32_t PreTradeRiskGate::getInstrumentId(const std::string& instrument) const {
+    auto it = m_instrumentIds.find(instrument);
+    return (it != m_instrumentIds.end()) ? it->second : kUnknownInstrument;
+}
+
+void PreTradeRiskGate::updateReferencePrice(uint32_t instrumentId, double mid) {
+    if (instrumentId < m_instrumentCount) {
+        m_instruments[instrumentId].referencePrice.store(mid, std::memory_order_relaxed);
+    }
+}
+
+void PreTradeRiskGate::updatePosition(uint32_t instrumentId, double position) {
+    if (instrumentId < m_instrumentCount) {
+        m_instruments[instrumentId].position.store(position, std::memory_order_relaxed);
+    }
+}
+
+void PreTradeRiskGate::onFill(uint32_t instrumentId, OrderSide side, double amount) {
+    if (instrumentId >= m_instrumentCount) {
+        return;
+    }
+    auto& position = m_instruments[instrumentId].position;
+    double delta = side == OrderSide::BUY ? amount : -amount;
+    double current = position.load(std::memory_order_relaxed);
+    while (!position.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {
+    }
+}
+
+const char* PreTradeRiskGate::resultToString(RiskCheckResult result) {
+    switch (result) {
+        case RiskCheckResult::PASSED:               return "passed";
+        case RiskCheckResult::UNKNOWN_INSTRUMENT:   return "unknown_instrument";
+        case RiskCheckResult::SIZE_TOO_SMALL:       return "size_too_small";
+        case RiskCheckResult::SIZE_TOO_LARGE:       return "size_too_large";
+        case RiskCheckResult::NOTIONAL_TOO_LARGE:   return "notional_too_large";
+        case RiskCheckResult::NO_REFERENCE_PRICE:   return "no_reference_price";
+        case RiskCheckResult::PRICE_OUTSIDE_BAND:   return "price_outside_band";
+        case RiskCheckResult::TOO_MANY_OPEN_ORDERS: return "too_many_open_orders";
+        case RiskCheckResult::POSITION_LIMIT:       return "position_limit";
+        case RiskCheckResult::MESSAGE_RATE:         return "message_rate";
+        case RiskCheckResult::HALTED:               return "halted";
+        default:                                    return "unknown";
+    }
+}
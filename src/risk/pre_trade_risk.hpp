@@ -0,0 +1,178 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "order/order.hpp"
+#include "utils/config.hpp"
+#include "utils/tsc_clock.hpp"
+
+enum class RiskCheckResult : uint8_t {
+    PASSED,
+    UNKNOWN_INSTRUMENT,
+    SIZE_TOO_SMALL,
+    SIZE_TOO_LARGE,
+    NOTIONAL_TOO_LARGE,
+    NO_REFERENCE_PRICE,
+    PRICE_OUTSIDE_BAND,
+    TOO_MANY_OPEN_ORDERS,
+    POSITION_LIMIT,
+    MESSAGE_RATE,
+    HALTED
+};
+
+constexpr size_t kRiskCheckResultCount = 11;
+
+// Limits compiled once from Config. Disabled limits are stored as infinity
+// so every check is a plain comparison with no lookups or branches on flags.
+struct RiskLimits {
+    double minOrderSize = 0.0;
+    double maxOrderSize = INFINITY;
+    double maxNotional = INFINITY;
+    double priceBand = INFINITY;        // Max |price - mid| / mid
+    double maxPosition = INFINITY;      // Max |position| after the order
+    int64_t maxOpenOrders = INT64_MAX;
+    int64_t maxMessagesPerSecond = INT64_MAX;
+
+    static RiskLimits fromConfig(const deribit::Config& config);
+};
+
+struct RiskOrder {
+    uint32_t instrumentId;
+    OrderSide side;
+    double price;                   // Ignored for market orders
+    double amount;                  // USD for inverse instruments
+    OrderType type = OrderType::LIMIT;
+};
+
+// Pre-trade checks between strategy and order entry. check() may run on
+// several threads at once; everything it reads or counts (mids,
+// positions, open orders, the message window) is a relaxed atomic.
+class PreTradeRiskGate {
+public:
+    explicit PreTradeRiskGate(const RiskLimits& limits, size_t maxInstruments = 1024);
+
+    // Instrument IDs are assigned once at startup. Amounts of inverse
+    // instruments are already USD notionals.
+    uint32_t registerInstrument(const std::string& instrument, bool inverse = false);
+    uint32_t getInstrumentId(const std::string& instrument) const;
+    static constexpr uint32_t kUnknownInstrument = UINT32_MAX;
+
+    // Hot path
+    RiskCheckResult check(const RiskOrder& order, int64_t nowNs) {
+        if (m_halted.load(std::memory_order_relaxed)) {
+            return reject(RiskCheckResult::HALTED);
+        }
+        if (order.instrumentId >= m_instrumentCount) {
+            return reject(RiskCheckResult::UNKNOWN_INSTRUMENT);
+        }
+        if (order.amount < m_limits.minOrderSize) {
+            return reject(RiskCheckResult::SIZE_TOO_SMALL);
+        }
+        if (order.amount > m_limits.maxOrderSize) {
+            return reject(RiskCheckResult::SIZE_TOO_LARGE);
+        }
+
+        // Market orders carry no price: they are valued at the mid and skip
+        // the band
+        const InstrumentState& state = m_instruments[order.instrumentId];
+        const bool market = order.type == OrderType::MARKET || order.type == OrderType::STOP_MARKET;
+        double mid = state.referencePrice.load(std::memory_order_relaxed);
+        if (!state.inverse) {
+            double price = market ? mid : order.price;
+            if (market && m_limits.maxNotional != INFINITY && mid <= 0.0) {
+                return reject(RiskCheckResult::NO_REFERENCE_PRICE);
+            }
+            if (price * order.amount > m_limits.maxNotional) {
+                return reject(RiskCheckResult::NOTIONAL_TOO_LARGE);
+            }
+        } else if (order.amount > m_limits.maxNotional) {
+            return reject(RiskCheckResult::NOTIONAL_TOO_LARGE);
+        }
+
+        if (m_limits.priceBand != INFINITY && !market) {
+            if (mid <= 0.0) {
+                return reject(RiskCheckResult::NO_REFERENCE_PRICE);
+            }
+            if (std::fabs(order.price - mid) > m_limits.priceBand * mid) {
+                return reject(RiskCheckResult::PRICE_OUTSIDE_BAND);
+            }
+        }
+
+        if (m_openOrders.load(std::memory_order_relaxed) >= m_limits.maxOpenOrders) {
+            return reject(RiskCheckResult::TOO_MANY_OPEN_ORDERS);
+        }
+
+        double signedAmount = order.side == OrderSide::BUY ? order.amount : -order.amount;
+        if (std::fabs(state.position.load(std::memory_order_relaxed) + signedAmount) > m_limits.maxPosition) {
+            return reject(RiskCheckResult::POSITION_LIMIT);
+        }
+
+        // Fixed one-second window. The thread that moves the window resets
+        // the count; a slot is only taken while the window has room.
+        int64_t windowStart = m_windowStartNs.load(std::memory_order_relaxed);
+        if (nowNs - windowStart >= 1000000000LL &&
+            m_windowStartNs.compare_exchange_strong(windowStart, nowNs, std::memory_order_relaxed)) {
+            m_windowMessages.store(0, std::memory_order_relaxed);
+        }
+        int64_t messages = m_windowMessages.load(std::memory_order_relaxed);
+        do {
+            if (messages >= m_limits.maxMessagesPerSecond) {
+                return reject(RiskCheckResult::MESSAGE_RATE);
+            }
+        } while (!m_windowMessages.compare_exchange_weak(messages, messages + 1, std::memory_order_relaxed));
+
+        return count(RiskCheckResult::PASSED);
+    }
+
+    RiskCheckResult check(const RiskOrder& order) {
+        return check(order, utils::TscClock::nowNs());
+    }
+
+    // State published from market data and order handling
+    void updateReferencePrice(uint32_t instrumentId, double mid);
+    void updatePosition(uint32_t instrumentId, double position);
+    void onFill(uint32_t instrumentId, OrderSide side, double amount);
+    void onOrderOpened() { m_openOrders.fetch_add(1, std::memory_order_relaxed); }
+    void onOrderClosed() { m_openOrders.fetch_sub(1, std::memory_order_relaxed); }
+
+    // Kill switch, blocks all new orders and edits until resumed
+    void halt() { m_halted.store(true, std::memory_order_relaxed); }
+    void resume() { m_halted.store(false, std::memory_order_relaxed); }
+    bool isHalted() const { return m_halted.load(std::memory_order_relaxed); }
+
+    const RiskLimits& getLimits() const { return m_limits; }
+    uint64_t getCount(RiskCheckResult result) const {
+        return m_counters[static_cast<size_t>(result)].load(std::memory_order_relaxed);
+    }
+    static const char* resultToString(RiskCheckResult result);
+
+private:
+    struct alignas(64) InstrumentState {
+        std::atomic<double> referencePrice{0.0};
+        std::atomic<double> position{0.0};
+        bool inverse = false;           // Set at registration only
+    };
+
+    RiskCheckResult count(RiskCheckResult result) {
+        m_counters[static_cast<size_t>(result)].fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+    RiskCheckResult reject(RiskCheckResult result) { return count(result); }
+
+    const RiskLimits m_limits;
+    std::unique_ptr<InstrumentState[]> m_instruments;
+    const size_t m_maxInstruments;
+    uint32_t m_instrumentCount;
+    std::unordered_map<std::string, uint32_t> m_instrumentIds;
+
+    alignas(64) std::atomic<int64_t> m_windowStartNs;
+    std::atomic<int64_t> m_windowMessages;
+    alignas(64) std::atomic<uint64_t> m_counters[kRiskCheckResultCount];
+
+    alignas(64) std::atomic<int64_t> m_openOrders;
+    alignas(64) std::atomic<bool> m_halted;
+};
@@ -0,0 +1,647 @@
+#include "runtime/runtime.hpp"
+#include "api/websocket.hpp"
+#include "metrics/latency_metrics.hpp"
+#include "utils/logger.hpp"
+#include "utils/utils.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Idle wait of a blocking feed shard, a missed wake-up costs at most this
+    constexpr auto kShardIdleWait = std::chrono::milliseconds(1);
+    // Idle sleep of a non-busy I/O thread polling several connections
+    constexpr auto kIoIdleSleep = std::chrono::microseconds(50);
+    // Records taken from one ring before moving to the next
+    constexpr size_t kDrainBatch = 64;
+
+    const char* kRoleNames[kThreadRoleCount] = {
+        "io", "feed", "strategy", "order_entry", "logging", "housekeeping"
+    };
+
+    // Producer ring index of the calling thread, -1 when it is not one of
+    // this runtime's I/O threads
+    thread_local const Runtime* t_runtime = nullptr;
+    thread_local int t_producer = -1;
+
+    // Ahead of every frame in a shard ring; oversized frames travel on
+    // the heap and only the header goes through the ring
+    struct FeedRecordHeader {
+        int64_t receivedNs;
+        std::string* oversized;
+    };
+
+    inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    int currentTid() {
+#ifdef __linux__
+        return static_cast<int>(::syscall(SYS_gettid));
+#else
+        return 0;
+#endif
+    }
+
+    // CPU the thread last ran on, field 39 of /proc/<pid>/task/<tid>/stat
+    int lastCpuOf(int tid) {
+#ifdef __linux__
+        std::ifstream stat("/proc/self/task/" + std::to_string(tid) + "/stat");
+        std::string line;
+        if (!std::getline(stat, line)) {
+            return -1;
+        }
+        size_t end = line.rfind(')');
+        if (end == std::string::npos) {
+            return -1;
+        }
+        std::istringstream fields(line.substr(end + 2));
+        std::string field;
+        for (int i = 3; i <= 39 && fields >> field; ++i) {
+            if (i == 39) {
+                return std::stoi(field);
+            }
+        }
+#endif
+        (void)tid;
+        return -1;
+    }
+
+    std::string readIsolatedCpus() {
+        std::ifstream isolated("/sys/devices/system/cpu/isolated");
+        std::string line;
+        std::getline(isolated, line);
+        return utils::trim(line);
+    }
+
+    // 0,1,2,5 -> "0-2,5"
+    std::string formatCpus(const std::vector<int>& cpus) {
+        std::string out;
+        for (size_t i = 0; i < cpus.size();) {
+            size_t j = i;
+            while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+                ++j;
+            }
+            if (!out.empty()) out += ',';
+            out += std::to_string(cpus[i]);
+            if (j > i) out += '-' + std::to_string(cpus[j]);
+            i = j + 1;
+        }
+        return out.empty() ? "-" : out;
+    }
+
+    uint64_t fnv1a(std::string_view text) {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : text) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+const char* threadRoleName(ThreadRole role) {
+    return kRoleNames[static_cast<size_t>(role)];
+}
+
+bool parseThreadRole(const std::string& name, ThreadRole& role) {
+    for (size_t i = 0; i < kThreadRoleCount; ++i) {
+        if (name == kRoleNames[i]) {
+            role = static_cast<ThreadRole>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+RuntimeConfig RuntimeConfig::fromConfig(const deribit::Config& config) {
+    RuntimeConfig runtime;
+    runtime.ioThreads = std::max(1, config.getWebSocketThreads());
+    runtime.feedShards = std::max(0, config.getProcessingThreads());
+    for (size_t i = 0; i < kThreadRoleCount; ++i) {
+        runtime.cpus[i] = parseCpuList(config.getString(std::string("cpu_") + kRoleNames[i], ""));
+    }
+    runtime.schedFifo = config.getBool("sched_fifo", false);
+    runtime.fifoPriority = config.getInt("sched_fifo_priority", 50);
+    runtime.busyPollIo = config.getBool("busy_poll_io", false);
+    runtime.busyPollFeed = config.getBool("busy_poll_feed", false);
+    runtime.busyPollStrategy = config.getBool("busy_poll_strategy", false);
+    runtime.strategyInterval = std::chrono::milliseconds(std::max(1, config.getInt("strategy_interval_ms", 100)));
+    runtime.feedRingBytes = static_cast<size_t>(std::max(64, config.getInt("feed_ring_kb", 1024))) << 10;
+    return runtime;
+}
+
+std::vector<int> RuntimeConfig::parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    for (const auto& part : utils::split(list, ',')) {
+        std::string item = utils::trim(part);
+        if (item.empty()) {
+            continue;
+        }
+        try {
+            size_t dash = item.find('-');
+            int first = std::stoi(item.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            if (first < 0 || last < first) {
+                throw std::invalid_argument(item);
+            }
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            throw std::invalid_argument("Bad CPU list: " + list);
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+Runtime::Shard::Shard(size_t producers, size_t ringBytes) {
+    for (size_t i = 0; i < producers; ++i) {
+        rings.push_back(std::make_unique<utils::SpscByteRing>(ringBytes));
+    }
+}
+
+Runtime::Runtime(const RuntimeConfig& config)
+    : m_config(config)
+    , m_running(false)
+    , m_hookInstalled(false)
+    , m_nextCpu{}
+    , m_strategyPending(false)
+    , m_strategySleeping(false)
+    , m_strategyTriggerNs(0)
+    , m_handoffMetric(LatencyMetrics::getInstance().registerMetric("runtime.feed_handoff"))
+    , m_feedRingFull(0)
+    , m_feedOversized(0)
+    , m_strategyCycles(0) {
+}
+
+Runtime::~Runtime() {
+    stop();
+    if (m_hookInstalled) {
+        utils::ThreadUtils::setThreadStartHook(nullptr);
+    }
+}
+
+void Runtime::installThreadStartHook() {
+    utils::ThreadUtils::setThreadStartHook([this](const std::string& roleName, const std::string& name) {
+        ThreadRole role = ThreadRole::HOUSEKEEPING;
+        parseThreadRole(roleName, role);
+        placeCurrentThread(role, name);
+    });
+    m_hookInstalled = true;
+}
+
+bool Runtime::isLatencyCritical(ThreadRole role) {
+    return role == ThreadRole::IO || role == ThreadRole::FEED ||
+           role == ThreadRole::STRATEGY || role == ThreadRole::ORDER_ENTRY;
+}
+
+bool Runtime::busyPolls(ThreadRole role) const {
+    switch (role) {
+        case ThreadRole::IO:       return m_config.busyPollIo;
+        case ThreadRole::FEED:     return m_config.busyPollFeed && m_config.feedShards > 0;
+        case ThreadRole::STRATEGY: return m_config.busyPollStrategy;
+        default:                   return false;
+    }
+}
+
+void Runtime::placeCurrentThread(ThreadRole role, const std::string& name) {
+    utils::ThreadUtils::setThreadName(name);
+
+    ThreadPlacement placement;
+    placement.name = name.substr(0, 15);
+    placement.role = role;
+    placement.tid = currentTid();
+    placement.busyPoll = busyPolls(role);
+    {
+        std::lock_guard<std::mutex> lock(m_placementMutex);
+        const auto& cpus = m_config.cpus[static_cast<size_t>(role)];
+        if (!cpus.empty()) {
+            if (isLatencyCritical(role)) {
+                size_t& next = m_nextCpu[static_cast<size_t>(role)];
+                placement.requestedCpus = {cpus[next++ % cpus.size()]};
+            } else {
+                placement.requestedCpus = cpus;
+            }
+        }
+    }
+
+    if (!placement.requestedCpus.empty()) {
+        placement.pinned = utils::ThreadUtils::setThreadAffinity(placement.requestedCpus);
+    }
+    if (m_config.schedFifo && isLatencyCritical(role)) {
+        utils::ThreadUtils::setThreadPriority(m_config.fifoPriority);
+    }
+
+    // Record what the OS granted, not what was asked for
+    placement.allowedCpus = utils::ThreadUtils::getThreadAffinity();
+#ifdef __linux__
+    int policy = SCHED_OTHER;
+    sched_param param{};
+    if (pthread_getschedparam(pthread_self(), &policy, &param) == 0) {
+        placement.fifo = policy == SCHED_FIFO;
+        placement.priority = param.sched_priority;
+    }
+#endif
+
+    std::lock_guard<std::mutex> lock(m_placementMutex);
+    m_placements.push_back(std::move(placement));
+}
+
+void Runtime::addConnection(DeribitWebSocket& socket) {
+    if (m_running) {
+        throw std::logic_error("Runtime already started");
+    }
+    socket.setExternalLoop(true);
+    m_connections.push_back(&socket);
+}
+
+void Runtime::setFeedHandler(FeedHandler handler) {
+    if (m_running) {
+        throw std::logic_error("Runtime already started");
+    }
+    m_feedHandler = std::move(handler);
+}
+
+void Runtime::start() {
+    if (m_running.exchange(true)) {
+        return;
+    }
+
+    // Connections are dealt round-robin, an I/O thread with several polls
+    // them in turn
+    size_t ioThreads = std::min(static_cast<size_t>(m_config.ioThreads), m_connections.size());
+    std::vector<std::vector<DeribitWebSocket*>> sockets(ioThreads);
+    for (size_t i = 0; i < m_connections.size(); ++i) {
+        sockets[i % ioThreads].push_back(m_connections[i]);
+    }
+
+    // One ring per I/O thread plus one shared by everybody else
+    if (m_feedHandler) {
+        for (int i = 0; i < m_config.feedShards; ++i) {
+            m_shards.push_back(std::make_unique<Shard>(ioThreads + 1, m_config.feedRingBytes));
+        }
+    }
+    for (size_t i = 0; i < m_shards.size(); ++i) {
+        m_threads.emplace_back([this, i] { shardLoop(i); });
+    }
+    for (size_t i = 0; i < ioThreads; ++i) {
+        m_threads.emplace_back([this, i, list = sockets[i]] { ioLoop(i, list); });
+    }
+
+    Logger::getInstance().info("Runtime started: ", ioThreads, " I/O threads for ", m_connections.size(),
+                               " connections, ", m_shards.size(), " feed shards");
+}
+
+void Runtime::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    for (auto* socket : m_connections) {
+        socket->stopLoop();
+    }
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->wake.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_strategyMutex);
+        m_strategyWake.notify_all();
+    }
+    for (auto& thread : m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    m_threads.clear();
+}
+
+void Runtime::ioLoop(size_t index, std::vector<DeribitWebSocket*> sockets) {
+    placeCurrentThread(ThreadRole::IO, "io-" + std::to_string(index));
+    t_runtime = this;
+    t_producer = static_cast<int>(index);
+
+    bool busy = m_config.busyPollIo;
+    try {
+        if (sockets.size() == 1 && !busy) {
+            sockets.front()->run();     // Until stopLoop()
+        } else {
+            while (m_running) {
+                size_t handled = 0;
+                for (auto* socket : sockets) {
+                    handled += socket->poll();
+                }
+                if (handled == 0) {
+                    if (busy) {
+                        cpuRelax();
+                    } else {
+                        std::this_thread::sleep_for(kIoIdleSleep);
+                    }
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        Logger::getInstance().error("I/O thread ", index, " stopped: ", e.what());
+    }
+    t_runtime = nullptr;
+    t_producer = -1;
+}
+
+size_t Runtime::shardFor(const std::string& payload) const {
+    // Instrument from "<type>.<instrument>.<interval>" or "<instrument>.<type>";
+    // private user.* channels all go to shard 0
+    static constexpr std::string_view kKey = "\"channel\":\"";
+    size_t start = payload.find(kKey.data(), 0, kKey.size());
+    if (start == std::string::npos) {
+        return 0;
+    }
+    start += kKey.size();
+    size_t end = payload.find('"', start);
+    if (end == std::string::npos) {
+        return 0;
+    }
+    std::string_view channel(payload.data() + start, end - start);
+    if (channel.compare(0, 5, "user.") == 0) {
+        return 0;
+    }
+    size_t dot = channel.find('.');
+    std::string_view instrument = channel.substr(0, dot);
+    if (dot != std::string_view::npos &&
+        (instrument == "book" || instrument == "trades" || instrument == "ticker")) {
+        std::string_view rest = channel.substr(dot + 1);
+        instrument = rest.substr(0, rest.find('.'));
+    }
+    return static_cast<size_t>(fnv1a(instrument) % m_shards.size());
+}
+
+void Runtime::dispatchFeed(const std::string& payload) {
+    if (m_shards.empty()) {
+        if (m_feedHandler) {
+            m_feedHandler(payload);
+        }
+        return;
+    }
+
+    Shard& shard = *m_shards[shardFor(payload)];
+    bool external = t_runtime != this || t_producer < 0;
+    std::unique_lock<std::mutex> externalLock(m_externalProducerMutex, std::defer_lock);
+    if (external) {
+        externalLock.lock();
+    }
+    utils::SpscByteRing& ring = external ? *shard.rings.back() : *shard.rings[t_producer];
+
+    FeedRecordHeader header{pipeline::now(), nullptr};
+    size_t length = sizeof(header) + payload.size();
+    if (length > ring.maxRecordSize()) {
+        header.oversized = new std::string(payload);
+        length = sizeof(header);
+        m_feedOversized.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A full ring holds up this connection rather than dropping book updates
+    char* record = ring.beginWrite(length);
+    if (!record) {
+        m_feedRingFull.fetch_add(1, std::memory_order_relaxed);
+        while (!(record = ring.beginWrite(length))) {
+            if (!m_running) {
+                delete header.oversized;
+                return;
+            }
+            cpuRelax();
+        }
+    }
+    std::memcpy(record, &header, sizeof(header));
+    if (!header.oversized) {
+        std::memcpy(record + sizeof(header), payload.data(), payload.size());
+    }
+    ring.commitWrite();
+
+    if (!m_config.busyPollFeed) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (shard.sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.wake.notify_one();
+        }
+    }
+}
+
+size_t Runtime::drainShard(Shard& shard) {
+    thread_local std::string payload;
+    auto& metrics = LatencyMetrics::getInstance();
+    size_t handled = 0;
+
+    for (auto& ring : shard.rings) {
+        for (size_t i = 0; i < kDrainBatch; ++i) {
+            size_t length = 0;
+            const char* record = ring->beginRead(length);
+            if (!record) {
+                break;
+            }
+            FeedRecordHeader header;
+            std::memcpy(&header, record, sizeof(header));
+            std::unique_ptr<std::string> oversized(header.oversized);
+            if (!oversized) {
+                payload.assign(record + sizeof(header), length - sizeof(header));
+            }
+            ring->commitRead();
+
+            metrics.record(m_handoffMetric, static_cast<uint64_t>(pipeline::now() - header.receivedNs));
+            pipeline::frameReceived(header.receivedNs);
+            try {
+                m_feedHandler(oversized ? *oversized : payload);
+            } catch (const std::exception& e) {
+                Logger::getInstance().error("Feed handler failed: ", e.what());
+            }
+            pipeline::frameDone();
+            ++handled;
+        }
+    }
+    if (handled) {
+        shard.frames.fetch_add(handled, std::memory_order_relaxed);
+    }
+    return handled;
+}
+
+void Runtime::shardLoop(size_t index) {
+    placeCurrentThread(ThreadRole::FEED, "feed-" + std::to_string(index));
+    Shard& shard = *m_shards[index];
+    bool busy = m_config.busyPollFeed;
+
+    while (m_running) {
+        if (drainShard(shard)) {
+            continue;
+        }
+        if (busy) {
+            cpuRelax();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool empty = std::all_of(shard.rings.begin(), shard.rings.end(),
+                                 [](const auto& ring) { return ring->usedBytes() == 0; });
+        if (empty && m_running) {
+            shard.wake.wait_for(lock, kShardIdleWait);
+        }
+        shard.sleeping.store(false, std::memory_order_relaxed);
+    }
+    drainShard(shard);
+}
+
+void Runtime::runStrategy(const std::atomic<bool>& running, const std::function<void()>& cycle) {
+    bool busy = m_config.busyPollStrategy;
+    while (running && m_running) {
+        m_strategyPending.store(false, std::memory_order_relaxed);
+        int64_t triggerNs = m_strategyTriggerNs.exchange(0, std::memory_order_relaxed);
+        if (triggerNs != 0) {
+            pipeline::frameReceived(triggerNs);
+        }
+        cycle();
+        if (triggerNs != 0) {
+            pipeline::frameDone();
+        }
+        m_strategyCycles.fetch_add(1, std::memory_order_relaxed);
+
+        auto deadline = std::chrono::steady_clock::now() + m_config.strategyInterval;
+        if (busy) {
+            while (running && !m_strategyPending.load(std::memory_order_acquire) &&
+                   std::chrono::steady_clock::now() < deadline) {
+                cpuRelax();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_strategyMutex);
+        m_strategySleeping.store(true);
+        m_strategyWake.wait_until(lock, deadline, [&] {
+            return !running || !m_running || m_strategyPending.load();
+        });
+        m_strategySleeping.store(false);
+    }
+}
+
+void Runtime::wakeStrategy() {
+    int64_t receivedNs = pipeline::currentFrameNs();
+    if (receivedNs != 0) {
+        int64_t none = 0;
+        m_strategyTriggerNs.compare_exchange_strong(none, receivedNs, std::memory_order_relaxed);
+    }
+    if (m_strategyPending.exchange(true)) {
+        return;
+    }
+    if (m_strategySleeping.load()) {
+        std::lock_guard<std::mutex> lock(m_strategyMutex);
+        m_strategyWake.notify_one();
+    }
+}
+
+std::vector<ThreadPlacement> Runtime::getPlacements() const {
+    std::lock_guard<std::mutex> lock(m_placementMutex);
+    return m_placements;
+}
+
+RuntimeStats Runtime::getStats() const {
+    RuntimeStats stats;
+    for (const auto& shard : m_shards) {
+        stats.feedFrames += shard->frames.load(std::memory_order_relaxed);
+    }
+    stats.feedRingFull = m_feedRingFull.load(std::memory_order_relaxed);
+    stats.feedOversized = m_feedOversized.load(std::memory_order_relaxed);
+    stats.strategyCycles = m_strategyCycles.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::string Runtime::placementReport() const {
+    auto placements = getPlacements();
+    std::string isolated = readIsolatedCpus();
+
+    std::ostringstream report;
+    report << "Thread placement, " << std::thread::hardware_concurrency() << " CPUs online, isolated "
+           << (isolated.empty() ? "none" : isolated) << "\n";
+    char line[160];
+    std::snprintf(line, sizeof(line), "  %-15s %-12s %7s %-10s %-10s %4s %-9s\n",
+                  "thread", "role", "tid", "requested", "allowed", "on", "policy");
+    report << line;
+
+    std::vector<std::string> warnings;
+    std::map<int, std::vector<std::string>> dedicated;     // CPU -> latency-critical threads
+    for (const auto& placement : placements) {
+        std::string policy = placement.fifo ? "fifo:" + std::to_string(placement.priority) : "other";
+        if (placement.busyPoll) {
+            policy += " busy";
+        }
+        std::snprintf(line, sizeof(line), "  %-15s %-12s %7d %-10s %-10s %4d %-9s\n",
+                      placement.name.c_str(), threadRoleName(placement.role), placement.tid,
+                      formatCpus(placement.requestedCpus).c_str(), formatCpus(placement.allowedCpus).c_str(),
+                      lastCpuOf(placement.tid), policy.c_str());
+        report << line;
+
+        bool critical = isLatencyCritical(placement.role);
+        if (!placement.requestedCpus.empty() && placement.allowedCpus != placement.requestedCpus) {
+            warnings.push_back(placement.name + " could not be pinned to " + formatCpus(placement.requestedCpus));
+        }
+        if (m_config.schedFifo && critical && !placement.fifo) {
+            warnings.push_back(placement.name + " runs SCHED_OTHER, SCHED_FIFO needs CAP_SYS_NICE or rtprio");
+        }
+        if (placement.busyPoll && placement.allowedCpus.size() != 1) {
+            warnings.push_back(placement.name + " busy-polls without a dedicated CPU");
+        }
+        if (critical && placement.allowedCpus.size() == 1) {
+            dedicated[placement.allowedCpus.front()].push_back(placement.name);
+        }
+    }
+
+    // A pinned hot thread sharing its CPU with another hot thread, or with
+    // logging and housekeeping, is back to waiting on the scheduler
+    bool strays = false;
+    for (const auto& placement : placements) {
+        if (isLatencyCritical(placement.role)) {
+            continue;
+        }
+        strays = strays || placement.requestedCpus.empty();
+        for (int cpu : placement.allowedCpus) {
+            auto it = dedicated.find(cpu);
+            if (it != dedicated.end() && !placement.requestedCpus.empty()) {
+                it->second.push_back(placement.name);
+            }
+        }
+    }
+    for (const auto& entry : dedicated) {
+        if (entry.second.size() > 1) {
+            std::string names;
+            for (const auto& name : entry.second) {
+                names += (names.empty() ? "" : ", ") + name;
+            }
+            warnings.push_back("CPU " + std::to_string(entry.first) + " is shared by " + names);
+        }
+    }
+
+    if (strays && !dedicated.empty() && isolated.empty()) {
+        warnings.push_back("unpinned threads may run on the pinned CPUs, set cpu_logging and "
+                           "cpu_housekeeping or isolate them");
+    }
+
+    for (const auto& warning : warnings) {
+        report << "  warning: " << warning << "\n";
+    }
+    std::string text = report.str();
+    if (!text.empty() && text.back() == '\n') {
+        text.pop_back();
+    }
+    return text;
+}
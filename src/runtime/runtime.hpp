@@ -0,0 +1,185 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/config.hpp"
+#include "utils/lockfree_queue.hpp"
+#include "utils/spsc_ring.hpp"
+
+class DeribitWebSocket;
+
+enum class ThreadRole : uint8_t {
+    IO,             // Websocket event loops
+    FEED,           // Market data decode and book updates, one shard each
+    STRATEGY,       // Quote cycles
+    ORDER_ENTRY,    // Rate limiter dispatch, kill switch
+    LOGGING,        // Log and capture writers
+    HOUSEKEEPING    // Metrics, auth refresh, clock calibration, ...
+};
+
+constexpr size_t kThreadRoleCount = 6;
+
+// Config and ThreadUtils::onThreadStart() spelling, e.g. "order_entry"
+const char* threadRoleName(ThreadRole role);
+bool parseThreadRole(const std::string& name, ThreadRole& role);
+
+struct RuntimeConfig {
+    int ioThreads = 2;              // Connections are dealt to these
+    int feedShards = 4;             // 0 handles frames on the I/O thread
+
+    // CPUs per role. Threads of the I/O, feed, strategy and order entry
+    // roles take one CPU each in turn; logging and housekeeping threads
+    // share the whole list. Empty leaves a role's threads unpinned.
+    std::array<std::vector<int>, kThreadRoleCount> cpus;
+
+    // SCHED_FIFO for the latency-critical roles (I/O, feed, strategy,
+    // order entry). Needs CAP_SYS_NICE or an rtprio limit.
+    bool schedFifo = false;
+    int fifoPriority = 50;
+
+    // Spin instead of sleeping when idle. Only sensible on a dedicated,
+    // ideally isolated, CPU per thread.
+    bool busyPollIo = false;
+    bool busyPollFeed = false;
+    bool busyPollStrategy = false;
+
+    // Longest wait between quote cycles without market data
+    std::chrono::milliseconds strategyInterval{100};
+    size_t feedRingBytes = 1u << 20;    // Per I/O thread and shard
+
+    static RuntimeConfig fromConfig(const deribit::Config& config);
+    // "0,2,4-7"
+    static std::vector<int> parseCpuList(const std::string& list);
+};
+
+// Where a thread asked to run and where it actually ended up
+struct ThreadPlacement {
+    std::string name;
+    ThreadRole role = ThreadRole::HOUSEKEEPING;
+    int tid = 0;
+    std::vector<int> requestedCpus;     // Empty when unpinned
+    std::vector<int> allowedCpus;       // Read back after pinning
+    bool pinned = false;                // Affinity call succeeded
+    bool fifo = false;                  // Running SCHED_FIFO
+    int priority = 0;
+    bool busyPoll = false;
+};
+
+struct RuntimeStats {
+    uint64_t feedFrames = 0;
+    uint64_t feedRingFull = 0;          // Times an I/O thread waited on a shard
+    uint64_t feedOversized = 0;         // Frames too large for the ring
+    uint64_t strategyCycles = 0;
+};
+
+// Thread-per-core topology: I/O threads drive the websocket event loops,
+// feed shards decode market data, the strategy runs on the thread that
+// calls runStrategy(), and threads started by other components (logger,
+// rate limiter, metrics, ...) are placed by role through the
+// ThreadUtils::onThreadStart() hook. Every placed thread is named,
+// optionally pinned and made SCHED_FIFO, and listed in the placement
+// report with what the OS actually granted.
+//
+// Frames reach a shard through one SPSC ring per I/O thread and shard,
+// keyed by instrument, so each book is only ever written by one thread
+// and stays in order.
+class Runtime {
+public:
+    using FeedHandler = std::function<void(const std::string& payload)>;
+
+    explicit Runtime(const RuntimeConfig& config);
+    ~Runtime();
+
+    Runtime(const Runtime&) = delete;
+    Runtime& operator=(const Runtime&) = delete;
+
+    // Routes ThreadUtils::onThreadStart() here until the runtime is
+    // destroyed. Install before starting the components to be placed.
+    void installThreadStartHook();
+
+    // Names, pins and prioritises the calling thread for its role
+    void placeCurrentThread(ThreadRole role, const std::string& name);
+
+    // Before start(). The socket's event loop moves to an I/O thread.
+    void addConnection(DeribitWebSocket& socket);
+    // Before start(). Runs on the feed shards, or inline without shards.
+    void setFeedHandler(FeedHandler handler);
+
+    void start();
+    void stop();
+    bool isRunning() const { return m_running; }
+
+    // Hands a received frame to the shard owning its instrument. Called
+    // on I/O threads; other threads are serialised onto a shared ring.
+    void dispatchFeed(const std::string& payload);
+
+    // Runs cycle on the calling thread until running turns false or the
+    // runtime stops; place the thread as STRATEGY first. A cycle follows
+    // every wakeStrategy(), or strategyInterval after the previous one at
+    // the latest.
+    void runStrategy(const std::atomic<bool>& running, const std::function<void()>& cycle);
+    // Called while handling a frame, the next cycle runs as part of that
+    // frame's pipeline and orders it sends count towards tick_to_trade
+    void wakeStrategy();
+
+    std::vector<ThreadPlacement> getPlacements() const;
+    // One line per thread plus warnings about shared or unpinned CPUs
+    std::string placementReport() const;
+    RuntimeStats getStats() const;
+    const RuntimeConfig& getConfig() const { return m_config; }
+
+private:
+    struct Shard {
+        explicit Shard(size_t producers, size_t ringBytes);
+
+        std::vector<std::unique_ptr<utils::SpscByteRing>> rings;    // By producer
+        std::mutex mutex;
+        std::condition_variable wake;
+        alignas(utils::kCacheLineSize) std::atomic<bool> sleeping{false};
+        std::atomic<uint64_t> frames{0};
+    };
+
+    void ioLoop(size_t index, std::vector<DeribitWebSocket*> sockets);
+    void shardLoop(size_t index);
+    size_t drainShard(Shard& shard);
+    size_t shardFor(const std::string& payload) const;
+
+    static bool isLatencyCritical(ThreadRole role);
+    bool busyPolls(ThreadRole role) const;
+
+    RuntimeConfig m_config;
+    FeedHandler m_feedHandler;
+    std::vector<DeribitWebSocket*> m_connections;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::vector<std::thread> m_threads;
+    std::atomic<bool> m_running;
+    bool m_hookInstalled;
+
+    // Threads that are not I/O threads share the last producer ring of
+    // every shard
+    std::mutex m_externalProducerMutex;
+
+    mutable std::mutex m_placementMutex;
+    std::vector<ThreadPlacement> m_placements;
+    std::array<size_t, kThreadRoleCount> m_nextCpu;
+
+    std::mutex m_strategyMutex;
+    std::condition_variable m_strategyWake;
+    alignas(utils::kCacheLineSize) std::atomic<bool> m_strategyPending;
+    std::atomic<bool> m_strategySleeping;
+    std::atomic<int64_t> m_strategyTriggerNs;   // Oldest frame since the last cycle
+
+    uint32_t m_handoffMetric;
+    std::atomic<uint64_t> m_feedRingFull;
+    std::atomic<uint64_t> m_feedOversized;
+    std::atomic<uint64_t> m_strategyCycles;
+};
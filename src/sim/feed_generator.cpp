@@ -0,0 +1,477 @@
+#include "sim/feed_generator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+    // Fixed so that a seed always gives the same payloads
+    constexpr int64_t kStartMs = 1700000000000;
+
+    const char* kExpiries[] = {"27DEC24", "28MAR25", "27JUN25"};
+
+    int decimalsFor(double step) {
+        int decimals = 0;
+        while (decimals < 8 && std::fabs(step * std::pow(10.0, decimals) -
+                                         std::round(step * std::pow(10.0, decimals))) > 1e-9) {
+            ++decimals;
+        }
+        return decimals;
+    }
+
+    void appendNumber(std::string& out, double value, int decimals) {
+        char text[48];
+        std::snprintf(text, sizeof(text), "%.*f", decimals, value);
+        out += text;
+    }
+
+    void appendInt(std::string& out, int64_t value) {
+        char text[24];
+        std::snprintf(text, sizeof(text), "%lld", static_cast<long long>(value));
+        out += text;
+    }
+}
+
+FeedGenerator::FeedGenerator(const FeedGeneratorConfig& config)
+    : m_config(config)
+    , m_rng(config.seed)
+    , m_volatile(false)
+    , m_regimeEndsNs(0)
+    , m_nextTradeId(1)
+    , m_startMs(kStartMs) {
+    if (m_config.instruments.empty()) {
+        throw std::invalid_argument("Feed generator needs at least one instrument");
+    }
+    if (m_config.bookDepth < 1 || m_config.snapshotDepth < 1) {
+        throw std::invalid_argument("Book and snapshot depth must be positive");
+    }
+
+    m_instruments.resize(m_config.instruments.size());
+    for (size_t i = 0; i < m_instruments.size(); ++i) {
+        seedInstrument(m_instruments[i], i);
+        uint32_t index = static_cast<uint32_t>(i);
+        m_events.push({0, index, FeedFrameKind::BOOK_SNAPSHOT});
+        schedule(index, FeedFrameKind::BOOK_CHANGE, 0);
+        schedule(index, FeedFrameKind::TRADES, 0);
+        schedule(index, FeedFrameKind::TICKER, 0);
+    }
+    std::exponential_distribution<double> calm(1.0 / std::max(m_config.meanCalmSeconds, 1e-3));
+    m_regimeEndsNs = static_cast<int64_t>(calm(m_rng) * 1e9);
+}
+
+std::vector<std::string> FeedGenerator::makeInstruments(size_t count) {
+    std::vector<std::string> names;
+    const char* currencies[] = {"BTC", "ETH"};
+    for (const char* currency : currencies) {
+        names.push_back(std::string(currency) + "-PERPETUAL");
+    }
+    for (const char* expiry : kExpiries) {
+        for (const char* currency : currencies) {
+            names.push_back(std::string(currency) + "-" + expiry);
+        }
+    }
+    // Options around the money, alternating currencies
+    for (int strike = 0; names.size() < count; ++strike) {
+        for (const char* expiry : kExpiries) {
+            names.push_back(std::string("BTC-") + expiry + "-" + std::to_string(40000 + 1000 * strike) + "-C");
+            names.push_back(std::string("BTC-") + expiry + "-" + std::to_string(40000 + 1000 * strike) + "-P");
+            names.push_back(std::string("ETH-") + expiry + "-" + std::to_string(2000 + 50 * strike) + "-C");
+            names.push_back(std::string("ETH-") + expiry + "-" + std::to_string(2000 + 50 * strike) + "-P");
+        }
+    }
+    names.resize(count);
+    return names;
+}
+
+const char* FeedGenerator::kindName(FeedFrameKind kind) {
+    switch (kind) {
+        case FeedFrameKind::BOOK_SNAPSHOT: return "book_snapshot";
+        case FeedFrameKind::BOOK_CHANGE:   return "book_change";
+        case FeedFrameKind::TRADES:        return "trades";
+        case FeedFrameKind::TICKER:        return "ticker";
+    }
+    return "unknown";
+}
+
+double FeedGenerator::expectedRate() const {
+    double perInstrument = m_config.bookChangesPerSecond + m_config.tradesPerSecond + m_config.tickersPerSecond;
+    double calm = std::max(m_config.meanCalmSeconds, 1e-3);
+    double volatileSeconds = std::max(m_config.meanVolatileSeconds, 0.0);
+    double multiplier = (calm + volatileSeconds * m_config.burstMultiplier) / (calm + volatileSeconds);
+    return perInstrument * multiplier * static_cast<double>(m_instruments.size());
+}
+
+void FeedGenerator::seedInstrument(Instrument& instrument, size_t index) {
+    instrument.name = m_config.instruments[index];
+    bool option = instrument.name.size() > 2 &&
+                  (instrument.name.compare(instrument.name.size() - 2, 2, "-C") == 0 ||
+                   instrument.name.compare(instrument.name.size() - 2, 2, "-P") == 0);
+    double mid;
+    if (option) {
+        // Quoted in the underlying, like the exchange's options
+        instrument.tickSize = 0.0005;
+        instrument.lotSize = 0.1;
+        mid = 0.02 + 0.0005 * static_cast<double>(m_rng() % 200);
+    } else if (instrument.name.compare(0, 4, "BTC-") == 0) {
+        instrument.tickSize = 0.5;
+        instrument.lotSize = 10.0;
+        mid = 60000.0;
+    } else if (instrument.name.compare(0, 4, "ETH-") == 0) {
+        instrument.tickSize = 0.05;
+        instrument.lotSize = 1.0;
+        mid = 3000.0;
+    } else {
+        instrument.tickSize = 0.01;
+        instrument.lotSize = 1.0;
+        mid = 100.0;
+    }
+    instrument.bestBidTicks = static_cast<int64_t>(std::llround(mid / instrument.tickSize));
+    for (int i = 0; i < m_config.bookDepth; ++i) {
+        instrument.bids[instrument.bestBidTicks - i] = randomAmount(instrument);
+        instrument.asks[instrument.bestBidTicks + 1 + i] = randomAmount(instrument);
+    }
+    instrument.lastPrice = midPrice(instrument);
+    instrument.changeId = 1000 + static_cast<int64_t>(index) * 1000000;
+}
+
+void FeedGenerator::schedule(uint32_t instrument, FeedFrameKind kind, int64_t afterNs) {
+    double rate = 0.0;
+    switch (kind) {
+        case FeedFrameKind::BOOK_SNAPSHOT:
+        case FeedFrameKind::BOOK_CHANGE: rate = m_config.bookChangesPerSecond; break;
+        case FeedFrameKind::TRADES:      rate = m_config.tradesPerSecond; break;
+        case FeedFrameKind::TICKER:      rate = m_config.tickersPerSecond; break;
+    }
+    if (m_volatile) {
+        rate *= m_config.burstMultiplier;
+    }
+    if (rate <= 0.0) {
+        return;
+    }
+    std::exponential_distribution<double> gap(rate);
+    int64_t delayNs = std::max<int64_t>(1, static_cast<int64_t>(gap(m_rng) * 1e9));
+    m_events.push({afterNs + delayNs, instrument, kind});
+}
+
+void FeedGenerator::updateRegime(int64_t nowNs) {
+    if (m_config.meanVolatileSeconds <= 0.0) {
+        return;
+    }
+    while (nowNs >= m_regimeEndsNs) {
+        m_volatile = !m_volatile;
+        double mean = m_volatile ? m_config.meanVolatileSeconds : std::max(m_config.meanCalmSeconds, 1e-3);
+        std::exponential_distribution<double> length(1.0 / mean);
+        m_regimeEndsNs += std::max<int64_t>(1, static_cast<int64_t>(length(m_rng) * 1e9));
+    }
+}
+
+void FeedGenerator::next(FeedFrame& frame) {
+    Event event = m_events.top();
+    m_events.pop();
+    updateRegime(event.timeNs);
+
+    Instrument& instrument = m_instruments[event.instrument];
+    frame.timeNs = event.timeNs;
+    frame.instrument = event.instrument;
+    frame.volatileRegime = m_volatile;
+    frame.payload.clear();
+
+    switch (event.kind) {
+        case FeedFrameKind::BOOK_SNAPSHOT:
+            frame.kind = FeedFrameKind::BOOK_SNAPSHOT;
+            bookSnapshot(instrument, frame.payload);
+            return;     // Changes are scheduled on their own
+        case FeedFrameKind::BOOK_CHANGE:
+            if (m_config.snapshotInterval > 0 && instrument.changesSinceSnapshot >= m_config.snapshotInterval) {
+                frame.kind = FeedFrameKind::BOOK_SNAPSHOT;
+                bookSnapshot(instrument, frame.payload);
+            } else {
+                frame.kind = FeedFrameKind::BOOK_CHANGE;
+                bookChange(instrument, event.timeNs, frame.payload);
+            }
+            break;
+        case FeedFrameKind::TRADES:
+            frame.kind = FeedFrameKind::TRADES;
+            trades(instrument, event.timeNs, frame.payload);
+            break;
+        case FeedFrameKind::TICKER:
+            frame.kind = FeedFrameKind::TICKER;
+            ticker(instrument, event.timeNs, frame.payload);
+            break;
+    }
+    schedule(event.instrument, event.kind, event.timeNs);
+}
+
+void FeedGenerator::beginNotification(const char* channel, const Instrument& instrument, std::string& out) const {
+    out += "{\"jsonrpc\":\"2.0\",\"method\":\"subscription\",\"params\":{\"channel\":\"";
+    out += channel;
+    out += '.';
+    out += instrument.name;
+    out += '.';
+    out += m_config.interval;
+    out += "\",\"data\":";
+}
+
+void FeedGenerator::appendPrice(std::string& out, const Instrument& instrument, int64_t ticks) const {
+    appendNumber(out, static_cast<double>(ticks) * instrument.tickSize, decimalsFor(instrument.tickSize));
+}
+
+double FeedGenerator::randomAmount(const Instrument& instrument) {
+    return instrument.lotSize * static_cast<double>(1 + m_rng() % 200);
+}
+
+double FeedGenerator::midPrice(const Instrument& instrument) const {
+    return (static_cast<double>(instrument.bestBidTicks) + 0.5) * instrument.tickSize;
+}
+
+void FeedGenerator::snapshot(uint32_t instrument, std::string& out) const {
+    writeSnapshot(m_instruments.at(instrument), out);
+}
+
+void FeedGenerator::bookSnapshot(Instrument& instrument, std::string& out) {
+    instrument.changeId += 1;
+    instrument.changesSinceSnapshot = 0;
+    writeSnapshot(instrument, out);
+}
+
+void FeedGenerator::writeSnapshot(const Instrument& instrument, std::string& out) const {
+    int amountDecimals = decimalsFor(instrument.lotSize);
+    beginNotification("book", instrument, out);
+    out += "{\"type\":\"snapshot\",\"timestamp\":";
+    appendInt(out, m_startMs);
+    out += ",\"instrument_name\":\"";
+    out += instrument.name;
+    out += "\",\"change_id\":";
+    appendInt(out, instrument.changeId);
+
+    // Book levels first, then fixed-size padding out to snapshotDepth
+    auto appendSide = [&](const char* name, bool bid) {
+        out += ",\"";
+        out += name;
+        out += "\":[";
+        int written = 0;
+        auto level = [&](int64_t ticks, double amount) {
+            out += written++ ? ",[\"new\"," : "[\"new\",";
+            appendPrice(out, instrument, ticks);
+            out += ',';
+            appendNumber(out, amount, amountDecimals);
+            out += ']';
+        };
+        int64_t edge = 0;
+        if (bid) {
+            for (auto it = instrument.bids.rbegin(); it != instrument.bids.rend() && written < m_config.snapshotDepth; ++it) {
+                level(it->first, it->second);
+                edge = it->first;
+            }
+            for (int64_t ticks = edge - 1; written < m_config.snapshotDepth && ticks > 0; --ticks) {
+                level(ticks, instrument.lotSize * static_cast<double>(1 + (ticks % 97)));
+                instrument.paddedBidHigh = std::max(instrument.paddedBidHigh, ticks);
+            }
+        } else {
+            for (auto it = instrument.asks.begin(); it != instrument.asks.end() && written < m_config.snapshotDepth; ++it) {
+                level(it->first, it->second);
+                edge = it->first;
+            }
+            for (int64_t ticks = edge + 1; written < m_config.snapshotDepth; ++ticks) {
+                level(ticks, instrument.lotSize * static_cast<double>(1 + (ticks % 97)));
+                instrument.paddedAskLow = std::min(instrument.paddedAskLow, ticks);
+            }
+        }
+        out += ']';
+    };
+    appendSide("bids", true);
+    appendSide("asks", false);
+    out += "}}}";
+}
+
+void FeedGenerator::bookChange(Instrument& instrument, int64_t nowNs, std::string& out) {
+    int amountDecimals = decimalsFor(instrument.lotSize);
+    std::string bids;
+    std::string asks;
+    auto add = [&](std::string& side, const char* action, int64_t ticks, double amount) {
+        side += side.empty() ? "[\"" : ",[\"";
+        side += action;
+        side += "\",";
+        appendPrice(side, instrument, ticks);
+        side += ',';
+        appendNumber(side, amount, amountDecimals);
+        side += ']';
+    };
+
+    // Calm markets mostly change sizes; volatile ones move the touch by
+    // several ticks and reshuffle more of the book
+    double moveProbability = m_volatile ? 0.4 : 0.08;
+    if (std::uniform_real_distribution<double>(0.0, 1.0)(m_rng) < moveProbability) {
+        int64_t maxMove = m_volatile ? 5 : 1;
+        int64_t move = 1 + static_cast<int64_t>(m_rng() % static_cast<uint64_t>(maxMove));
+        if (m_rng() & 1) {
+            move = -move;
+        }
+        // Keep prices positive for cheap options
+        if (instrument.bestBidTicks + move < m_config.bookDepth + 1) {
+            move = -move;
+        }
+        instrument.bestBidTicks += move;
+        int64_t best = instrument.bestBidTicks;
+        int64_t depth = m_config.bookDepth;
+
+        // Padding the touch moved past would leave subscribers crossed
+        for (; instrument.paddedAskLow <= best; ++instrument.paddedAskLow) {
+            if (!instrument.asks.count(instrument.paddedAskLow)) {
+                add(asks, "delete", instrument.paddedAskLow, 0.0);
+            }
+        }
+        for (; instrument.paddedBidHigh > best; --instrument.paddedBidHigh) {
+            if (!instrument.bids.count(instrument.paddedBidHigh)) {
+                add(bids, "delete", instrument.paddedBidHigh, 0.0);
+            }
+        }
+
+        for (auto it = instrument.bids.begin(); it != instrument.bids.end();) {
+            if (it->first > best || it->first <= best - depth) {
+                add(bids, "delete", it->first, 0.0);
+                it = instrument.bids.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (auto it = instrument.asks.begin(); it != instrument.asks.end();) {
+            if (it->first <= best || it->first > best + depth) {
+                add(asks, "delete", it->first, 0.0);
+                it = instrument.asks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (int64_t i = 0; i < depth; ++i) {
+            if (instrument.bids.emplace(best - i, 0.0).second) {
+                instrument.bids[best - i] = randomAmount(instrument);
+                add(bids, "new", best - i, instrument.bids[best - i]);
+            }
+            if (instrument.asks.emplace(best + 1 + i, 0.0).second) {
+                instrument.asks[best + 1 + i] = randomAmount(instrument);
+                add(asks, "new", best + 1 + i, instrument.asks[best + 1 + i]);
+            }
+        }
+    } else {
+        int changes = 1 + static_cast<int>(m_rng() % (m_volatile ? 8 : 3));
+        for (int i = 0; i < changes; ++i) {
+            bool bid = m_rng() & 1;
+            auto& levels = bid ? instrument.bids : instrument.asks;
+            // Activity is concentrated near the touch
+            uint64_t offset = std::min<uint64_t>(m_rng() % static_cast<uint64_t>(m_config.bookDepth),
+                                                 m_rng() % static_cast<uint64_t>(m_config.bookDepth));
+            int64_t ticks = bid ? instrument.bestBidTicks - static_cast<int64_t>(offset)
+                                : instrument.bestBidTicks + 1 + static_cast<int64_t>(offset);
+            levels[ticks] = randomAmount(instrument);
+            add(bid ? bids : asks, "change", ticks, levels[ticks]);
+        }
+    }
+
+    int64_t previous = instrument.changeId;
+    instrument.changeId += 1;
+    instrument.changesSinceSnapshot += 1;
+
+    beginNotification("book", instrument, out);
+    out += "{\"type\":\"change\",\"timestamp\":";
+    appendInt(out, m_startMs + nowNs / 1000000);
+    out += ",\"prev_change_id\":";
+    appendInt(out, previous);
+    out += ",\"instrument_name\":\"";
+    out += instrument.name;
+    out += "\",\"change_id\":";
+    appendInt(out, instrument.changeId);
+    out += ",\"bids\":[";
+    out += bids.empty() ? "" : bids;
+    out += "],\"asks\":[";
+    out += asks.empty() ? "" : asks;
+    out += "]}}}";
+}
+
+void FeedGenerator::trades(Instrument& instrument, int64_t nowNs, std::string& out) {
+    int priceDecimals = decimalsFor(instrument.tickSize);
+    int amountDecimals = decimalsFor(instrument.lotSize);
+    int count = m_volatile ? 1 + static_cast<int>(m_rng() % 6) : 1 + static_cast<int>(m_rng() % 10 == 0);
+
+    beginNotification("trades", instrument, out);
+    out += '[';
+    for (int i = 0; i < count; ++i) {
+        bool buy = m_rng() & 1;
+        double price = static_cast<double>(buy ? instrument.bestBidTicks + 1 : instrument.bestBidTicks) *
+                       instrument.tickSize;
+        int tickDirection = price > instrument.lastPrice ? 0 : price < instrument.lastPrice ? 2 : buy ? 1 : 3;
+        instrument.lastPrice = price;
+
+        out += i ? ",{\"trade_seq\":" : "{\"trade_seq\":";
+        appendInt(out, static_cast<int64_t>(++instrument.tradeSeq));
+        out += ",\"trade_id\":\"";
+        appendInt(out, static_cast<int64_t>(m_nextTradeId++));
+        out += "\",\"timestamp\":";
+        appendInt(out, m_startMs + nowNs / 1000000);
+        out += ",\"tick_direction\":";
+        appendInt(out, tickDirection);
+        out += ",\"price\":";
+        appendNumber(out, price, priceDecimals);
+        out += ",\"mark_price\":";
+        appendNumber(out, midPrice(instrument), priceDecimals + 2);
+        out += ",\"instrument_name\":\"";
+        out += instrument.name;
+        out += "\",\"index_price\":";
+        appendNumber(out, midPrice(instrument) * 0.9999, 2);
+        out += ",\"direction\":\"";
+        out += buy ? "buy" : "sell";
+        out += "\",\"amount\":";
+        appendNumber(out, randomAmount(instrument), amountDecimals);
+        out += '}';
+    }
+    out += "]}}";
+}
+
+void FeedGenerator::ticker(Instrument& instrument, int64_t nowNs, std::string& out) {
+    int priceDecimals = decimalsFor(instrument.tickSize);
+    int amountDecimals = decimalsFor(instrument.lotSize);
+    double mid = midPrice(instrument);
+    double bestBid = static_cast<double>(instrument.bestBidTicks) * instrument.tickSize;
+    double bestAsk = bestBid + instrument.tickSize;
+    auto side = [](const std::map<int64_t, double>& levels, bool bid) {
+        if (levels.empty()) return 0.0;
+        return bid ? levels.rbegin()->second : levels.begin()->second;
+    };
+
+    beginNotification("ticker", instrument, out);
+    out += "{\"timestamp\":";
+    appendInt(out, m_startMs + nowNs / 1000000);
+    out += ",\"stats\":{\"volume\":";
+    appendNumber(out, 1000.0 + static_cast<double>(instrument.tradeSeq % 100000), 2);
+    out += ",\"price_change\":";
+    appendNumber(out, std::fmod(static_cast<double>(instrument.bestBidTicks), 7.0) - 3.5, 4);
+    out += ",\"low\":";
+    appendNumber(out, mid * 0.97, priceDecimals);
+    out += ",\"high\":";
+    appendNumber(out, mid * 1.03, priceDecimals);
+    out += "},\"state\":\"open\",\"settlement_price\":";
+    appendNumber(out, mid * 0.998, priceDecimals + 2);
+    out += ",\"open_interest\":";
+    appendNumber(out, 1e6 + static_cast<double>(instrument.changeId % 1000000), 0);
+    out += ",\"min_price\":";
+    appendNumber(out, mid * 0.985, priceDecimals);
+    out += ",\"max_price\":";
+    appendNumber(out, mid * 1.015, priceDecimals);
+    out += ",\"mark_price\":";
+    appendNumber(out, mid, priceDecimals + 2);
+    out += ",\"last_price\":";
+    appendNumber(out, instrument.lastPrice, priceDecimals);
+    out += ",\"instrument_name\":\"";
+    out += instrument.name;
+    out += "\",\"index_price\":";
+    appendNumber(out, mid * 0.9999, 2);
+    out += ",\"best_bid_price\":";
+    appendNumber(out, bestBid, priceDecimals);
+    out += ",\"best_bid_amount\":";
+    appendNumber(out, side(instrument.bids, true), amountDecimals);
+    out += ",\"best_ask_price\":";
+    appendNumber(out, bestAsk, priceDecimals);
+    out += ",\"best_ask_amount\":";
+    appendNumber(out, side(instrument.asks, false), amountDecimals);
+    out += "}}}";
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+enum class FeedFrameKind : uint8_t {
+    BOOK_SNAPSHOT,
+    BOOK_CHANGE,
+    TRADES,
+    TICKER
+};
+
+struct FeedGeneratorConfig {
+    std::vector<std::string> instruments = {"BTC-PERPETUAL", "ETH-PERPETUAL"};
+    std::string interval = "100ms";     // Channel suffix, e.g. book.BTC-PERPETUAL.100ms
+
+    // Calm regime rates, per instrument
+    double bookChangesPerSecond = 100.0;
+    double tradesPerSecond = 10.0;
+    double tickersPerSecond = 1.0;
+
+    int bookDepth = 20;                 // Levels per side kept in the book
+    int snapshotDepth = 20;             // Levels per side in snapshots, deeper ones padded, bids above zero
+    uint64_t snapshotInterval = 0;      // Book changes between repeat snapshots, 0 first only
+
+    // Volatility regimes, switched market-wide at exponential intervals.
+    // A volatile market sends burstMultiplier times the messages, moves
+    // several ticks at a time and touches more levels per change.
+    double meanCalmSeconds = 5.0;
+    double meanVolatileSeconds = 1.0;   // 0 never turns volatile
+    double burstMultiplier = 10.0;
+
+    uint64_t seed = 42;
+};
+
+struct FeedFrame {
+    int64_t timeNs = 0;                 // Virtual time since the start
+    uint32_t instrument = 0;            // Index into the config's instruments
+    FeedFrameKind kind = FeedFrameKind::BOOK_SNAPSHOT;
+    bool volatileRegime = false;
+    std::string payload;                // Deribit subscription notification
+};
+
+// Synthetic public market data in the exchange's notification format:
+// book snapshots and changes with a consistent change_id chain, trades
+// and tickers, for any number of instruments. Frames come out in virtual
+// time order with Poisson arrivals at the configured rates, so a caller
+// can replay them as fast as possible or paced against a clock.
+// Deterministic for a given seed. Not thread-safe.
+class FeedGenerator {
+public:
+    explicit FeedGenerator(const FeedGeneratorConfig& config = FeedGeneratorConfig());
+
+    // The next frame, the stream does not end. The first frame of every
+    // instrument is its snapshot.
+    void next(FeedFrame& frame);
+
+    const FeedGeneratorConfig& getConfig() const { return m_config; }
+    // Average frames per second over all instruments, regimes weighted
+    double expectedRate() const;
+
+    // Perpetuals, futures and options with exchange-style names
+    static std::vector<std::string> makeInstruments(size_t count);
+
+    // Current book of an instrument without advancing the change_id chain,
+    // e.g. for a subscriber joining mid-stream
+    void snapshot(uint32_t instrument, std::string& out) const;
+
+    static const char* kindName(FeedFrameKind kind);
+
+private:
+    struct Instrument {
+        std::string name;
+        double tickSize = 0.5;
+        double lotSize = 10.0;
+        int64_t bestBidTicks = 0;
+        std::map<int64_t, double> bids;         // By price in ticks
+        std::map<int64_t, double> asks;
+        // Snapshot padding is not kept in the book; changes delete it once
+        // the touch crosses it. Lowest padded ask and highest padded bid.
+        mutable int64_t paddedAskLow = INT64_MAX;
+        mutable int64_t paddedBidHigh = INT64_MIN;
+        int64_t changeId = 0;
+        uint64_t changesSinceSnapshot = 0;
+        uint64_t tradeSeq = 0;
+        double lastPrice = 0.0;
+    };
+
+    struct Event {
+        int64_t timeNs;
+        uint32_t instrument;
+        FeedFrameKind kind;
+        bool operator>(const Event& other) const { return timeNs > other.timeNs; }
+    };
+
+    void seedInstrument(Instrument& instrument, size_t index);
+    void schedule(uint32_t instrument, FeedFrameKind kind, int64_t afterNs);
+    void updateRegime(int64_t nowNs);
+
+    void bookSnapshot(Instrument& instrument, std::string& out);
+    void writeSnapshot(const Instrument& instrument, std::string& out) const;
+    void bookChange(Instrument& instrument, int64_t nowNs, std::string& out);
+    void trades(Instrument& instrument, int64_t nowNs, std::string& out);
+    void ticker(Instrument& instrument, int64_t nowNs, std::string& out);
+
+    void beginNotification(const char* channel, const Instrument& instrument, std::string& out) const;
+    void appendPrice(std::string& out, const Instrument& instrument, int64_t ticks) const;
+    double randomAmount(const Instrument& instrument);
+    double midPrice(const Instrument& instrument) const;
+
+    FeedGeneratorConfig m_config;
+    std::mt19937_64 m_rng;
+    std::vector<Instrument> m_instruments;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> m_events;
+    bool m_volatile;
+    int64_t m_regimeEndsNs;
+    uint64_t m_nextTradeId;
+    int64_t m_startMs;
+};
@@ -0,0 +1,506 @@
+#include "sim/matching_simulator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    constexpr double kEpsilon = 1e-9;
+    constexpr size_t kMaxTakeLevels = 64;
+
+    // Same codes as the exchange
+    constexpr int kInvalidParams = -32602;
+    constexpr int kMethodNotFound = -32601;
+    constexpr int kOrderNotFound = 10004;
+    constexpr int kPostOnlyReject = 11054;
+
+    OrderSide opposite(OrderSide side) {
+        return side == OrderSide::BUY ? OrderSide::SELL : OrderSide::BUY;
+    }
+
+    // Whether a price on the other side of the book trades with ours
+    bool crosses(OrderSide side, double price, double otherPrice) {
+        return side == OrderSide::BUY ? otherPrice <= price + kEpsilon : otherPrice >= price - kEpsilon;
+    }
+}
+
+MatchingSimulator::MatchingSimulator(const SimulatorConfig& config)
+    : m_config(config)
+    , m_now(0)
+    , m_nextSequence(0)
+    , m_nextOrderId(1)
+    , m_nextTradeId(1)
+    , m_exchangeFeed(std::make_unique<deribit::MarketDataManager>("wss://simulator.invalid")) {
+    m_exchangeFeed->setOrderBookCallback([this](const std::string& instrument, const std::string&,
+                                                const nlohmann::json&) {
+        onBook(instrument);
+    });
+    m_exchangeFeed->setMarketDataCallback([this](const std::string& instrument, const std::string& channel,
+                                                 const nlohmann::json& data) {
+        if (channel.find("trades") != std::string::npos && data.is_array()) {
+            onTrades(instrument, data);
+        }
+    });
+}
+
+MatchingSimulator::~MatchingSimulator() = default;
+
+void MatchingSimulator::addInstrument(const std::string& instrument) {
+    m_exchangeFeed->addOrderBook(instrument);
+    m_books[instrument] = m_exchangeFeed->getOrderBook(instrument);
+    m_resting[instrument];
+}
+
+OrderTransport MatchingSimulator::transport() {
+    return [this](const std::string& method, const nlohmann::json& params, ResponseCallback callback) {
+        schedule(m_now + m_config.orderEntryLatencyNs, [this, method, params, callback] {
+            handleRequest(method, params, callback);
+        });
+    };
+}
+
+void MatchingSimulator::setMarketDataCallback(PayloadCallback callback) {
+    m_marketDataCallback = std::move(callback);
+}
+
+void MatchingSimulator::setOrderCallback(NotificationCallback callback) {
+    m_orderCallback = std::move(callback);
+}
+
+void MatchingSimulator::setTradeCallback(NotificationCallback callback) {
+    m_tradeCallback = std::move(callback);
+}
+
+void MatchingSimulator::onMarketData(const std::string& payload, int64_t exchangeNs) {
+    advanceTo(exchangeNs);
+    ++m_stats.marketMessages;
+
+    // The exchange sees the update now, we see it after the feed latency
+    m_exchangeFeed->processMessage(payload);
+    if (m_marketDataCallback) {
+        schedule(exchangeNs + m_config.marketDataLatencyNs, [this, payload] {
+            m_marketDataCallback(payload);
+        });
+    }
+}
+
+uint64_t MatchingSimulator::replay(CaptureReader& reader, uint32_t connectionId) {
+    uint64_t frames = 0;
+    CaptureFrame frame;
+    std::string payload;
+    while (reader.next(frame)) {
+        if (connectionId != UINT32_MAX && frame.connectionId != connectionId) {
+            continue;
+        }
+        payload.assign(frame.data, frame.length);
+        onMarketData(payload, frame.receiveNs);
+        ++frames;
+    }
+    runUntilIdle();
+    return frames;
+}
+
+void MatchingSimulator::advanceTo(int64_t timeNs) {
+    while (!m_events.empty() && m_events.top().timeNs <= timeNs) {
+        // Moved out before popping, the action may schedule more events
+        Event event = std::move(const_cast<Event&>(m_events.top()));
+        m_events.pop();
+        m_now = std::max(m_now, event.timeNs);
+        ++m_stats.events;
+        event.action();
+    }
+    m_now = std::max(m_now, timeNs);
+}
+
+void MatchingSimulator::runUntilIdle() {
+    advanceTo(std::numeric_limits<int64_t>::max());
+}
+
+std::shared_ptr<OrderBook> MatchingSimulator::getOrderBook(const std::string& instrument) {
+    auto it = m_books.find(instrument);
+    return it != m_books.end() ? it->second : nullptr;
+}
+
+void MatchingSimulator::schedule(int64_t timeNs, std::function<void()> action) {
+    m_events.push({timeNs, m_nextSequence++, std::move(action)});
+}
+
+void MatchingSimulator::handleRequest(const std::string& method, const nlohmann::json& params,
+                                      ResponseCallback callback) {
+    nlohmann::json response;
+    try {
+        if (method == "private/buy" || method == "private/sell") {
+            ++m_stats.ordersReceived;
+            response = placeOrder(method == "private/buy" ? OrderSide::BUY : OrderSide::SELL, params);
+        } else if (method == "private/edit") {
+            response = editOrder(params);
+        } else if (method == "private/cancel") {
+            auto it = m_orders.find(params.value("order_id", std::string()));
+            response = it != m_orders.end() ? nlohmann::json{{"result", cancelOrder(it->second)}}
+                                            : error(kOrderNotFound, "order_not_found");
+        } else if (method == "private/cancel_by_label") {
+            std::string label = params.value("label", std::string());
+            response = {{"result", cancelWhere([&](const SimOrder& order) { return order.label == label; })}};
+        } else if (method == "private/cancel_all") {
+            response = {{"result", cancelWhere([](const SimOrder&) { return true; })}};
+        } else if (method == "private/cancel_all_by_instrument") {
+            std::string instrument = params.value("instrument_name", std::string());
+            response = {{"result", cancelWhere([&](const SimOrder& order) {
+                return order.instrument == instrument;
+            })}};
+        } else {
+            response = error(kMethodNotFound, "Method not found: " + method);
+        }
+    } catch (const std::exception& e) {
+        response = error(kInvalidParams, e.what());
+    }
+
+    if (response.contains("error")) {
+        ++m_stats.rejects;
+    }
+    respond(std::move(callback), std::move(response));
+}
+
+nlohmann::json MatchingSimulator::placeOrder(OrderSide side, const nlohmann::json& params) {
+    std::string instrument = params.at("instrument_name").get<std::string>();
+    auto book = getOrderBook(instrument);
+    if (!book) {
+        return error(kInvalidParams, "Unknown instrument " + instrument);
+    }
+    double amount = params.at("amount").get<double>();
+    if (!(amount > 0.0)) {
+        return error(kInvalidParams, "Invalid amount");
+    }
+
+    std::string type = params.value("type", std::string("limit"));
+    if (type != "limit" && type != "market") {
+        return error(kInvalidParams, "Order type not simulated: " + type);
+    }
+
+    SimOrder order;
+    order.orderId = "SIM-" + std::to_string(m_nextOrderId++);
+    order.label = params.value("label", std::string());
+    order.instrument = instrument;
+    order.side = side;
+    order.type = type == "market" ? OrderType::MARKET : OrderType::LIMIT;
+    order.amount = amount;
+    order.postOnly = params.value("post_only", false);
+    order.reduceOnly = params.value("reduce_only", false);
+    order.createdNs = m_now;
+    order.updatedNs = m_now;
+    if (order.type == OrderType::LIMIT) {
+        order.price = params.at("price").get<double>();
+    } else {
+        order.price = side == OrderSide::BUY ? std::numeric_limits<double>::infinity()
+                                             : -std::numeric_limits<double>::infinity();
+    }
+
+    double bestOther = side == OrderSide::BUY ? book->getBestAsk() : book->getBestBid();
+    bool crossing = bestOther > 0.0 && crosses(side, order.price, bestOther);
+    if (crossing && order.postOnly) {
+        return error(kPostOnlyReject, "post_only_reject");
+    }
+
+    nlohmann::json trades = nlohmann::json::array();
+    if (crossing) {
+        takeLiquidity(order, trades);
+    }
+
+    std::string orderId = order.orderId;
+    SimOrder* stored = &m_orders.emplace(orderId, std::move(order)).first->second;
+    if (stored->state == "open" && stored->type == OrderType::MARKET) {
+        // Unfilled market remainder does not rest
+        stored->state = "cancelled";
+    }
+    if (stored->state == "open") {
+        rest(*stored);
+    }
+
+    nlohmann::json result = {{"order", orderToJson(*stored)}, {"trades", trades}};
+    publishOrder(*stored);
+    for (const auto& trade : trades) {
+        publishTrade(trade);
+    }
+    if (stored->state != "open") {
+        close(*stored);
+    }
+    return {{"result", result}};
+}
+
+nlohmann::json MatchingSimulator::editOrder(const nlohmann::json& params) {
+    auto it = m_orders.find(params.value("order_id", std::string()));
+    if (it == m_orders.end()) {
+        return error(kOrderNotFound, "order_not_found");
+    }
+    SimOrder& order = it->second;
+    auto book = getOrderBook(order.instrument);
+
+    double amount = params.value("amount", order.amount);
+    double price = params.value("price", order.price);
+    if (!(amount > 0.0)) {
+        return error(kInvalidParams, "Invalid amount");
+    }
+
+    double bestOther = order.side == OrderSide::BUY ? book->getBestAsk() : book->getBestBid();
+    bool crossing = bestOther > 0.0 && crosses(order.side, price, bestOther);
+    if (crossing && order.postOnly) {
+        return error(kPostOnlyReject, "post_only_reject");
+    }
+
+    // A new price or a larger size goes to the back of the queue
+    bool losesPriority = std::fabs(price - order.price) > kEpsilon || amount > order.amount + kEpsilon;
+    order.price = price;
+    order.amount = std::max(amount, order.filled);
+    order.updatedNs = m_now;
+
+    auto& resting = m_resting[order.instrument];
+    resting.erase(std::remove(resting.begin(), resting.end(), &order), resting.end());
+
+    nlohmann::json trades = nlohmann::json::array();
+    if (order.remaining() <= kEpsilon) {
+        order.state = "filled";
+    } else if (crossing) {
+        takeLiquidity(order, trades);
+    }
+
+    if (order.state == "open") {
+        if (losesPriority) {
+            rest(order);
+        } else {
+            // Same place in the queue, and in time priority among ours
+            auto position = std::find_if(resting.begin(), resting.end(), [&](const SimOrder* other) {
+                return other->sequence > order.sequence;
+            });
+            resting.insert(position, &order);
+        }
+    }
+
+    nlohmann::json result = {{"order", orderToJson(order)}, {"trades", trades}};
+    publishOrder(order);
+    for (const auto& trade : trades) {
+        publishTrade(trade);
+    }
+    if (order.state != "open") {
+        close(order);
+    }
+    return {{"result", result}};
+}
+
+nlohmann::json MatchingSimulator::cancelOrder(SimOrder& order) {
+    order.state = "cancelled";
+    order.updatedNs = m_now;
+    nlohmann::json result = orderToJson(order);
+    publishOrder(order);
+    close(order);
+    return result;
+}
+
+size_t MatchingSimulator::cancelWhere(const std::function<bool(const SimOrder&)>& predicate) {
+    std::vector<SimOrder*> matched;
+    for (auto& [orderId, order] : m_orders) {
+        if (predicate(order)) {
+            matched.push_back(&order);
+        }
+    }
+    for (SimOrder* order : matched) {
+        cancelOrder(*order);
+    }
+    return matched.size();
+}
+
+void MatchingSimulator::takeLiquidity(SimOrder& order, nlohmann::json& trades) {
+    // Our takes are not removed from the replayed book; at sizes that
+    // matter against the visible depth the result is optimistic
+    std::pair<double, double> levels[kMaxTakeLevels];
+    size_t count = m_books[order.instrument]->getTopLevels(opposite(order.side), levels, kMaxTakeLevels);
+    for (size_t i = 0; i < count && order.remaining() > kEpsilon; ++i) {
+        if (!crosses(order.side, order.price, levels[i].first)) {
+            break;
+        }
+        double amount = std::min(order.remaining(), levels[i].second);
+        if (amount > kEpsilon) {
+            trades.push_back(fill(order, levels[i].first, amount, false));
+        }
+    }
+}
+
+void MatchingSimulator::rest(SimOrder& order) {
+    order.sequence = m_nextSequence++;
+    order.lastLevelVolume = m_books[order.instrument]->getVolumeAt(order.side, order.price);
+    order.queueAhead = order.lastLevelVolume;
+    m_resting[order.instrument].push_back(&order);
+}
+
+void MatchingSimulator::close(SimOrder& order) {
+    auto& resting = m_resting[order.instrument];
+    resting.erase(std::remove(resting.begin(), resting.end(), &order), resting.end());
+    m_orders.erase(order.orderId);
+}
+
+void MatchingSimulator::onBook(const std::string& instrument) {
+    auto restingIt = m_resting.find(instrument);
+    if (restingIt == m_resting.end() || restingIt->second.empty()) {
+        return;
+    }
+    auto& book = m_books[instrument];
+    double bestBid = book->getBestBid();
+    double bestAsk = book->getBestAsk();
+
+    std::vector<SimOrder*> done;
+    for (SimOrder* order : restingIt->second) {
+        // Cancels at our level remove part of the queue ahead of us
+        double volume = book->getVolumeAt(order->side, order->price);
+        if (volume < order->lastLevelVolume) {
+            order->queueAhead -= (order->lastLevelVolume - volume) * m_config.cancelAheadFraction;
+        }
+        order->queueAhead = std::max(0.0, std::min(order->queueAhead, volume));
+        order->lastLevelVolume = volume;
+
+        // The other side moved through our price without a print we saw:
+        // fill as maker against what is now offered at or through it
+        double bestOther = order->side == OrderSide::BUY ? bestAsk : bestBid;
+        if (bestOther > 0.0 && crosses(order->side, order->price, bestOther)) {
+            std::pair<double, double> levels[kMaxTakeLevels];
+            size_t count = book->getTopLevels(opposite(order->side), levels, kMaxTakeLevels);
+            double available = 0.0;
+            for (size_t i = 0; i < count && crosses(order->side, order->price, levels[i].first); ++i) {
+                available += levels[i].second;
+            }
+            double amount = std::min(order->remaining(), available);
+            if (amount > kEpsilon) {
+                publishTrade(fill(*order, order->price, amount, true));
+                publishOrder(*order);
+                order->queueAhead = 0.0;
+                if (order->state != "open") {
+                    done.push_back(order);
+                }
+            }
+        }
+    }
+    for (SimOrder* order : done) {
+        close(*order);
+    }
+}
+
+void MatchingSimulator::onTrades(const std::string& instrument, const nlohmann::json& trades) {
+    auto restingIt = m_resting.find(instrument);
+    if (restingIt == m_resting.end() || restingIt->second.empty()) {
+        return;
+    }
+
+    std::vector<SimOrder*> done;
+    for (const auto& trade : trades) {
+        double price = trade.value("price", 0.0);
+        double amount = trade.value("amount", 0.0);
+        // direction is the aggressor, it trades against the other side
+        OrderSide passive = trade.value("direction", std::string()) == "buy" ? OrderSide::SELL : OrderSide::BUY;
+
+        double consumed = 0.0;   // Taken by our earlier orders in this print
+        for (SimOrder* order : restingIt->second) {
+            if (order->side != passive || order->state != "open" || !crosses(order->side, order->price, price)) {
+                continue;
+            }
+
+            double available;
+            if (std::fabs(order->price - price) > kEpsilon) {
+                // Printed through our price, everything ahead of us is gone
+                order->queueAhead = 0.0;
+                available = amount - consumed;
+            } else {
+                double ahead = std::min(order->queueAhead, amount);
+                order->queueAhead -= ahead;
+                available = amount - ahead - consumed;
+            }
+            if (available <= kEpsilon) {
+                continue;
+            }
+
+            double filled = std::min(order->remaining(), available);
+            consumed += filled;
+            publishTrade(fill(*order, order->price, filled, true));
+            publishOrder(*order);
+            if (order->state != "open") {
+                done.push_back(order);
+            }
+        }
+    }
+    for (SimOrder* order : done) {
+        close(*order);
+    }
+}
+
+nlohmann::json MatchingSimulator::fill(SimOrder& order, double price, double amount, bool maker) {
+    order.filled += amount;
+    order.filledValue += price * amount;
+    order.updatedNs = m_now;
+    if (order.remaining() <= kEpsilon) {
+        order.state = "filled";
+    }
+
+    ++(maker ? m_stats.makerFills : m_stats.takerFills);
+    m_stats.filledAmount += amount;
+
+    return {
+        {"trade_id", "SIM-T" + std::to_string(m_nextTradeId++)},
+        {"order_id", order.orderId},
+        {"label", order.label},
+        {"instrument_name", order.instrument},
+        {"direction", order.side == OrderSide::BUY ? "buy" : "sell"},
+        {"price", price},
+        {"amount", amount},
+        {"timestamp", m_now / 1000000},
+        {"liquidity", maker ? "M" : "T"},
+        {"fee", 0.0},
+        {"order_type", order.type == OrderType::MARKET ? "market" : "limit"},
+        {"state", order.state}
+    };
+}
+
+void MatchingSimulator::publishOrder(const SimOrder& order) {
+    if (m_orderCallback) {
+        schedule(m_now + m_config.orderResponseLatencyNs, [this, data = orderToJson(order)] {
+            m_orderCallback(data);
+        });
+    }
+}
+
+void MatchingSimulator::publishTrade(const nlohmann::json& trade) {
+    if (m_tradeCallback) {
+        schedule(m_now + m_config.orderResponseLatencyNs, [this, trade] {
+            m_tradeCallback(trade);
+        });
+    }
+}
+
+void MatchingSimulator::respond(ResponseCallback callback, nlohmann::json response) {
+    if (!callback) {
+        return;
+    }
+    response["jsonrpc"] = "2.0";
+    schedule(m_now + m_config.orderResponseLatencyNs,
+             [callback = std::move(callback), response = std::move(response)] {
+                 callback(response);
+             });
+}
+
+nlohmann::json MatchingSimulator::orderToJson(const SimOrder& order) {
+    return {
+        {"order_id", order.orderId},
+        {"label", order.label},
+        {"instrument_name", order.instrument},
+        {"direction", order.side == OrderSide::BUY ? "buy" : "sell"},
+        {"order_type", order.type == OrderType::MARKET ? "market" : "limit"},
+        {"order_state", order.state},
+        {"price", std::isfinite(order.price) ? order.price : 0.0},
+        {"amount", order.amount},
+        {"filled_amount", order.filled},
+        {"average_price", order.filled > 0.0 ? order.filledValue / order.filled : 0.0},
+        {"post_only", order.postOnly},
+        {"reduce_only", order.reduceOnly},
+        {"creation_timestamp", order.createdNs / 1000000},
+        {"last_update_timestamp", order.updatedNs / 1000000}
+    };
+}
+
+nlohmann::json MatchingSimulator::error(int code, const std::string& message) {
+    return {{"error", {{"code", code}, {"message", message}}}};
+}
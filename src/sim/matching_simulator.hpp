@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "capture/capture_reader.hpp"
+#include "market/market_data.hpp"
+#include "order/order.hpp"
+#include "order/order_transport.hpp"
+
+struct SimulatorConfig {
+    int64_t orderEntryLatencyNs = 500000;     // Our request to the matching engine
+    int64_t orderResponseLatencyNs = 500000;  // Responses and private notifications back
+    int64_t marketDataLatencyNs = 1000000;    // Public feed from the exchange to us
+
+    // Share of a level's decrease (not explained by prints) taken from the
+    // queue ahead of us. 0 assumes cancels come from behind, 1 from ahead.
+    double cancelAheadFraction = 0.5;
+};
+
+struct SimulatorStats {
+    uint64_t events = 0;
+    uint64_t marketMessages = 0;
+    uint64_t ordersReceived = 0;
+    uint64_t rejects = 0;
+    uint64_t makerFills = 0;
+    uint64_t takerFills = 0;
+    double filledAmount = 0.0;
+};
+
+// Discrete-event stand-in for the exchange, for backtesting against
+// replayed market data. The public feed is applied to an exchange-side
+// OrderBook as it arrives and reaches the strategy only after the market
+// data latency. Our orders go through transport(), reach the matching
+// engine after the entry latency, and are answered with the same JSON-RPC
+// responses and user.orders / user.trades payloads as live, so
+// OrderManager and everything behind its callbacks run unchanged.
+//
+// Resting orders are not shown in the book. Each one tracks the volume
+// queued ahead of it at its price: prints at that price work through the
+// queue first, prints through the price fill it outright, and shrinking
+// levels remove part of the queue ahead.
+//
+// Time is virtual and advanced by the feed, so a run is as fast as one
+// core can process it. Not thread-safe; everything, including the
+// strategy's reactions, runs on the thread feeding it.
+class MatchingSimulator {
+public:
+    using PayloadCallback = std::function<void(const std::string& payload)>;
+    using NotificationCallback = std::function<void(const nlohmann::json& data)>;
+
+    explicit MatchingSimulator(const SimulatorConfig& config = SimulatorConfig());
+    ~MatchingSimulator();
+
+    MatchingSimulator(const MatchingSimulator&) = delete;
+    MatchingSimulator& operator=(const MatchingSimulator&) = delete;
+
+    void addInstrument(const std::string& instrument);
+
+    // Order entry for OrderManager: private/buy, sell, edit, cancel,
+    // cancel_by_label and cancel_all(_by_instrument)
+    OrderTransport transport();
+
+    // Delivery to the strategy, e.g. MarketDataManager::processMessage and
+    // OrderManager::onOrderUpdate / onTrade
+    void setMarketDataCallback(PayloadCallback callback);
+    void setOrderCallback(NotificationCallback callback);
+    void setTradeCallback(NotificationCallback callback);
+
+    // One public feed frame at its exchange time. Runs every event due
+    // before it first.
+    void onMarketData(const std::string& payload, int64_t exchangeNs);
+
+    // Feeds a whole capture; returns the frames fed
+    uint64_t replay(CaptureReader& reader, uint32_t connectionId = UINT32_MAX);
+
+    // Runs events up to the given time, or every pending one
+    void advanceTo(int64_t timeNs);
+    void runUntilIdle();
+
+    int64_t now() const { return m_now; }
+    std::shared_ptr<OrderBook> getOrderBook(const std::string& instrument);
+    const SimulatorStats& getStats() const { return m_stats; }
+
+private:
+    struct SimOrder {
+        std::string orderId;
+        std::string label;
+        std::string instrument;
+        OrderSide side = OrderSide::BUY;
+        OrderType type = OrderType::LIMIT;
+        double price = 0.0;
+        double amount = 0.0;
+        double filled = 0.0;
+        double filledValue = 0.0;
+        double queueAhead = 0.0;
+        double lastLevelVolume = 0.0;
+        bool postOnly = false;
+        bool reduceOnly = false;
+        std::string state = "open";
+        uint64_t sequence = 0;
+        int64_t createdNs = 0;
+        int64_t updatedNs = 0;
+
+        double remaining() const { return amount - filled; }
+    };
+
+    struct Event {
+        int64_t timeNs;
+        uint64_t sequence;
+        std::function<void()> action;
+
+        bool operator>(const Event& other) const {
+            return timeNs != other.timeNs ? timeNs > other.timeNs : sequence > other.sequence;
+        }
+    };
+
+    void schedule(int64_t timeNs, std::function<void()> action);
+
+    // Matching engine side, run at arrival time
+    void handleRequest(const std::string& method, const nlohmann::json& params, ResponseCallback callback);
+    nlohmann::json placeOrder(OrderSide side, const nlohmann::json& params);
+    nlohmann::json editOrder(const nlohmann::json& params);
+    nlohmann::json cancelOrder(SimOrder& order);
+    size_t cancelWhere(const std::function<bool(const SimOrder&)>& predicate);
+    void takeLiquidity(SimOrder& order, nlohmann::json& trades);
+    void rest(SimOrder& order);
+    void close(SimOrder& order);
+
+    // Exchange-side feed handling
+    void onBook(const std::string& instrument);
+    void onTrades(const std::string& instrument, const nlohmann::json& trades);
+
+    nlohmann::json fill(SimOrder& order, double price, double amount, bool maker);
+    void publishOrder(const SimOrder& order);
+    void publishTrade(const nlohmann::json& trade);
+    void respond(ResponseCallback callback, nlohmann::json response);
+    static nlohmann::json orderToJson(const SimOrder& order);
+    static nlohmann::json error(int code, const std::string& message);
+
+    SimulatorConfig m_config;
+    int64_t m_now;
+    uint64_t m_nextSequence;
+    uint64_t m_nextOrderId;
+    uint64_t m_nextTradeId;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> m_events;
+
+    // Exchange view of the public feed, applied without delay
+    std::unique_ptr<deribit::MarketDataManager> m_exchangeFeed;
+    std::unordered_map<std::string, std::shared_ptr<OrderBook>> m_books;
+
+    // Live orders by exchange ID; resting ones also per instrument, in
+    // time priority
+    std::unordered_map<std::string, SimOrder> m_orders;
+    std::unordered_map<std::string, std::vector<SimOrder*>> m_resting;
+
+    PayloadCallback m_marketDataCallback;
+    NotificationCallback m_orderCallback;
+    NotificationCallback m_tradeCallback;
+
+    SimulatorStats m_stats;
+};
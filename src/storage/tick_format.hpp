@@ -0,0 +1,125 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk layout of the tick store. Each instrument and table has one
+// append-only file: a file header followed by self-contained blocks.
+// Within a block every column is stored as zigzag varints of the delta to
+// the previous row (the first row against 0), so blocks decode on their
+// own and a crash loses at most the block being written.
+//
+// Prices and amounts are fixed point, value = stored * quantum, with the
+// quanta recorded in the file header.
+
+enum class TickTable : uint8_t {
+    TRADES = 0,
+    TICKERS = 1,
+    BOOK = 2
+};
+
+enum class TickColumnKind : uint8_t {
+    TIME,       // Nanoseconds since the epoch, kept as int64
+    PRICE,      // Scaled by the price quantum
+    AMOUNT,     // Scaled by the amount quantum
+    INTEGER     // Stored as is
+};
+
+struct TickColumnDef {
+    std::string name;
+    TickColumnKind kind;
+};
+
+constexpr char kTickFileMagic[8] = {'D', 'R', 'B', 'T', 'T', 'C', 'K', '1'};
+constexpr uint32_t kTickFileVersion = 1;
+constexpr uint32_t kTickBlockMagic = 0x314b4c42;  // "BLK1"
+constexpr size_t kTickInstrumentNameSize = 64;
+
+struct TickFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t table;
+    uint32_t columnCount;
+    uint32_t bookDepth;             // BOOK only
+    double priceQuantum;
+    double amountQuantum;
+    char instrument[kTickInstrumentNameSize];
+};
+static_assert(sizeof(TickFileHeader) == 104, "tick file header layout changed");
+
+// Followed by columnCount uint32 byte lengths, then the column data, then
+// padding to 8 bytes
+struct TickBlockHeader {
+    uint32_t magic;
+    uint32_t rows;
+    int64_t minTimeNs;
+    int64_t maxTimeNs;
+    uint32_t payloadBytes;          // Lengths array, columns and padding
+    uint32_t columnCount;
+};
+static_assert(sizeof(TickBlockHeader) == 32, "tick block header layout changed");
+
+namespace tickcodec {
+
+inline uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+inline void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Returns the position after the varint, or nullptr if it runs past end
+inline const uint8_t* getVarint(const uint8_t* in, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; in < end && shift < 64; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return in;
+        }
+    }
+    return nullptr;
+}
+
+// Delta + zigzag + varint of one column
+inline void encodeColumn(const int64_t* values, size_t count, std::string& out) {
+    uint64_t previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        // Unsigned arithmetic, deltas may wrap
+        uint64_t current = static_cast<uint64_t>(values[i]);
+        putVarint(out, zigzag(static_cast<int64_t>(current - previous)));
+        previous = current;
+    }
+}
+
+inline bool decodeColumn(const uint8_t* in, const uint8_t* end, int64_t* values, size_t count) {
+    uint64_t previous = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t encoded;
+        in = getVarint(in, end, encoded);
+        if (!in) {
+            return false;
+        }
+        previous += static_cast<uint64_t>(unzigzag(encoded));
+        values[i] = static_cast<int64_t>(previous);
+    }
+    return true;
+}
+
+} // namespace tickcodec
+
+// Column layout of each table. Column 0 is always the time.
+// BOOK has bid_price_<i>, bid_amount_<i>, ask_price_<i>, ask_amount_<i>
+// for every level i below the depth.
+std::vector<TickColumnDef> tickTableSchema(TickTable table, size_t bookDepth);
+const char* tickTableName(TickTable table);
@@ -0,0 +1,537 @@
+#include "storage/tick_store.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    std::string tickFilePath(const std::string& root, const std::string& instrument, TickTable table) {
+        return root + "/" + instrument + "/" + tickTableName(table) + ".ticks";
+    }
+
+    void makeDirectory(const std::string& path) {
+        if (::mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("Failed to create directory " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    void writeAll(int fd, const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t written = ::write(fd, data, length);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("Tick store write failed: ") + std::strerror(errno));
+            }
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+    }
+
+    int64_t toFixed(double value, double perUnit) {
+        return std::llround(value * perUnit);
+    }
+
+    // End of the last complete block, walking the same chain as the reader
+    size_t validBlocksEnd(int fd, size_t size, uint32_t columnCount) {
+        size_t offset = sizeof(TickFileHeader);
+        while (offset + sizeof(TickBlockHeader) <= size) {
+            TickBlockHeader block;
+            if (::pread(fd, &block, sizeof(block), static_cast<off_t>(offset)) !=
+                static_cast<ssize_t>(sizeof(block))) {
+                break;
+            }
+            size_t end = offset + sizeof(block) + block.payloadBytes;
+            if (block.magic != kTickBlockMagic || block.columnCount != columnCount || end > size) {
+                break;
+            }
+            offset = end;
+        }
+        return offset;
+    }
+
+    void truncateTo(int fd, size_t size, const std::string& path) {
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Failed to truncate tick file " + path + ": " + std::strerror(error));
+        }
+    }
+}
+
+std::vector<TickColumnDef> tickTableSchema(TickTable table, size_t bookDepth) {
+    std::vector<TickColumnDef> schema = {{"time", TickColumnKind::TIME}};
+    switch (table) {
+        case TickTable::TRADES:
+            schema.push_back({"price", TickColumnKind::PRICE});
+            schema.push_back({"amount", TickColumnKind::AMOUNT});
+            schema.push_back({"direction", TickColumnKind::INTEGER});  // 1 buy aggressor, -1 sell
+            break;
+        case TickTable::TICKERS:
+            schema.push_back({"best_bid_price", TickColumnKind::PRICE});
+            schema.push_back({"best_bid_amount", TickColumnKind::AMOUNT});
+            schema.push_back({"best_ask_price", TickColumnKind::PRICE});
+            schema.push_back({"best_ask_amount", TickColumnKind::AMOUNT});
+            schema.push_back({"mark_price", TickColumnKind::PRICE});
+            schema.push_back({"index_price", TickColumnKind::PRICE});
+            break;
+        case TickTable::BOOK:
+            for (size_t level = 0; level < bookDepth; ++level) {
+                std::string suffix = "_" + std::to_string(level);
+                schema.push_back({"bid_price" + suffix, TickColumnKind::PRICE});
+                schema.push_back({"bid_amount" + suffix, TickColumnKind::AMOUNT});
+                schema.push_back({"ask_price" + suffix, TickColumnKind::PRICE});
+                schema.push_back({"ask_amount" + suffix, TickColumnKind::AMOUNT});
+            }
+            break;
+    }
+    return schema;
+}
+
+const char* tickTableName(TickTable table) {
+    switch (table) {
+        case TickTable::TRADES: return "trades";
+        case TickTable::TICKERS: return "tickers";
+        case TickTable::BOOK: return "book";
+    }
+    return "unknown";
+}
+
+// TickStoreWriter
+
+TickStoreWriter::TickStoreWriter(const std::string& root, size_t bookDepth, size_t rowsPerBlock)
+    : m_root(root)
+    , m_bookDepth(bookDepth)
+    , m_rowsPerBlock(rowsPerBlock)
+    , m_rowsWritten(0)
+    , m_bytesWritten(0) {
+    if (bookDepth == 0 || rowsPerBlock == 0) {
+        throw std::invalid_argument("Book depth and rows per block must be positive");
+    }
+    makeDirectory(m_root);
+}
+
+TickStoreWriter::~TickStoreWriter() {
+    try {
+        flush();
+    } catch (...) {
+        // Nothing sensible to do with a failed write during destruction
+    }
+    for (auto& [instrument, state] : m_instruments) {
+        for (auto& series : state.tables) {
+            if (series && series->fd >= 0) {
+                ::close(series->fd);
+            }
+        }
+    }
+}
+
+void TickStoreWriter::registerInstrument(const std::string& instrument, const TickInstrumentSpec& spec) {
+    if (instrument.empty() || instrument.size() >= kTickInstrumentNameSize ||
+        instrument.find('/') != std::string::npos) {
+        throw std::invalid_argument("Invalid instrument name for tick store: " + instrument);
+    }
+    if (!(spec.priceQuantum > 0.0) || !(spec.amountQuantum > 0.0)) {
+        throw std::invalid_argument("Tick store quanta must be positive");
+    }
+    auto& state = m_instruments[instrument];
+    state.spec = spec;
+    state.pricesPerUnit = 1.0 / spec.priceQuantum;
+    state.amountsPerUnit = 1.0 / spec.amountQuantum;
+}
+
+void TickStoreWriter::appendTrade(const std::string& instrument, const TradeTick& trade) {
+    auto& state = instrumentFor(instrument);
+    auto& series = seriesFor(instrument, state, TickTable::TRADES);
+    series.columns[0].push_back(trade.timeNs);
+    series.columns[1].push_back(toFixed(trade.price, state.pricesPerUnit));
+    series.columns[2].push_back(toFixed(trade.amount, state.amountsPerUnit));
+    series.columns[3].push_back(trade.buyAggressor ? 1 : -1);
+    endRow(series);
+}
+
+void TickStoreWriter::appendTicker(const std::string& instrument, const TickerTick& ticker) {
+    auto& state = instrumentFor(instrument);
+    auto& series = seriesFor(instrument, state, TickTable::TICKERS);
+    series.columns[0].push_back(ticker.timeNs);
+    series.columns[1].push_back(toFixed(ticker.bestBidPrice, state.pricesPerUnit));
+    series.columns[2].push_back(toFixed(ticker.bestBidAmount, state.amountsPerUnit));
+    series.columns[3].push_back(toFixed(ticker.bestAskPrice, state.pricesPerUnit));
+    series.columns[4].push_back(toFixed(ticker.bestAskAmount, state.amountsPerUnit));
+    series.columns[5].push_back(toFixed(ticker.markPrice, state.pricesPerUnit));
+    series.columns[6].push_back(toFixed(ticker.indexPrice, state.pricesPerUnit));
+    endRow(series);
+}
+
+void TickStoreWriter::appendBook(const std::string& instrument, int64_t timeNs,
+                                 const std::pair<double, double>* bids, size_t bidCount,
+                                 const std::pair<double, double>* asks, size_t askCount) {
+    auto& state = instrumentFor(instrument);
+    auto& series = seriesFor(instrument, state, TickTable::BOOK);
+    series.columns[0].push_back(timeNs);
+    for (size_t level = 0; level < m_bookDepth; ++level) {
+        auto* column = &series.columns[1 + level * 4];
+        bool hasBid = level < bidCount;
+        bool hasAsk = level < askCount;
+        column[0].push_back(hasBid ? toFixed(bids[level].first, state.pricesPerUnit) : 0);
+        column[1].push_back(hasBid ? toFixed(bids[level].second, state.amountsPerUnit) : 0);
+        column[2].push_back(hasAsk ? toFixed(asks[level].first, state.pricesPerUnit) : 0);
+        column[3].push_back(hasAsk ? toFixed(asks[level].second, state.amountsPerUnit) : 0);
+    }
+    endRow(series);
+}
+
+void TickStoreWriter::flush() {
+    for (auto& [instrument, state] : m_instruments) {
+        for (auto& series : state.tables) {
+            if (series && series->rows > 0) {
+                writeBlock(*series);
+            }
+        }
+    }
+}
+
+TickStoreWriter::InstrumentSeries& TickStoreWriter::instrumentFor(const std::string& instrument) {
+    auto it = m_instruments.find(instrument);
+    if (it == m_instruments.end()) {
+        throw std::invalid_argument("Instrument not registered with the tick store: " + instrument);
+    }
+    return it->second;
+}
+
+TickStoreWriter::Series& TickStoreWriter::seriesFor(const std::string& instrument, InstrumentSeries& state,
+                                                    TickTable table) {
+    auto& slot = state.tables[static_cast<size_t>(table)];
+    if (slot) {
+        return *slot;
+    }
+
+    auto series = std::make_unique<Series>();
+    series->table = table;
+    series->schema = tickTableSchema(table, m_bookDepth);
+    series->columns.resize(series->schema.size());
+    for (auto& column : series->columns) {
+        column.reserve(m_rowsPerBlock);
+    }
+
+    makeDirectory(m_root + "/" + instrument);
+    std::string path = tickFilePath(m_root, instrument, table);
+    // Read as well, reopening checks the header and block chain
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open tick file " + path + ": " + std::strerror(errno));
+    }
+    series->fd = fd;
+
+    TickFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kTickFileMagic, sizeof(header.magic));
+    header.version = kTickFileVersion;
+    header.table = static_cast<uint32_t>(table);
+    header.columnCount = static_cast<uint32_t>(series->schema.size());
+    header.bookDepth = table == TickTable::BOOK ? static_cast<uint32_t>(m_bookDepth) : 0;
+    header.priceQuantum = state.spec.priceQuantum;
+    header.amountQuantum = state.spec.amountQuantum;
+    std::memcpy(header.instrument, instrument.data(), instrument.size());
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to stat tick file " + path + ": " + std::strerror(errno));
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    if (size > 0 && size < sizeof(TickFileHeader)) {
+        // Cut short while the header was written, start over
+        truncateTo(fd, 0, path);
+        size = 0;
+    }
+    if (size > 0) {
+        // Appending to an existing file, its layout has to match
+        TickFileHeader existing;
+        if (::pread(fd, &existing, sizeof(existing), 0) != static_cast<ssize_t>(sizeof(existing)) ||
+            std::memcmp(existing.magic, header.magic, sizeof(header.magic)) != 0 ||
+            existing.version != header.version ||
+            existing.table != header.table ||
+            existing.columnCount != header.columnCount ||
+            existing.bookDepth != header.bookDepth ||
+            existing.priceQuantum != header.priceQuantum ||
+            existing.amountQuantum != header.amountQuantum) {
+            ::close(fd);
+            throw std::runtime_error("Existing tick file has a different layout: " + path);
+        }
+
+        // Readers stop at the first bad block, so a block torn by a crash
+        // is cut off before anything is appended behind it
+        size_t end = validBlocksEnd(fd, size, header.columnCount);
+        if (end < size) {
+            truncateTo(fd, end, path);
+        }
+    } else {
+        writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header));
+        m_bytesWritten += sizeof(header);
+    }
+
+    slot = std::move(series);
+    return *slot;
+}
+
+void TickStoreWriter::endRow(Series& series) {
+    ++m_rowsWritten;
+    if (++series.rows >= m_rowsPerBlock) {
+        writeBlock(series);
+    }
+}
+
+void TickStoreWriter::writeBlock(Series& series) {
+    const size_t columnCount = series.columns.size();
+    const auto& times = series.columns[0];
+
+    TickBlockHeader header;
+    header.magic = kTickBlockMagic;
+    header.rows = static_cast<uint32_t>(series.rows);
+    header.minTimeNs = *std::min_element(times.begin(), times.end());
+    header.maxTimeNs = *std::max_element(times.begin(), times.end());
+    header.columnCount = static_cast<uint32_t>(columnCount);
+
+    // Header and length table are patched in once the columns are encoded
+    std::string& buffer = m_encodeBuffer;
+    size_t lengthsOffset = sizeof(TickBlockHeader);
+    buffer.assign(lengthsOffset + columnCount * sizeof(uint32_t), '\0');
+    for (size_t i = 0; i < columnCount; ++i) {
+        size_t before = buffer.size();
+        tickcodec::encodeColumn(series.columns[i].data(), series.rows, buffer);
+        uint32_t length = static_cast<uint32_t>(buffer.size() - before);
+        std::memcpy(&buffer[lengthsOffset + i * sizeof(uint32_t)], &length, sizeof(length));
+    }
+    buffer.resize((buffer.size() + 7) & ~static_cast<size_t>(7), '\0');
+
+    header.payloadBytes = static_cast<uint32_t>(buffer.size() - sizeof(TickBlockHeader));
+    std::memcpy(&buffer[0], &header, sizeof(header));
+    writeAll(series.fd, buffer.data(), buffer.size());
+    m_bytesWritten += buffer.size();
+
+    for (auto& column : series.columns) {
+        column.clear();
+    }
+    series.rows = 0;
+}
+
+// TickColumns
+
+ColumnSpan<double> TickColumns::values(size_t column) const {
+    if (column == 0 || column >= m_values.size()) {
+        throw std::out_of_range("No such tick column");
+    }
+    return {m_values[column].data(), m_values[column].size()};
+}
+
+ColumnSpan<double> TickColumns::values(const std::string& name) const {
+    for (size_t i = 1; i < m_schema.size(); ++i) {
+        if (m_schema[i].name == name) {
+            return values(i);
+        }
+    }
+    throw std::out_of_range("No tick column named " + name);
+}
+
+// TickStoreReader
+
+TickStoreReader::TickStoreReader(const std::string& root) : m_root(root) {}
+
+TickStoreReader::~TickStoreReader() {
+    for (auto& [path, file] : m_files) {
+        ::munmap(const_cast<uint8_t*>(file->data), file->size);
+    }
+}
+
+void TickStoreReader::query(TickTable table, const std::string& instrument, int64_t fromNs, int64_t toNs,
+                            TickColumns& out) {
+    out.m_instrument = instrument;
+    out.m_table = table;
+    out.m_time.clear();
+    for (auto& column : out.m_values) {
+        column.clear();
+    }
+
+    MappedFile* file = open(table, instrument);
+    if (!file) {
+        out.m_schema = tickTableSchema(table, 0);
+        out.m_values.resize(out.m_schema.size());
+        return;
+    }
+    out.m_schema = file->schema;
+    out.m_values.resize(file->schema.size());
+
+    for (const auto& block : file->blocks) {
+        if (block.maxTimeNs < fromNs || block.minTimeNs > toNs) {
+            continue;
+        }
+        decodeBlock(*file, block, fromNs, toNs, out);
+    }
+}
+
+std::vector<TickColumns> TickStoreReader::query(TickTable table, const std::vector<std::string>& instruments,
+                                                int64_t fromNs, int64_t toNs) {
+    std::vector<TickColumns> results(instruments.size());
+    for (size_t i = 0; i < instruments.size(); ++i) {
+        query(table, instruments[i], fromNs, toNs, results[i]);
+    }
+    return results;
+}
+
+std::vector<std::string> TickStoreReader::listInstruments() const {
+    std::vector<std::string> instruments;
+    DIR* dir = ::opendir(m_root.c_str());
+    if (!dir) {
+        return instruments;
+    }
+    while (dirent* entry = ::readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        for (TickTable table : {TickTable::TRADES, TickTable::TICKERS, TickTable::BOOK}) {
+            struct stat info;
+            if (::stat(tickFilePath(m_root, name, table).c_str(), &info) == 0) {
+                instruments.push_back(name);
+                break;
+            }
+        }
+    }
+    ::closedir(dir);
+    std::sort(instruments.begin(), instruments.end());
+    return instruments;
+}
+
+uint64_t TickStoreReader::countRows(TickTable table, const std::string& instrument) {
+    MappedFile* file = open(table, instrument);
+    return file ? file->rows : 0;
+}
+
+uint64_t TickStoreReader::fileBytes(TickTable table, const std::string& instrument) {
+    MappedFile* file = open(table, instrument);
+    return file ? file->size : 0;
+}
+
+TickStoreReader::MappedFile* TickStoreReader::open(TickTable table, const std::string& instrument) {
+    std::string path = tickFilePath(m_root, instrument, table);
+    auto it = m_files.find(path);
+    if (it != m_files.end()) {
+        return it->second.get();
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(TickFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a tick file: " + path);
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Failed to map tick file " + path + ": " + std::strerror(errno));
+    }
+
+    auto file = std::make_unique<MappedFile>();
+    file->data = static_cast<const uint8_t*>(map);
+    file->size = size;
+    std::memcpy(&file->header, file->data, sizeof(TickFileHeader));
+    if (std::memcmp(file->header.magic, kTickFileMagic, sizeof(kTickFileMagic)) != 0 ||
+        file->header.version != kTickFileVersion || file->header.table != static_cast<uint32_t>(table)) {
+        ::munmap(map, size);
+        throw std::runtime_error("Not a tick file or unsupported version: " + path);
+    }
+    file->schema = tickTableSchema(table, file->header.bookDepth);
+    if (file->schema.size() != file->header.columnCount) {
+        ::munmap(map, size);
+        throw std::runtime_error("Tick file column count does not match its table: " + path);
+    }
+
+    // The time index is the chain of block headers; a block cut short by
+    // a crash ends the file
+    size_t offset = sizeof(TickFileHeader);
+    while (offset + sizeof(TickBlockHeader) <= size) {
+        TickBlockHeader block;
+        std::memcpy(&block, file->data + offset, sizeof(block));
+        size_t end = offset + sizeof(block) + block.payloadBytes;
+        if (block.magic != kTickBlockMagic || block.columnCount != file->header.columnCount || end > size) {
+            break;
+        }
+        file->blocks.push_back({block.minTimeNs, block.maxTimeNs, offset, block.rows, block.payloadBytes});
+        file->rows += block.rows;
+        offset = end;
+    }
+    ::madvise(map, size, MADV_RANDOM);
+
+    MappedFile* result = file.get();
+    m_files[path] = std::move(file);
+    return result;
+}
+
+void TickStoreReader::decodeBlock(const MappedFile& file, const BlockIndex& block, int64_t fromNs, int64_t toNs,
+                                  TickColumns& out) {
+    const uint8_t* base = file.data + block.offset;
+    const size_t columnCount = file.header.columnCount;
+    const uint8_t* lengths = base + sizeof(TickBlockHeader);
+    const uint8_t* column = lengths + columnCount * sizeof(uint32_t);
+    const uint8_t* end = base + sizeof(TickBlockHeader) + block.payloadBytes;
+    const size_t rows = block.rows;
+
+    m_scratch.resize(rows);
+    m_selected.clear();
+    bool whole = block.minTimeNs >= fromNs && block.maxTimeNs <= toNs;
+
+    for (size_t c = 0; c < columnCount; ++c) {
+        uint32_t length;
+        std::memcpy(&length, lengths + c * sizeof(uint32_t), sizeof(length));
+        if (column + length > end || !tickcodec::decodeColumn(column, column + length, m_scratch.data(), rows)) {
+            throw std::runtime_error("Corrupt block in tick file for " + out.m_instrument);
+        }
+        column += length;
+
+        if (c == 0) {
+            if (whole) {
+                out.m_time.insert(out.m_time.end(), m_scratch.begin(), m_scratch.end());
+            } else {
+                for (uint32_t row = 0; row < rows; ++row) {
+                    if (m_scratch[row] >= fromNs && m_scratch[row] <= toNs) {
+                        m_selected.push_back(row);
+                        out.m_time.push_back(m_scratch[row]);
+                    }
+                }
+                if (m_selected.empty()) {
+                    return;
+                }
+            }
+            continue;
+        }
+
+        double scale = 1.0;
+        if (file.schema[c].kind == TickColumnKind::PRICE) {
+            scale = file.header.priceQuantum;
+        } else if (file.schema[c].kind == TickColumnKind::AMOUNT) {
+            scale = file.header.amountQuantum;
+        }
+        auto& values = out.m_values[c];
+        if (whole) {
+            for (size_t row = 0; row < rows; ++row) {
+                values.push_back(static_cast<double>(m_scratch[row]) * scale);
+            }
+        } else {
+            for (uint32_t row : m_selected) {
+                values.push_back(static_cast<double>(m_scratch[row]) * scale);
+            }
+        }
+    }
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "storage/tick_format.hpp"
+
+// Read-only view of a contiguous column, valid while its owner lives
+template<typename T>
+class ColumnSpan {
+public:
+    ColumnSpan() : m_data(nullptr), m_size(0) {}
+    ColumnSpan(const T* data, size_t size) : m_data(data), m_size(size) {}
+
+    const T* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const T& operator[](size_t index) const { return m_data[index]; }
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+
+private:
+    const T* m_data;
+    size_t m_size;
+};
+
+// Fixed-point resolution of one instrument's prices and amounts. Values
+// are rounded to the quantum when written.
+struct TickInstrumentSpec {
+    double priceQuantum = 0.01;
+    double amountQuantum = 0.0001;
+};
+
+struct TradeTick {
+    int64_t timeNs = 0;
+    double price = 0.0;
+    double amount = 0.0;
+    bool buyAggressor = false;
+};
+
+struct TickerTick {
+    int64_t timeNs = 0;
+    double bestBidPrice = 0.0;
+    double bestBidAmount = 0.0;
+    double bestAskPrice = 0.0;
+    double bestAskAmount = 0.0;
+    double markPrice = 0.0;
+    double indexPrice = 0.0;
+};
+
+// Appends ticks to <root>/<instrument>/<table>.ticks. Rows are buffered per
+// file and written as one compressed block every rowsPerBlock rows and on
+// flush(). Not thread-safe.
+class TickStoreWriter {
+public:
+    TickStoreWriter(const std::string& root, size_t bookDepth = 10, size_t rowsPerBlock = 4096);
+    ~TickStoreWriter();
+
+    TickStoreWriter(const TickStoreWriter&) = delete;
+    TickStoreWriter& operator=(const TickStoreWriter&) = delete;
+
+    // Must be called before the instrument's first tick
+    void registerInstrument(const std::string& instrument, const TickInstrumentSpec& spec);
+
+    void appendTrade(const std::string& instrument, const TradeTick& trade);
+    void appendTicker(const std::string& instrument, const TickerTick& ticker);
+    // Top of book as (price, amount), best first. Missing levels are 0.
+    void appendBook(const std::string& instrument, int64_t timeNs,
+                    const std::pair<double, double>* bids, size_t bidCount,
+                    const std::pair<double, double>* asks, size_t askCount);
+
+    void flush();
+
+    size_t getBookDepth() const { return m_bookDepth; }
+    uint64_t getRowsWritten() const { return m_rowsWritten; }
+    uint64_t getBytesWritten() const { return m_bytesWritten; }
+
+private:
+    struct Series {
+        int fd = -1;
+        TickTable table = TickTable::TRADES;
+        std::vector<TickColumnDef> schema;
+        std::vector<std::vector<int64_t>> columns;
+        size_t rows = 0;
+    };
+
+    struct InstrumentSeries {
+        TickInstrumentSpec spec;
+        double pricesPerUnit = 0.0;
+        double amountsPerUnit = 0.0;
+        std::unique_ptr<Series> tables[3];
+    };
+
+    InstrumentSeries& instrumentFor(const std::string& instrument);
+    Series& seriesFor(const std::string& instrument, InstrumentSeries& state, TickTable table);
+    void endRow(Series& series);
+    void writeBlock(Series& series);
+
+    std::string m_root;
+    size_t m_bookDepth;
+    size_t m_rowsPerBlock;
+    std::map<std::string, InstrumentSeries> m_instruments;
+    std::string m_encodeBuffer;
+    uint64_t m_rowsWritten;
+    uint64_t m_bytesWritten;
+};
+
+// Decoded columns of one table and instrument for a time range. Spans stay
+// valid until the next query into this object.
+class TickColumns {
+public:
+    const std::string& instrument() const { return m_instrument; }
+    TickTable table() const { return m_table; }
+    size_t rows() const { return m_time.size(); }
+
+    ColumnSpan<int64_t> time() const { return {m_time.data(), m_time.size()}; }
+    // Column index as in tickTableSchema(), 1 and up
+    ColumnSpan<double> values(size_t column) const;
+    ColumnSpan<double> values(const std::string& name) const;
+    const std::vector<TickColumnDef>& schema() const { return m_schema; }
+
+private:
+    friend class TickStoreReader;
+
+    std::string m_instrument;
+    TickTable m_table = TickTable::TRADES;
+    std::vector<TickColumnDef> m_schema;
+    std::vector<int64_t> m_time;
+    std::vector<std::vector<double>> m_values;  // Index 0 unused
+};
+
+// Maps tick files read-only. Each file's block headers form its time
+// index; a query decodes only the blocks overlapping the range.
+class TickStoreReader {
+public:
+    explicit TickStoreReader(const std::string& root);
+    ~TickStoreReader();
+
+    TickStoreReader(const TickStoreReader&) = delete;
+    TickStoreReader& operator=(const TickStoreReader&) = delete;
+
+    // Inclusive range; reuses out's buffers
+    void query(TickTable table, const std::string& instrument, int64_t fromNs, int64_t toNs,
+               TickColumns& out);
+    std::vector<TickColumns> query(TickTable table, const std::vector<std::string>& instruments,
+                                   int64_t fromNs, int64_t toNs);
+
+    // Instruments with at least one table on disk
+    std::vector<std::string> listInstruments() const;
+
+    // Rows and bytes of one file, 0 if it does not exist
+    uint64_t countRows(TickTable table, const std::string& instrument);
+    uint64_t fileBytes(TickTable table, const std::string& instrument);
+
+private:
+    struct BlockIndex {
+        int64_t minTimeNs;
+        int64_t maxTimeNs;
+        size_t offset;      // Of the block header
+        uint32_t rows;
+        uint32_t payloadBytes;
+    };
+
+    struct MappedFile {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        TickFileHeader header;
+        std::vector<TickColumnDef> schema;
+        std::vector<BlockIndex> blocks;
+        uint64_t rows = 0;
+    };
+
+    MappedFile* open(TickTable table, const std::string& instrument);
+    void decodeBlock(const MappedFile& file, const BlockIndex& block, int64_t fromNs, int64_t toNs,
+                     TickColumns& out);
+
+    std::string m_root;
+    std::map<std::string, std::unique_ptr<MappedFile>> m_files;
+    std::vector<int64_t> m_scratch;
+    std::vector<uint32_t> m_selected;
+};
@@ -0,0 +1,397 @@
+#include "strategy/quote_engine.hpp"
+#include "utils/tsc_clock.hpp"
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    // Retry delays after a rejected place, doubling per rejection
+    constexpr int64_t kMinPlaceBackoffNs = 10000000;      // 10 ms
+    constexpr int64_t kMaxPlaceBackoffNs = 1000000000;    // 1 s
+}
+
+QuoteEngine::QuoteEngine(OrderManager& orders, size_t maxInstruments)
+    : m_orders(orders)
+    , m_instruments(new InstrumentState[maxInstruments])
+    , m_maxInstruments(maxInstruments)
+    , m_instrumentCount(0) {
+    m_dirty.reserve(maxInstruments);
+    m_stillDirty.reserve(maxInstruments);
+    m_ops.reserve(maxInstruments * 2 * kMaxOpsPerSide);
+    m_slotByClientId.reserve(maxInstruments * 2 * kSlotsPerSide);
+}
+
+uint32_t QuoteEngine::registerInstrument(const std::string& instrument, double tickSize,
+                                         double minAmount) {
+    if (tickSize <= 0.0) {
+        throw std::invalid_argument("Tick size must be positive for " + instrument);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_instrumentIds.find(instrument);
+    if (it != m_instrumentIds.end()) {
+        return it->second;
+    }
+    if (m_instrumentCount >= m_maxInstruments) {
+        throw std::runtime_error("Too many instruments registered with quote engine");
+    }
+
+    uint32_t id = m_instrumentCount++;
+    InstrumentState& state = m_instruments[id];
+    state.name = instrument;
+    state.tickSize = tickSize;
+    state.invTickSize = 1.0 / tickSize;
+    state.halfTick = tickSize / 2.0;
+    state.amountEpsilon = minAmount > 0.0 ? minAmount / 2.0 : 1e-9;
+    m_instrumentIds.emplace(instrument, id);
+    return id;
+}
+
+uint32_t QuoteEngine::getInstrumentId(const std::string& instrument) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_instrumentIds.find(instrument);
+    return (it != m_instrumentIds.end()) ? it->second : kUnknownInstrument;
+}
+
+void QuoteEngine::setQuotes(uint32_t instrumentId, OrderSide side, const QuoteLevel* levels,
+                            size_t count) {
+    if (count > kMaxQuoteLevels) {
+        throw std::invalid_argument("Quote ladder deeper than kMaxQuoteLevels");
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (instrumentId >= m_instrumentCount) {
+        throw std::invalid_argument("Unknown quote instrument");
+    }
+    InstrumentState& state = m_instruments[instrumentId];
+    SideState& sideState = state.sides[sideIndex(side)];
+
+    // Snap to the tick first so an unchanged ladder compares equal
+    QuoteLevel snapped[kMaxQuoteLevels];
+    uint8_t snappedCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (levels[i].amount < state.amountEpsilon) {
+            continue;
+        }
+        snapped[snappedCount].price = std::round(levels[i].price * state.invTickSize) * state.tickSize;
+        snapped[snappedCount].amount = levels[i].amount;
+        ++snappedCount;
+    }
+
+    bool changed = snappedCount != sideState.desiredCount;
+    for (uint8_t i = 0; i < snappedCount && !changed; ++i) {
+        changed = std::fabs(snapped[i].price - sideState.desired[i].price) >= state.halfTick ||
+                  std::fabs(snapped[i].amount - sideState.desired[i].amount) >= state.amountEpsilon;
+    }
+    if (!changed) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < snappedCount; ++i) {
+        sideState.desired[i] = snapped[i];
+    }
+    sideState.desiredCount = snappedCount;
+    markDirty(instrumentId);
+}
+
+void QuoteEngine::pullQuotes(uint32_t instrumentId) {
+    setQuotes(instrumentId, OrderSide::BUY, nullptr, 0);
+    setQuotes(instrumentId, OrderSide::SELL, nullptr, 0);
+}
+
+size_t QuoteEngine::runCycle() {
+    uint64_t start = utils::TscClock::ticks();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        computeDiffLocked();
+    }
+
+    // Sending takes the order manager's locks, so ours is not held here
+    for (const auto& op : m_ops) {
+        execute(op);
+    }
+
+    int64_t elapsed = utils::TscClock::ticksToNs(
+        static_cast<int64_t>(utils::TscClock::ticks() - start));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cycleLatency.record(static_cast<uint64_t>(elapsed));
+    ++m_stats.cycles;
+    return m_ops.size();
+}
+
+const std::vector<QuoteOp>& QuoteEngine::computeDiff() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return computeDiffLocked();
+}
+
+const std::vector<QuoteOp>& QuoteEngine::computeDiffLocked() {
+    m_ops.clear();
+    m_stillDirty.clear();
+    m_cycleNowNs = utils::TscClock::nowNs();
+
+    for (uint32_t id : m_dirty) {
+        InstrumentState& state = m_instruments[id];
+        state.dirty = false;
+
+        bool waiting = false;
+        diffSide(id, state, OrderSide::BUY, waiting);
+        diffSide(id, state, OrderSide::SELL, waiting);
+
+        // Revisit next cycle once the pending orders are acknowledged
+        if (waiting) {
+            state.dirty = true;
+            m_stillDirty.push_back(id);
+        }
+    }
+
+    m_dirty.swap(m_stillDirty);
+    return m_ops;
+}
+
+void QuoteEngine::diffSide(uint32_t instrumentId, InstrumentState& state, OrderSide side,
+                           bool& waiting) {
+    SideState& sideState = state.sides[sideIndex(side)];
+    bool matched[kMaxQuoteLevels] = {};
+    bool kept[kSlotsPerSide] = {};
+
+    auto isWorking = [](const Slot& slot) {
+        return slot.state == SlotState::PENDING_NEW || slot.state == SlotState::LIVE;
+    };
+    auto emit = [&](QuoteOpType type, size_t slot, double price, double amount) {
+        m_ops.push_back({type, instrumentId, side, static_cast<uint8_t>(slot), price, amount});
+    };
+
+    // Orders already resting at a wanted price stay, at most resized
+    for (size_t i = 0; i < kSlotsPerSide; ++i) {
+        Slot& slot = sideState.slots[i];
+        if (!isWorking(slot)) {
+            continue;
+        }
+        for (uint8_t j = 0; j < sideState.desiredCount; ++j) {
+            const QuoteLevel& level = sideState.desired[j];
+            if (matched[j] || std::fabs(slot.price - level.price) >= state.halfTick) {
+                continue;
+            }
+            matched[j] = kept[i] = true;
+            if (std::fabs(slot.remaining() - level.amount) >= state.amountEpsilon) {
+                if (slot.state == SlotState::LIVE) {
+                    slot.totalAmount = slot.filled + level.amount;
+                    emit(QuoteOpType::EDIT, i, level.price, level.amount);
+                } else {
+                    waiting = true;
+                    ++m_stats.deferred;
+                }
+            }
+            break;
+        }
+    }
+
+    // Remaining orders are moved onto unmatched levels, one edit instead
+    // of a cancel and a place
+    uint8_t next = 0;
+    for (size_t i = 0; i < kSlotsPerSide; ++i) {
+        Slot& slot = sideState.slots[i];
+        if (kept[i] || !isWorking(slot)) {
+            continue;
+        }
+        while (next < sideState.desiredCount && matched[next]) {
+            ++next;
+        }
+        if (next == sideState.desiredCount) {
+            break;
+        }
+
+        const QuoteLevel& level = sideState.desired[next];
+        matched[next] = kept[i] = true;
+        if (slot.state == SlotState::LIVE) {
+            slot.price = level.price;
+            slot.totalAmount = slot.filled + level.amount;
+            emit(QuoteOpType::EDIT, i, level.price, level.amount);
+        } else {
+            waiting = true;
+            ++m_stats.deferred;
+        }
+    }
+
+    // Anything not wanted any more is pulled
+    for (size_t i = 0; i < kSlotsPerSide; ++i) {
+        Slot& slot = sideState.slots[i];
+        if (!kept[i] && isWorking(slot)) {
+            slot.state = SlotState::PENDING_CANCEL;
+            emit(QuoteOpType::CANCEL, i, slot.price, 0.0);
+        }
+    }
+
+    // New levels go into free slots
+    size_t freeSlot = 0;
+    for (uint8_t j = 0; j < sideState.desiredCount; ++j) {
+        if (matched[j]) {
+            continue;
+        }
+        if (m_cycleNowNs < sideState.placeRetryNs) {
+            waiting = true;  // Backing off after a rejection
+            ++m_stats.deferred;
+            break;
+        }
+        while (freeSlot < kSlotsPerSide && sideState.slots[freeSlot].state != SlotState::FREE) {
+            ++freeSlot;
+        }
+        if (freeSlot == kSlotsPerSide) {
+            waiting = true;  // Cancels still in flight
+            ++m_stats.deferred;
+            break;
+        }
+
+        const QuoteLevel& level = sideState.desired[j];
+        Slot& slot = sideState.slots[freeSlot];
+        slot.state = SlotState::PENDING_NEW;
+        slot.price = level.price;
+        slot.totalAmount = level.amount;
+        slot.filled = 0.0;
+        emit(QuoteOpType::PLACE, freeSlot, level.price, level.amount);
+    }
+}
+
+void QuoteEngine::execute(const QuoteOp& op) {
+    InstrumentState& state = m_instruments[op.instrumentId];
+    size_t side = sideIndex(op.side);
+
+    switch (op.type) {
+        case QuoteOpType::PLACE: {
+            std::string clientOrderId = m_orders.nextClientOrderId();
+            {
+                // Indexed before sending so the first update always finds it
+                std::lock_guard<std::mutex> lock(m_mutex);
+                Slot& slot = state.sides[side].slots[op.slot];
+                slot.clientOrderId = clientOrderId;
+                m_slotByClientId[clientOrderId] = {op.instrumentId, static_cast<uint8_t>(side), op.slot};
+                ++m_stats.places;
+            }
+            m_orders.submitOrder(state.name, op.side, OrderType::LIMIT, op.price, op.amount,
+                                 true, false, clientOrderId);
+            break;
+        }
+        case QuoteOpType::EDIT: {
+            double totalAmount;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                const Slot& slot = state.sides[side].slots[op.slot];
+                if (slot.state != SlotState::LIVE) {
+                    return;  // Closed since the diff
+                }
+                m_scratchId = slot.clientOrderId;
+                totalAmount = slot.totalAmount;
+                ++m_stats.edits;
+            }
+            if (!m_orders.modifyOrder(m_scratchId, op.price, totalAmount)) {
+                // Never sent, the slot goes back to the order as it rests
+                auto order = m_orders.getByClientId(m_scratchId);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                Slot& slot = state.sides[side].slots[op.slot];
+                if (order && slot.state == SlotState::LIVE && slot.clientOrderId == m_scratchId) {
+                    slot.price = order->getPrice();
+                    slot.totalAmount = order->getAmount();
+                }
+            }
+            break;
+        }
+        case QuoteOpType::CANCEL: {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                const Slot& slot = state.sides[side].slots[op.slot];
+                if (slot.state != SlotState::PENDING_CANCEL) {
+                    return;
+                }
+                m_scratchId = slot.clientOrderId;
+                ++m_stats.cancels;
+            }
+            if (!m_orders.cancelOrder(m_scratchId)) {
+                // Not sent, the order still rests; the next cycle retries
+                std::lock_guard<std::mutex> lock(m_mutex);
+                Slot& slot = state.sides[side].slots[op.slot];
+                if (slot.state == SlotState::PENDING_CANCEL && slot.clientOrderId == m_scratchId) {
+                    slot.state = SlotState::LIVE;
+                    markDirty(op.instrumentId);
+                }
+            }
+            break;
+        }
+    }
+}
+
+void QuoteEngine::onOrderUpdate(const Order& order) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_slotByClientId.find(order.getClientOrderId());
+    if (it == m_slotByClientId.end()) {
+        return;  // Not a quote
+    }
+
+    const SlotRef ref = it->second;
+    InstrumentState& state = m_instruments[ref.instrumentId];
+    SideState& sideState = state.sides[ref.side];
+    Slot& slot = sideState.slots[ref.slot];
+
+    if (!order.isActive()) {
+        if (order.getStatus() == OrderStatus::REJECTED && slot.state == SlotState::PENDING_NEW) {
+            sideState.placeBackoffNs = std::min(std::max(2 * sideState.placeBackoffNs, kMinPlaceBackoffNs),
+                                                kMaxPlaceBackoffNs);
+            sideState.placeRetryNs = utils::TscClock::nowNs() + sideState.placeBackoffNs;
+        }
+        releaseSlot(slot);
+        m_slotByClientId.erase(it);
+        markDirty(ref.instrumentId);
+        return;
+    }
+
+    // A refused cancel leaves the order resting, pull it again next cycle
+    if (slot.state == SlotState::PENDING_CANCEL && !m_orders.hasCancelInFlight(order.getClientOrderId())) {
+        slot.state = SlotState::LIVE;
+        markDirty(ref.instrumentId);
+    }
+    if (slot.state == SlotState::PENDING_NEW && order.getStatus() != OrderStatus::PENDING) {
+        slot.state = SlotState::LIVE;
+        sideState.placeBackoffNs = 0;
+        markDirty(ref.instrumentId);
+    }
+    if (order.getFilledAmount() != slot.filled) {
+        slot.filled = order.getFilledAmount();
+        markDirty(ref.instrumentId);
+    }
+
+    // Without an edit outstanding the order is what the exchange says
+    if (slot.state == SlotState::LIVE && !m_orders.hasAmendInFlight(order.getOrderId()) &&
+        (std::fabs(order.getPrice() - slot.price) >= state.halfTick ||
+         std::fabs(order.getAmount() - slot.totalAmount) >= state.amountEpsilon)) {
+        slot.price = order.getPrice();
+        slot.totalAmount = order.getAmount();
+        markDirty(ref.instrumentId);
+    }
+}
+
+utils::LatencyHistogram QuoteEngine::getCycleLatency() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cycleLatency;
+}
+
+QuoteEngineStats QuoteEngine::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void QuoteEngine::markDirty(uint32_t instrumentId) {
+    InstrumentState& state = m_instruments[instrumentId];
+    if (!state.dirty) {
+        state.dirty = true;
+        m_dirty.push_back(instrumentId);
+    }
+}
+
+void QuoteEngine::releaseSlot(Slot& slot) {
+    slot.state = SlotState::FREE;
+    slot.price = 0.0;
+    slot.totalAmount = 0.0;
+    slot.filled = 0.0;
+    slot.clientOrderId.clear();
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "order/order.hpp"
+#include "order/order_manager.hpp"
+#include "utils/histogram.hpp"
+
+constexpr size_t kMaxQuoteLevels = 8;
+
+struct QuoteLevel {
+    double price = 0.0;
+    double amount = 0.0;
+};
+
+enum class QuoteOpType : uint8_t {
+    PLACE,
+    EDIT,
+    CANCEL
+};
+
+// One order operation produced by a cycle, addressed by slot rather than
+// by order ID so building it never touches a string
+struct QuoteOp {
+    QuoteOpType type;
+    uint32_t instrumentId;
+    OrderSide side;
+    uint8_t slot;
+    double price;
+    double amount;      // Remaining size wanted at this level
+};
+
+struct QuoteEngineStats {
+    uint64_t cycles = 0;
+    uint64_t places = 0;
+    uint64_t edits = 0;
+    uint64_t cancels = 0;
+    uint64_t deferred = 0;  // Levels waiting on an unacknowledged order
+};
+
+// Turns desired bid/ask ladders into the fewest place/edit/cancel calls
+// against our live quotes. Levels resting at the right price are kept,
+// mispriced orders are moved with an edit before anything is cancelled or
+// placed, and only instruments whose target or orders changed are visited.
+//
+// All per-instrument state is allocated at registration; computing a cycle
+// does not allocate. setQuotes() and runCycle() belong to the strategy
+// thread, onOrderUpdate() may be called from the websocket thread.
+class QuoteEngine {
+public:
+    // Live orders per side; twice the ladder depth so replacements can be
+    // placed while cancels are still in flight
+    static constexpr size_t kSlotsPerSide = 2 * kMaxQuoteLevels;
+    // Worst case per side and cycle: a cancel and a place for every slot
+    static constexpr size_t kMaxOpsPerSide = 2 * kSlotsPerSide;
+
+    explicit QuoteEngine(OrderManager& orders, size_t maxInstruments = 2048);
+
+    // Instrument IDs are assigned once at startup
+    uint32_t registerInstrument(const std::string& instrument, double tickSize, double minAmount);
+    uint32_t getInstrumentId(const std::string& instrument) const;
+    static constexpr uint32_t kUnknownInstrument = UINT32_MAX;
+
+    // Desired ladder for one side, best level first. Prices are snapped to
+    // the tick and levels with no size are dropped.
+    void setQuotes(uint32_t instrumentId, OrderSide side, const QuoteLevel* levels, size_t count);
+    void pullQuotes(uint32_t instrumentId);
+
+    // Diffs every changed instrument and sends the result through the
+    // order manager. Returns the number of operations sent.
+    size_t runCycle();
+
+    // Diff only, for callers that route the operations themselves. The
+    // returned vector is reused by the next cycle.
+    const std::vector<QuoteOp>& computeDiff();
+
+    // Feed from OrderManager's update callback
+    void onOrderUpdate(const Order& order);
+
+    // Wall time of runCycle(), in nanoseconds
+    utils::LatencyHistogram getCycleLatency() const;
+    QuoteEngineStats getStats() const;
+
+private:
+    enum class SlotState : uint8_t {
+        FREE,
+        PENDING_NEW,    // Sent, no exchange ID yet, cannot be edited
+        LIVE,
+        PENDING_CANCEL
+    };
+
+    // price and totalAmount are what was last requested. Once no edit is
+    // in flight they are reset to the exchange's view of the order, so a
+    // rejected edit does not leave the slot at a price that never rested.
+    struct Slot {
+        SlotState state = SlotState::FREE;
+        double price = 0.0;
+        double totalAmount = 0.0;   // Order size as last requested
+        double filled = 0.0;
+        std::string clientOrderId;
+
+        double remaining() const { return totalAmount - filled; }
+    };
+
+    struct SideState {
+        QuoteLevel desired[kMaxQuoteLevels];
+        uint8_t desiredCount = 0;
+        Slot slots[kSlotsPerSide];
+
+        // Places rejected by risk or the exchange back off exponentially
+        int64_t placeBackoffNs = 0;
+        int64_t placeRetryNs = 0;
+    };
+
+    struct InstrumentState {
+        std::string name;
+        double tickSize = 0.0;
+        double invTickSize = 0.0;
+        double halfTick = 0.0;
+        double amountEpsilon = 0.0;
+        bool dirty = false;
+        SideState sides[2];
+    };
+
+    struct SlotRef {
+        uint32_t instrumentId;
+        uint8_t side;
+        uint8_t slot;
+    };
+
+    static size_t sideIndex(OrderSide side) { return side == OrderSide::BUY ? 0 : 1; }
+
+    const std::vector<QuoteOp>& computeDiffLocked();
+    void markDirty(uint32_t instrumentId);
+    void diffSide(uint32_t instrumentId, InstrumentState& state, OrderSide side, bool& waiting);
+    void execute(const QuoteOp& op);
+    void releaseSlot(Slot& slot);
+
+    OrderManager& m_orders;
+    std::unique_ptr<InstrumentState[]> m_instruments;
+    const size_t m_maxInstruments;
+    uint32_t m_instrumentCount;
+    std::unordered_map<std::string, uint32_t> m_instrumentIds;
+
+    // Client order ID to slot, filled in before the order is sent
+    std::unordered_map<std::string, SlotRef> m_slotByClientId;
+
+    // Reserved up front, reused every cycle
+    std::vector<uint32_t> m_dirty;
+    std::vector<uint32_t> m_stillDirty;
+    std::vector<QuoteOp> m_ops;
+    std::string m_scratchId;
+    int64_t m_cycleNowNs = 0;
+
+    QuoteEngineStats m_stats;
+    utils::LatencyHistogram m_cycleLatency;
+    mutable std::mutex m_mutex;
+};
@@ -0,0 +1,126 @@
+#include "utils/binary_log.hpp"
+#include <cstdio>
+
+namespace utils {
+
+namespace {
+    template<typename T>
+    bool readValue(const char*& in, const char* end, T& value) {
+        if (static_cast<size_t>(end - in) < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return true;
+    }
+
+    bool appendArg(const char*& in, const char* end, std::string& out) {
+        uint8_t tag;
+        if (!readValue(in, end, tag)) {
+            return false;
+        }
+
+        char number[32];
+        switch (static_cast<LogArgTag>(tag)) {
+            case LogArgTag::INT: {
+                int64_t value;
+                if (!readValue(in, end, value)) return false;
+                std::snprintf(number, sizeof(number), "%lld", static_cast<long long>(value));
+                out += number;
+                return true;
+            }
+            case LogArgTag::UINT: {
+                uint64_t value;
+                if (!readValue(in, end, value)) return false;
+                std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(value));
+                out += number;
+                return true;
+            }
+            case LogArgTag::DOUBLE: {
+                // Same as the default ostream formatting of the text path
+                double value;
+                if (!readValue(in, end, value)) return false;
+                std::snprintf(number, sizeof(number), "%g", value);
+                out += number;
+                return true;
+            }
+            case LogArgTag::BOOL: {
+                uint8_t value;
+                if (!readValue(in, end, value)) return false;
+                out += value ? '1' : '0';
+                return true;
+            }
+            case LogArgTag::CHAR: {
+                char value;
+                if (!readValue(in, end, value)) return false;
+                out += value;
+                return true;
+            }
+            case LogArgTag::STRING: {
+                uint32_t length;
+                if (!readValue(in, end, length) || static_cast<size_t>(end - in) < length) return false;
+                out.append(in, length);
+                in += length;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+LogSiteRegistry& LogSiteRegistry::getInstance() {
+    static LogSiteRegistry instance;
+    return instance;
+}
+
+uint32_t LogSiteRegistry::add(uint8_t level, const char* format, const char* file, int line) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sites.push_back({format, file, line, level});
+    return static_cast<uint32_t>(m_sites.size() - 1);
+}
+
+LogSite LogSiteRegistry::get(uint32_t id) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (id >= m_sites.size()) {
+        return {"<unknown log site>", "", 0, 0};
+    }
+    return m_sites[id];
+}
+
+size_t LogSiteRegistry::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sites.size();
+}
+
+bool formatLogRecord(const char* format, const char* args, size_t length, std::string& out) {
+    const char* in = args;
+    const char* end = args + length;
+    bool ok = true;
+
+    for (const char* p = format; *p; ++p) {
+        if (p[0] == '{' && p[1] == '{') {
+            out += '{';
+            ++p;
+        } else if (p[0] == '}' && p[1] == '}') {
+            out += '}';
+            ++p;
+        } else if (p[0] == '{' && p[1] == '}') {
+            if (ok && in < end) {
+                ok = appendArg(in, end, out);
+            } else {
+                out += "{}";
+            }
+            ++p;
+        } else {
+            out += *p;
+        }
+    }
+
+    while (ok && in < end) {
+        out += ' ';
+        ok = appendArg(in, end, out);
+    }
+    return ok;
+}
+
+} // namespace utils
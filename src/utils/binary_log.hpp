@@ -0,0 +1,138 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Deferred log formatting. A call site registers its format string once and
+// gets a site ID; each call then copies only the ID and its raw arguments,
+// tagged by type, and "{}" placeholders are filled in later by the logger's
+// writer thread or offline by tools/log_decoder.
+//
+// Binary log file (AsyncLogConfig::binaryFile), little endian:
+//   header: "DRBTLOG1"
+//   entries: uint8 type, uint32 payload length, payload
+//     SITE:     uint32 id, uint8 level, uint32 line, format\0, file\0
+//     DEFERRED: int64 timeNs, uint32 site id, encoded arguments
+//     TEXT:     int64 timeNs, uint8 level, message
+// A site is written before the first record that uses it.
+
+namespace utils {
+
+constexpr char kBinaryLogMagic[8] = {'D', 'R', 'B', 'T', 'L', 'O', 'G', '1'};
+
+enum class BinaryLogEntry : uint8_t {
+    SITE = 1,
+    DEFERRED = 2,
+    TEXT = 3
+};
+
+enum class LogArgTag : uint8_t {
+    INT = 1,        // int64
+    UINT = 2,       // uint64
+    DOUBLE = 3,
+    BOOL = 4,       // uint8
+    CHAR = 5,
+    STRING = 6      // uint32 length, bytes
+};
+
+struct LogSite {
+    const char* format;
+    const char* file;
+    int line;
+    uint8_t level;
+};
+
+// Strings longer than this are cut. Logger::startAsync() refuses rings
+// too small for a record with such a string; a record that still does not
+// fit is dropped and counted.
+constexpr size_t kMaxLogStringArg = 4096;
+
+// Sites live for the process; IDs are indexes in registration order
+class LogSiteRegistry {
+public:
+    static LogSiteRegistry& getInstance();
+
+    uint32_t add(uint8_t level, const char* format, const char* file, int line);
+    LogSite get(uint32_t id) const;
+    size_t size() const;
+
+private:
+    LogSiteRegistry() = default;
+
+    mutable std::mutex m_mutex;
+    std::deque<LogSite> m_sites;
+};
+
+template<typename T>
+size_t logArgSize(const T& value) {
+    using Arg = std::decay_t<T>;
+    if constexpr (std::is_same_v<Arg, bool> || std::is_same_v<Arg, char>) {
+        return 2;
+    } else if constexpr (std::is_arithmetic_v<Arg> || std::is_enum_v<Arg>) {
+        return 1 + sizeof(uint64_t);
+    } else {
+        static_assert(std::is_convertible_v<const T&, std::string_view>,
+                      "Deferred log arguments must be numbers, enums or strings");
+        return 1 + sizeof(uint32_t) + std::min(std::string_view(value).size(), kMaxLogStringArg);
+    }
+}
+
+template<typename T>
+char* writeLogArg(char* out, const T& value) {
+    using Arg = std::decay_t<T>;
+    if constexpr (std::is_same_v<Arg, bool>) {
+        *out++ = static_cast<char>(LogArgTag::BOOL);
+        *out++ = value ? 1 : 0;
+    } else if constexpr (std::is_same_v<Arg, char>) {
+        *out++ = static_cast<char>(LogArgTag::CHAR);
+        *out++ = value;
+    } else if constexpr (std::is_floating_point_v<Arg>) {
+        double converted = static_cast<double>(value);
+        *out++ = static_cast<char>(LogArgTag::DOUBLE);
+        std::memcpy(out, &converted, sizeof(converted));
+        out += sizeof(converted);
+    } else if constexpr (std::is_enum_v<Arg> || (std::is_integral_v<Arg> && std::is_signed_v<Arg>)) {
+        int64_t converted = static_cast<int64_t>(value);
+        *out++ = static_cast<char>(LogArgTag::INT);
+        std::memcpy(out, &converted, sizeof(converted));
+        out += sizeof(converted);
+    } else if constexpr (std::is_integral_v<Arg>) {
+        uint64_t converted = static_cast<uint64_t>(value);
+        *out++ = static_cast<char>(LogArgTag::UINT);
+        std::memcpy(out, &converted, sizeof(converted));
+        out += sizeof(converted);
+    } else {
+        std::string_view text(value);
+        uint32_t length = static_cast<uint32_t>(std::min(text.size(), kMaxLogStringArg));
+        *out++ = static_cast<char>(LogArgTag::STRING);
+        std::memcpy(out, &length, sizeof(length));
+        out += sizeof(length);
+        std::memcpy(out, text.data(), length);
+        out += length;
+    }
+    return out;
+}
+
+template<typename... Args>
+size_t logArgsSize(const Args&... args) {
+    return (size_t(0) + ... + logArgSize(args));
+}
+
+template<typename... Args>
+char* writeLogArgs(char* out, const Args&... args) {
+    ((out = writeLogArg(out, args)), ...);
+    return out;
+}
+
+// Appends format with each "{}" replaced by the next argument. "{{" and
+// "}}" are literal braces, surplus arguments are appended at the end.
+// Returns false if the arguments are truncated or malformed.
+bool formatLogRecord(const char* format, const char* args, size_t length, std::string& out);
+
+} // namespace utils
@@ -12,13 +12,53 @@ namespace {
             {"api_secret", "294sD3YBhxuKIo6GXiwf3mQ4Oc-U7Bnt9emLhgeLfg0"},
             {"ws_url", "wss://test.deribit.com/ws/api/v2"},
             {"rest_url", "https://test.deribit.com/api/v2"},
+            {"auth_method", "client_credentials"},
+            {"auth_refresh_margin", 0.8},
             {"max_order_size", 10.0},
             {"min_order_size", 0.0001},
             {"max_open_orders", 100},
+            {"max_notional", 1000000.0},
+            {"price_band", 0.05},
+            {"max_position", 100.0},
+            {"max_messages_per_second", 50},
+            {"rate_limit_burst_credits", 50000},
+            {"rate_limit_refill_per_second", 10000},
+            {"rate_limit_cost_per_request", 500},
+            {"position_reconcile_interval_ms", 30000},
+            {"cancel_on_disconnect", true},
             {"websocket_threads", 2},
             {"processing_threads", 4},
+            {"cpu_io", ""},
+            {"cpu_feed", ""},
+            {"cpu_strategy", ""},
+            {"cpu_order_entry", ""},
+            {"cpu_logging", ""},
+            {"cpu_housekeeping", ""},
+            {"sched_fifo", false},
+            {"sched_fifo_priority", 50},
+            {"busy_poll_io", false},
+            {"busy_poll_feed", false},
+            {"busy_poll_strategy", false},
+            {"strategy_interval_ms", 100},
+            {"feed_ring_kb", 1024},
+            {"capture_dir", ""},
+            {"capture_segment_mb", 256},
+            {"capture_ring_mb", 16},
             {"log_file", "trading_system.log"},
-            {"log_level", "INFO"}
+            {"log_level", "INFO"},
+            {"log_async", false},
+            {"log_ring_kb", 1024},
+            {"log_overflow", "count"},
+            {"log_flush_ms", 100},
+            {"log_binary_file", ""},
+            {"latency_report_interval_ms", 10000},
+            {"clock_recalibration_ms", 60000},
+            {"metrics_port", 9464},
+            {"metrics_bind", "127.0.0.1"},
+            {"trace_enabled", false},
+            {"trace_events_per_thread", 65536},
+            {"trace_dir", "traces"},
+            {"trace_threshold_us", 2000}
         };
     }
 }
@@ -89,6 +129,14 @@ std::string Config::getRestUrl() const {
     return getString("rest_url");
 }
 
+std::string Config::getAuthMethod() const {
+    return getString("auth_method");
+}
+
+double Config::getAuthRefreshMargin() const {
+    return getDouble("auth_refresh_margin");
+}
+
 double Config::getMaxOrderSize() const {
     return getDouble("max_order_size");
 }
@@ -101,6 +149,22 @@ int Config::getMaxOpenOrders() const {
     return getInt("max_open_orders");
 }
 
+double Config::getMaxNotional() const {
+    return getDouble("max_notional");
+}
+
+double Config::getPriceBand() const {
+    return getDouble("price_band");
+}
+
+double Config::getMaxPosition() const {
+    return getDouble("max_position");
+}
+
+int Config::getMaxMessagesPerSecond() const {
+    return getInt("max_messages_per_second");
+}
+
 int Config::getWebSocketThreads() const {
     return getInt("websocket_threads");
 }
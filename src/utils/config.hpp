@@ -26,9 +26,15 @@ public:
     std::string getApiSecret() const;
     std::string getWsUrl() const;
     std::string getRestUrl() const;
+    std::string getAuthMethod() const;
+    double getAuthRefreshMargin() const;
     double getMaxOrderSize() const;
     double getMinOrderSize() const;
     int getMaxOpenOrders() const;
+    double getMaxNotional() const;
+    double getPriceBand() const;
+    double getMaxPosition() const;
+    int getMaxMessagesPerSecond() const;
     int getWebSocketThreads() const;
     int getProcessingThreads() const;
     std::string getLogFile() const;
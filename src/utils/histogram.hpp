@@ -0,0 +1,110 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace utils {
+
+// Fixed-size log-linear histogram for latencies in nanoseconds. Each power
+// of two is split into 16 linear sub-buckets, which keeps the relative error
+// under ~6% across the full uint64 range with no allocation. record() is a
+// couple of instructions; it is not thread-safe, keep one per writer thread
+// and merge() them for reporting.
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBucketBits = 4;
+    static constexpr uint64_t kSubBucketCount = 1ull << kSubBucketBits;
+    static constexpr size_t kBucketCount = (64 - kSubBucketBits + 1) * kSubBucketCount;
+
+    LatencyHistogram() { reset(); }
+
+    void record(uint64_t value) {
+        ++m_counts[bucketIndex(value)];
+        ++m_total;
+        m_sum += value;
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+    }
+
+    void reset() {
+        m_counts.fill(0);
+        m_total = 0;
+        m_sum = 0;
+        m_min = std::numeric_limits<uint64_t>::max();
+        m_max = 0;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            m_counts[i] += other.m_counts[i];
+        }
+        m_total += other.m_total;
+        m_sum += other.m_sum;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    // Adds counts kept elsewhere in the same bucket layout, e.g. by a
+    // concurrently written shard
+    void mergeBuckets(const uint64_t* counts, uint64_t sum, uint64_t min, uint64_t max) {
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            m_counts[i] += counts[i];
+            m_total += counts[i];
+        }
+        m_sum += sum;
+        m_min = std::min(m_min, min);
+        m_max = std::max(m_max, max);
+    }
+
+    uint64_t count() const { return m_total; }
+    uint64_t min() const { return m_total ? m_min : 0; }
+    uint64_t max() const { return m_max; }
+    double mean() const { return m_total ? static_cast<double>(m_sum) / m_total : 0.0; }
+
+    // Upper bound of the bucket holding the given percentile (0-100)
+    uint64_t percentile(double percent) const {
+        if (m_total == 0) {
+            return 0;
+        }
+        percent = std::min(std::max(percent, 0.0), 100.0);
+        uint64_t rank = static_cast<uint64_t>(percent / 100.0 * m_total + 0.5);
+        rank = std::max<uint64_t>(rank, 1);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            seen += m_counts[i];
+            if (seen >= rank) {
+                return std::min(bucketUpperBound(i), m_max);
+            }
+        }
+        return m_max;
+    }
+
+    static size_t bucketIndex(uint64_t value) {
+        if (value < 2 * kSubBucketCount) {
+            return static_cast<size_t>(value);
+        }
+        unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+        unsigned shift = msb - kSubBucketBits;
+        return (shift + 1) * kSubBucketCount + ((value >> shift) - kSubBucketCount);
+    }
+
+    static uint64_t bucketUpperBound(size_t index) {
+        if (index < 2 * kSubBucketCount) {
+            return index;
+        }
+        uint64_t shift = index / kSubBucketCount - 1;
+        uint64_t sub = index % kSubBucketCount + kSubBucketCount;
+        return ((sub + 1) << shift) - 1;  // Wraps to UINT64_MAX for the last bucket
+    }
+
+private:
+    std::array<uint64_t, kBucketCount> m_counts;
+    uint64_t m_total;
+    uint64_t m_sum;
+    uint64_t m_min;
+    uint64_t m_max;
+};
+
+} // namespace utils
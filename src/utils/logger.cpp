@@ -1,14 +1,69 @@
 #include "utils/logger.hpp"
+#include "utils/spsc_ring.hpp"
+#include "utils/tsc_clock.hpp"
+#include "utils/utils.hpp"
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <cstring>
 #include <ctime>
+#include <stdexcept>
+
+namespace {
+    // Records taken from one ring per pass, so a chatty thread cannot
+    // hold up the others
+    constexpr size_t kDrainBatch = 4096;
+    constexpr auto kWriterIdleSleep = std::chrono::milliseconds(1);
+    constexpr size_t kRecordHeaderSize = sizeof(int64_t) + 1;
+
+    // A ring takes records up to half its size. The smallest one holds a
+    // deferred record with a full kMaxLogStringArg string, and about as
+    // much again for the other arguments.
+    constexpr size_t kMinRingBytes = 4 * utils::kMaxLogStringArg;
+    static_assert(kMinRingBytes / 2 - sizeof(uint32_t) >=
+                      kRecordHeaderSize + sizeof(uint32_t) + 1 + sizeof(uint32_t) + utils::kMaxLogStringArg,
+                  "minimum log ring cannot hold a full string argument");
+
+    // Level byte flag for records holding a site ID and encoded arguments
+    constexpr uint8_t kDeferredFlag = 0x80;
+    constexpr uint32_t kTextSite = UINT32_MAX;
+
+    int64_t wallClockNs() {
+        return utils::TscClock::wallNowNs();
+    }
+}
+
+struct Logger::ProducerRing {
+    explicit ProducerRing(size_t bytes) : ring(bytes), dropped(0), reportedDropped(0), retired(false) {}
+
+    utils::SpscByteRing ring;
+    std::atomic<uint64_t> dropped;
+    uint64_t reportedDropped;       // Writer only, for COUNT
+    std::atomic<bool> retired;      // Owning thread has exited
+};
+
+struct Logger::AsyncRecord {
+    int64_t timeNs;
+    LogLevel level;
+    std::string message;            // Encoded arguments for a deferred record
+    uint32_t site = kTextSite;
+};
 
 Logger::Logger() 
     : m_logLevel(LogLevel::INFO)
-    , m_consoleOutput(true) {
+    , m_consoleOutput(true)
+    , m_async(false)
+    , m_asyncGeneration(0)
+    , m_ringsVersion(0)
+    , m_written(0)
+    , m_blocked(0)
+    , m_droppedRetired(0)
+    , m_cachedSecond(-1) {
+    m_cachedTimestamp[0] = '\0';
 }
 
 Logger::~Logger() {
+    stopAsync();
     if (m_logFile.is_open()) {
         m_logFile.close();
     }
@@ -35,7 +90,404 @@ void Logger::setLogLevel(LogLevel level) {
     m_logLevel = level;
 }
 
+void Logger::setConsoleOutput(bool enabled) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_consoleOutput = enabled;
+}
+
+void Logger::startAsync(const AsyncLogConfig& config) {
+    if (config.ringBytes < kMinRingBytes) {
+        throw std::invalid_argument("Log ring must be at least " + std::to_string(kMinRingBytes) + " bytes");
+    }
+    if (m_async.load()) {
+        return;
+    }
+
+    if (!config.binaryFile.empty()) {
+        m_binaryFile.open(config.binaryFile, std::ios::binary | std::ios::trunc);
+        if (!m_binaryFile.is_open()) {
+            throw std::runtime_error("Failed to open binary log file: " + config.binaryFile);
+        }
+        m_binaryFile.write(utils::kBinaryLogMagic, sizeof(utils::kBinaryLogMagic));
+        m_sitesWritten.clear();
+    }
+
+    m_asyncConfig = config;
+    m_asyncGeneration.fetch_add(1, std::memory_order_release);
+    m_async.store(true, std::memory_order_release);
+    m_writer = std::thread([this] { runWriter(); });
+}
+
+void Logger::stopAsync() {
+    if (!m_async.exchange(false)) {
+        return;
+    }
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+    if (m_binaryFile.is_open()) {
+        m_binaryFile.close();
+    }
+
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    for (const auto& ring : m_rings) {
+        m_droppedRetired += ring->dropped.load();
+    }
+    m_rings.clear();
+    m_ringsVersion.fetch_add(1);
+}
+
+LogStats Logger::getStats() const {
+    LogStats stats;
+    stats.written = m_written.load(std::memory_order_relaxed);
+    stats.blocked = m_blocked.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    stats.dropped = m_droppedRetired;
+    for (const auto& ring : m_rings) {
+        stats.dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+LogOverflowPolicy Logger::parseOverflowPolicy(const std::string& policy) {
+    std::string lower = policy;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if (lower == "block") return LogOverflowPolicy::BLOCK;
+    if (lower == "drop") return LogOverflowPolicy::DROP;
+    if (lower == "count") return LogOverflowPolicy::COUNT;
+    throw std::invalid_argument("Invalid log overflow policy: " + policy);
+}
+
+uint32_t Logger::registerSite(LogLevel level, const char* format, const char* file, int line) {
+    return utils::LogSiteRegistry::getInstance().add(static_cast<uint8_t>(level), format, file, line);
+}
+
+Logger::ProducerRing* Logger::producerRing() {
+    // Marks the ring for removal once the thread is gone and it is drained
+    struct Handle {
+        std::shared_ptr<ProducerRing> ring;
+        uint64_t generation = 0;
+
+        ~Handle() {
+            if (ring) {
+                ring->retired.store(true, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Handle handle;
+
+    uint64_t generation = m_asyncGeneration.load(std::memory_order_acquire);
+    if (handle.ring && handle.generation == generation) {
+        return handle.ring.get();
+    }
+
+    // First message from this thread since async mode started
+    auto ring = std::make_shared<ProducerRing>(m_asyncConfig.ringBytes);
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        m_rings.push_back(ring);
+        m_ringsVersion.fetch_add(1, std::memory_order_release);
+    }
+    handle.ring = std::move(ring);
+    handle.generation = generation;
+    return handle.ring.get();
+}
+
+char* Logger::reserve(ProducerRing* producer, size_t length) {
+    if (length > producer->ring.maxRecordSize()) {
+        producer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    bool waited = false;
+    for (;;) {
+        if (char* slot = producer->ring.beginWrite(length)) {
+            return slot;
+        }
+        if (m_asyncConfig.overflow != LogOverflowPolicy::BLOCK || !m_async.load(std::memory_order_relaxed)) {
+            producer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        if (!waited) {
+            m_blocked.fetch_add(1, std::memory_order_relaxed);
+            waited = true;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void Logger::enqueue(LogLevel level, const std::string& message) {
+    ProducerRing* producer = producerRing();
+    size_t length = std::min(message.size(), producer->ring.maxRecordSize() - kRecordHeaderSize);
+    int64_t timeNs = wallClockNs();
+
+    if (char* slot = reserve(producer, kRecordHeaderSize + length)) {
+        std::memcpy(slot, &timeNs, sizeof(timeNs));
+        slot[sizeof(timeNs)] = static_cast<char>(level);
+        std::memcpy(slot + kRecordHeaderSize, message.data(), length);
+        producer->ring.commitWrite();
+    }
+}
+
+char* Logger::beginDeferred(LogLevel level, uint32_t site, size_t argsSize, ProducerRing*& ring) {
+    ring = producerRing();
+    int64_t timeNs = wallClockNs();
+
+    char* slot = reserve(ring, kRecordHeaderSize + sizeof(site) + argsSize);
+    if (!slot) {
+        return nullptr;
+    }
+    std::memcpy(slot, &timeNs, sizeof(timeNs));
+    slot[sizeof(timeNs)] = static_cast<char>(static_cast<uint8_t>(level) | kDeferredFlag);
+    std::memcpy(slot + kRecordHeaderSize, &site, sizeof(site));
+    return slot + kRecordHeaderSize + sizeof(site);
+}
+
+void Logger::commitDeferred(ProducerRing* ring) {
+    ring->ring.commitWrite();
+}
+
+void Logger::writeDeferred(LogLevel level, uint32_t site, const std::string& encoded) {
+    std::string message;
+    utils::formatLogRecord(utils::LogSiteRegistry::getInstance().get(site).format,
+                           encoded.data(), encoded.size(), message);
+    writeLog(level, message);
+}
+
+void Logger::runWriter() {
+    utils::ThreadUtils::onThreadStart("logging", "log-writer");
+    std::vector<std::shared_ptr<ProducerRing>> rings;
+    std::vector<AsyncRecord> records;
+    uint64_t version = UINT64_MAX;
+    bool unflushed = false;
+    auto nextFlush = std::chrono::steady_clock::now() + m_asyncConfig.flushInterval;
+    int idlePasses = 0;
+
+    for (;;) {
+        bool stopping = !m_async.load(std::memory_order_acquire);
+
+        uint64_t current = m_ringsVersion.load(std::memory_order_acquire);
+        if (current != version) {
+            std::lock_guard<std::mutex> lock(m_ringsMutex);
+            rings = m_rings;
+            version = m_ringsVersion.load();
+        }
+
+        size_t drained = drainRings(rings, records);
+        if (drained > 0) {
+            writeBatch(records);
+            records.clear();
+            unflushed = true;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (unflushed && (now >= nextFlush || stopping)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_logFile.is_open()) {
+                m_logFile.flush();
+            }
+            if (m_binaryFile.is_open()) {
+                m_binaryFile.flush();
+            }
+            if (m_consoleOutput) {
+                std::cout.flush();
+            }
+            unflushed = false;
+            nextFlush = now + m_asyncConfig.flushInterval;
+        }
+
+        // Threads that have exited and been drained give their ring back
+        bool retiredAny = false;
+        for (const auto& ring : rings) {
+            if (ring->retired.load(std::memory_order_acquire) && ring->ring.usedBytes() == 0) {
+                retiredAny = true;
+                break;
+            }
+        }
+        if (retiredAny) {
+            std::lock_guard<std::mutex> lock(m_ringsMutex);
+            auto retired = [this](const std::shared_ptr<ProducerRing>& ring) {
+                if (ring->retired.load(std::memory_order_acquire) && ring->ring.usedBytes() == 0) {
+                    m_droppedRetired += ring->dropped.load();
+                    return true;
+                }
+                return false;
+            };
+            m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), retired), m_rings.end());
+            m_ringsVersion.fetch_add(1, std::memory_order_release);
+        }
+
+        if (drained == 0) {
+            // Two empty passes after stop, so a producer that saw async
+            // mode just before it ended still gets written
+            if (stopping && ++idlePasses >= 2) {
+                break;
+            }
+            std::this_thread::sleep_for(kWriterIdleSleep);
+        } else {
+            idlePasses = 0;
+        }
+    }
+}
+
+size_t Logger::drainRings(std::vector<std::shared_ptr<ProducerRing>>& rings, std::vector<AsyncRecord>& records) {
+    size_t drained = 0;
+    for (const auto& producer : rings) {
+        if (m_asyncConfig.overflow == LogOverflowPolicy::COUNT) {
+            uint64_t dropped = producer->dropped.load(std::memory_order_relaxed);
+            if (dropped != producer->reportedDropped) {
+                records.push_back({wallClockNs(), LogLevel::WARNING,
+                                   "Logger dropped " + std::to_string(dropped - producer->reportedDropped) +
+                                   " messages from one thread, ring full"});
+                producer->reportedDropped = dropped;
+                ++drained;
+            }
+        }
+
+        size_t length = 0;
+        size_t count = 0;
+        const char* record;
+        while (count < kDrainBatch && (record = producer->ring.beginRead(length)) != nullptr) {
+            AsyncRecord entry;
+            std::memcpy(&entry.timeNs, record, sizeof(entry.timeNs));
+            uint8_t level = static_cast<uint8_t>(record[sizeof(entry.timeNs)]);
+            entry.level = static_cast<LogLevel>(level & ~kDeferredFlag);
+            const char* body = record + kRecordHeaderSize;
+            size_t bodyLength = length - kRecordHeaderSize;
+            if (level & kDeferredFlag) {
+                std::memcpy(&entry.site, body, sizeof(entry.site));
+                body += sizeof(entry.site);
+                bodyLength -= sizeof(entry.site);
+            }
+            entry.message.assign(body, bodyLength);
+            records.push_back(std::move(entry));
+            producer->ring.commitRead();
+            ++count;
+        }
+        drained += count;
+    }
+
+    // Rings are per thread; interleave them back into time order
+    if (drained > 1) {
+        std::stable_sort(records.begin(), records.end(), [](const AsyncRecord& a, const AsyncRecord& b) {
+            return a.timeNs < b.timeNs;
+        });
+    }
+    return drained;
+}
+
+void Logger::writeBatch(std::vector<AsyncRecord>& records) {
+    std::string fileBatch;
+    std::string outBatch;
+    std::string errBatch;
+    fileBatch.reserve(records.size() * 96);
+
+    bool binary = m_binaryFile.is_open();
+    auto& sites = utils::LogSiteRegistry::getInstance();
+    for (const auto& record : records) {
+        if (binary) {
+            writeBinary(record);
+            if (record.level < LogLevel::WARNING) {
+                continue;
+            }
+        }
+
+        size_t start = fileBatch.size();
+        formatTimestamp(record.timeNs, fileBatch);
+        fileBatch += " [";
+        fileBatch += levelToString(record.level);
+        fileBatch += "] ";
+        if (record.site == kTextSite) {
+            fileBatch += record.message;
+        } else {
+            utils::formatLogRecord(sites.get(record.site).format, record.message.data(),
+                                   record.message.size(), fileBatch);
+        }
+        fileBatch += '\n';
+        if (m_consoleOutput) {
+            (record.level >= LogLevel::WARNING ? errBatch : outBatch).append(fileBatch, start, std::string::npos);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_logFile.is_open() && !fileBatch.empty()) {
+        m_logFile.write(fileBatch.data(), static_cast<std::streamsize>(fileBatch.size()));
+    }
+    if (!outBatch.empty()) {
+        std::cout.write(outBatch.data(), static_cast<std::streamsize>(outBatch.size()));
+    }
+    if (!errBatch.empty()) {
+        std::cerr.write(errBatch.data(), static_cast<std::streamsize>(errBatch.size()));
+    }
+    m_written.fetch_add(records.size(), std::memory_order_relaxed);
+}
+
+void Logger::writeBinary(const AsyncRecord& record) {
+    auto writeEntry = [this](utils::BinaryLogEntry type, const std::string& payload) {
+        uint8_t typeByte = static_cast<uint8_t>(type);
+        uint32_t length = static_cast<uint32_t>(payload.size());
+        m_binaryFile.write(reinterpret_cast<const char*>(&typeByte), sizeof(typeByte));
+        m_binaryFile.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        m_binaryFile.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    };
+    auto append = [](std::string& out, const auto& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    std::string payload;
+    if (record.site == kTextSite) {
+        append(payload, record.timeNs);
+        append(payload, static_cast<uint8_t>(record.level));
+        payload += record.message;
+        writeEntry(utils::BinaryLogEntry::TEXT, payload);
+        return;
+    }
+
+    // Describe the site the first time it is used
+    if (record.site >= m_sitesWritten.size()) {
+        m_sitesWritten.resize(record.site + 1, false);
+    }
+    if (!m_sitesWritten[record.site]) {
+        utils::LogSite site = utils::LogSiteRegistry::getInstance().get(record.site);
+        append(payload, record.site);
+        append(payload, site.level);
+        append(payload, static_cast<uint32_t>(site.line));
+        payload.append(site.format).push_back('\0');
+        payload.append(site.file).push_back('\0');
+        writeEntry(utils::BinaryLogEntry::SITE, payload);
+        m_sitesWritten[record.site] = true;
+        payload.clear();
+    }
+
+    append(payload, record.timeNs);
+    append(payload, record.site);
+    payload += record.message;
+    writeEntry(utils::BinaryLogEntry::DEFERRED, payload);
+}
+
+void Logger::formatTimestamp(int64_t timeNs, std::string& out) {
+    // localtime only once per second
+    int64_t second = timeNs / 1000000000;
+    if (second != m_cachedSecond) {
+        std::time_t seconds = static_cast<std::time_t>(second);
+        std::tm local;
+        localtime_r(&seconds, &local);
+        std::strftime(m_cachedTimestamp, sizeof(m_cachedTimestamp), "%Y-%m-%d %H:%M:%S", &local);
+        m_cachedSecond = second;
+    }
+    char millis[8];
+    std::snprintf(millis, sizeof(millis), ".%03d", static_cast<int>((timeNs / 1000000) % 1000));
+    out += m_cachedTimestamp;
+    out += millis;
+}
+
 void Logger::writeLog(LogLevel level, const std::string& message) {
+    if (m_async.load(std::memory_order_acquire)) {
+        enqueue(level, message);
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(m_mutex);
     
     std::string timestamp = getTimestamp();
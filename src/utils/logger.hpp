@@ -1,10 +1,14 @@
 #pragma once
+#include <atomic>
 #include <string>
 #include <fstream>
 #include <memory>
 #include <mutex>
 #include <sstream>
 #include <chrono>
+#include <thread>
+#include <vector>
+#include "utils/binary_log.hpp"
 
 enum class LogLevel {
     DEBUG,
@@ -14,42 +18,123 @@ enum class LogLevel {
     CRITICAL
 };
 
+// Lowest level compiled in, as a LogLevel value. The LOG_* macros below
+// drop anything under it at compile time, arguments included.
+#ifndef DERIBIT_LOG_MIN_LEVEL
+#define DERIBIT_LOG_MIN_LEVEL 0
+#endif
+
+constexpr LogLevel kLogMinLevel = static_cast<LogLevel>(DERIBIT_LOG_MIN_LEVEL);
+
+// What a producer does when its ring is full in async mode
+enum class LogOverflowPolicy {
+    BLOCK,      // Wait for the writer to make room
+    DROP,       // Discard, visible only in the counters
+    COUNT       // Discard, and note how many were lost in the log itself
+};
+
+struct AsyncLogConfig {
+    size_t ringBytes = 1u << 20;    // Per producer thread
+    LogOverflowPolicy overflow = LogOverflowPolicy::COUNT;
+    std::chrono::milliseconds flushInterval{100};
+
+    // If set, records go to this file unformatted, for tools/log_decoder,
+    // and only WARNING and above are also written as text
+    std::string binaryFile;
+};
+
+struct LogStats {
+    uint64_t written = 0;
+    uint64_t dropped = 0;
+    uint64_t blocked = 0;           // Producer waits under BLOCK
+};
+
 class Logger {
 public:
     static Logger& getInstance();
 
     void setLogFile(const std::string& filename);
     void setLogLevel(LogLevel level);
+    // Echo to stdout/stderr, on by default
+    void setConsoleOutput(bool enabled);
+
+    // Async mode: each producer thread formats its message into its own
+    // SPSC ring and returns; a background thread orders records by time,
+    // writes them in batches and flushes every flushInterval. stopAsync()
+    // drains what is queued and returns to synchronous writes.
+    void startAsync(const AsyncLogConfig& config = AsyncLogConfig());
+    void stopAsync();
+    bool isAsync() const { return m_async.load(std::memory_order_acquire); }
+    LogStats getStats() const;
+
+    static LogOverflowPolicy parseOverflowPolicy(const std::string& policy);
+
+    // Deferred formatting, use through LOG_DEFERRED. The caller copies the
+    // site ID and raw arguments; "{}" placeholders are filled in on the
+    // writer thread. Without async mode the message is formatted in place.
+    static uint32_t registerSite(LogLevel level, const char* format, const char* file, int line);
+
+    template<typename... Args>
+    void logDeferred(LogLevel level, uint32_t site, const Args&... args) {
+        if (!isEnabled(level)) {
+            return;
+        }
+        size_t argsSize = utils::logArgsSize(args...);
+        if (m_async.load(std::memory_order_acquire)) {
+            ProducerRing* ring = nullptr;
+            if (char* slot = beginDeferred(level, site, argsSize, ring)) {
+                utils::writeLogArgs(slot, args...);
+                commitDeferred(ring);
+            }
+            return;
+        }
+        std::string encoded(argsSize, '\0');
+        utils::writeLogArgs(&encoded[0], args...);
+        writeDeferred(level, site, encoded);
+    }
     
     template<typename... Args>
-    void debug(Args... args) {
-        log(LogLevel::DEBUG, args...);
+    void debug(Args&&... args) {
+        log(LogLevel::DEBUG, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
-    void info(Args... args) {
-        log(LogLevel::INFO, args...);
+    void info(Args&&... args) {
+        log(LogLevel::INFO, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
-    void warning(Args... args) {
-        log(LogLevel::WARNING, args...);
+    void warning(Args&&... args) {
+        log(LogLevel::WARNING, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
-    void error(Args... args) {
-        log(LogLevel::ERROR, args...);
+    void error(Args&&... args) {
+        log(LogLevel::ERROR, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
-    void critical(Args... args) {
-        log(LogLevel::CRITICAL, args...);
+    void critical(Args&&... args) {
+        log(LogLevel::CRITICAL, std::forward<Args>(args)...);
     }
 
     // For latency measurements
     void logLatency(const std::string& operation, 
                    std::chrono::microseconds duration);
 
+    bool isEnabled(LogLevel level) const {
+        return level >= kLogMinLevel && level >= m_logLevel;
+    }
+
+    template<typename... Args>
+    void log(LogLevel level, Args&&... args) {
+        if (isEnabled(level)) {
+            std::ostringstream ss;
+            logOneArg(ss, std::forward<Args>(args)...);
+            writeLog(level, ss.str());
+        }
+    }
+
 private:
     Logger();
     ~Logger();
@@ -67,16 +152,21 @@ private:
         logOneArg(ss, std::forward<Args>(args)...);
     }
 
-    template<typename... Args>
-    void log(LogLevel level, Args&&... args) {
-        if (level >= m_logLevel) {
-            std::ostringstream ss;
-            logOneArg(ss, std::forward<Args>(args)...);
-            writeLog(level, ss.str());
-        }
-    }
+    struct ProducerRing;
+    struct AsyncRecord;
 
     void writeLog(LogLevel level, const std::string& message);
+    void enqueue(LogLevel level, const std::string& message);
+    char* reserve(ProducerRing* producer, size_t length);
+    char* beginDeferred(LogLevel level, uint32_t site, size_t argsSize, ProducerRing*& ring);
+    void commitDeferred(ProducerRing* ring);
+    void writeDeferred(LogLevel level, uint32_t site, const std::string& encoded);
+    ProducerRing* producerRing();
+    void runWriter();
+    size_t drainRings(std::vector<std::shared_ptr<ProducerRing>>& rings, std::vector<AsyncRecord>& records);
+    void writeBatch(std::vector<AsyncRecord>& records);
+    void writeBinary(const AsyncRecord& record);
+    void formatTimestamp(int64_t timeNs, std::string& out);
     std::string getTimestamp() const;
     std::string levelToString(LogLevel level) const;
 
@@ -84,4 +174,54 @@ private:
     std::ofstream m_logFile;
     std::mutex m_mutex;
     bool m_consoleOutput;
-};
\ No newline at end of file
+
+    // Async mode
+    std::atomic<bool> m_async;
+    std::atomic<uint64_t> m_asyncGeneration;
+    AsyncLogConfig m_asyncConfig;
+    std::vector<std::shared_ptr<ProducerRing>> m_rings;
+    std::atomic<uint64_t> m_ringsVersion;
+    mutable std::mutex m_ringsMutex;
+    std::thread m_writer;
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_blocked;
+    uint64_t m_droppedRetired;
+    std::ofstream m_binaryFile;
+    std::vector<bool> m_sitesWritten;   // Writer only
+    int64_t m_cachedSecond;
+    char m_cachedTimestamp[32];
+};
+
+// Arguments are only evaluated if the level is compiled in and enabled,
+// so e.g. LOG_DEBUG("Data: ", data.dump()) costs a branch when filtered
+// and nothing when below DERIBIT_LOG_MIN_LEVEL
+#define LOG_AT(level, ...) \
+    do { \
+        if constexpr ((level) >= kLogMinLevel) { \
+            auto& logger_ = Logger::getInstance(); \
+            if (logger_.isEnabled(level)) { \
+                logger_.log(level, __VA_ARGS__); \
+            } \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LogLevel::DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::INFO, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(LogLevel::WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::ERROR, __VA_ARGS__)
+#define LOG_CRITICAL(...) LOG_AT(LogLevel::CRITICAL, __VA_ARGS__)
+
+// Logs with deferred formatting, e.g.
+//   LOG_DEFERRED(LogLevel::INFO, "Order {} sent at {}", orderId, price);
+// Arguments must be numbers, enums or strings. Filtered the same way as
+// LOG_AT.
+#define LOG_DEFERRED(level, format, ...) \
+    do { \
+        if constexpr ((level) >= kLogMinLevel) { \
+            auto& logger_ = Logger::getInstance(); \
+            if (logger_.isEnabled(level)) { \
+                static const uint32_t logSite_ = Logger::registerSite(level, format, __FILE__, __LINE__); \
+                logger_.logDeferred(level, logSite_, ##__VA_ARGS__); \
+            } \
+        } \
+    } while (0)
@@ -0,0 +1,160 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include "utils/lockfree_queue.hpp"
+
+namespace utils {
+
+// Single-producer single-consumer ring of variable-length byte records.
+// Each record is a 4-byte length followed by the payload, padded to 8
+// bytes, and is always contiguous so it can be written and read in place.
+// When a record does not fit before the end of the buffer a wrap marker
+// is left and the record starts again at offset 0.
+class SpscByteRing {
+public:
+    explicit SpscByteRing(size_t capacity)
+        : m_capacity(roundUpPowerOfTwo(capacity))
+        , m_mask(m_capacity - 1)
+        , m_buffer(new char[m_capacity])
+        , m_writePos(0)
+        , m_readPos(0)
+        , m_cachedReadPos(0)
+        , m_pendingWritePos(0)
+        , m_cachedWritePos(0)
+        , m_pendingReadPos(0) {
+    }
+
+    SpscByteRing(const SpscByteRing&) = delete;
+    SpscByteRing& operator=(const SpscByteRing&) = delete;
+
+    // Producer: reserves space for a record of the given length and returns
+    // where to write it, or nullptr when the ring is full
+    char* beginWrite(size_t length) {
+        size_t need = recordSize(length);
+        if (need > m_capacity / 2) {
+            return nullptr;
+        }
+
+        uint64_t pos = m_writePos.load(std::memory_order_relaxed);
+        size_t offset = static_cast<size_t>(pos & m_mask);
+        size_t contiguous = m_capacity - offset;
+        size_t total = contiguous < need ? contiguous + need : need;
+
+        if (m_capacity - (pos - m_cachedReadPos) < total) {
+            m_cachedReadPos = m_readPos.load(std::memory_order_acquire);
+            if (m_capacity - (pos - m_cachedReadPos) < total) {
+                return nullptr;
+            }
+        }
+
+        if (contiguous < need) {
+            storeLength(offset, kWrapMarker);
+            pos += contiguous;
+            offset = 0;
+        }
+        storeLength(offset, static_cast<uint32_t>(length));
+        m_pendingWritePos = pos + need;
+        return m_buffer.get() + offset + kLengthSize;
+    }
+
+    // Producer: publishes the record reserved by beginWrite()
+    void commitWrite() {
+        m_writePos.store(m_pendingWritePos, std::memory_order_release);
+    }
+
+    bool tryWrite(const void* data, size_t length) {
+        char* destination = beginWrite(length);
+        if (!destination) {
+            return false;
+        }
+        std::memcpy(destination, data, length);
+        commitWrite();
+        return true;
+    }
+
+    // Consumer: next record in place, or nullptr when empty
+    const char* beginRead(size_t& length) {
+        uint64_t pos = m_readPos.load(std::memory_order_relaxed);
+        for (;;) {
+            if (pos == m_cachedWritePos) {
+                m_cachedWritePos = m_writePos.load(std::memory_order_acquire);
+                if (pos == m_cachedWritePos) {
+                    return nullptr;
+                }
+            }
+            size_t offset = static_cast<size_t>(pos & m_mask);
+            uint32_t stored = loadLength(offset);
+            if (stored == kWrapMarker) {
+                pos += m_capacity - offset;
+                m_readPos.store(pos, std::memory_order_release);
+                continue;
+            }
+            length = stored;
+            m_pendingReadPos = pos + recordSize(stored);
+            return m_buffer.get() + offset + kLengthSize;
+        }
+    }
+
+    // Consumer: releases the record returned by beginRead()
+    void commitRead() {
+        m_readPos.store(m_pendingReadPos, std::memory_order_release);
+    }
+
+    // Approximate, safe from either side
+    size_t usedBytes() const {
+        return static_cast<size_t>(m_writePos.load(std::memory_order_relaxed) -
+                                   m_readPos.load(std::memory_order_relaxed));
+    }
+    size_t capacity() const { return m_capacity; }
+    size_t maxRecordSize() const { return m_capacity / 2 - kLengthSize; }
+
+private:
+    static constexpr uint32_t kWrapMarker = UINT32_MAX;
+    static constexpr size_t kLengthSize = sizeof(uint32_t);
+
+    static size_t recordSize(size_t length) {
+        return (kLengthSize + length + 7) & ~static_cast<size_t>(7);
+    }
+
+    static size_t roundUpPowerOfTwo(size_t value) {
+        if (value < 64) {
+            throw std::invalid_argument("Ring capacity must be at least 64 bytes");
+        }
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    void storeLength(size_t offset, uint32_t length) {
+        std::memcpy(m_buffer.get() + offset, &length, sizeof(length));
+    }
+
+    uint32_t loadLength(size_t offset) const {
+        uint32_t length;
+        std::memcpy(&length, m_buffer.get() + offset, sizeof(length));
+        return length;
+    }
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<char[]> m_buffer;
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> m_writePos;
+    alignas(kCacheLineSize) std::atomic<uint64_t> m_readPos;
+
+    // Producer-local
+    alignas(kCacheLineSize) uint64_t m_cachedReadPos;
+    uint64_t m_pendingWritePos;
+
+    // Consumer-local
+    alignas(kCacheLineSize) uint64_t m_cachedWritePos;
+    uint64_t m_pendingReadPos;
+};
+
+} // namespace utils
@@ -0,0 +1,189 @@
+#include "utils/tsc_clock.hpp"
+#include "utils/utils.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace utils {
+
+std::atomic<bool> TscClock::s_usesTsc(false);
+std::atomic<uint32_t> TscClock::s_sequence(0);
+TscClock::SharedCalibration TscClock::s_calibration;
+
+namespace {
+    constexpr int64_t kInitialWindowNs = 10000000;
+    constexpr int kSampleAttempts = 8;
+    // Shortest time over which a backwards correction is slewed out
+    constexpr int64_t kMinSlewNs = 100000000;
+
+    struct Sample {
+        uint64_t tsc;
+        int64_t monotonicNs;
+        int64_t wallNs;
+    };
+
+    int64_t readClock(clockid_t clock) {
+        timespec ts;
+        clock_gettime(clock, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    bool hasInvariantTsc() {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+            return false;
+        }
+        __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        return (edx & (1u << 8)) != 0;
+#else
+        return false;
+#endif
+    }
+
+    // Both clocks read between two TSC reads; the tightest bracket of a
+    // few attempts wins, which filters out interrupts
+    Sample takeSample(bool tsc) {
+        Sample best{0, 0, 0};
+        uint64_t bestWidth = UINT64_MAX;
+        for (int attempt = 0; attempt < kSampleAttempts; ++attempt) {
+            uint64_t before = tsc ? TscClock::ticks() : 0;
+            int64_t monotonic = readClock(CLOCK_MONOTONIC);
+            int64_t wall = readClock(CLOCK_REALTIME);
+            uint64_t after = tsc ? TscClock::ticks() : 0;
+            if (after - before < bestWidth) {
+                bestWidth = after - before;
+                best = {before + (after - before) / 2, monotonic, wall};
+            }
+            if (!tsc) {
+                best.tsc = static_cast<uint64_t>(monotonic);
+                break;
+            }
+        }
+        return best;
+    }
+
+    Sample g_origin;
+    std::mutex g_calibrationMutex;
+
+    std::mutex g_threadMutex;
+    std::condition_variable g_threadWake;
+    std::thread g_thread;
+    bool g_threadRunning = false;
+}
+
+// Calibrates once before main()
+struct TscClockInit {
+    TscClockInit() {
+        TscClock::Calibration slot;
+        if (!hasInvariantTsc()) {
+            Sample sample = takeSample(false);
+            slot.tscBase = sample.tsc;
+            slot.monotonicBaseNs = sample.monotonicNs;
+            slot.wallBaseNs = sample.wallNs;
+            slot.nsPerTick = 1.0;
+            g_origin = sample;
+            TscClock::publish(slot);
+            return;
+        }
+
+        TscClock::s_usesTsc.store(true, std::memory_order_relaxed);
+        g_origin = takeSample(true);
+        while (readClock(CLOCK_MONOTONIC) - g_origin.monotonicNs < kInitialWindowNs) {
+        }
+        Sample sample = takeSample(true);
+
+        slot.tscBase = sample.tsc;
+        slot.monotonicBaseNs = sample.monotonicNs;
+        slot.wallBaseNs = sample.wallNs;
+        slot.nsPerTick = static_cast<double>(sample.monotonicNs - g_origin.monotonicNs) /
+                         static_cast<double>(sample.tsc - g_origin.tsc);
+        slot.slewNsPerTick = slot.nsPerTick;
+        TscClock::publish(slot);
+    }
+};
+
+namespace {
+    TscClockInit g_init;
+}
+
+void TscClock::publish(const Calibration& calibration) {
+    uint32_t sequence = s_sequence.load(std::memory_order_relaxed);
+    s_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s_calibration.tscBase.store(calibration.tscBase, std::memory_order_relaxed);
+    s_calibration.monotonicBaseNs.store(calibration.monotonicBaseNs, std::memory_order_relaxed);
+    s_calibration.wallBaseNs.store(calibration.wallBaseNs, std::memory_order_relaxed);
+    s_calibration.nsPerTick.store(calibration.nsPerTick, std::memory_order_relaxed);
+    s_calibration.slewTicks.store(calibration.slewTicks, std::memory_order_relaxed);
+    s_calibration.slewNsPerTick.store(calibration.slewNsPerTick, std::memory_order_relaxed);
+    s_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void TscClock::recalibrate() {
+    std::lock_guard<std::mutex> lock(g_calibrationMutex);
+    bool tsc = usesTsc();
+    Sample sample = takeSample(tsc);
+
+    Calibration slot;
+    slot.tscBase = sample.tsc;
+    slot.monotonicBaseNs = sample.monotonicNs;
+    slot.wallBaseNs = sample.wallNs;
+    slot.nsPerTick = tsc ? static_cast<double>(sample.monotonicNs - g_origin.monotonicNs) /
+                           static_cast<double>(sample.tsc - g_origin.tsc)
+                         : 1.0;
+    slot.slewNsPerTick = slot.nsPerTick;
+
+    // Running ahead: keep the current reading at the sample and run slow
+    // until the lead is gone, instead of stepping back
+    int64_t ahead = toMonotonicNs(sample.tsc) - sample.monotonicNs;
+    if (ahead > 0) {
+        int64_t slewNs = std::max(kMinSlewNs, 2 * ahead);
+        slot.monotonicBaseNs += ahead;
+        slot.wallBaseNs += ahead;
+        slot.slewTicks = static_cast<int64_t>(static_cast<double>(slewNs) / slot.nsPerTick);
+        slot.slewNsPerTick = static_cast<double>(slewNs - ahead) / static_cast<double>(slot.slewTicks);
+    }
+    publish(slot);
+}
+
+void TscClock::startRecalibration(std::chrono::milliseconds interval) {
+    if (interval.count() <= 0) {
+        throw std::invalid_argument("Clock recalibration interval must be positive");
+    }
+    std::lock_guard<std::mutex> lock(g_threadMutex);
+    if (g_threadRunning) {
+        return;
+    }
+    g_threadRunning = true;
+    g_thread = std::thread([interval] {
+        ThreadUtils::onThreadStart("housekeeping", "tsc-calibrate");
+        std::unique_lock<std::mutex> lock(g_threadMutex);
+        while (!g_threadWake.wait_for(lock, interval, [] { return !g_threadRunning; })) {
+            lock.unlock();
+            recalibrate();
+            lock.lock();
+        }
+    });
+}
+
+void TscClock::stopRecalibration() {
+    {
+        std::lock_guard<std::mutex> lock(g_threadMutex);
+        if (!g_threadRunning) {
+            return;
+        }
+        g_threadRunning = false;
+    }
+    g_threadWake.notify_all();
+    if (g_thread.joinable()) {
+        g_thread.join();
+    }
+}
+
+} // namespace utils
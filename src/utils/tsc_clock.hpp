@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace utils {
+
+// Hot-path clock. ticks() reads the invariant TSC directly, a few
+// nanoseconds with no vDSO call; stamps are kept as ticks and turned into
+// CLOCK_MONOTONIC or CLOCK_REALTIME nanoseconds only when needed.
+//
+// The tick rate is measured against CLOCK_MONOTONIC at static
+// initialization (about 10ms) and refined by recalibrate(), which also
+// re-anchors both clocks to correct the accumulated drift, normally well
+// under a microsecond. A correction backwards is slewed out over at least
+// 100ms rather than stepped, so nowNs() never goes back. Without an
+// invariant TSC (or off x86) ticks are CLOCK_MONOTONIC nanoseconds and the
+// same calls work.
+class TscClock {
+public:
+    static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        if (s_usesTsc.load(std::memory_order_relaxed)) {
+            return __rdtsc();
+        }
+#endif
+        return static_cast<uint64_t>(monotonicNs());
+    }
+
+    static int64_t toMonotonicNs(uint64_t ticks) {
+        const Calibration calibration = current();
+        return calibration.monotonicBaseNs + elapsedNs(calibration, ticks);
+    }
+
+    static int64_t toWallNs(uint64_t ticks) {
+        const Calibration calibration = current();
+        return calibration.wallBaseNs + elapsedNs(calibration, ticks);
+    }
+
+    static std::chrono::system_clock::time_point toSystemTime(uint64_t ticks) {
+        return std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::nanoseconds(toWallNs(ticks))));
+    }
+
+    // Length of an interval between two ticks() readings
+    static int64_t ticksToNs(int64_t ticks) {
+        return static_cast<int64_t>(static_cast<double>(ticks) * current().nsPerTick);
+    }
+
+    static int64_t nowNs() { return toMonotonicNs(ticks()); }
+    static int64_t wallNowNs() { return toWallNs(ticks()); }
+
+    static bool usesTsc() { return s_usesTsc.load(std::memory_order_relaxed); }
+    static double ticksPerSecond() { return 1e9 / current().nsPerTick; }
+
+    // Measures the rate over everything since startup and re-anchors
+    static void recalibrate();
+
+    // Recalibrates from a background thread every interval
+    static void startRecalibration(std::chrono::milliseconds interval);
+    static void stopRecalibration();
+
+private:
+    // Up to slewTicks after tscBase time runs at slewNsPerTick, slower
+    // than nsPerTick, to absorb a backwards correction
+    struct Calibration {
+        uint64_t tscBase = 0;
+        int64_t monotonicBaseNs = 0;
+        int64_t wallBaseNs = 0;
+        double nsPerTick = 1.0;
+        int64_t slewTicks = 0;
+        double slewNsPerTick = 1.0;
+    };
+
+    // Published under a seqlock; every field is an atomic so a reader
+    // racing a recalibration retries instead of reading a torn value
+    struct SharedCalibration {
+        std::atomic<uint64_t> tscBase{0};
+        std::atomic<int64_t> monotonicBaseNs{0};
+        std::atomic<int64_t> wallBaseNs{0};
+        std::atomic<double> nsPerTick{1.0};
+        std::atomic<int64_t> slewTicks{0};
+        std::atomic<double> slewNsPerTick{1.0};
+    };
+
+    static Calibration current() {
+        Calibration calibration;
+        uint32_t sequence;
+        do {
+            sequence = s_sequence.load(std::memory_order_acquire);
+            calibration.tscBase = s_calibration.tscBase.load(std::memory_order_relaxed);
+            calibration.monotonicBaseNs = s_calibration.monotonicBaseNs.load(std::memory_order_relaxed);
+            calibration.wallBaseNs = s_calibration.wallBaseNs.load(std::memory_order_relaxed);
+            calibration.nsPerTick = s_calibration.nsPerTick.load(std::memory_order_relaxed);
+            calibration.slewTicks = s_calibration.slewTicks.load(std::memory_order_relaxed);
+            calibration.slewNsPerTick = s_calibration.slewNsPerTick.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((sequence & 1) != 0 || sequence != s_sequence.load(std::memory_order_relaxed));
+        return calibration;
+    }
+
+    static int64_t elapsedNs(const Calibration& calibration, uint64_t ticks) {
+        int64_t elapsed = static_cast<int64_t>(ticks - calibration.tscBase);
+        if (elapsed < calibration.slewTicks) {
+            return static_cast<int64_t>(static_cast<double>(elapsed) * calibration.slewNsPerTick);
+        }
+        return static_cast<int64_t>(
+            static_cast<double>(calibration.slewTicks) * calibration.slewNsPerTick +
+            static_cast<double>(elapsed - calibration.slewTicks) * calibration.nsPerTick);
+    }
+
+    static void publish(const Calibration& calibration);
+
+    static int64_t monotonicNs() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    friend struct TscClockInit;
+
+    static std::atomic<bool> s_usesTsc;
+    static std::atomic<uint32_t> s_sequence;
+    static SharedCalibration s_calibration;
+};
+
+} // namespace utils
@@ -1,9 +1,11 @@
 #include "utils/utils.hpp"
 #include "utils/logger.hpp"
+#include "metrics/latency_metrics.hpp"
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
 #include <cmath>
+#include <mutex>
 #include <thread>
 #include <unistd.h>
 #include <sys/resource.h>
@@ -116,52 +118,74 @@ double roundQuantity(double quantity, int decimals) {
 
 // ScopedTimer implementation
 ScopedTimer::ScopedTimer(const std::string& operation)
-    : m_operation(operation)
-    , m_start(std::chrono::high_resolution_clock::now()) {
+    : ScopedTimer(LatencyMetrics::getInstance().registerMetric(operation)) {
+}
+
+ScopedTimer::ScopedTimer(uint32_t metric)
+    : m_metric(metric)
+    , m_startNs(pipeline::now()) {
 }
 
 ScopedTimer::~ScopedTimer() {
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - m_start);
-    Logger::getInstance().logLatency(m_operation, duration);
+    LatencyMetrics::getInstance().record(m_metric, static_cast<uint64_t>(pipeline::now() - m_startNs));
 }
 
 // ThreadUtils implementation
-void ThreadUtils::setThreadPriority(int priority) {
+namespace {
+    std::mutex g_threadStartMutex;
+    ThreadUtils::ThreadStartHook g_threadStartHook;
+}
+
+bool ThreadUtils::setThreadPriority(int priority) {
 #ifdef __linux__
     struct sched_param param;
     param.sched_priority = priority;
     
     if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
         Logger::getInstance().warning("Failed to set thread priority");
+        return false;
     }
 #elif defined(_WIN32)
     if (!SetThreadPriority(GetCurrentThread(), priority)) {
         Logger::getInstance().warning("Failed to set thread priority");
+        return false;
     }
 #endif
+    return true;
+}
+
+bool ThreadUtils::setThreadAffinity(int cpuId) {
+    return setThreadAffinity(std::vector<int>{cpuId});
 }
 
-void ThreadUtils::setThreadAffinity(int cpuId) {
+bool ThreadUtils::setThreadAffinity(const std::vector<int>& cpuIds) {
 #ifdef __linux__
     cpu_set_t cpuset;
     CPU_ZERO(&cpuset);
-    CPU_SET(cpuId, &cpuset);
+    for (int cpuId : cpuIds) {
+        CPU_SET(cpuId, &cpuset);
+    }
     
     if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
         Logger::getInstance().warning("Failed to set thread affinity");
+        return false;
     }
 #elif defined(_WIN32)
-    DWORD_PTR mask = 1ULL << cpuId;
+    DWORD_PTR mask = 0;
+    for (int cpuId : cpuIds) {
+        mask |= 1ULL << cpuId;
+    }
     if (!SetThreadAffinityMask(GetCurrentThread(), mask)) {
         Logger::getInstance().warning("Failed to set thread affinity");
+        return false;
     }
 #endif
+    return true;
 }
 
 void ThreadUtils::setThreadName(const std::string& name) {
 #ifdef __linux__
-    pthread_setname_np(pthread_self(), name.c_str());
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
 #endif
 }
 
@@ -173,6 +197,39 @@ int ThreadUtils::getCurrentCPU() {
 #endif
 }
 
+std::vector<int> ThreadUtils::getThreadAffinity() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpuset)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    return cpus;
+}
+
+void ThreadUtils::setThreadStartHook(ThreadStartHook hook) {
+    std::lock_guard<std::mutex> lock(g_threadStartMutex);
+    g_threadStartHook = std::move(hook);
+}
+
+void ThreadUtils::onThreadStart(const std::string& role, const std::string& name) {
+    setThreadName(name);
+    ThreadStartHook hook;
+    {
+        std::lock_guard<std::mutex> lock(g_threadStartMutex);
+        hook = g_threadStartHook;
+    }
+    if (hook) {
+        hook(role, name);
+    }
+}
+
 // MemoryUtils implementation
 size_t MemoryUtils::getProcessMemoryUsage() {
 #ifdef __linux__
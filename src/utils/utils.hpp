@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include <chrono>
+#include <functional>
 #include <vector>
 #include <optional>
 
@@ -23,24 +24,39 @@ bool isValidQuantity(double quantity);
 double roundPrice(double price, int decimals);
 double roundQuantity(double quantity, int decimals);
 
-// Performance measurement
+// Performance measurement. Records the scope's duration in the named
+// LatencyMetrics histogram; pass the metric ID on hot paths to skip the
+// name lookup.
 class ScopedTimer {
 public:
-    ScopedTimer(const std::string& operation);
+    explicit ScopedTimer(const std::string& operation);
+    explicit ScopedTimer(uint32_t metric);
     ~ScopedTimer();
 
 private:
-    std::string m_operation;
-    std::chrono::high_resolution_clock::time_point m_start;
+    uint32_t m_metric;
+    int64_t m_startNs;
 };
 
-// Thread utilities
+// Thread utilities. The setters act on the calling thread and return
+// false, with a warning logged, when the OS refuses.
 class ThreadUtils {
 public:
-    static void setThreadPriority(int priority);
-    static void setThreadAffinity(int cpuId);
+    static bool setThreadPriority(int priority);        // SCHED_FIFO
+    static bool setThreadAffinity(int cpuId);
+    static bool setThreadAffinity(const std::vector<int>& cpuIds);
     static void setThreadName(const std::string& name);
     static int getCurrentCPU();
+    // CPUs the calling thread may run on
+    static std::vector<int> getThreadAffinity();
+
+    // Long-lived threads call onThreadStart() first thing with their role
+    // ("logging", "order_entry", "housekeeping", ...) and a name of at
+    // most 15 characters. It names the thread and hands it to the hook,
+    // which a runtime installs to pin and prioritise threads by role.
+    using ThreadStartHook = std::function<void(const std::string& role, const std::string& name)>;
+    static void setThreadStartHook(ThreadStartHook hook);
+    static void onThreadStart(const std::string& role, const std::string& name);
 };
 
 // Memory utilities
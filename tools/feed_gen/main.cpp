@@ -0,0 +1,692 @@
+// Synthetic Deribit market data for throughput stress tests. By default
+// frames are pre-generated and pushed through MarketDataManager on one or
+// more threads, as fast as possible or paced at a target rate; a sweep
+// over instrument and thread counts shows where the pipeline saturates.
+// serve streams the same feed over a local websocket instead, for testing
+// the client end to end, and print writes it to stdout.
+//
+//   feed_gen --instruments 100 --threads 4
+//   feed_gen --sweep-instruments 1,10,100,1000 --sweep-threads 1,2,4,8
+//   feed_gen --rate 200000 --seconds 10 --instruments 50 --burst 20
+//   feed_gen serve --plain-port 8080 --instruments 20 --speed 2
+//   feed_gen print --instruments 2 --frames 10
+//
+// serve answers subscriptions and auth only; use mock_exchange for order
+// entry.
+
+#include "sim/feed_generator.hpp"
+#include "market/market_data.hpp"
+#include "utils/histogram.hpp"
+#include "utils/logger.hpp"
+#include <websocketpp/config/asio.hpp>
+#include <websocketpp/server.hpp>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+using TlsServer = websocketpp::server<websocketpp::config::asio_tls>;
+using PlainServer = websocketpp::server<websocketpp::config::asio>;
+
+namespace {
+    constexpr auto kServeTick = std::chrono::milliseconds(1);
+    // Frames sent per tick at most, a serve that cannot keep up lags
+    // rather than stalling the io thread
+    constexpr size_t kMaxFramesPerTick = 100000;
+
+    enum class Mode { BENCH, SERVE, PRINT };
+
+    struct Options {
+        Mode mode = Mode::BENCH;
+        FeedGeneratorConfig feed;
+        size_t instrumentCount = 10;
+        bool instrumentsListed = false;
+
+        // bench
+        std::vector<size_t> sweepInstruments;
+        std::vector<int> sweepThreads;
+        int threads = 1;
+        size_t frames = 200000;
+        double rate = 0.0;              // Total frames per second, 0 unpaced
+        double seconds = 5.0;
+
+        // serve
+        uint16_t port = 0;
+        uint16_t plainPort = 0;
+        std::string certFile;
+        std::string keyFile;
+        double speed = 1.0;
+        int statsIntervalSeconds = 10;
+    };
+
+    void usage() {
+        std::cerr <<
+            "Usage: feed_gen [bench|serve|print] [options]\n"
+            "Feed:\n"
+            "  --instruments N        generated instrument names\n"
+            "  --instrument-list A,B  explicit instruments instead\n"
+            "  --book-rate N          book changes per second per instrument\n"
+            "  --trade-rate N         trade frames per second per instrument\n"
+            "  --ticker-rate N        tickers per second per instrument\n"
+            "  --depth N              levels per side kept in the book\n"
+            "  --snapshot-depth N     levels per side in snapshots\n"
+            "  --snapshot-every N     repeat the snapshot after N changes\n"
+            "  --calm-s S             mean calm regime length\n"
+            "  --volatile-s S         mean volatile regime length, 0 disables\n"
+            "  --burst X              rate multiplier while volatile\n"
+            "  --seed N               random seed\n"
+            "bench (default):\n"
+            "  --threads N            ingest threads, instruments are sharded\n"
+            "  --frames N             frames per unpaced run\n"
+            "  --rate N               pace at N frames per second in total\n"
+            "  --seconds S            length of a paced run\n"
+            "  --sweep-instruments L  comma separated instrument counts\n"
+            "  --sweep-threads L      comma separated thread counts\n"
+            "serve:\n"
+            "  --port N               TLS websocket port (needs --cert and --key)\n"
+            "  --plain-port N         plain websocket port\n"
+            "  --cert FILE            PEM certificate chain\n"
+            "  --key FILE             PEM private key\n"
+            "  --speed X              virtual time runs X times faster\n"
+            "  --stats-interval S     seconds between stats lines, 0 disables\n"
+            "print:\n"
+            "  --frames N             frames to write\n";
+    }
+
+    template<typename T, typename Parse>
+    std::vector<T> parseList(const std::string& value, Parse parse) {
+        std::vector<T> result;
+        std::istringstream list(value);
+        std::string item;
+        while (std::getline(list, item, ',')) {
+            if (!item.empty()) result.push_back(static_cast<T>(parse(item)));
+        }
+        return result;
+    }
+
+    Options parseOptions(int argc, char* argv[]) {
+        Options options;
+        int first = 1;
+        if (argc > 1 && argv[1][0] != '-') {
+            std::string mode = argv[1];
+            if (mode == "bench") options.mode = Mode::BENCH;
+            else if (mode == "serve") options.mode = Mode::SERVE;
+            else if (mode == "print") options.mode = Mode::PRINT;
+            else throw std::invalid_argument("Unknown mode " + mode);
+            first = 2;
+        }
+        if (options.mode == Mode::PRINT) {
+            options.frames = 20;
+        }
+
+        for (int i = first; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(0);
+            }
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            std::string value = argv[++i];
+
+            if (arg == "--instruments") options.instrumentCount = std::stoull(value);
+            else if (arg == "--book-rate") options.feed.bookChangesPerSecond = std::stod(value);
+            else if (arg == "--trade-rate") options.feed.tradesPerSecond = std::stod(value);
+            else if (arg == "--ticker-rate") options.feed.tickersPerSecond = std::stod(value);
+            else if (arg == "--depth") options.feed.bookDepth = std::stoi(value);
+            else if (arg == "--snapshot-depth") options.feed.snapshotDepth = std::stoi(value);
+            else if (arg == "--snapshot-every") options.feed.snapshotInterval = std::stoull(value);
+            else if (arg == "--calm-s") options.feed.meanCalmSeconds = std::stod(value);
+            else if (arg == "--volatile-s") options.feed.meanVolatileSeconds = std::stod(value);
+            else if (arg == "--burst") options.feed.burstMultiplier = std::stod(value);
+            else if (arg == "--seed") options.feed.seed = std::stoull(value);
+            else if (arg == "--threads") options.threads = std::max(1, std::stoi(value));
+            else if (arg == "--frames") options.frames = std::max<size_t>(1, std::stoull(value));
+            else if (arg == "--rate") options.rate = std::stod(value);
+            else if (arg == "--seconds") options.seconds = std::stod(value);
+            else if (arg == "--port") options.port = static_cast<uint16_t>(std::stoi(value));
+            else if (arg == "--plain-port") options.plainPort = static_cast<uint16_t>(std::stoi(value));
+            else if (arg == "--cert") options.certFile = value;
+            else if (arg == "--key") options.keyFile = value;
+            else if (arg == "--speed") options.speed = std::stod(value);
+            else if (arg == "--stats-interval") options.statsIntervalSeconds = std::stoi(value);
+            else if (arg == "--sweep-instruments") {
+                options.sweepInstruments = parseList<size_t>(value, [](const std::string& s) { return std::stoull(s); });
+            } else if (arg == "--sweep-threads") {
+                options.sweepThreads = parseList<int>(value, [](const std::string& s) { return std::stoi(s); });
+            } else if (arg == "--instrument-list") {
+                options.feed.instruments = parseList<std::string>(value, [](const std::string& s) { return s; });
+                options.instrumentsListed = true;
+            } else {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+
+        if (!options.instrumentsListed) {
+            options.feed.instruments = FeedGenerator::makeInstruments(options.instrumentCount);
+        }
+        if (options.mode == Mode::SERVE) {
+            if (options.port == 0 && options.plainPort == 0) {
+                options.plainPort = 8080;
+            }
+            if (options.port != 0 && (options.certFile.empty() || options.keyFile.empty())) {
+                throw std::invalid_argument("--port needs --cert and --key");
+            }
+            if (options.speed <= 0.0) {
+                throw std::invalid_argument("--speed must be positive");
+            }
+        }
+        return options;
+    }
+
+    double micros(uint64_t ns) {
+        return static_cast<double>(ns) / 1000.0;
+    }
+
+    // bench
+
+    struct RunResult {
+        size_t instruments = 0;
+        int threads = 0;
+        size_t frames = 0;
+        size_t bytes = 0;
+        double seconds = 0.0;
+        double targetRate = 0.0;
+        utils::LatencyHistogram processing;     // processMessage() per frame
+        utils::LatencyHistogram lag;            // Paced: done minus due time
+    };
+
+    struct Shard {
+        std::vector<FeedFrame> frames;
+        double scale = 1.0;                     // Virtual ns to wall ns, paced only
+        utils::LatencyHistogram processing;
+        utils::LatencyHistogram lag;
+    };
+
+    int64_t steadyNowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Instruments are dealt round-robin to threads, each with its own
+    // generator, so a book is only ever updated from one thread as with a
+    // per-connection feed
+    RunResult runBench(const Options& options, const std::vector<std::string>& instruments, int threads) {
+        threads = std::max(1, std::min<int>(threads, static_cast<int>(instruments.size())));
+        bool paced = options.rate > 0.0;
+
+        std::vector<Shard> shards(threads);
+        for (int t = 0; t < threads; ++t) {
+            FeedGeneratorConfig config = options.feed;
+            config.instruments.clear();
+            for (size_t i = t; i < instruments.size(); i += threads) {
+                config.instruments.push_back(instruments[i]);
+            }
+            config.seed = options.feed.seed + static_cast<uint64_t>(t);
+
+            size_t count = paced ? static_cast<size_t>(options.rate / threads * options.seconds)
+                                 : options.frames / threads;
+            count = std::max<size_t>(count, config.instruments.size());
+
+            FeedGenerator generator(config);
+            Shard& shard = shards[t];
+            shard.frames.resize(count);
+            for (auto& frame : shard.frames) {
+                generator.next(frame);
+            }
+            // Stretch or squeeze virtual time so the shard averages its share
+            // of the target rate, bursts included
+            int64_t spanNs = std::max<int64_t>(1, shard.frames.back().timeNs);
+            if (paced) {
+                shard.scale = static_cast<double>(count) / (options.rate / threads) * 1e9 / spanNs;
+            }
+        }
+
+        deribit::MarketDataManager marketData("wss://feed-gen.invalid");
+        for (const auto& instrument : instruments) {
+            marketData.addOrderBook(instrument);
+        }
+
+        std::atomic<int> ready{0};
+        std::atomic<int64_t> startNs{0};
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                Shard& shard = shards[t];
+                ready.fetch_add(1);
+                int64_t start;
+                while ((start = startNs.load(std::memory_order_acquire)) == 0) {
+                    std::this_thread::yield();
+                }
+                for (const auto& frame : shard.frames) {
+                    int64_t dueNs = start;
+                    if (paced) {
+                        dueNs = start + static_cast<int64_t>(static_cast<double>(frame.timeNs) * shard.scale);
+                        int64_t now;
+                        while ((now = steadyNowNs()) < dueNs) {
+                            if (dueNs - now > 200000) {
+                                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                            }
+                        }
+                    }
+                    int64_t begin = steadyNowNs();
+                    marketData.processMessage(frame.payload);
+                    int64_t end = steadyNowNs();
+                    shard.processing.record(static_cast<uint64_t>(end - begin));
+                    if (paced) {
+                        shard.lag.record(static_cast<uint64_t>(std::max<int64_t>(0, end - dueNs)));
+                    }
+                }
+            });
+        }
+        while (ready.load() < threads) {
+            std::this_thread::yield();
+        }
+        int64_t start = steadyNowNs();
+        startNs.store(start, std::memory_order_release);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        int64_t elapsed = steadyNowNs() - start;
+
+        RunResult result;
+        result.instruments = instruments.size();
+        result.threads = threads;
+        result.seconds = static_cast<double>(elapsed) / 1e9;
+        result.targetRate = options.rate;
+        for (const auto& shard : shards) {
+            result.frames += shard.frames.size();
+            for (const auto& frame : shard.frames) {
+                result.bytes += frame.payload.size();
+            }
+            result.processing.merge(shard.processing);
+            result.lag.merge(shard.lag);
+        }
+        return result;
+    }
+
+    void printResultHeader(bool paced) {
+        std::printf("%11s %7s %10s %12s %8s %9s %9s %9s", "instruments", "threads", "frames",
+                    "frames/s", "MB/s", "p50 us", "p99 us", "max us");
+        if (paced) {
+            std::printf(" %12s %12s %12s", "lag p99 us", "lag max us", "kept up");
+        }
+        std::printf("\n");
+    }
+
+    void printResult(const RunResult& result) {
+        std::printf("%11zu %7d %10zu %12.0f %8.1f %9.2f %9.2f %9.2f", result.instruments, result.threads,
+                    result.frames, result.frames / result.seconds, result.bytes / result.seconds / 1e6,
+                    micros(result.processing.percentile(50)), micros(result.processing.percentile(99)),
+                    micros(result.processing.max()));
+        if (result.targetRate > 0.0) {
+            // Behind if the run overran its schedule by more than a tenth
+            double planned = static_cast<double>(result.frames) / result.targetRate;
+            std::printf(" %12.1f %12.1f %12s", micros(result.lag.percentile(99)), micros(result.lag.max()),
+                        result.seconds <= planned * 1.1 ? "yes" : "no");
+        }
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+
+    int runBenchMode(const Options& options) {
+        // Parse errors are still logged, but not to the terminal
+        auto& logger = Logger::getInstance();
+        logger.setLogFile("feed_gen.log");
+        logger.setConsoleOutput(false);
+        logger.setLogLevel(LogLevel::WARNING);
+
+        std::vector<size_t> instrumentCounts = options.sweepInstruments;
+        if (instrumentCounts.empty() || options.instrumentsListed) {
+            instrumentCounts = {options.feed.instruments.size()};
+        }
+        std::vector<int> threadCounts = options.sweepThreads;
+        if (threadCounts.empty()) {
+            threadCounts = {options.threads};
+        }
+
+        FeedGenerator reference(options.feed);
+        std::printf("feed: %.0f frames/s per instrument on average, burst x%.1f\n",
+                    reference.expectedRate() / options.feed.instruments.size(), options.feed.burstMultiplier);
+        printResultHeader(options.rate > 0.0);
+
+        for (size_t count : instrumentCounts) {
+            std::vector<std::string> instruments = options.instrumentsListed
+                ? options.feed.instruments : FeedGenerator::makeInstruments(count);
+            for (int threads : threadCounts) {
+                printResult(runBench(options, instruments, threads));
+            }
+        }
+        return 0;
+    }
+
+    int runPrintMode(const Options& options) {
+        FeedGenerator generator(options.feed);
+        FeedFrame frame;
+        for (size_t i = 0; i < options.frames; ++i) {
+            generator.next(frame);
+            std::cout << frame.payload << '\n';
+        }
+        std::cout.flush();
+        return 0;
+    }
+}
+
+// serve
+
+// Streams the generator to websocket subscribers in virtual time scaled by
+// --speed. Everything runs on one io_context thread.
+class FeedServer {
+public:
+    FeedServer(const Options& options, boost::asio::io_context& io)
+        : m_options(options)
+        , m_generator(options.feed)
+        , m_io(io)
+        , m_timer(io) {
+        const auto& instruments = m_generator.getConfig().instruments;
+        for (size_t i = 0; i < instruments.size(); ++i) {
+            m_instrumentIndex[instruments[i]] = static_cast<uint32_t>(i);
+        }
+        m_generator.next(m_pending);
+    }
+
+    template<typename Endpoint>
+    void attach(Endpoint& endpoint) {
+        endpoint.clear_access_channels(websocketpp::log::alevel::all);
+        endpoint.clear_error_channels(websocketpp::log::elevel::all);
+        endpoint.init_asio(&m_io);
+        endpoint.set_reuse_addr(true);
+
+        endpoint.set_open_handler([this, &endpoint](websocketpp::connection_hdl hdl) {
+            Connection connection;
+            connection.send = [&endpoint, hdl](const std::string& payload) {
+                websocketpp::lib::error_code ec;
+                endpoint.send(hdl, payload, websocketpp::frame::opcode::text, ec);
+            };
+            m_connections[hdl] = std::move(connection);
+        });
+
+        auto onClose = [this](websocketpp::connection_hdl hdl) {
+            m_connections.erase(hdl);
+        };
+        endpoint.set_close_handler(onClose);
+        endpoint.set_fail_handler(onClose);
+
+        endpoint.set_message_handler([this](websocketpp::connection_hdl hdl, typename Endpoint::message_ptr msg) {
+            auto it = m_connections.find(hdl);
+            if (it != m_connections.end()) {
+                handleRequest(it->second, msg->get_payload());
+            }
+        });
+    }
+
+    void start() {
+        m_startedAt = std::chrono::steady_clock::now();
+        tick();
+    }
+
+    size_t getConnectionCount() const { return m_connections.size(); }
+    uint64_t getFramesSent() const { return m_framesSent; }
+    uint64_t getFramesGenerated() const { return m_framesGenerated; }
+    // How far generation trails the virtual clock
+    double getLagMs() const { return m_lagNs / 1e6; }
+
+private:
+    struct Connection {
+        std::function<void(const std::string&)> send;
+        std::unordered_set<uint64_t> subscriptions;     // subscriptionKey()
+        std::vector<uint32_t> heldSnapshots;            // Until m_pending is sent
+    };
+
+    enum Channel : uint64_t { BOOK = 0, TRADES = 1, TICKER = 2 };
+
+    static uint64_t subscriptionKey(uint32_t instrument, uint64_t channel) {
+        return (static_cast<uint64_t>(instrument) << 2) | channel;
+    }
+
+    static uint64_t channelOf(FeedFrameKind kind) {
+        switch (kind) {
+            case FeedFrameKind::TRADES: return TRADES;
+            case FeedFrameKind::TICKER: return TICKER;
+            default:                    return BOOK;
+        }
+    }
+
+    // Accepts "book.<instrument>.<interval>" and "<instrument>.book"
+    bool parseChannel(const std::string& channel, uint32_t& instrument, uint64_t& type) const {
+        size_t first = channel.find('.');
+        if (first == std::string::npos) {
+            return false;
+        }
+        std::string head = channel.substr(0, first);
+        std::string name;
+        std::string kind;
+        if (head == "book" || head == "trades" || head == "ticker") {
+            size_t second = channel.find('.', first + 1);
+            name = channel.substr(first + 1, second == std::string::npos ? std::string::npos : second - first - 1);
+            kind = head;
+        } else {
+            name = head;
+            kind = channel.substr(first + 1);
+        }
+        auto it = m_instrumentIndex.find(name);
+        if (it == m_instrumentIndex.end()) {
+            return false;
+        }
+        instrument = it->second;
+        if (kind == "book") type = BOOK;
+        else if (kind == "trades") type = TRADES;
+        else if (kind == "ticker") type = TICKER;
+        else return false;
+        return true;
+    }
+
+    void handleRequest(Connection& connection, const std::string& payload) {
+        nlohmann::json request = nlohmann::json::parse(payload, nullptr, false);
+        if (request.is_discarded() || !request.is_object()) {
+            return;
+        }
+        nlohmann::json response = {{"jsonrpc", "2.0"}, {"id", request.value("id", nlohmann::json())}};
+        std::string method = request.value("method", "");
+        const nlohmann::json params = request.value("params", nlohmann::json::object());
+
+        std::vector<uint32_t> newBooks;
+        if (method == "public/subscribe" || method == "private/subscribe" ||
+            method == "public/unsubscribe" || method == "private/unsubscribe") {
+            bool subscribe = method.find("unsubscribe") == std::string::npos;
+            nlohmann::json accepted = nlohmann::json::array();
+            for (const auto& channel : params.value("channels", nlohmann::json::array())) {
+                uint32_t instrument;
+                uint64_t type;
+                if (!channel.is_string() || !parseChannel(channel.get<std::string>(), instrument, type)) {
+                    continue;
+                }
+                uint64_t key = subscriptionKey(instrument, type);
+                if (subscribe && connection.subscriptions.insert(key).second && type == BOOK) {
+                    newBooks.push_back(instrument);
+                } else if (!subscribe) {
+                    connection.subscriptions.erase(key);
+                }
+                accepted.push_back(channel);
+            }
+            response["result"] = accepted;
+        } else if (method == "public/auth") {
+            response["result"] = {{"access_token", "feed-gen"}, {"refresh_token", "feed-gen"},
+                                  {"expires_in", 900}, {"scope", "session:feed-gen"}, {"token_type", "bearer"}};
+        } else if (method == "public/test" || method == "public/set_heartbeat" ||
+                   method == "private/enable_cancel_on_disconnect") {
+            response["result"] = "ok";
+        } else if (method == "public/get_time") {
+            response["result"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        } else {
+            response["error"] = {{"code", -32601}, {"message", "Method not found"}};
+        }
+        connection.send(response.dump());
+
+        // A book subscriber needs a snapshot before changes make sense.
+        // The generator's book already includes m_pending; when that is a
+        // change of this book the snapshot waits until it has been sent,
+        // or the change would arrive behind the snapshot's change_id.
+        std::string snapshot;
+        for (uint32_t instrument : newBooks) {
+            if (channelOf(m_pending.kind) == BOOK && m_pending.instrument == instrument) {
+                connection.heldSnapshots.push_back(instrument);
+                m_snapshotsHeld = true;
+                continue;
+            }
+            snapshot.clear();
+            m_generator.snapshot(instrument, snapshot);
+            connection.send(snapshot);
+        }
+    }
+
+    void sendHeldSnapshots() {
+        std::string snapshot;
+        for (auto& entry : m_connections) {
+            for (uint32_t instrument : entry.second.heldSnapshots) {
+                snapshot.clear();
+                m_generator.snapshot(instrument, snapshot);
+                entry.second.send(snapshot);
+            }
+            entry.second.heldSnapshots.clear();
+        }
+        m_snapshotsHeld = false;
+    }
+
+    void tick() {
+        auto elapsed = std::chrono::steady_clock::now() - m_startedAt;
+        int64_t virtualNs = static_cast<int64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() * m_options.speed);
+
+        size_t sent = 0;
+        while (m_pending.timeNs <= virtualNs && sent < kMaxFramesPerTick) {
+            uint64_t key = subscriptionKey(m_pending.instrument, channelOf(m_pending.kind));
+            for (auto& entry : m_connections) {
+                if (entry.second.subscriptions.count(key)) {
+                    entry.second.send(m_pending.payload);
+                    ++m_framesSent;
+                }
+            }
+            ++m_framesGenerated;
+            ++sent;
+            if (m_snapshotsHeld) {
+                sendHeldSnapshots();
+            }
+            m_generator.next(m_pending);
+        }
+        m_lagNs = std::max<int64_t>(0, virtualNs - m_pending.timeNs);
+
+        m_timer.expires_after(kServeTick);
+        m_timer.async_wait([this](const boost::system::error_code& ec) {
+            if (!ec) {
+                tick();
+            }
+        });
+    }
+
+    const Options& m_options;
+    FeedGenerator m_generator;
+    boost::asio::io_context& m_io;
+    boost::asio::steady_timer m_timer;
+    std::chrono::steady_clock::time_point m_startedAt;
+    FeedFrame m_pending;
+    std::map<std::string, uint32_t> m_instrumentIndex;
+    std::map<websocketpp::connection_hdl, Connection, std::owner_less<websocketpp::connection_hdl>> m_connections;
+    uint64_t m_framesSent = 0;
+    uint64_t m_framesGenerated = 0;
+    int64_t m_lagNs = 0;
+    bool m_snapshotsHeld = false;
+};
+
+namespace {
+    int runServeMode(const Options& options) {
+        boost::asio::io_context io;
+        FeedServer server(options, io);
+
+        TlsServer tlsEndpoint;
+        PlainServer plainEndpoint;
+
+        if (options.port != 0) {
+            server.attach(tlsEndpoint);
+            tlsEndpoint.set_tls_init_handler([&options](websocketpp::connection_hdl) {
+                auto context = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tls_server);
+                context->use_certificate_chain_file(options.certFile);
+                context->use_private_key_file(options.keyFile, boost::asio::ssl::context::pem);
+                return context;
+            });
+            tlsEndpoint.listen(options.port);
+            tlsEndpoint.start_accept();
+            std::cout << "TLS websocket on port " << options.port << std::endl;
+        }
+        if (options.plainPort != 0) {
+            server.attach(plainEndpoint);
+            plainEndpoint.listen(options.plainPort);
+            plainEndpoint.start_accept();
+            std::cout << "Plain websocket on port " << options.plainPort << std::endl;
+        }
+        std::cout << options.feed.instruments.size() << " instruments, about "
+                  << static_cast<uint64_t>(FeedGenerator(options.feed).expectedRate() * options.speed)
+                  << " frames/s" << std::endl;
+
+        server.start();
+
+        boost::asio::steady_timer statsTimer(io);
+        uint64_t lastSent = 0;
+        uint64_t lastGenerated = 0;
+        std::function<void()> scheduleStats = [&]() {
+            if (options.statsIntervalSeconds <= 0) {
+                return;
+            }
+            statsTimer.expires_after(std::chrono::seconds(options.statsIntervalSeconds));
+            statsTimer.async_wait([&](const boost::system::error_code& ec) {
+                if (ec) return;
+                double seconds = options.statsIntervalSeconds;
+                std::cout << "connections=" << server.getConnectionCount()
+                          << " generated/s=" << (server.getFramesGenerated() - lastGenerated) / seconds
+                          << " sent/s=" << (server.getFramesSent() - lastSent) / seconds
+                          << " lag_ms=" << server.getLagMs() << std::endl;
+                lastSent = server.getFramesSent();
+                lastGenerated = server.getFramesGenerated();
+                scheduleStats();
+            });
+        };
+        scheduleStats();
+
+        boost::asio::signal_set signals(io, SIGINT, SIGTERM);
+        signals.async_wait([&](const boost::system::error_code&, int) {
+            io.stop();
+        });
+
+        io.run();
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parseOptions(argc, argv);
+        switch (options.mode) {
+            case Mode::SERVE: return runServeMode(options);
+            case Mode::PRINT: return runPrintMode(options);
+            case Mode::BENCH: return runBenchMode(options);
+        }
+        return 0;
+
+    } catch (const std::exception& e) {
+        std::cerr << "feed_gen: " << e.what() << std::endl;
+        return 1;
+    }
+}
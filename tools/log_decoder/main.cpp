@@ -0,0 +1,191 @@
+// Turns a binary log written with AsyncLogConfig::binaryFile back into the
+// text format of the regular log file.
+//
+//   log_decoder trading_system.blog > trading_system.txt
+//   log_decoder --level WARNING --sites trading_system.blog
+
+#include "utils/binary_log.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    const char* kLevelNames[] = {"DEBUG", "INFO", "WARNING", "ERROR", "CRITICAL"};
+
+    struct Options {
+        std::string path;
+        int minLevel = 0;
+        bool listSites = false;
+    };
+
+    struct Site {
+        int level;
+        uint32_t line;
+        std::string format;
+        std::string file;
+    };
+
+    void usage() {
+        std::cerr <<
+            "Usage: log_decoder [options] <binary log>\n"
+            "  --level NAME           skip records below NAME (DEBUG, INFO, ...)\n"
+            "  --sites                list the format sites instead of the records\n";
+    }
+
+    int parseLevel(const std::string& name) {
+        for (int i = 0; i < 5; ++i) {
+            if (name == kLevelNames[i]) {
+                return i;
+            }
+        }
+        throw std::invalid_argument("Unknown level " + name);
+    }
+
+    const char* levelName(int level) {
+        return level >= 0 && level < 5 ? kLevelNames[level] : "UNKNOWN";
+    }
+
+    Options parseOptions(int argc, char* argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(0);
+            }
+            if (arg == "--sites") {
+                options.listSites = true;
+            } else if (arg == "--level" && i + 1 < argc) {
+                options.minLevel = parseLevel(argv[++i]);
+            } else if (arg.compare(0, 2, "--") != 0 && options.path.empty()) {
+                options.path = arg;
+            } else {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+        if (options.path.empty()) {
+            throw std::invalid_argument("Need a binary log file");
+        }
+        return options;
+    }
+
+    template<typename T>
+    T readAt(const char*& in) {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
+    }
+
+    void appendTimestamp(int64_t timeNs, std::string& out) {
+        std::time_t seconds = static_cast<std::time_t>(timeNs / 1000000000);
+        std::tm local;
+        localtime_r(&seconds, &local);
+        char text[40];
+        size_t length = std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+        std::snprintf(text + length, sizeof(text) - length, ".%03d",
+                      static_cast<int>((timeNs / 1000000) % 1000));
+        out += text;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parseOptions(argc, argv);
+
+        std::ifstream file(options.path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open " + options.path);
+        }
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < sizeof(utils::kBinaryLogMagic) ||
+            std::memcmp(data.data(), utils::kBinaryLogMagic, sizeof(utils::kBinaryLogMagic)) != 0) {
+            throw std::runtime_error("Not a binary log: " + options.path);
+        }
+
+        std::map<uint32_t, Site> sites;
+        std::string line;
+        uint64_t malformed = 0;
+
+        const char* in = data.data() + sizeof(utils::kBinaryLogMagic);
+        const char* end = data.data() + data.size();
+        while (end - in >= 5) {
+            auto type = static_cast<utils::BinaryLogEntry>(readAt<uint8_t>(in));
+            uint32_t length = readAt<uint32_t>(in);
+            if (static_cast<size_t>(end - in) < length) {
+                break;  // Cut short by a crash
+            }
+            const char* payload = in;
+            const char* payloadEnd = in + length;
+            in = payloadEnd;
+
+            if (type == utils::BinaryLogEntry::SITE) {
+                uint32_t id = readAt<uint32_t>(payload);
+                Site site;
+                site.level = readAt<uint8_t>(payload);
+                site.line = readAt<uint32_t>(payload);
+                site.format = payload;
+                site.file = payload + site.format.size() + 1;
+                if (options.listSites) {
+                    std::printf("%u %s %s:%u \"%s\"\n", id, levelName(site.level),
+                                site.file.c_str(), site.line, site.format.c_str());
+                }
+                sites[id] = std::move(site);
+                continue;
+            }
+            if (options.listSites) {
+                continue;
+            }
+
+            int64_t timeNs = readAt<int64_t>(payload);
+            int level;
+            line.clear();
+            if (type == utils::BinaryLogEntry::TEXT) {
+                level = readAt<uint8_t>(payload);
+                if (level < options.minLevel) continue;
+                appendTimestamp(timeNs, line);
+                line += " [";
+                line += levelName(level);
+                line += "] ";
+                line.append(payload, payloadEnd);
+            } else if (type == utils::BinaryLogEntry::DEFERRED) {
+                auto site = sites.find(readAt<uint32_t>(payload));
+                if (site == sites.end()) {
+                    ++malformed;
+                    continue;
+                }
+                level = site->second.level;
+                if (level < options.minLevel) continue;
+                appendTimestamp(timeNs, line);
+                line += " [";
+                line += levelName(level);
+                line += "] ";
+                if (!utils::formatLogRecord(site->second.format.c_str(), payload,
+                                            static_cast<size_t>(payloadEnd - payload), line)) {
+                    ++malformed;
+                }
+            } else {
+                ++malformed;
+                continue;
+            }
+            line += '\n';
+            std::fwrite(line.data(), 1, line.size(), stdout);
+        }
+
+        if (malformed > 0) {
+            std::cerr << "log_decoder: " << malformed << " malformed records" << std::endl;
+        }
+        return 0;
+
+    } catch (const std::exception& e) {
+        std::cerr << "log_decoder: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,372 @@
+// Local Deribit stand-in. Serves JSON-RPC over websocket and REST over
+// HTTP on the same ports: TLS on --port when a certificate is given (the
+// trading client only speaks wss), plain ws/http on --plain-port.
+//
+//   mock_exchange --port 8443 --cert server.pem --key server.key
+//                 --plain-port 8080 --book-rate 1000 --latency-us 200
+//
+// Point ws_url at wss://127.0.0.1:8443/ws/api/v2 and rest_url at
+// http://127.0.0.1:8080/api/v2.
+
+#include "mock_exchange.hpp"
+#include <websocketpp/config/asio.hpp>
+#include <websocketpp/server.hpp>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+
+using TlsServer = websocketpp::server<websocketpp::config::asio_tls>;
+using PlainServer = websocketpp::server<websocketpp::config::asio>;
+
+namespace {
+    constexpr auto kMarketTick = std::chrono::milliseconds(1);
+
+    struct Options {
+        MockExchangeConfig exchange;
+        uint16_t port = 0;
+        uint16_t plainPort = 0;
+        std::string certFile;
+        std::string keyFile;
+        int statsIntervalSeconds = 10;
+    };
+
+    void usage() {
+        std::cerr <<
+            "Usage: mock_exchange [options]\n"
+            "  --port N               TLS websocket/https port (needs --cert and --key)\n"
+            "  --plain-port N         plain websocket/http port\n"
+            "  --cert FILE            PEM certificate chain\n"
+            "  --key FILE             PEM private key\n"
+            "  --instruments A,B      instruments to simulate\n"
+            "  --book-rate N          book changes per second per instrument\n"
+            "  --trade-rate N         trades per second per instrument\n"
+            "  --ticker-rate N        tickers per second per instrument\n"
+            "  --depth N              levels per side\n"
+            "  --latency-us N         delay added to every outbound frame\n"
+            "  --jitter-us N          uniform extra delay\n"
+            "  --gap-prob P           probability a book change is dropped\n"
+            "  --disconnect-after N   close each connection after N frames\n"
+            "  --disconnect-prob P    probability of closing after a frame\n"
+            "  --seed N               random seed\n"
+            "  --stats-interval S     seconds between stats lines, 0 disables\n";
+    }
+
+    Options parseOptions(int argc, char* argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(0);
+            }
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            std::string value = argv[++i];
+
+            if (arg == "--port") options.port = static_cast<uint16_t>(std::stoi(value));
+            else if (arg == "--plain-port") options.plainPort = static_cast<uint16_t>(std::stoi(value));
+            else if (arg == "--cert") options.certFile = value;
+            else if (arg == "--key") options.keyFile = value;
+            else if (arg == "--book-rate") options.exchange.bookUpdatesPerSecond = std::stod(value);
+            else if (arg == "--trade-rate") options.exchange.tradesPerSecond = std::stod(value);
+            else if (arg == "--ticker-rate") options.exchange.tickersPerSecond = std::stod(value);
+            else if (arg == "--depth") options.exchange.bookDepth = std::stoi(value);
+            else if (arg == "--latency-us") options.exchange.latencyUs = static_cast<uint32_t>(std::stoul(value));
+            else if (arg == "--jitter-us") options.exchange.latencyJitterUs = static_cast<uint32_t>(std::stoul(value));
+            else if (arg == "--gap-prob") options.exchange.gapProbability = std::stod(value);
+            else if (arg == "--disconnect-after") options.exchange.disconnectAfterMessages = std::stoull(value);
+            else if (arg == "--disconnect-prob") options.exchange.disconnectProbability = std::stod(value);
+            else if (arg == "--seed") options.exchange.seed = std::stoull(value);
+            else if (arg == "--stats-interval") options.statsIntervalSeconds = std::stoi(value);
+            else if (arg == "--instruments") {
+                options.exchange.instruments.clear();
+                std::istringstream list(value);
+                std::string instrument;
+                while (std::getline(list, instrument, ',')) {
+                    if (!instrument.empty()) options.exchange.instruments.push_back(instrument);
+                }
+            } else {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+        if (options.port == 0 && options.plainPort == 0) {
+            options.plainPort = 8080;
+        }
+        if (options.port != 0 && (options.certFile.empty() || options.keyFile.empty())) {
+            throw std::invalid_argument("--port needs --cert and --key");
+        }
+        return options;
+    }
+
+    std::string urlDecode(const std::string& value) {
+        std::string result;
+        for (size_t i = 0; i < value.size(); ++i) {
+            if (value[i] == '%' && i + 2 < value.size()) {
+                result += static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            } else {
+                result += value[i] == '+' ? ' ' : value[i];
+            }
+        }
+        return result;
+    }
+
+    // Query values arrive as text; numbers and booleans are restored
+    nlohmann::json parseQuery(const std::string& query) {
+        nlohmann::json params = nlohmann::json::object();
+        std::istringstream pairs(query);
+        std::string pair;
+        while (std::getline(pairs, pair, '&')) {
+            size_t eq = pair.find('=');
+            std::string key = urlDecode(pair.substr(0, eq));
+            std::string value = eq == std::string::npos ? std::string() : urlDecode(pair.substr(eq + 1));
+            nlohmann::json parsed = nlohmann::json::parse(value, nullptr, false);
+            params[key] = (!parsed.is_discarded() && (parsed.is_number() || parsed.is_boolean()))
+                ? parsed : nlohmann::json(value);
+        }
+        return params;
+    }
+}
+
+// Glue between websocketpp endpoints and the exchange core. Everything runs
+// on one io_context thread.
+class MockServer {
+public:
+    MockServer(MockExchange& exchange, boost::asio::io_context& io)
+        : m_exchange(exchange)
+        , m_io(io)
+        , m_marketTimer(io)
+        , m_lastAdvance(std::chrono::steady_clock::now()) {
+    }
+
+    template<typename Endpoint>
+    void attach(Endpoint& endpoint) {
+        endpoint.clear_access_channels(websocketpp::log::alevel::all);
+        endpoint.clear_error_channels(websocketpp::log::elevel::all);
+        endpoint.init_asio(&m_io);
+        endpoint.set_reuse_addr(true);
+
+        endpoint.set_open_handler([this, &endpoint](websocketpp::connection_hdl hdl) {
+            Connection connection;
+            connection.session = m_exchange.openSession();
+            connection.send = [&endpoint, hdl](const std::string& payload) {
+                websocketpp::lib::error_code ec;
+                endpoint.send(hdl, payload, websocketpp::frame::opcode::text, ec);
+            };
+            connection.close = [&endpoint, hdl]() {
+                websocketpp::lib::error_code ec;
+                endpoint.close(hdl, websocketpp::close::status::going_away, "injected disconnect", ec);
+            };
+            m_sessionsByHandle[hdl] = connection.session;
+            m_connections[connection.session] = std::move(connection);
+        });
+
+        auto onClose = [this](websocketpp::connection_hdl hdl) {
+            auto it = m_sessionsByHandle.find(hdl);
+            if (it == m_sessionsByHandle.end()) {
+                return;
+            }
+            MockExchange::SessionId session = it->second;
+            m_sessionsByHandle.erase(it);
+            m_connections.erase(session);
+
+            std::vector<MockExchange::Outbound> out;
+            m_exchange.closeSession(session, out);
+            deliver(out);
+        };
+        endpoint.set_close_handler(onClose);
+        endpoint.set_fail_handler(onClose);
+
+        endpoint.set_message_handler([this](websocketpp::connection_hdl hdl, typename Endpoint::message_ptr msg) {
+            auto it = m_sessionsByHandle.find(hdl);
+            if (it == m_sessionsByHandle.end()) {
+                return;
+            }
+            std::vector<MockExchange::Outbound> out;
+            m_exchange.handleMessage(it->second, msg->get_payload(), out);
+            deliver(out);
+        });
+
+        endpoint.set_http_handler([this, &endpoint](websocketpp::connection_hdl hdl) {
+            auto con = endpoint.get_con_from_hdl(hdl);
+            const auto& request = con->get_request();
+
+            // /api/v2/<scope>/<method>?query
+            std::string resource = con->get_resource();
+            size_t queryStart = resource.find('?');
+            std::string path = resource.substr(0, queryStart);
+            const std::string prefix = "/api/v2/";
+            if (path.compare(0, prefix.size(), prefix) != 0) {
+                con->set_status(websocketpp::http::status_code::not_found);
+                return;
+            }
+
+            nlohmann::json params = queryStart == std::string::npos
+                ? nlohmann::json::object() : parseQuery(resource.substr(queryStart + 1));
+            const std::string& body = request.get_body();
+            if (!body.empty()) {
+                nlohmann::json bodyParams = nlohmann::json::parse(body, nullptr, false);
+                if (bodyParams.is_object()) {
+                    params.update(bodyParams);
+                }
+            }
+
+            std::vector<MockExchange::Outbound> out;
+            std::string response = m_exchange.handleHttp(path.substr(prefix.size()), params,
+                                                          request.get_header("Authorization"), out);
+            con->set_status(websocketpp::http::status_code::ok);
+            con->append_header("Content-Type", "application/json");
+            con->set_body(response);
+            deliver(out);
+        });
+    }
+
+    void startMarket() {
+        m_marketTimer.expires_after(kMarketTick);
+        m_marketTimer.async_wait([this](const boost::system::error_code& ec) {
+            if (ec) {
+                return;
+            }
+            auto now = std::chrono::steady_clock::now();
+            std::vector<MockExchange::Outbound> out;
+            m_exchange.advance(now - m_lastAdvance, out);
+            m_lastAdvance = now;
+            deliver(out);
+            startMarket();
+        });
+    }
+
+    size_t getConnectionCount() const { return m_connections.size(); }
+
+private:
+    struct Connection {
+        MockExchange::SessionId session = 0;
+        std::function<void(const std::string&)> send;
+        std::function<void()> close;
+        std::chrono::steady_clock::time_point nextSendAt{};
+    };
+
+    void deliver(std::vector<MockExchange::Outbound>& out) {
+        auto now = std::chrono::steady_clock::now();
+        for (auto& frame : out) {
+            auto it = m_connections.find(frame.session);
+            if (it == m_connections.end()) {
+                continue;
+            }
+            Connection& connection = it->second;
+
+            // Delays never reorder frames within a connection
+            auto sendAt = std::max(now + m_exchange.nextDelay(), connection.nextSendAt);
+            connection.nextSendAt = sendAt;
+            if (sendAt <= now) {
+                transmit(frame.session, frame.payload);
+                continue;
+            }
+
+            auto timer = std::make_shared<boost::asio::steady_timer>(m_io, sendAt);
+            timer->async_wait([this, timer, session = frame.session,
+                               payload = std::move(frame.payload)](const boost::system::error_code& ec) {
+                if (!ec) {
+                    transmit(session, payload);
+                }
+            });
+        }
+    }
+
+    void transmit(MockExchange::SessionId session, const std::string& payload) {
+        auto it = m_connections.find(session);
+        if (it == m_connections.end()) {
+            return;
+        }
+        it->second.send(payload);
+        if (m_exchange.shouldDisconnect(session)) {
+            it->second.close();
+        }
+    }
+
+    MockExchange& m_exchange;
+    boost::asio::io_context& m_io;
+    boost::asio::steady_timer m_marketTimer;
+    std::chrono::steady_clock::time_point m_lastAdvance;
+    std::unordered_map<MockExchange::SessionId, Connection> m_connections;
+    std::map<websocketpp::connection_hdl, MockExchange::SessionId,
+             std::owner_less<websocketpp::connection_hdl>> m_sessionsByHandle;
+};
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parseOptions(argc, argv);
+
+        boost::asio::io_context io;
+        MockExchange exchange(options.exchange);
+        MockServer server(exchange, io);
+
+        TlsServer tlsEndpoint;
+        PlainServer plainEndpoint;
+
+        if (options.port != 0) {
+            server.attach(tlsEndpoint);
+            tlsEndpoint.set_tls_init_handler([&options](websocketpp::connection_hdl) {
+                auto context = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tls_server);
+                context->use_certificate_chain_file(options.certFile);
+                context->use_private_key_file(options.keyFile, boost::asio::ssl::context::pem);
+                return context;
+            });
+            tlsEndpoint.listen(options.port);
+            tlsEndpoint.start_accept();
+            std::cout << "TLS websocket/https on port " << options.port << std::endl;
+        }
+        if (options.plainPort != 0) {
+            server.attach(plainEndpoint);
+            plainEndpoint.listen(options.plainPort);
+            plainEndpoint.start_accept();
+            std::cout << "Plain websocket/http on port " << options.plainPort << std::endl;
+        }
+
+        server.startMarket();
+
+        // Periodic throughput line
+        boost::asio::steady_timer statsTimer(io);
+        MockExchange::Stats lastStats;
+        std::function<void()> scheduleStats = [&]() {
+            if (options.statsIntervalSeconds <= 0) {
+                return;
+            }
+            statsTimer.expires_after(std::chrono::seconds(options.statsIntervalSeconds));
+            statsTimer.async_wait([&](const boost::system::error_code& ec) {
+                if (ec) return;
+                const auto& stats = exchange.getStats();
+                double seconds = options.statsIntervalSeconds;
+                std::cout << "connections=" << server.getConnectionCount()
+                          << " requests/s=" << (stats.requests - lastStats.requests) / seconds
+                          << " notifications/s=" << (stats.notifications - lastStats.notifications) / seconds
+                          << " orders=" << stats.ordersPlaced
+                          << " fills=" << stats.fills
+                          << " gaps=" << stats.gapsInjected << std::endl;
+                lastStats = stats;
+                scheduleStats();
+            });
+        };
+        scheduleStats();
+
+        boost::asio::signal_set signals(io, SIGINT, SIGTERM);
+        signals.async_wait([&](const boost::system::error_code&, int) {
+            io.stop();
+        });
+
+        io.run();
+        return 0;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal error: " << e.what() << std::endl;
+        usage();
+        return 1;
+    }
+}
@@ -0,0 +1,810 @@
+#include "mock_exchange.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // JSON-RPC and Deribit error codes used by the mock
+    constexpr int kParseError = -32700;
+    constexpr int kMethodNotFound = -32601;
+    constexpr int kInvalidParams = -32602;
+    constexpr int kOrderNotFound = 10004;
+    constexpr int kUnauthorized = 13009;
+    constexpr int kNotOpenOrder = 11044;
+    constexpr int kPostOnlyReject = 11054;
+
+    // Session used for REST calls, websocket sessions start at 1
+    constexpr MockExchange::SessionId kRestSession = 0;
+
+    // Bound on catch-up work after a stalled timer
+    constexpr double kMaxCredit = 1000.0;
+
+    constexpr double kEpsilon = 1e-9;
+
+    int64_t nowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    bool startsWith(const std::string& value, const std::string& prefix) {
+        return value.compare(0, prefix.size(), prefix) == 0;
+    }
+}
+
+MockExchange::MockExchange(const MockExchangeConfig& config)
+    : m_config(config)
+    , m_rng(config.seed)
+    , m_nextSession(kRestSession + 1)
+    , m_nextOrderId(1)
+    , m_nextTradeId(1) {
+    m_sessions[kRestSession] = Session();
+
+    for (const auto& name : m_config.instruments) {
+        Instrument instrument;
+        instrument.name = name;
+        instrument.currency = name.substr(0, name.find('-'));
+        if (instrument.currency == "BTC") {
+            instrument.tickSize = 0.5;
+            instrument.minAmount = 10.0;
+            instrument.mid = 60000.0;
+        } else if (instrument.currency == "ETH") {
+            instrument.tickSize = 0.05;
+            instrument.minAmount = 1.0;
+            instrument.mid = 3000.0;
+        } else {
+            instrument.tickSize = 0.01;
+            instrument.minAmount = 1.0;
+            instrument.mid = 100.0;
+        }
+        seedBook(instrument);
+        m_instruments.emplace(name, std::move(instrument));
+    }
+}
+
+MockExchange::SessionId MockExchange::openSession() {
+    SessionId id = m_nextSession++;
+    m_sessions[id] = Session();
+    return id;
+}
+
+void MockExchange::closeSession(SessionId session, std::vector<Outbound>& out) {
+    auto it = m_sessions.find(session);
+    if (it == m_sessions.end()) {
+        return;
+    }
+    bool cancelOnDisconnect = it->second.cancelOnDisconnect;
+    m_sessions.erase(it);
+
+    // Other connections still see the cancellations
+    if (cancelOnDisconnect) {
+        cancelWhere([session](const MockOrder& order) { return order.session == session; }, out);
+    }
+}
+
+void MockExchange::handleMessage(SessionId session, const std::string& payload,
+                                 std::vector<Outbound>& out) {
+    ++m_stats.requests;
+    nlohmann::json response = {{"jsonrpc", "2.0"}};
+
+    nlohmann::json request = nlohmann::json::parse(payload, nullptr, false);
+    if (request.is_discarded() || !request.is_object() || !request.contains("method")) {
+        response["id"] = nullptr;
+        response["error"] = {{"code", kParseError}, {"message", "Parse error"}};
+        out.push_back({session, response.dump()});
+        return;
+    }
+
+    response["id"] = request.value("id", nlohmann::json());
+    size_t firstCaused = out.size();
+    int64_t usIn = nowUs();
+    try {
+        response["result"] = dispatch(session, request["method"].get<std::string>(),
+                                      request.value("params", nlohmann::json::object()), out);
+    } catch (const RpcError& e) {
+        response["error"] = {{"code", e.code}, {"message", e.message}};
+    } catch (const nlohmann::json::exception& e) {
+        response["error"] = {{"code", kInvalidParams}, {"message", e.what()}};
+    }
+    int64_t usOut = nowUs();
+    response["usIn"] = usIn;
+    response["usOut"] = usOut;
+    response["usDiff"] = usOut - usIn;
+    response["testnet"] = true;
+
+    // The response goes ahead of notifications it caused, like the exchange
+    out.insert(out.begin() + static_cast<std::ptrdiff_t>(firstCaused), {session, response.dump()});
+}
+
+std::string MockExchange::handleHttp(const std::string& method, const nlohmann::json& params,
+                                     const std::string& authorization, std::vector<Outbound>& out) {
+    ++m_stats.requests;
+    std::string token = startsWith(authorization, "Bearer ") ? authorization.substr(7) : std::string();
+    m_sessions[kRestSession].authenticated = m_tokens.count(token) > 0;
+
+    nlohmann::json response = {{"jsonrpc", "2.0"}};
+    int64_t usIn = nowUs();
+    try {
+        response["result"] = dispatch(kRestSession, method, params, out);
+    } catch (const RpcError& e) {
+        response["error"] = {{"code", e.code}, {"message", e.message}};
+    } catch (const nlohmann::json::exception& e) {
+        response["error"] = {{"code", kInvalidParams}, {"message", e.what()}};
+    }
+    response["usIn"] = usIn;
+    response["usOut"] = nowUs();
+    response["testnet"] = true;
+    return response.dump();
+}
+
+nlohmann::json MockExchange::dispatch(SessionId session, const std::string& method,
+                                      const nlohmann::json& params, std::vector<Outbound>& out) {
+    Session& state = m_sessions[session];
+
+    if (method == "public/auth") return handleAuth(params, &state);
+    if (method == "public/test") return {{"version", "mock"}};
+    if (method == "public/get_time") return nowUs() / 1000;
+    if (method == "public/get_order_book") return handleGetOrderBook(params);
+    if (method == "public/get_instrument") return handleGetInstrument(params);
+    if (method == "public/subscribe") return handleSubscribe(session, params, true, out);
+    if (method == "public/unsubscribe") return handleSubscribe(session, params, false, out);
+
+    if (!startsWith(method, "private/")) {
+        throw RpcError{kMethodNotFound, "Method not found"};
+    }
+    if (!state.authenticated) {
+        throw RpcError{kUnauthorized, "unauthorized"};
+    }
+
+    if (method == "private/subscribe") return handleSubscribe(session, params, true, out);
+    if (method == "private/unsubscribe") return handleSubscribe(session, params, false, out);
+    if (method == "private/buy") return handleOrder(session, true, params, out);
+    if (method == "private/sell") return handleOrder(session, false, params, out);
+    if (method == "private/edit") return handleEdit(params, out);
+    if (method == "private/cancel") return handleCancel(params, out);
+    if (method == "private/cancel_all") {
+        return cancelWhere([](const MockOrder&) { return true; }, out);
+    }
+    if (method == "private/cancel_all_by_instrument") {
+        std::string instrument = params.at("instrument_name").get<std::string>();
+        return cancelWhere([&](const MockOrder& order) { return order.instrument == instrument; }, out);
+    }
+    if (method == "private/cancel_all_by_currency") {
+        std::string currency = params.at("currency").get<std::string>();
+        return cancelWhere([&](const MockOrder& order) {
+            return startsWith(order.instrument, currency + "-");
+        }, out);
+    }
+    if (method == "private/cancel_by_label") {
+        std::string label = params.at("label").get<std::string>();
+        return cancelWhere([&](const MockOrder& order) { return order.label == label; }, out);
+    }
+    if (method == "private/enable_cancel_on_disconnect" ||
+        method == "private/disable_cancel_on_disconnect") {
+        if (session == kRestSession) {
+            throw RpcError{kInvalidParams, "connection scope needs a websocket"};
+        }
+        state.cancelOnDisconnect = method == "private/enable_cancel_on_disconnect";
+        return "ok";
+    }
+    if (method == "private/get_positions") return handleGetPositions(params);
+
+    throw RpcError{kMethodNotFound, "Method not found"};
+}
+
+nlohmann::json MockExchange::handleAuth(const nlohmann::json& params, Session* session) {
+    std::string grantType = params.value("grant_type", std::string());
+    if (grantType == "refresh_token") {
+        if (!m_tokens.count(params.value("refresh_token", std::string()))) {
+            throw RpcError{kUnauthorized, "invalid_token"};
+        }
+    } else if (grantType == "client_credentials" || grantType == "client_signature") {
+        if (params.value("client_id", std::string()).empty()) {
+            throw RpcError{kUnauthorized, "invalid_credentials"};
+        }
+    } else {
+        throw RpcError{kInvalidParams, "unsupported grant_type"};
+    }
+
+    // Tokens never expire here, both kinds are accepted as bearer tokens
+    std::string accessToken = "mock-access-" + std::to_string(m_rng());
+    std::string refreshToken = "mock-refresh-" + std::to_string(m_rng());
+    m_tokens.insert(accessToken);
+    m_tokens.insert(refreshToken);
+    if (session) {
+        session->authenticated = true;
+    }
+
+    return {
+        {"access_token", accessToken},
+        {"refresh_token", refreshToken},
+        {"expires_in", 900},
+        {"scope", "connection mainaccount"},
+        {"token_type", "bearer"}
+    };
+}
+
+nlohmann::json MockExchange::handleSubscribe(SessionId session, const nlohmann::json& params,
+                                             bool subscribe, std::vector<Outbound>& out) {
+    if (session == kRestSession) {
+        throw RpcError{kInvalidParams, "subscriptions need a websocket"};
+    }
+    Session& state = m_sessions[session];
+
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto& item : params.at("channels")) {
+        std::string channel = item.get<std::string>();
+        if (!subscribe) {
+            if (state.channels.erase(channel)) {
+                result.push_back(channel);
+            }
+            continue;
+        }
+        state.channels.insert(channel);
+        result.push_back(channel);
+
+        // Book subscribers start from a full snapshot
+        for (const auto& [name, instrument] : m_instruments) {
+            if (channelMatches(channel, "book", name, instrument.currency)) {
+                notify(session, channel, bookSnapshot(instrument), out);
+            }
+        }
+    }
+    return result;
+}
+
+nlohmann::json MockExchange::handleOrder(SessionId session, bool buy, const nlohmann::json& params,
+                                         std::vector<Outbound>& out) {
+    Instrument* instrument = findInstrument(params.at("instrument_name").get<std::string>());
+    double amount = params.at("amount").get<double>();
+    if (amount <= 0.0) {
+        throw RpcError{kInvalidParams, "amount must be positive"};
+    }
+
+    std::string type = params.value("type", std::string("limit"));
+    bool market = type == "market";
+    if (!market && type != "limit") {
+        throw RpcError{kInvalidParams, "unsupported order type"};
+    }
+
+    MockOrder order;
+    order.orderId = instrument->currency + "-" + std::to_string(m_nextOrderId++);
+    order.label = params.value("label", std::string());
+    order.instrument = instrument->name;
+    order.buy = buy;
+    order.price = market ? (buy ? INFINITY : 0.0) : params.at("price").get<double>();
+    order.amount = amount;
+    order.postOnly = params.value("post_only", false);
+    order.reduceOnly = params.value("reduce_only", false);
+    order.session = session;
+    order.createdMs = order.updatedMs = nowMs();
+
+    bool crosses = buy ? (!instrument->asks.empty() && order.price >= instrument->asks.begin()->first)
+                       : (!instrument->bids.empty() && order.price <= instrument->bids.begin()->first);
+    if (crosses && order.postOnly) {
+        throw RpcError{kPostOnlyReject, "post_only_reject"};
+    }
+
+    ++m_stats.ordersPlaced;
+    nlohmann::json trades = takeLiquidity(*instrument, order);
+    if (market) {
+        // Unfilled market remainder does not rest
+        order.price = order.filled > 0.0 ? order.filledValue / order.filled : 0.0;
+        if (order.state == "open") {
+            order.state = "cancelled";
+        }
+    }
+
+    auto& stored = m_orders[order.orderId] = order;
+    publishOrder(stored, out);
+    for (const auto& trade : trades) {
+        publishTrade(stored, trade, out);
+    }
+    return {{"order", orderToJson(stored)}, {"trades", trades}};
+}
+
+nlohmann::json MockExchange::handleEdit(const nlohmann::json& params, std::vector<Outbound>& out) {
+    auto it = m_orders.find(params.at("order_id").get<std::string>());
+    if (it == m_orders.end()) {
+        throw RpcError{kOrderNotFound, "order_not_found"};
+    }
+    MockOrder& order = it->second;
+    if (order.state != "open") {
+        throw RpcError{kNotOpenOrder, "not_open_order"};
+    }
+
+    double amount = params.at("amount").get<double>();
+    if (amount < order.filled - kEpsilon) {
+        throw RpcError{kInvalidParams, "amount below filled amount"};
+    }
+    order.amount = amount;
+    order.price = params.value("price", order.price);
+    order.updatedMs = nowMs();
+
+    nlohmann::json trades = takeLiquidity(*findInstrument(order.instrument), order);
+    if (order.state == "open" && order.filled >= order.amount - kEpsilon) {
+        order.state = "filled";
+    }
+    publishOrder(order, out);
+    for (const auto& trade : trades) {
+        publishTrade(order, trade, out);
+    }
+    return {{"order", orderToJson(order)}, {"trades", trades}};
+}
+
+nlohmann::json MockExchange::handleCancel(const nlohmann::json& params, std::vector<Outbound>& out) {
+    auto it = m_orders.find(params.at("order_id").get<std::string>());
+    if (it == m_orders.end()) {
+        throw RpcError{kOrderNotFound, "order_not_found"};
+    }
+    MockOrder& order = it->second;
+    if (order.state != "open") {
+        throw RpcError{kNotOpenOrder, "not_open_order"};
+    }
+    order.state = "cancelled";
+    order.updatedMs = nowMs();
+    publishOrder(order, out);
+    return orderToJson(order);
+}
+
+size_t MockExchange::cancelWhere(const std::function<bool(const MockOrder&)>& predicate,
+                                 std::vector<Outbound>& out) {
+    size_t cancelled = 0;
+    for (auto& [id, order] : m_orders) {
+        if (order.state == "open" && predicate(order)) {
+            order.state = "cancelled";
+            order.updatedMs = nowMs();
+            publishOrder(order, out);
+            ++cancelled;
+        }
+    }
+    return cancelled;
+}
+
+nlohmann::json MockExchange::handleGetOrderBook(const nlohmann::json& params) {
+    const Instrument* instrument = findInstrument(params.at("instrument_name").get<std::string>());
+    nlohmann::json result = bookSnapshot(*instrument);
+    result["best_bid_price"] = instrument->bids.empty() ? 0.0 : instrument->bids.begin()->first;
+    result["best_ask_price"] = instrument->asks.empty() ? 0.0 : instrument->asks.begin()->first;
+    result["mark_price"] = instrument->mid;
+    result["index_price"] = instrument->mid;
+
+    // REST books are plain [price, amount] pairs
+    for (const char* side : {"bids", "asks"}) {
+        for (auto& level : result[side]) {
+            level = nlohmann::json::array({level[1], level[2]});
+        }
+    }
+    return result;
+}
+
+nlohmann::json MockExchange::handleGetInstrument(const nlohmann::json& params) {
+    const Instrument* instrument = findInstrument(params.at("instrument_name").get<std::string>());
+    return {
+        {"instrument_name", instrument->name},
+        {"kind", "future"},
+        {"base_currency", instrument->currency},
+        {"quote_currency", "USD"},
+        {"settlement_period", "perpetual"},
+        {"tick_size", instrument->tickSize},
+        {"min_trade_amount", instrument->minAmount},
+        {"contract_size", instrument->minAmount},
+        {"is_active", true}
+    };
+}
+
+nlohmann::json MockExchange::handleGetPositions(const nlohmann::json& params) {
+    std::string currency = params.at("currency").get<std::string>();
+    nlohmann::json result = nlohmann::json::array();
+    for (const auto& [name, instrument] : m_instruments) {
+        if (instrument.currency != currency) {
+            continue;
+        }
+        const Position& position = instrument.position;
+        double floating = position.size * (instrument.mid - position.averagePrice);
+        result.push_back({
+            {"instrument_name", name},
+            {"kind", "future"},
+            {"size", position.size},
+            {"direction", position.size > 0.0 ? "buy" : position.size < 0.0 ? "sell" : "zero"},
+            {"average_price", position.averagePrice},
+            {"mark_price", instrument.mid},
+            {"index_price", instrument.mid},
+            {"floating_profit_loss", floating},
+            {"realized_profit_loss", position.realizedPnl}
+        });
+    }
+    return result;
+}
+
+nlohmann::json MockExchange::takeLiquidity(Instrument& instrument, MockOrder& order) {
+    nlohmann::json trades = nlohmann::json::array();
+    if (order.buy) {
+        while (order.amount - order.filled > kEpsilon && !instrument.asks.empty() &&
+               order.price >= instrument.asks.begin()->first) {
+            auto level = instrument.asks.begin();
+            double amount = std::min(level->second, order.amount - order.filled);
+            trades.push_back(fill(order, level->first, amount, false));
+            if ((level->second -= amount) <= kEpsilon) {
+                instrument.asks.erase(level);
+            }
+        }
+    } else {
+        while (order.amount - order.filled > kEpsilon && !instrument.bids.empty() &&
+               order.price <= instrument.bids.begin()->first) {
+            auto level = instrument.bids.begin();
+            double amount = std::min(level->second, order.amount - order.filled);
+            trades.push_back(fill(order, level->first, amount, false));
+            if ((level->second -= amount) <= kEpsilon) {
+                instrument.bids.erase(level);
+            }
+        }
+    }
+    return trades;
+}
+
+nlohmann::json MockExchange::fill(MockOrder& order, double price, double amount, bool maker) {
+    ++m_stats.fills;
+    Instrument& instrument = *findInstrument(order.instrument);
+
+    order.filled += amount;
+    order.filledValue += price * amount;
+    order.updatedMs = nowMs();
+    if (order.filled >= order.amount - kEpsilon) {
+        order.state = "filled";
+    }
+
+    // Average-price position with realized PnL on reductions
+    Position& position = instrument.position;
+    double signedAmount = order.buy ? amount : -amount;
+    if (position.size == 0.0 || (position.size > 0.0) == (signedAmount > 0.0)) {
+        double total = std::fabs(position.size) + amount;
+        position.averagePrice = (position.averagePrice * std::fabs(position.size) + price * amount) / total;
+    } else {
+        double closed = std::min(std::fabs(position.size), amount);
+        double direction = position.size > 0.0 ? 1.0 : -1.0;
+        position.realizedPnl += (price - position.averagePrice) * closed * direction;
+        if (amount > std::fabs(position.size)) {
+            position.averagePrice = price;
+        }
+    }
+    position.size += signedAmount;
+    if (std::fabs(position.size) < kEpsilon) {
+        position.size = 0.0;
+        position.averagePrice = 0.0;
+    }
+
+    instrument.lastPrice = price;
+    return {
+        {"trade_id", instrument.currency + "-T" + std::to_string(m_nextTradeId++)},
+        {"trade_seq", ++instrument.tradeSeq},
+        {"order_id", order.orderId},
+        {"label", order.label},
+        {"instrument_name", order.instrument},
+        {"direction", order.buy ? "buy" : "sell"},
+        {"price", price},
+        {"amount", amount},
+        {"timestamp", order.updatedMs},
+        {"liquidity", maker ? "M" : "T"},
+        {"fee", 0.0},
+        {"fee_currency", instrument.currency},
+        {"order_type", "limit"},
+        {"state", order.state},
+        {"mark_price", instrument.mid},
+        {"index_price", instrument.mid}
+    };
+}
+
+void MockExchange::matchRestingOrders(Instrument& instrument, bool buyAggressor, double price,
+                                      double amount, std::vector<Outbound>& out) {
+    // Our orders are not shown in the synthetic book; a print through
+    // their price fills them as makers
+    for (auto& [id, order] : m_orders) {
+        if (amount <= kEpsilon) {
+            break;
+        }
+        if (order.state != "open" || order.instrument != instrument.name || order.buy == buyAggressor) {
+            continue;
+        }
+        bool through = order.buy ? price <= order.price : price >= order.price;
+        if (!through) {
+            continue;
+        }
+        double filled = std::min(amount, order.amount - order.filled);
+        amount -= filled;
+        nlohmann::json trade = fill(order, order.price, filled, true);
+        publishOrder(order, out);
+        publishTrade(order, trade, out);
+    }
+}
+
+void MockExchange::advance(std::chrono::nanoseconds elapsed, std::vector<Outbound>& out) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    for (auto& [name, instrument] : m_instruments) {
+        instrument.bookCredit = std::min(kMaxCredit, instrument.bookCredit + m_config.bookUpdatesPerSecond * seconds);
+        instrument.tradeCredit = std::min(kMaxCredit, instrument.tradeCredit + m_config.tradesPerSecond * seconds);
+        instrument.tickerCredit = std::min(kMaxCredit, instrument.tickerCredit + m_config.tickersPerSecond * seconds);
+
+        for (; instrument.bookCredit >= 1.0; instrument.bookCredit -= 1.0) {
+            stepBook(instrument, out);
+        }
+        for (; instrument.tradeCredit >= 1.0; instrument.tradeCredit -= 1.0) {
+            stepTrade(instrument, out);
+        }
+        for (; instrument.tickerCredit >= 1.0; instrument.tickerCredit -= 1.0) {
+            stepTicker(instrument, out);
+        }
+    }
+}
+
+bool MockExchange::shouldDisconnect(SessionId session) {
+    auto it = m_sessions.find(session);
+    if (it == m_sessions.end()) {
+        return false;
+    }
+    uint64_t sent = ++it->second.framesSent;
+    if (m_config.disconnectAfterMessages > 0 && sent >= m_config.disconnectAfterMessages) {
+        return true;
+    }
+    if (m_config.disconnectProbability > 0.0) {
+        return std::uniform_real_distribution<double>(0.0, 1.0)(m_rng) < m_config.disconnectProbability;
+    }
+    return false;
+}
+
+std::chrono::microseconds MockExchange::nextDelay() {
+    uint32_t jitter = m_config.latencyJitterUs > 0
+        ? std::uniform_int_distribution<uint32_t>(0, m_config.latencyJitterUs)(m_rng)
+        : 0;
+    return std::chrono::microseconds(m_config.latencyUs + jitter);
+}
+
+void MockExchange::seedBook(Instrument& instrument) {
+    std::uniform_int_distribution<int> lots(1, 100);
+    double bestBid = std::floor(instrument.mid / instrument.tickSize) * instrument.tickSize;
+    for (int i = 0; i < m_config.bookDepth; ++i) {
+        instrument.bids[bestBid - i * instrument.tickSize] = lots(m_rng) * instrument.minAmount;
+        instrument.asks[bestBid + (i + 1) * instrument.tickSize] = lots(m_rng) * instrument.minAmount;
+    }
+    instrument.mid = bestBid + instrument.tickSize / 2.0;
+    instrument.lastPrice = instrument.mid;
+}
+
+void MockExchange::stepBook(Instrument& instrument, std::vector<Outbound>& out) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::uniform_int_distribution<int> lots(1, 100);
+    nlohmann::json bids = nlohmann::json::array();
+    nlohmann::json asks = nlohmann::json::array();
+    const double tick = instrument.tickSize;
+
+    double move = uniform(m_rng);
+    if (move < 0.05 && !instrument.asks.empty() && !instrument.bids.empty()) {
+        // Up a tick: best ask becomes a bid, depth kept on both sides
+        double price = instrument.asks.begin()->first;
+        instrument.asks.erase(instrument.asks.begin());
+        asks.push_back({"delete", price, 0.0});
+        double amount = lots(m_rng) * instrument.minAmount;
+        instrument.bids[price] = amount;
+        bids.push_back({"new", price, amount});
+
+        double worstBid = instrument.bids.rbegin()->first;
+        instrument.bids.erase(worstBid);
+        bids.push_back({"delete", worstBid, 0.0});
+        double newAsk = (instrument.asks.empty() ? price : instrument.asks.rbegin()->first) + tick;
+        amount = lots(m_rng) * instrument.minAmount;
+        instrument.asks[newAsk] = amount;
+        asks.push_back({"new", newAsk, amount});
+    } else if (move < 0.10 && !instrument.asks.empty() && !instrument.bids.empty()) {
+        double price = instrument.bids.begin()->first;
+        instrument.bids.erase(instrument.bids.begin());
+        bids.push_back({"delete", price, 0.0});
+        double amount = lots(m_rng) * instrument.minAmount;
+        instrument.asks[price] = amount;
+        asks.push_back({"new", price, amount});
+
+        double worstAsk = instrument.asks.rbegin()->first;
+        instrument.asks.erase(worstAsk);
+        asks.push_back({"delete", worstAsk, 0.0});
+        double newBid = (instrument.bids.empty() ? price : instrument.bids.rbegin()->first) - tick;
+        amount = lots(m_rng) * instrument.minAmount;
+        instrument.bids[newBid] = amount;
+        bids.push_back({"new", newBid, amount});
+    } else {
+        // Size change somewhere in the book
+        bool bidSide = uniform(m_rng) < 0.5;
+        size_t depth = bidSide ? instrument.bids.size() : instrument.asks.size();
+        if (depth == 0) {
+            return;
+        }
+        size_t index = std::uniform_int_distribution<size_t>(0, depth - 1)(m_rng);
+        double amount = lots(m_rng) * instrument.minAmount;
+        if (bidSide) {
+            auto level = std::next(instrument.bids.begin(), index);
+            level->second = amount;
+            bids.push_back({"change", level->first, amount});
+        } else {
+            auto level = std::next(instrument.asks.begin(), index);
+            level->second = amount;
+            asks.push_back({"change", level->first, amount});
+        }
+    }
+
+    if (!instrument.bids.empty() && !instrument.asks.empty()) {
+        instrument.mid = (instrument.bids.begin()->first + instrument.asks.begin()->first) / 2.0;
+    }
+
+    int64_t previous = instrument.changeId++;
+    if (m_config.gapProbability > 0.0 && uniform(m_rng) < m_config.gapProbability) {
+        ++m_stats.gapsInjected;
+        return;  // Applied but never sent, the next change exposes the gap
+    }
+
+    publish("book", instrument, {
+        {"type", "change"},
+        {"timestamp", nowMs()},
+        {"instrument_name", instrument.name},
+        {"prev_change_id", previous},
+        {"change_id", instrument.changeId},
+        {"bids", bids},
+        {"asks", asks}
+    }, out);
+}
+
+void MockExchange::stepTrade(Instrument& instrument, std::vector<Outbound>& out) {
+    if (instrument.bids.empty() || instrument.asks.empty()) {
+        return;
+    }
+    bool buyAggressor = std::uniform_int_distribution<int>(0, 1)(m_rng) == 1;
+    double price = buyAggressor ? instrument.asks.begin()->first : instrument.bids.begin()->first;
+    double amount = std::uniform_int_distribution<int>(1, 10)(m_rng) * instrument.minAmount;
+    bool uptick = price >= instrument.lastPrice;
+    instrument.lastPrice = price;
+
+    publish("trades", instrument, nlohmann::json::array({{
+        {"trade_id", instrument.currency + "-T" + std::to_string(m_nextTradeId++)},
+        {"trade_seq", ++instrument.tradeSeq},
+        {"timestamp", nowMs()},
+        {"tick_direction", uptick ? 0 : 2},
+        {"price", price},
+        {"mark_price", instrument.mid},
+        {"index_price", instrument.mid},
+        {"instrument_name", instrument.name},
+        {"direction", buyAggressor ? "buy" : "sell"},
+        {"amount", amount}
+    }}), out);
+
+    matchRestingOrders(instrument, buyAggressor, price, amount, out);
+}
+
+void MockExchange::stepTicker(Instrument& instrument, std::vector<Outbound>& out) {
+    publish("ticker", instrument, tickerData(instrument), out);
+}
+
+nlohmann::json MockExchange::bookSnapshot(const Instrument& instrument) const {
+    nlohmann::json bids = nlohmann::json::array();
+    nlohmann::json asks = nlohmann::json::array();
+    for (const auto& [price, amount] : instrument.bids) {
+        bids.push_back({"new", price, amount});
+    }
+    for (const auto& [price, amount] : instrument.asks) {
+        asks.push_back({"new", price, amount});
+    }
+    return {
+        {"type", "snapshot"},
+        {"timestamp", nowMs()},
+        {"instrument_name", instrument.name},
+        {"change_id", instrument.changeId},
+        {"bids", bids},
+        {"asks", asks}
+    };
+}
+
+nlohmann::json MockExchange::tickerData(const Instrument& instrument) const {
+    return {
+        {"timestamp", nowMs()},
+        {"instrument_name", instrument.name},
+        {"state", "open"},
+        {"best_bid_price", instrument.bids.empty() ? 0.0 : instrument.bids.begin()->first},
+        {"best_bid_amount", instrument.bids.empty() ? 0.0 : instrument.bids.begin()->second},
+        {"best_ask_price", instrument.asks.empty() ? 0.0 : instrument.asks.begin()->first},
+        {"best_ask_amount", instrument.asks.empty() ? 0.0 : instrument.asks.begin()->second},
+        {"mark_price", instrument.mid},
+        {"index_price", instrument.mid},
+        {"last_price", instrument.lastPrice},
+        {"open_interest", 0.0}
+    };
+}
+
+void MockExchange::publish(const std::string& kind, const Instrument& instrument,
+                           const nlohmann::json& data, std::vector<Outbound>& out) {
+    for (const auto& [id, session] : m_sessions) {
+        for (const auto& channel : session.channels) {
+            if (channelMatches(channel, kind, instrument.name, instrument.currency)) {
+                notify(id, channel, data, out);
+            }
+        }
+    }
+}
+
+void MockExchange::publishOrder(const MockOrder& order, std::vector<Outbound>& out) {
+    const Instrument& instrument = *findInstrument(order.instrument);
+    publish("user.orders", instrument, orderToJson(order), out);
+}
+
+void MockExchange::publishTrade(const MockOrder& order, const nlohmann::json& trade,
+                                std::vector<Outbound>& out) {
+    const Instrument& instrument = *findInstrument(order.instrument);
+    publish("user.trades", instrument, nlohmann::json::array({trade}), out);
+}
+
+void MockExchange::notify(SessionId session, const std::string& channel, const nlohmann::json& data,
+                          std::vector<Outbound>& out) {
+    ++m_stats.notifications;
+    nlohmann::json message = {
+        {"jsonrpc", "2.0"},
+        {"method", "subscription"},
+        {"params", {{"channel", channel}, {"data", data}}}
+    };
+    out.push_back({session, message.dump()});
+}
+
+MockExchange::Instrument* MockExchange::findInstrument(const std::string& name) {
+    auto it = m_instruments.find(name);
+    if (it == m_instruments.end()) {
+        throw RpcError{kInvalidParams, "unknown instrument " + name};
+    }
+    return &it->second;
+}
+
+nlohmann::json MockExchange::orderToJson(const MockOrder& order) {
+    return {
+        {"order_id", order.orderId},
+        {"label", order.label},
+        {"instrument_name", order.instrument},
+        {"direction", order.buy ? "buy" : "sell"},
+        {"order_type", "limit"},
+        {"order_state", order.state},
+        {"price", std::isfinite(order.price) ? order.price : 0.0},
+        {"amount", order.amount},
+        {"filled_amount", order.filled},
+        {"average_price", order.filled > 0.0 ? order.filledValue / order.filled : 0.0},
+        {"post_only", order.postOnly},
+        {"reduce_only", order.reduceOnly},
+        {"time_in_force", "good_til_cancelled"},
+        {"creation_timestamp", order.createdMs},
+        {"last_update_timestamp", order.updatedMs}
+    };
+}
+
+bool MockExchange::channelMatches(const std::string& channel, const std::string& kind,
+                                  const std::string& instrument, const std::string& currency) {
+    if (startsWith(kind, "user.")) {
+        // user.orders.<instrument>.raw or user.orders.<kind>.<currency>.raw
+        if (!startsWith(channel, kind + ".")) {
+            return false;
+        }
+        std::string target = channel.substr(kind.size() + 1);
+        size_t interval = target.rfind('.');
+        if (interval != std::string::npos && (target.compare(interval, std::string::npos, ".raw") == 0 ||
+                                              target.compare(interval, std::string::npos, ".100ms") == 0)) {
+            target.erase(interval);
+        }
+        if (target == instrument) {
+            return true;
+        }
+        size_t dot = target.find('.');
+        std::string scope = dot == std::string::npos ? target : target.substr(dot + 1);
+        return scope == "any" || scope == currency;
+    }
+
+    // Deribit naming, book.BTC-PERPETUAL.100ms, and the shorter
+    // BTC-PERPETUAL.book used by MarketDataManager
+    std::string prefix = kind + "." + instrument;
+    if (startsWith(channel, prefix) &&
+        (channel.size() == prefix.size() || channel[prefix.size()] == '.')) {
+        return true;
+    }
+    return channel == instrument + "." + kind;
+}
+
+int64_t MockExchange::nowMs() {
+    return nowUs() / 1000;
+}
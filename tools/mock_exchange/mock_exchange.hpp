@@ -0,0 +1,186 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+struct MockExchangeConfig {
+    std::vector<std::string> instruments = {"BTC-PERPETUAL", "ETH-PERPETUAL"};
+
+    // Synthetic market, rates are per instrument
+    double bookUpdatesPerSecond = 100.0;
+    double tradesPerSecond = 10.0;
+    double tickersPerSecond = 1.0;
+    int bookDepth = 10;
+
+    // Fault injection
+    uint32_t latencyUs = 0;                 // Added to every outbound frame
+    uint32_t latencyJitterUs = 0;           // Uniform extra delay on top
+    double gapProbability = 0.0;            // Book change skipped, change_id jumps
+    uint64_t disconnectAfterMessages = 0;   // Per connection, 0 disables
+    double disconnectProbability = 0.0;     // Per outbound frame
+
+    uint64_t seed = 42;
+};
+
+// Transport-independent core of the local Deribit stand-in. It handles
+// JSON-RPC requests for auth, subscriptions and order entry, generates a
+// random-walk market for every instrument and matches our orders against
+// it. Everything runs on the server's single I/O thread, so there is no
+// locking here.
+class MockExchange {
+public:
+    using SessionId = uint64_t;
+
+    struct Outbound {
+        SessionId session;
+        std::string payload;
+    };
+
+    struct Stats {
+        uint64_t requests = 0;
+        uint64_t notifications = 0;
+        uint64_t ordersPlaced = 0;
+        uint64_t fills = 0;
+        uint64_t gapsInjected = 0;
+    };
+
+    explicit MockExchange(const MockExchangeConfig& config);
+
+    SessionId openSession();
+    // Applies cancel-on-disconnect for the session
+    void closeSession(SessionId session, std::vector<Outbound>& out);
+
+    // One websocket text frame; the response and any notifications it
+    // causes are appended to out
+    void handleMessage(SessionId session, const std::string& payload, std::vector<Outbound>& out);
+
+    // REST call, method is e.g. "public/get_order_book". Returns the body.
+    std::string handleHttp(const std::string& method, const nlohmann::json& params,
+                           const std::string& authorization, std::vector<Outbound>& out);
+
+    // Moves the synthetic market forward
+    void advance(std::chrono::nanoseconds elapsed, std::vector<Outbound>& out);
+
+    // Disconnect injection, asked once per frame sent to the session
+    bool shouldDisconnect(SessionId session);
+
+    // Per-frame delay from the latency settings
+    std::chrono::microseconds nextDelay();
+
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    struct RpcError {
+        int code;
+        std::string message;
+    };
+
+    struct Session {
+        bool authenticated = false;
+        bool cancelOnDisconnect = false;
+        std::set<std::string> channels;
+        uint64_t framesSent = 0;
+    };
+
+    struct MockOrder {
+        std::string orderId;
+        std::string label;
+        std::string instrument;
+        bool buy = true;
+        double price = 0.0;
+        double amount = 0.0;
+        double filled = 0.0;
+        double filledValue = 0.0;
+        std::string state = "open";
+        bool postOnly = false;
+        bool reduceOnly = false;
+        SessionId session = 0;
+        int64_t createdMs = 0;
+        int64_t updatedMs = 0;
+    };
+
+    struct Position {
+        double size = 0.0;
+        double averagePrice = 0.0;
+        double realizedPnl = 0.0;
+    };
+
+    struct Instrument {
+        std::string name;
+        std::string currency;
+        double tickSize = 0.5;
+        double minAmount = 1.0;
+        double mid = 0.0;
+        std::map<double, double, std::greater<double>> bids;
+        std::map<double, double> asks;
+        int64_t changeId = 0;
+        uint64_t tradeSeq = 0;
+        double lastPrice = 0.0;
+        double bookCredit = 0.0;
+        double tradeCredit = 0.0;
+        double tickerCredit = 0.0;
+        Position position;
+    };
+
+    nlohmann::json dispatch(SessionId session, const std::string& method, const nlohmann::json& params,
+                            std::vector<Outbound>& out);
+
+    // Request handlers
+    nlohmann::json handleAuth(const nlohmann::json& params, Session* session);
+    nlohmann::json handleSubscribe(SessionId session, const nlohmann::json& params, bool subscribe,
+                                   std::vector<Outbound>& out);
+    nlohmann::json handleOrder(SessionId session, bool buy, const nlohmann::json& params,
+                               std::vector<Outbound>& out);
+    nlohmann::json handleEdit(const nlohmann::json& params, std::vector<Outbound>& out);
+    nlohmann::json handleCancel(const nlohmann::json& params, std::vector<Outbound>& out);
+    size_t cancelWhere(const std::function<bool(const MockOrder&)>& predicate, std::vector<Outbound>& out);
+    nlohmann::json handleGetOrderBook(const nlohmann::json& params);
+    nlohmann::json handleGetInstrument(const nlohmann::json& params);
+    nlohmann::json handleGetPositions(const nlohmann::json& params);
+
+    // Matching
+    nlohmann::json takeLiquidity(Instrument& instrument, MockOrder& order);
+    nlohmann::json fill(MockOrder& order, double price, double amount, bool maker);
+    void matchRestingOrders(Instrument& instrument, bool buyAggressor, double price, double amount,
+                            std::vector<Outbound>& out);
+
+    // Market generation
+    void seedBook(Instrument& instrument);
+    void stepBook(Instrument& instrument, std::vector<Outbound>& out);
+    void stepTrade(Instrument& instrument, std::vector<Outbound>& out);
+    void stepTicker(Instrument& instrument, std::vector<Outbound>& out);
+    nlohmann::json bookSnapshot(const Instrument& instrument) const;
+    nlohmann::json tickerData(const Instrument& instrument) const;
+
+    // Notifications
+    void publish(const std::string& kind, const Instrument& instrument, const nlohmann::json& data,
+                 std::vector<Outbound>& out);
+    void publishOrder(const MockOrder& order, std::vector<Outbound>& out);
+    void publishTrade(const MockOrder& order, const nlohmann::json& trade, std::vector<Outbound>& out);
+    void notify(SessionId session, const std::string& channel, const nlohmann::json& data,
+                std::vector<Outbound>& out);
+
+    Instrument* findInstrument(const std::string& name);
+    static nlohmann::json orderToJson(const MockOrder& order);
+    static bool channelMatches(const std::string& channel, const std::string& kind,
+                               const std::string& instrument, const std::string& currency);
+    static int64_t nowMs();
+
+    MockExchangeConfig m_config;
+    std::mt19937_64 m_rng;
+    std::map<std::string, Instrument> m_instruments;
+    std::unordered_map<SessionId, Session> m_sessions;
+    std::unordered_map<std::string, MockOrder> m_orders;
+    std::set<std::string> m_tokens;
+    SessionId m_nextSession;
+    uint64_t m_nextOrderId;
+    uint64_t m_nextTradeId;
+    Stats m_stats;
+};
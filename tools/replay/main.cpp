@@ -0,0 +1,153 @@
+// Replays a capture written by FrameRecorder through MarketDataManager and
+// reports throughput. The digest line is stable across deterministic runs
+// of the same capture and build, so it can gate regressions.
+//
+//   replay --deterministic --latency captures/
+//   replay --speed 10 --connection 1 captures/capture-1760000000-000000.cap
+
+#include "capture/capture_reader.hpp"
+#include "capture/replay_engine.hpp"
+#include "utils/logger.hpp"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    ReplayEngine* activeReplay = nullptr;
+
+    void signalHandler(int) {
+        if (activeReplay) {
+            activeReplay->stop();
+        }
+    }
+
+    struct Options {
+        ReplayConfig replay;
+        std::vector<std::string> instruments;
+        std::vector<std::string> paths;
+        std::string prefix = "capture";
+        int repeat = 1;
+    };
+
+    void usage() {
+        std::cerr <<
+            "Usage: replay [options] <capture file or directory>...\n"
+            "  --realtime             release frames at their recorded spacing\n"
+            "  --speed X              recorded spacing divided by X\n"
+            "  --deterministic        single thread, file order, no pacing\n"
+            "  --connection N         only frames recorded on connection N\n"
+            "  --instruments A,B      books to maintain (default BTC-PERPETUAL,ETH-PERPETUAL)\n"
+            "  --max-frames N         stop after N frames\n"
+            "  --latency              time each frame and print percentiles\n"
+            "  --repeat N             replay the capture N times\n"
+            "  --prefix NAME          segment prefix when given a directory\n";
+    }
+
+    Options parseOptions(int argc, char* argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(0);
+            }
+            if (arg.compare(0, 2, "--") != 0) {
+                options.paths.push_back(arg);
+                continue;
+            }
+            if (arg == "--realtime") { options.replay.pacing = ReplayPacing::REAL_TIME; continue; }
+            if (arg == "--deterministic") { options.replay.deterministic = true; continue; }
+            if (arg == "--latency") { options.replay.measureLatency = true; continue; }
+
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            std::string value = argv[++i];
+            if (arg == "--speed") {
+                options.replay.pacing = ReplayPacing::SCALED;
+                options.replay.speed = std::stod(value);
+            } else if (arg == "--connection") {
+                options.replay.connectionId = static_cast<uint32_t>(std::stoul(value));
+            } else if (arg == "--max-frames") {
+                options.replay.maxFrames = std::stoull(value);
+            } else if (arg == "--repeat") {
+                options.repeat = std::max(1, std::stoi(value));
+            } else if (arg == "--prefix") {
+                options.prefix = value;
+            } else if (arg == "--instruments") {
+                std::istringstream list(value);
+                std::string instrument;
+                while (std::getline(list, instrument, ',')) {
+                    if (!instrument.empty()) options.instruments.push_back(instrument);
+                }
+            } else {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+        if (options.paths.empty()) {
+            throw std::invalid_argument("No capture given");
+        }
+        if (options.instruments.empty()) {
+            options.instruments = {"BTC-PERPETUAL", "ETH-PERPETUAL"};
+        }
+        return options;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parseOptions(argc, argv);
+
+        // Parse errors are still logged, but not to the terminal
+        auto& logger = Logger::getInstance();
+        logger.setLogFile("replay.log");
+        logger.setLogLevel(LogLevel::WARNING);
+
+        std::vector<std::string> segments;
+        for (const auto& path : options.paths) {
+            auto found = CaptureReader::listSegments(path, options.prefix);
+            segments.insert(segments.end(), found.begin(), found.end());
+        }
+        CaptureReader reader(segments);
+
+        for (int run = 0; run < options.repeat; ++run) {
+            // Fresh books every run so digests are comparable
+            deribit::MarketDataManager marketData("wss://replay.invalid");
+            ReplayEngine replay(marketData, options.replay);
+            for (const auto& instrument : options.instruments) {
+                replay.addInstrument(instrument);
+            }
+
+            activeReplay = &replay;
+            std::signal(SIGINT, signalHandler);
+            reader.rewind();
+            ReplayStats stats = replay.run(reader);
+            activeReplay = nullptr;
+
+            std::printf("run %d: %llu frames, %llu skipped, %.3f s, %.0f msg/s, %.1f MB/s, digest %016llx\n",
+                        run + 1,
+                        static_cast<unsigned long long>(stats.frames),
+                        static_cast<unsigned long long>(stats.skipped),
+                        stats.elapsedNs / 1e9, stats.messagesPerSecond(), stats.megabytesPerSecond(),
+                        static_cast<unsigned long long>(stats.bookDigest));
+            if (options.replay.pacing != ReplayPacing::AS_FAST_AS_POSSIBLE && !options.replay.deterministic) {
+                std::printf("  max lag behind schedule: %.1f us\n", stats.maxLagNs / 1e3);
+            }
+            if (options.replay.measureLatency && stats.latency.count() > 0) {
+                std::printf("  per frame ns - p50: %llu, p99: %llu, p99.9: %llu, max: %llu\n",
+                            static_cast<unsigned long long>(stats.latency.percentile(50)),
+                            static_cast<unsigned long long>(stats.latency.percentile(99)),
+                            static_cast<unsigned long long>(stats.latency.percentile(99.9)),
+                            static_cast<unsigned long long>(stats.latency.max()));
+            }
+        }
+        return 0;
+
+    } catch (const std::exception& e) {
+        std::cerr << "replay: " << e.what() << std::endl;
+        return 1;
+    }
+}
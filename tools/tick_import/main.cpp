@@ -0,0 +1,176 @@
+// Converts captures written by FrameRecorder into the columnar tick store:
+// top-of-book snapshots after every book update, trades and tickers, all
+// stamped with the capture receive time.
+//
+//   tick_import --out ticks --depth 10 --instruments BTC-PERPETUAL captures/
+
+#include "capture/capture_reader.hpp"
+#include "market/market_data.hpp"
+#include "storage/tick_store.hpp"
+#include "utils/logger.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    struct Options {
+        std::string output;
+        std::vector<std::string> instruments;
+        std::vector<std::string> paths;
+        std::string prefix = "capture";
+        size_t bookDepth = 10;
+        size_t rowsPerBlock = 4096;
+        uint32_t connectionId = UINT32_MAX;
+        TickInstrumentSpec spec;
+    };
+
+    void usage() {
+        std::cerr <<
+            "Usage: tick_import --out DIR [options] <capture file or directory>...\n"
+            "  --instruments A,B      instruments to keep (default BTC-PERPETUAL,ETH-PERPETUAL)\n"
+            "  --depth N              book levels per snapshot (default 10)\n"
+            "  --block-rows N         rows per compressed block (default 4096)\n"
+            "  --price-quantum X      price resolution (default 0.01)\n"
+            "  --amount-quantum X     amount resolution (default 0.0001)\n"
+            "  --connection N         only frames recorded on connection N\n"
+            "  --prefix NAME          segment prefix when given a directory\n";
+    }
+
+    Options parseOptions(int argc, char* argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(0);
+            }
+            if (arg.compare(0, 2, "--") != 0) {
+                options.paths.push_back(arg);
+                continue;
+            }
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            std::string value = argv[++i];
+            if (arg == "--out") options.output = value;
+            else if (arg == "--depth") options.bookDepth = std::stoul(value);
+            else if (arg == "--block-rows") options.rowsPerBlock = std::stoul(value);
+            else if (arg == "--price-quantum") options.spec.priceQuantum = std::stod(value);
+            else if (arg == "--amount-quantum") options.spec.amountQuantum = std::stod(value);
+            else if (arg == "--connection") options.connectionId = static_cast<uint32_t>(std::stoul(value));
+            else if (arg == "--prefix") options.prefix = value;
+            else if (arg == "--instruments") {
+                std::istringstream list(value);
+                std::string instrument;
+                while (std::getline(list, instrument, ',')) {
+                    if (!instrument.empty()) options.instruments.push_back(instrument);
+                }
+            } else {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+        if (options.output.empty() || options.paths.empty()) {
+            throw std::invalid_argument("Need --out and at least one capture");
+        }
+        if (options.instruments.empty()) {
+            options.instruments = {"BTC-PERPETUAL", "ETH-PERPETUAL"};
+        }
+        return options;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parseOptions(argc, argv);
+
+        auto& logger = Logger::getInstance();
+        logger.setLogFile("tick_import.log");
+        logger.setLogLevel(LogLevel::WARNING);
+
+        std::vector<std::string> segments;
+        for (const auto& path : options.paths) {
+            auto found = CaptureReader::listSegments(path, options.prefix);
+            segments.insert(segments.end(), found.begin(), found.end());
+        }
+        CaptureReader reader(segments);
+
+        TickStoreWriter store(options.output, options.bookDepth, options.rowsPerBlock);
+        deribit::MarketDataManager marketData("wss://import.invalid");
+        for (const auto& instrument : options.instruments) {
+            store.registerInstrument(instrument, options.spec);
+            marketData.addOrderBook(instrument);
+        }
+
+        // Callbacks run inside processMessage(), the frame time is current
+        int64_t frameTimeNs = 0;
+        std::vector<std::pair<double, double>> bids(options.bookDepth);
+        std::vector<std::pair<double, double>> asks(options.bookDepth);
+
+        marketData.setOrderBookCallback([&](const std::string& instrument, const std::string&,
+                                            const nlohmann::json&) {
+            auto book = marketData.getOrderBook(instrument);
+            if (!book) {
+                return;
+            }
+            size_t bidCount = book->getTopLevels(OrderSide::BUY, bids.data(), bids.size());
+            size_t askCount = book->getTopLevels(OrderSide::SELL, asks.data(), asks.size());
+            store.appendBook(instrument, frameTimeNs, bids.data(), bidCount, asks.data(), askCount);
+        });
+        marketData.setMarketDataCallback([&](const std::string& instrument, const std::string& channel,
+                                             const nlohmann::json& data) {
+            if (!marketData.getOrderBook(instrument)) {
+                return;  // Not one of the imported instruments
+            }
+            if (channel.find("trades") != std::string::npos && data.is_array()) {
+                for (const auto& trade : data) {
+                    TradeTick tick;
+                    tick.timeNs = frameTimeNs;
+                    tick.price = trade.value("price", 0.0);
+                    tick.amount = trade.value("amount", 0.0);
+                    tick.buyAggressor = trade.value("direction", std::string()) == "buy";
+                    store.appendTrade(instrument, tick);
+                }
+            } else if (channel.find("ticker") != std::string::npos && data.is_object()) {
+                TickerTick tick;
+                tick.timeNs = frameTimeNs;
+                tick.bestBidPrice = data.value("best_bid_price", 0.0);
+                tick.bestBidAmount = data.value("best_bid_amount", 0.0);
+                tick.bestAskPrice = data.value("best_ask_price", 0.0);
+                tick.bestAskAmount = data.value("best_ask_amount", 0.0);
+                tick.markPrice = data.value("mark_price", 0.0);
+                tick.indexPrice = data.value("index_price", 0.0);
+                store.appendTicker(instrument, tick);
+            }
+        });
+
+        uint64_t frames = 0;
+        uint64_t captureBytes = 0;
+        CaptureFrame frame;
+        std::string payload;
+        while (reader.next(frame)) {
+            if (options.connectionId != UINT32_MAX && frame.connectionId != options.connectionId) {
+                continue;
+            }
+            frameTimeNs = frame.receiveNs;
+            payload.assign(frame.data, frame.length);
+            marketData.processMessage(payload);
+            ++frames;
+            captureBytes += frame.length;
+        }
+        store.flush();
+
+        double ratio = store.getBytesWritten() > 0
+            ? static_cast<double>(captureBytes) / store.getBytesWritten() : 0.0;
+        std::printf("%llu frames, %llu JSON bytes -> %llu rows, %llu bytes (%.1fx)\n",
+                    static_cast<unsigned long long>(frames),
+                    static_cast<unsigned long long>(captureBytes),
+                    static_cast<unsigned long long>(store.getRowsWritten()),
+                    static_cast<unsigned long long>(store.getBytesWritten()), ratio);
+        return 0;
+
+    } catch (const std::exception& e) {
+        std::cerr << "tick_import: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,184 @@
+// Converts a TraceRecorder dump into Chrome trace event JSON, which
+// chrome://tracing and ui.perfetto.dev both open. Each frame becomes a
+// slice with one child per stage, and orders are linked to their acks
+// with flow arrows across threads.
+//
+//   trace_to_chrome traces/trace-20240101-120000-000.bin > trace.json
+//   trace_to_chrome --output trace.json traces/trace-20240101-120000-000.bin
+
+#include "metrics/trace_recorder.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+    struct Options {
+        std::string path;
+        std::string output;
+    };
+
+    void usage() {
+        std::cerr <<
+            "Usage: trace_to_chrome [options] <trace dump>\n"
+            "  --output FILE          write the JSON to FILE instead of stdout\n";
+    }
+
+    Options parseOptions(int argc, char* argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h") {
+                usage();
+                std::exit(0);
+            }
+            if (arg == "--output" && i + 1 < argc) {
+                options.output = argv[++i];
+            } else if (arg.compare(0, 2, "--") != 0 && options.path.empty()) {
+                options.path = arg;
+            } else {
+                throw std::invalid_argument("Unknown option " + arg);
+            }
+        }
+        if (options.path.empty()) {
+            throw std::invalid_argument("Need a trace dump");
+        }
+        return options;
+    }
+
+    class ChromeTrace {
+    public:
+        ChromeTrace(const TraceDump& dump, int64_t baseNs)
+            : m_dump(dump), m_baseNs(baseNs), m_events(nlohmann::json::array()) {}
+
+        void addThread(const TraceThread& thread) {
+            m_events.push_back({{"ph", "M"}, {"name", "thread_name"}, {"pid", 1}, {"tid", thread.tid},
+                                {"args", {{"name", thread.name + " (" + std::to_string(thread.tid) + ")"}}}});
+
+            // Events of a frame are contiguous on its thread; the start of
+            // the oldest one may have been overwritten
+            uint64_t frame = 0;
+            int64_t frameStartNs = 0;
+            int64_t lastNs = 0;
+            for (const auto& event : thread.events) {
+                switch (event.stage) {
+                    case TraceStage::FRAME_RECEIVED:
+                        frame = event.messageId;
+                        frameStartNs = lastNs = event.timeNs;
+                        break;
+                    case TraceStage::FRAME_DONE:
+                        if (frame != 0 && event.messageId == frame) {
+                            slice(thread.tid, "frame", frameStartNs, event.timeNs, event);
+                        }
+                        frame = 0;
+                        break;
+                    case TraceStage::ACK_RECEIVED:
+                        instant(thread.tid, event);
+                        flow(thread.tid, "f", event);
+                        break;
+                    default:
+                        if (frame != 0 && event.messageId == frame) {
+                            slice(thread.tid, traceStageName(event.stage), lastNs, event.timeNs, event);
+                            lastNs = event.timeNs;
+                        } else {
+                            instant(thread.tid, event);
+                        }
+                        if (event.stage == TraceStage::ORDER_SENT) {
+                            flow(thread.tid, "s", event);
+                        }
+                        break;
+                }
+            }
+        }
+
+        nlohmann::json finish() const {
+            return {
+                {"traceEvents", m_events},
+                {"displayTimeUnit", "ns"},
+                {"otherData", {{"reason", m_dump.reason}, {"base_time_ns", m_baseNs}}}
+            };
+        }
+
+    private:
+        // Microseconds from the first event, absolute times lose precision
+        double micros(int64_t timeNs) const {
+            return static_cast<double>(timeNs - m_baseNs) / 1000.0;
+        }
+
+        nlohmann::json args(const TraceEvent& event) const {
+            nlohmann::json result = {{"message", event.messageId}};
+            if (event.instrumentId != 0) {
+                auto it = m_dump.instruments.find(event.instrumentId);
+                result["instrument"] = it != m_dump.instruments.end() ? it->second
+                                                                      : std::to_string(event.instrumentId);
+            }
+            return result;
+        }
+
+        void slice(uint32_t tid, const char* name, int64_t startNs, int64_t endNs, const TraceEvent& event) {
+            m_events.push_back({{"ph", "X"}, {"name", name}, {"cat", "pipeline"}, {"pid", 1}, {"tid", tid},
+                                {"ts", micros(startNs)}, {"dur", micros(endNs) - micros(startNs)},
+                                {"args", args(event)}});
+        }
+
+        void instant(uint32_t tid, const TraceEvent& event) {
+            m_events.push_back({{"ph", "i"}, {"s", "t"}, {"name", traceStageName(event.stage)},
+                                {"cat", "pipeline"}, {"pid", 1}, {"tid", tid},
+                                {"ts", micros(event.timeNs)}, {"args", args(event)}});
+        }
+
+        void flow(uint32_t tid, const char* phase, const TraceEvent& event) {
+            nlohmann::json arrow = {{"ph", phase}, {"name", "order"}, {"cat", "order"}, {"pid", 1},
+                                    {"tid", tid}, {"id", event.messageId}, {"ts", micros(event.timeNs)}};
+            if (phase[0] == 'f') {
+                arrow["bp"] = "e";
+            }
+            m_events.push_back(std::move(arrow));
+        }
+
+        const TraceDump& m_dump;
+        int64_t m_baseNs;
+        nlohmann::json m_events;
+    };
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parseOptions(argc, argv);
+        TraceDump dump = TraceRecorder::readDump(options.path);
+
+        int64_t baseNs = dump.dumpedAtNs;
+        size_t eventCount = 0;
+        for (const auto& thread : dump.threads) {
+            if (!thread.events.empty()) {
+                baseNs = std::min(baseNs, thread.events.front().timeNs);
+            }
+            eventCount += thread.events.size();
+        }
+
+        ChromeTrace trace(dump, baseNs);
+        for (const auto& thread : dump.threads) {
+            trace.addThread(thread);
+        }
+
+        std::string json = trace.finish().dump();
+        if (options.output.empty()) {
+            std::cout << json << std::endl;
+        } else {
+            std::ofstream out(options.output);
+            if (!out.is_open()) {
+                throw std::runtime_error("Failed to open " + options.output);
+            }
+            out << json << std::endl;
+        }
+        std::cerr << "trace_to_chrome: " << eventCount << " events from " << dump.threads.size()
+                  << " threads, dumped on " << dump.reason << std::endl;
+        return 0;
+
+    } catch (const std::exception& e) {
+        std::cerr << "trace_to_chrome: " << e.what() << std::endl;
+        return 1;
+    }
+}